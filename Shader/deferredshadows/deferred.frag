@@ -228,8 +228,8 @@ void main()
 	float ao = texture(samplerAO, inUV).r;
 
 	// Debug GBuffer
-	if(uboScene.debug.debugGBuffer > 0){
-		switch (uboScene.debug.debugGBuffer) {
+	if(uboDebug.debugGBuffer > 0){
+		switch (uboDebug.debugGBuffer) {
 			case 1: 
 				outfragColor.rgb = shadow(vec3(1.0), fragPos).rgb;
 				break;
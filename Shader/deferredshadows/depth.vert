@@ -0,0 +1,23 @@
+#version 450
+
+// Position stream, full or compact layout, see util/vertex.glsl
+layout (location = 0) in vec4 inPos;
+
+#extension GL_ARB_shading_language_include : require
+#include "../util/scene.glsl"
+#include "../util/mesh.glsl"
+#include "../util/vertex.glsl"
+
+// Geometry pass tests EQUAL against this depth, must match geometry.vert bit for bit
+invariant gl_Position;
+
+void main()
+{
+	// every instance, no visible instance indirection
+	MeshDrawData mesh = ssboMeshes.meshes[meshConsts.meshIndex];
+	vec4 tmpPos = vec4(decodePosition(inPos, mesh.positionScale.xyz, mesh.positionOffset.xyz), 1.0);
+
+	mat4 modelMatrix = mesh.modelMatrix * instanceMatrix(ssboInstance.instances[gl_InstanceIndex]);
+
+	gl_Position = uboView.projectionMatrix * uboView.viewMatrix * modelMatrix * tmpPos;
+}
@@ -2,12 +2,17 @@
 
 #extension GL_ARB_shading_language_include : require
 #include "../util/mesh.glsl"
+#include "../util/virtual_texture.glsl"
+
+// Hidden fragments don't request virtual texture pages
+layout(early_fragment_tests) in;
 
 layout (location = 0) in vec3 inNormal;
 layout (location = 1) in vec2 inUV;
 layout (location = 2) in vec3 inColor;
 layout (location = 3) in vec3 inWorldPos;
 layout (location = 4) in vec3 inTangent;
+layout (location = 5) flat in uint inInstanceIndex;
 
 layout (location = 0) out vec4 outPosition;
 layout (location = 1) out vec4 outNormal;
@@ -16,35 +21,57 @@ layout (location = 3) out float outMetallic;
 layout (location = 4) out float outRoughness;
 layout (location = 5) out float outAO;
 
+vec4 sampleMaterial(Material material, uint slot, vec2 uv)
+{
+	if ((material.virtualSamplers & (1u << slot)) != 0)
+	{
+		return sampleVirtualTexture(material.textureIndices[slot], uv);
+	}
+	return texture(textures[nonuniformEXT(material.textureIndices[slot])], uv);
+}
+
 void main() 
 {
+	Material material = ssboMaterial.materials[ssboMeshes.meshes[meshConsts.meshIndex].materialIndex];
+
 	outPosition = vec4(inWorldPos, 1.0);
 
 	// Calculate normal in tangent space
 	vec3 N = normalize(inNormal);
-	vec3 T = normalize(inTangent);
-	vec3 B = cross(N, T);
-	mat3 TBN = mat3(T, B, N);
-	vec3 tnorm = TBN * normalize(texture(samplerNormalMap, inUV).xyz * 2.0 - vec3(1.0));
+	vec3 tnorm = N;
+	if((material.usedSamplers & NORMAL) != 0){
+		vec3 T = normalize(inTangent);
+		vec3 B = cross(N, T);
+		mat3 TBN = mat3(T, B, N);
+		// xy only, BC5 normal maps don't store z
+		vec2 xy = sampleMaterial(material, SLOT_NORMAL, inUV).xy * 2.0 - vec2(1.0);
+		vec3 tangentNormal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+		tnorm = TBN * normalize(tangentNormal);
+	}
 	outNormal = vec4(tnorm, 1.0);
 
-	// from matConstants
-	outAlbedo = ssboMesh.matConstants.rgba;
-	outMetallic = ssboMesh.matConstants.metallic;
-	outRoughness = ssboMesh.matConstants.roughness;
-	outAO = ssboMesh.matConstants.ao;
+	// from material constants
+	outAlbedo = material.rgba;
+	outMetallic = material.metallic;
+	outRoughness = material.roughness;
+	outAO = material.ao;
 
 	// from textures
-	if((ssboMesh.usedSamplers & ALBEDO) != 0){
-		outAlbedo = texture(samplerAlbedo, inUV);
-	}
-	if((ssboMesh.usedSamplers & METALLIC) != 0){
-		outMetallic = texture(samplerMetallic, inUV).r;
+	if((material.usedSamplers & ALBEDO) != 0){
+		outAlbedo = sampleMaterial(material, SLOT_ALBEDO, inUV);
 	}
-	if((ssboMesh.usedSamplers & ROUGHNESS) != 0){
-		outRoughness = texture(samplerRoughness, inUV).r;
-	}
-	if((ssboMesh.usedSamplers & AO) != 0){
-		outAO = texture(samplerAO, inUV).r;
+	// one fetch for the three, channels without a source texture hold their constant
+	if((material.usedSamplers & ORM) != 0){
+		vec3 orm = sampleMaterial(material, SLOT_ORM, inUV).rgb;
+		outAO = orm.r;
+		outRoughness = orm.g;
+		outMetallic = orm.b;
 	}
+
+	// per instance material
+	PerInstanceSSBO instance = ssboInstance.instances[inInstanceIndex];
+	outAlbedo *= instance.colorFactor;
+	outMetallic *= instance.materialFactors.x;
+	outRoughness *= instance.materialFactors.y;
+	outAO *= instance.materialFactors.z;
 }
\ No newline at end of file
@@ -1,15 +1,17 @@
 #version 450
 
-layout (location = 0) in vec3 inPos;
+// Full or compact layout, see util/vertex.glsl
+layout (location = 0) in vec4 inPos;
 layout (location = 1) in vec2 inUV;
-layout (location = 2) in vec3 inColor;
-layout (location = 3) in vec3 inNormal;
+layout (location = 2) in vec4 inColor;
+layout (location = 3) in vec4 inNormal;
 layout (location = 4) in vec4 inTangent;
 
 
 #extension GL_ARB_shading_language_include : require
 #include "../util/scene.glsl"
 #include "../util/mesh.glsl"
+#include "../util/vertex.glsl"
 
 
 layout (location = 0) out vec3 outNormal;
@@ -17,12 +19,22 @@ layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outColor;
 layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out vec3 outTangent;
+layout (location = 5) flat out uint outInstanceIndex;
+
+// Depth pre-pass (depth.vert) writes the depth tested EQUAL here, both compute it the same way
+invariant gl_Position;
 
 void main() 
 {
-	vec4 tmpPos = vec4(inPos.xyz, 1.0) + ssboInstance.instances[gl_InstanceIndex].instancePos;
+	// gl_InstanceIndex starts at the mesh's instanceOffset
+	uint instanceIndex = ssboVisibleInstance.indices[gl_InstanceIndex];
+	outInstanceIndex = instanceIndex;
+
+	MeshDrawData mesh = ssboMeshes.meshes[meshConsts.meshIndex];
+	vec4 tmpPos = vec4(decodePosition(inPos, mesh.positionScale.xyz, mesh.positionOffset.xyz), 1.0);
 
-	mat4 modelMatrix = ssboMesh.modelMatrix;
+	PerInstanceSSBO instance = ssboInstance.instances[instanceIndex];
+	mat4 modelMatrix = mesh.modelMatrix * instanceMatrix(instance);
 
 	gl_Position = uboView.projectionMatrix * uboView.viewMatrix * modelMatrix * tmpPos;
 
@@ -31,11 +43,11 @@ void main()
 	// Vertex position in world space
 	outWorldPos = vec3(modelMatrix * tmpPos);
 
-	// Normal in world space
-	mat3 mNormal = transpose(inverse(mat3(modelMatrix)));
-	outNormal = mNormal * normalize(inNormal);	
-	outTangent = mNormal * normalize(inTangent.xyz);
+	// Normal in world space, normal matrices are precomputed
+	mat3 mNormal = normalMatrix(mesh, instance);
+	outNormal = mNormal * decodeNormal(inNormal);
+	outTangent = mNormal * decodeTangent(inTangent, inPos).xyz;
 	
 	// Currently just vertex color
-	outColor = inColor;
+	outColor = inColor.rgb;
 }
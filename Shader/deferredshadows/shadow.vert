@@ -2,14 +2,15 @@
 
 #extension GL_ARB_shading_language_include : require
 #include "../util/mesh.glsl"
+#include "../util/vertex.glsl"
 
 layout (location = 0) in vec4 inPos;
 
-layout (location = 0) out int outInstanceIndex;
-
 void main()
 {
-	outInstanceIndex = gl_InstanceIndex;
+	// every instance casts, no visible instance indirection
+	MeshDrawData mesh = ssboMeshes.meshes[meshConsts.meshIndex];
+	mat4 modelMatrix = mesh.modelMatrix * instanceMatrix(ssboInstance.instances[gl_InstanceIndex]);
 
-	gl_Position =  ssboMesh.modelMatrix * inPos;
+	gl_Position =  modelMatrix * vec4(decodePosition(inPos, mesh.positionScale.xyz, mesh.positionOffset.xyz), 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,60 @@
+/**
+    .vh: voko header
+    Cube map texel directions & hemisphere sampling of the IBL filtering shaders
+*
+*/
+#ifndef CUBEFILTER_VH
+#define CUBEFILTER_VH
+
+const float PI = 3.1415926536;
+
+// Direction through the center of a texel of face texel.z (+X -X +Y -Y +Z -Z), as samplerCube lookups address it
+vec3 cubeDirection(ivec3 texel, int size)
+{
+	vec2 uv = (vec2(texel.xy) + 0.5) / float(size) * 2.0 - 1.0;
+	vec3 dir;
+	switch (texel.z) {
+	case 0: dir = vec3(1.0, -uv.y, -uv.x); break;
+	case 1: dir = vec3(-1.0, -uv.y, uv.x); break;
+	case 2: dir = vec3(uv.x, 1.0, uv.y); break;
+	case 3: dir = vec3(uv.x, -1.0, -uv.y); break;
+	case 4: dir = vec3(uv.x, -uv.y, 1.0); break;
+	default: dir = vec3(-uv.x, -uv.y, -1.0); break;
+	}
+	return normalize(dir);
+}
+
+vec2 hammersley2d(uint i, uint N)
+{
+	// Radical inverse based on http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+	uint bits = (i << 16u) | (i >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	float rdi = float(bits) * 2.3283064365386963e-10;
+	return vec2(float(i) / float(N), rdi);
+}
+
+// Tangent space (z up) direction to world space around normal
+vec3 tangentToWorld(vec3 H, vec3 normal)
+{
+	vec3 up = abs(normal.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+	vec3 tangentX = normalize(cross(up, normal));
+	vec3 tangentY = normalize(cross(normal, tangentX));
+	return normalize(tangentX * H.x + tangentY * H.y + normal * H.z);
+}
+
+// Environment mip whose texels cover the solid angle of a sample with pdf, out of sampleCount
+// Filtering based on https://placeholderart.wordpress.com/2015/07/28/implementation-notes-runtime-environment-map-filtering-for-image-based-lighting/
+float sampleMipLevel(float pdf, uint sampleCount, float envMapDim)
+{
+	// Solid angle of the sample
+	float omegaS = 1.0 / (float(sampleCount) * pdf);
+	// Solid angle of 1 pixel across all cube faces
+	float omegaP = 4.0 * PI / (6.0 * envMapDim * envMapDim);
+	// Biased (+1.0) mip level for better result
+	return max(0.5 * log2(omegaS / omegaP) + 1.0, 0.0);
+}
+
+#endif
@@ -0,0 +1,28 @@
+/**
+    .vh: voko header
+    Culling Tests against the scene view, include after scene.glsl
+*
+*/
+#ifndef CULLING_VH
+#define CULLING_VH
+
+bool frustumVisible(vec3 center, float radius)
+{
+	mat4 viewProj = transpose(uboView.projectionMatrix * uboView.viewMatrix);
+	vec4 planes[6] = vec4[](
+		viewProj[3] + viewProj[0],
+		viewProj[3] - viewProj[0],
+		viewProj[3] + viewProj[1],
+		viewProj[3] - viewProj[1],
+		viewProj[2],                 // near, depth range [0, 1]
+		viewProj[3] - viewProj[2]
+	);
+	for (int i = 0; i < 6; i++) {
+		vec4 plane = planes[i] / length(planes[i].xyz);
+		if (dot(plane.xyz, center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+#endif // CULLING_VH
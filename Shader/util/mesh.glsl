@@ -1,46 +1,125 @@
 /**
     .vh: voko header
-    Per Mesh Buffer Definitions 
+    Mesh Buffer Definitions 
 *
 */
 #ifndef MESH_VH
 #define MESH_VH
 
+#extension GL_EXT_nonuniform_qualifier : require
+
 // define enum EMeshSamplerFlags
 const uint ALBEDO 		= 0x01;
 const uint NORMAL 		= 0x02;
-const uint METALLIC 	= 0x04;
-const uint ROUGHNESS  	= 0x08;
-const uint AO 			= 0x10;
+// r: occlusion, g: roughness, b: metallic
+const uint ORM 			= 0x04;
 const uint ALL 			= 0xff;
 
-struct MaterialConstants{
-	vec4 rgba;
-	float metallic;
-	float roughness;
-	float ao;
-};
+// Texture slots of a material, same order as voko_global::meshSamplers
+const uint SLOT_ALBEDO 		= 0;
+const uint SLOT_NORMAL 		= 1;
+const uint SLOT_ORM 		= 2;
 
-layout (set = 1, binding = 0) readonly buffer SSBOMeshProperty
-{
+struct MeshDrawData{
 	mat4 modelMatrix;
-	uint usedSamplers;
-	MaterialConstants matConstants;
-} ssboMesh;
+	// transpose(inverse(mat3(modelMatrix))), computed on the cpu
+	mat4 normalMatrix;
+	vec4 localSphere; // xyz: mesh local center, w: radius
+	// position dequantization of compact vertices, see util/vertex.glsl
+	vec4 positionScale;
+	vec4 positionOffset;
+	uint materialIndex;
+	uint instanceOffset;
+	uint instanceCount;
+	uint padding;
+};
+layout (std430, set = 1, binding = 0) readonly buffer SSBOMeshes
+{
+	MeshDrawData meshes[];
+} ssboMeshes;
 
 
 struct PerInstanceSSBO{
-    vec4 instancePos;
+	// rows of the 3x4 mesh local transform
+	vec4 transformRows[3];
+	// rows of its normal matrix, computed on the cpu
+	vec4 normalRows[3];
+	vec4 colorFactor;
+	// x: metallic, y: roughness, z: ao
+	vec4 materialFactors;
 };
+// All meshes' instances, draws start at their mesh's instanceOffset (firstInstance)
 layout (std430, set = 1, binding = 1) readonly buffer SSBOInstance
 {
 	PerInstanceSSBO instances[]; 
 } ssboInstance;
 
-layout (set = 1, binding = 2) uniform sampler2D samplerAlbedo;
-layout (set = 1, binding = 3) uniform sampler2D samplerNormalMap;
-layout (set = 1, binding = 4) uniform sampler2D samplerMetallic;
-layout (set = 1, binding = 5) uniform sampler2D samplerRoughness;
-layout (set = 1, binding = 6) uniform sampler2D samplerAO;
+struct Material{
+	vec4 rgba;
+	float metallic;
+	float roughness;
+	float ao;
+	uint usedSamplers;
+	// index into textures[], valid when the slot's flag is in usedSamplers
+	// into virtualTextures[] instead for the slots whose flag is in virtualSamplers
+	uint textureIndices[3];
+	uint virtualSamplers;
+};
+layout (std430, set = 1, binding = 2) readonly buffer SSBOMaterial
+{
+	Material materials[];
+} ssboMaterial;
+
+// Geometry pass gl_InstanceIndex -> instances[], compacted by instance culling
+#ifdef MESH_WRITE_VISIBLE_INSTANCE
+layout (std430, set = 1, binding = 3) writeonly buffer SSBOVisibleInstance
+#else
+layout (std430, set = 1, binding = 3) readonly buffer SSBOVisibleInstance
+#endif
+{
+	uint indices[];
+} ssboVisibleInstance;
+
+// Virtual textures, sampled through their page table & the page cache (util/virtual_texture.glsl)
+struct VirtualTextureInfo{
+	// index into textures[]
+	uint pageTableIndex;
+	// first bit of the texture's pages in the feedback
+	uint feedbackOffset;
+	uint levelCount;
+	uint padding;
+};
+layout (std430, set = 1, binding = 4) readonly buffer SSBOVirtualTextures
+{
+	VirtualTextureInfo textures[];
+} ssboVirtualTextures;
+
+layout (set = 1, binding = 5) uniform sampler2D virtualPageCache;
+
+// One bit per page sampled by the geometry pass, read & cleared by the cpu after the frame
+layout (std430, set = 1, binding = 6) buffer SSBOVirtualFeedback
+{
+	// rotates the pixel that writes feedback
+	uint frame;
+	uint requests[];
+} ssboVirtualFeedback;
+
+// Bindless, variable count
+layout (set = 1, binding = 7) uniform sampler2D textures[];
+
+layout (push_constant) uniform MeshPushConsts {
+	uint meshIndex;
+} meshConsts;
+
+mat4 instanceMatrix(PerInstanceSSBO instance)
+{
+	return transpose(mat4(instance.transformRows[0], instance.transformRows[1], instance.transformRows[2], vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+// Normal matrix of mesh.modelMatrix * instanceMatrix(instance)
+mat3 normalMatrix(MeshDrawData mesh, PerInstanceSSBO instance)
+{
+	return mat3(mesh.normalMatrix) * transpose(mat3(instance.normalRows[0].xyz, instance.normalRows[1].xyz, instance.normalRows[2].xyz));
+}
 
 #endif // MESH_VH
\ No newline at end of file
@@ -72,23 +72,30 @@ struct UniformBufferDebug{
 };
 
 // declare ds set & binding; assign global const uboVar
-layout (set = 0, binding = 0) uniform UniformBufferScene
+// view, lighting & debug are separate dynamic uniform buffers, each written only when it changed
+layout (set = 0, binding = 0) uniform UniformBufferSceneView
 {
     UniformBufferView view;
-    UniformBufferLighting lighting;
-    UniformBufferDebug debug;
-} uboScene;
+} uboSceneView;
 // IBL:
 layout (set = 0, binding = 1) uniform samplerCube environmentMap;
 layout (set = 0, binding = 2) uniform samplerCube irradianceMap;
 layout (set = 0, binding = 3) uniform sampler2D brdfLut;
 layout (set = 0, binding = 4) uniform samplerCube prefilteredMap;
+layout (set = 0, binding = 5) uniform UniformBufferSceneLighting
+{
+    UniformBufferLighting lighting;
+} uboSceneLighting;
+layout (set = 0, binding = 6) uniform UniformBufferSceneDebug
+{
+    UniformBufferDebug debug;
+} uboSceneDebug;
 
 
-// e.g. translate uboView -> uboScene.view
-#define uboView uboScene.view
-#define uboLighting uboScene.lighting
-#define uboDebug uboScene.debug
+// e.g. translate uboView -> uboSceneView.view
+#define uboView uboSceneView.view
+#define uboLighting uboSceneLighting.lighting
+#define uboDebug uboSceneDebug.debug
 
 
 #endif // SCENE_VH
\ No newline at end of file
@@ -0,0 +1,41 @@
+/**
+    .vh: voko header
+    Vertex Attribute Decoding
+    Full vertices arrive as floats, compact (quantized) vertices as:
+    position: unorm16 over the mesh bounds, w: tangent handedness
+    normal & tangent: octahedral snorm16
+*
+*/
+#ifndef VERTEX_VH
+#define VERTEX_VH
+
+// Set by the pipeline from the scene meshes' vkglTF::VertexFormat
+layout (constant_id = 0) const bool COMPACT_VERTEX = false;
+
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// Mesh local position, scale & offset come from the mesh's draw data
+vec3 decodePosition(vec4 inPos, vec3 scale, vec3 offset)
+{
+	return COMPACT_VERTEX ? inPos.xyz * scale + offset : inPos.xyz;
+}
+
+vec3 decodeNormal(vec4 inNormal)
+{
+	return COMPACT_VERTEX ? octahedralDecode(inNormal.xy) : normalize(inNormal.xyz);
+}
+
+// w: bitangent sign
+vec4 decodeTangent(vec4 inTangent, vec4 inPos)
+{
+	return COMPACT_VERTEX ? vec4(octahedralDecode(inTangent.xy), inPos.w * 2.0 - 1.0) : vec4(normalize(inTangent.xyz), inTangent.w);
+}
+
+#endif // VERTEX_VH
@@ -0,0 +1,65 @@
+/**
+    .vh: voko header
+    Virtual Texture Sampling, see vks::VirtualTextureCache
+*
+*/
+#ifndef VIRTUAL_TEXTURE_VH
+#define VIRTUAL_TEXTURE_VH
+
+#include "mesh.glsl"
+
+// Same as vks::VirtualTextureCache
+const uint VT_PAGE_SIZE 	= 128;
+const uint VT_PAGE_BORDER 	= 1;
+const uint VT_SLOT_SIZE 	= VT_PAGE_SIZE + 2 * VT_PAGE_BORDER;
+// One pixel of each VT_FEEDBACK_STRIDE² block writes feedback per frame, the block is covered every VT_FEEDBACK_STRIDE² frames
+const uint VT_FEEDBACK_STRIDE = 4;
+
+void writeVirtualFeedback(VirtualTextureInfo info, uint level, ivec2 page, ivec2 pages)
+{
+	uint frame = ssboVirtualFeedback.frame % (VT_FEEDBACK_STRIDE * VT_FEEDBACK_STRIDE);
+	if (uvec2(gl_FragCoord.xy) % VT_FEEDBACK_STRIDE != uvec2(frame % VT_FEEDBACK_STRIDE, frame / VT_FEEDBACK_STRIDE))
+	{
+		return;
+	}
+	// pages are stored level by level, row by row
+	uint bit = info.feedbackOffset;
+	for (uint i = 0; i < level; i++)
+	{
+		ivec2 levelPages = max(pages >> i, ivec2(1));
+		bit += uint(levelPages.x * levelPages.y);
+	}
+	ivec2 levelPages = max(pages >> level, ivec2(1));
+	bit += uint(page.y * levelPages.x + page.x);
+	atomicOr(ssboVirtualFeedback.requests[bit >> 5], 1u << (bit & 31u));
+}
+
+// Repeating uv like the material samplers, bilinear within the finest resident page of the level the derivatives select
+vec4 sampleVirtualTexture(uint virtualIndex, vec2 uv)
+{
+	VirtualTextureInfo info = ssboVirtualTextures.textures[nonuniformEXT(virtualIndex)];
+	uint pageTable = info.pageTableIndex;
+	ivec2 pages = textureSize(textures[nonuniformEXT(pageTable)], 0);
+	vec2 size = vec2(pages * int(VT_PAGE_SIZE));
+
+	vec2 dx = dFdx(uv) * size;
+	vec2 dy = dFdy(uv) * size;
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	uint level = uint(clamp(lod, 0.0, float(info.levelCount - 1)));
+
+	vec2 wrapped = fract(uv);
+	ivec2 levelPages = max(pages >> level, ivec2(1));
+	ivec2 page = min(ivec2(wrapped * vec2(levelPages)), levelPages - 1);
+	writeVirtualFeedback(info, level, page, pages);
+
+	// xy: cache slot, z: level of the page in it
+	vec3 entry = round(texelFetch(textures[nonuniformEXT(pageTable)], page, int(level)).xyz * 255.0);
+	int residentLevel = int(entry.z);
+	ivec2 residentPages = max(pages >> residentLevel, ivec2(1));
+	// levels smaller than a page only fill part of it
+	vec2 pageExtent = min(vec2(VT_PAGE_SIZE), max(size / float(1 << residentLevel), vec2(1.0)));
+	vec2 texel = entry.xy * float(VT_SLOT_SIZE) + float(VT_PAGE_BORDER) + fract(wrapped * vec2(residentPages)) * pageExtent;
+	return textureLod(virtualPageCache, texel / vec2(textureSize(virtualPageCache, 0)), 0.0);
+}
+
+#endif // VIRTUAL_TEXTURE_VH
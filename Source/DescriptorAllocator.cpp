@@ -0,0 +1,220 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace
+{
+    // Array elements of a binding are read from consecutive DescriptorInfos
+    static_assert(sizeof(vks::DescriptorInfo) == sizeof(VkDescriptorImageInfo) && sizeof(vks::DescriptorInfo) == sizeof(VkDescriptorBufferInfo),
+        "DescriptorInfo arrays must read as image / buffer info arrays");
+
+    bool isImageDescriptor(VkDescriptorType type)
+    {
+        return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+            || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+
+    bool isBufferDescriptor(VkDescriptorType type)
+    {
+        return type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+            || type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    }
+
+    bool sameBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const VkDescriptorSetLayoutBinding& x, const VkDescriptorSetLayoutBinding& y)
+        {
+            return x.binding == y.binding && x.descriptorType == y.descriptorType && x.descriptorCount == y.descriptorCount
+                && x.stageFlags == y.stageFlags && x.pImmutableSamplers == y.pImmutableSamplers;
+        });
+    }
+}
+
+vks::DescriptorAllocator::DescriptorAllocator(vks::VulkanDevice* inVulkanDevice)
+    : vulkanDevice(inVulkanDevice)
+{
+    // Null unless the extension was enabled on the device
+    VkDevice device = vulkanDevice->logicalDevice;
+    createUpdateTemplate = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR"));
+    destroyUpdateTemplate = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR"));
+    updateWithTemplate = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR"));
+    if (!createUpdateTemplate || !destroyUpdateTemplate || !updateWithTemplate)
+    {
+        createUpdateTemplate = nullptr;
+        destroyUpdateTemplate = nullptr;
+        updateWithTemplate = nullptr;
+    }
+}
+
+vks::DescriptorAllocator::~DescriptorAllocator()
+{
+    VkDevice device = vulkanDevice->logicalDevice;
+    for (const auto& layout : layouts)
+    {
+        for (VkDescriptorPool pool : layout->pools)
+        {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+        if (layout->updateTemplate != VK_NULL_HANDLE)
+        {
+            destroyUpdateTemplate(device, layout->updateTemplate, nullptr);
+        }
+        vkDestroyDescriptorSetLayout(device, layout->layout, nullptr);
+    }
+}
+
+VkDescriptorSetLayout vks::DescriptorAllocator::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    for (const auto& layout : layouts)
+    {
+        if (sameBindings(layout->bindings, bindings))
+        {
+            return layout->layout;
+        }
+    }
+
+    // Pools need at least one descriptor type
+    if (bindings.empty())
+    {
+        vks::tools::exitFatal("Descriptor allocator layouts need at least one binding", VK_ERROR_INITIALIZATION_FAILED);
+    }
+    auto layout = std::make_unique<Layout>();
+    layout->bindings = bindings;
+    VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(bindings);
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vulkanDevice->logicalDevice, &descriptorLayout, nullptr, &layout->layout));
+
+    std::vector<VkDescriptorUpdateTemplateEntryKHR> templateEntries;
+    for (const VkDescriptorSetLayoutBinding& binding : bindings)
+    {
+        if (!isImageDescriptor(binding.descriptorType) && !isBufferDescriptor(binding.descriptorType))
+        {
+            vks::tools::exitFatal("Descriptor allocator layouts take image & buffer descriptors only", VK_ERROR_FEATURE_NOT_PRESENT);
+        }
+        auto poolSize = std::find_if(layout->poolSizes.begin(), layout->poolSizes.end(), [&](const VkDescriptorPoolSize& size)
+        {
+            return size.type == binding.descriptorType;
+        });
+        if (poolSize == layout->poolSizes.end())
+        {
+            layout->poolSizes.push_back(vks::initializers::descriptorPoolSize(binding.descriptorType, 0));
+            poolSize = layout->poolSizes.end() - 1;
+        }
+        poolSize->descriptorCount += binding.descriptorCount * SETS_PER_POOL;
+
+        VkDescriptorUpdateTemplateEntryKHR entry{};
+        entry.dstBinding = binding.binding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = binding.descriptorCount;
+        entry.descriptorType = binding.descriptorType;
+        entry.offset = layout->descriptorCount * sizeof(DescriptorInfo);
+        entry.stride = sizeof(DescriptorInfo);
+        templateEntries.push_back(entry);
+
+        layout->firstDescriptors.push_back(layout->descriptorCount);
+        layout->descriptorCount += binding.descriptorCount;
+    }
+
+    if (createUpdateTemplate)
+    {
+        VkDescriptorUpdateTemplateCreateInfoKHR templateCI{};
+        templateCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        templateCI.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+        templateCI.pDescriptorUpdateEntries = templateEntries.data();
+        templateCI.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        templateCI.descriptorSetLayout = layout->layout;
+        VK_CHECK_RESULT(createUpdateTemplate(vulkanDevice->logicalDevice, &templateCI, nullptr, &layout->updateTemplate));
+    }
+
+    layouts.push_back(std::move(layout));
+    return layouts.back()->layout;
+}
+
+VkDescriptorSet vks::DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    return allocateSet(find(layout));
+}
+
+void vks::DescriptorAllocator::release(VkDescriptorSetLayout layout, VkDescriptorSet set)
+{
+    find(layout).freeSets.push_back(set);
+}
+
+void vks::DescriptorAllocator::update(VkDescriptorSet set, VkDescriptorSetLayout layout, const std::vector<DescriptorInfo>& descriptors)
+{
+    const Layout& target = find(layout);
+    if (descriptors.size() != target.descriptorCount)
+    {
+        vks::tools::exitFatal("Descriptor set update doesn't cover its layout", VK_ERROR_INITIALIZATION_FAILED);
+    }
+    if (target.updateTemplate != VK_NULL_HANDLE)
+    {
+        updateWithTemplate(vulkanDevice->logicalDevice, set, target.updateTemplate, descriptors.data());
+        return;
+    }
+
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+    writeDescriptorSets.reserve(target.bindings.size());
+    for (size_t i = 0; i < target.bindings.size(); i++)
+    {
+        const VkDescriptorSetLayoutBinding& binding = target.bindings[i];
+        const DescriptorInfo& first = descriptors[target.firstDescriptors[i]];
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = binding.binding;
+        write.descriptorCount = binding.descriptorCount;
+        write.descriptorType = binding.descriptorType;
+        if (isImageDescriptor(binding.descriptorType))
+        {
+            write.pImageInfo = &first.image;
+        }
+        else
+        {
+            write.pBufferInfo = &first.buffer;
+        }
+        writeDescriptorSets.push_back(write);
+    }
+    vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
+vks::DescriptorAllocator::Layout& vks::DescriptorAllocator::find(VkDescriptorSetLayout layout)
+{
+    for (const auto& candidate : layouts)
+    {
+        if (candidate->layout == layout)
+        {
+            return *candidate;
+        }
+    }
+    vks::tools::exitFatal("Descriptor set layout wasn't created by the descriptor allocator", VK_ERROR_INITIALIZATION_FAILED);
+    return *layouts.front();
+}
+
+VkDescriptorSet vks::DescriptorAllocator::allocateSet(Layout& layout)
+{
+    if (!layout.freeSets.empty())
+    {
+        VkDescriptorSet set = layout.freeSets.back();
+        layout.freeSets.pop_back();
+        return set;
+    }
+
+    // Pools hold SETS_PER_POOL sets of this layout exactly, a new one once the last is full
+    if (layout.poolSets == SETS_PER_POOL)
+    {
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(layout.poolSizes, SETS_PER_POOL);
+        VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolInfo, nullptr, &pool));
+        layout.pools.push_back(pool);
+        layout.poolSets = 0;
+    }
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(layout.pools.back(), &layout.layout, 1);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &set));
+    layout.poolSets++;
+    return set;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+
+    // One descriptor of a set, as read by DescriptorAllocator::update (array bindings take one per element)
+    union DescriptorInfo
+    {
+        DescriptorInfo() : buffer{} {}
+        DescriptorInfo(const VkDescriptorImageInfo& inImage) : image(inImage) {}
+        DescriptorInfo(const VkDescriptorBufferInfo& inBuffer) : buffer(inBuffer) {}
+
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+    };
+
+    /**
+     * Descriptor set layouts deduplicated by their bindings, each with its own pools that grow by SETS_PER_POOL sets
+     * Released sets go back to their layout & are handed out again, nothing is freed until the allocator is destroyed
+     * Sets are written whole through a descriptor update template per layout (VK_KHR_descriptor_update_template), plain writes without it
+     * Fixed size image & buffer bindings only, the bindless mesh set keeps its own pool. Main thread only
+     */
+    class DescriptorAllocator
+    {
+    public:
+        static constexpr uint32_t SETS_PER_POOL = 16;
+
+        DescriptorAllocator() = delete;
+        explicit DescriptorAllocator(vks::VulkanDevice* inVulkanDevice);
+        DescriptorAllocator(const DescriptorAllocator&) = delete;
+        DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+        // Destroys the layouts & the pools, with every set allocated from them
+        ~DescriptorAllocator();
+
+        // Owned by the allocator, callers never destroy it
+        VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+        // Set of a layout from getLayout, valid until released
+        VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+        void release(VkDescriptorSetLayout layout, VkDescriptorSet set);
+
+        // Writes every binding of set: one descriptor per element, bindings in their declaration order
+        void update(VkDescriptorSet set, VkDescriptorSetLayout layout, const std::vector<DescriptorInfo>& descriptors);
+
+    private:
+        struct Layout
+        {
+            VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            // Descriptors of SETS_PER_POOL sets
+            std::vector<VkDescriptorPoolSize> poolSizes;
+            std::vector<VkDescriptorPool> pools;
+            // Sets allocated from the last pool
+            uint32_t poolSets = SETS_PER_POOL;
+            std::vector<VkDescriptorSet> freeSets;
+            // Descriptors per set, offset of each binding's first one
+            uint32_t descriptorCount = 0;
+            std::vector<uint32_t> firstDescriptors;
+            VkDescriptorUpdateTemplateKHR updateTemplate = VK_NULL_HANDLE;
+        };
+
+        Layout& find(VkDescriptorSetLayout layout);
+        VkDescriptorSet allocateSet(Layout& layout);
+
+        vks::VulkanDevice* vulkanDevice = nullptr;
+        std::vector<std::unique_ptr<Layout>> layouts;
+
+        // Null without VK_KHR_descriptor_update_template
+        PFN_vkCreateDescriptorUpdateTemplateKHR createUpdateTemplate = nullptr;
+        PFN_vkDestroyDescriptorUpdateTemplateKHR destroyUpdateTemplate = nullptr;
+        PFN_vkUpdateDescriptorSetWithTemplateKHR updateWithTemplate = nullptr;
+    };
+}
@@ -0,0 +1,272 @@
+#include "GeometryArena.h"
+
+#include <cassert>
+#include <cstring>
+#include <iterator>
+
+#include "UploadBatch.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace
+{
+    uint32_t indexSize(VkIndexType indexType)
+    {
+        return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+}
+
+vks::GeometryArena::RangeAllocator::RangeAllocator(uint32_t capacity)
+{
+    freeRanges[0] = capacity;
+    freeCount = capacity;
+}
+
+bool vks::GeometryArena::RangeAllocator::allocate(uint32_t count, uint32_t alignment, uint32_t& offset)
+{
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+    {
+        const uint32_t rangeBegin = it->first;
+        const uint32_t rangeEnd = it->first + it->second;
+        const uint32_t alignedBegin = (rangeBegin + alignment - 1) / alignment * alignment;
+        if (alignedBegin + count > rangeEnd)
+        {
+            continue;
+        }
+        freeRanges.erase(it);
+        if (alignedBegin > rangeBegin)
+        {
+            freeRanges[rangeBegin] = alignedBegin - rangeBegin;
+        }
+        if (alignedBegin + count < rangeEnd)
+        {
+            freeRanges[alignedBegin + count] = rangeEnd - (alignedBegin + count);
+        }
+        offset = alignedBegin;
+        freeCount -= count;
+        return true;
+    }
+    return false;
+}
+
+void vks::GeometryArena::RangeAllocator::free(uint32_t offset, uint32_t count)
+{
+    freeCount += count;
+
+    auto next = freeRanges.lower_bound(offset);
+    assert(next == freeRanges.end() || offset + count <= next->first);
+
+    // Merge with the following range
+    if (next != freeRanges.end() && offset + count == next->first)
+    {
+        count += next->second;
+        next = freeRanges.erase(next);
+    }
+    // Merge with the preceding range
+    if (next != freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        assert(prev->first + prev->second <= offset);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += count;
+            return;
+        }
+    }
+    freeRanges[offset] = count;
+}
+
+vks::GeometryArena::GeometryArena(vks::VulkanDevice* inVulkanDevice, VkQueue inTransferQueue, uint32_t vertexCapacityBytes, uint32_t positionCapacityBytes, uint32_t indexCapacity, VkBufferUsageFlags extraUsageFlags)
+    : vulkanDevice(inVulkanDevice), transferQueue(inTransferQueue),
+      vertexRanges(vertexCapacityBytes), positionRanges(positionCapacityBytes), indexRanges(indexCapacity)
+{
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsageFlags,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &vertexBuffer, vertexCapacityBytes));
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsageFlags,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &positionBuffer, positionCapacityBytes));
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsageFlags,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &indexBuffer, sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCapacity)));
+}
+
+vks::GeometryArena::~GeometryArena()
+{
+    destroy();
+}
+
+void vks::GeometryArena::destroy()
+{
+    for (vks::Buffer* buffer : { &vertexBuffer, &positionBuffer, &indexBuffer })
+    {
+        buffer->destroy();
+        buffer->buffer = VK_NULL_HANDLE;
+        buffer->memory = VK_NULL_HANDLE;
+    }
+}
+
+vks::GeometryArena::Allocation vks::GeometryArena::upload(const void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const void* indexData, uint32_t indexCount, VkIndexType indexType, vks::UploadBatch* batch)
+{
+    assert(indexType == VK_INDEX_TYPE_UINT16 || indexType == VK_INDEX_TYPE_UINT32);
+    Allocation allocation;
+    allocation.vertexStride = vertexStride;
+    allocation.indexType = indexType;
+    allocateStreams(vertexRanges, vertexCount, vertexStride, indexCount, indexType, allocation.vertices, allocation.indices);
+    copyStreams(vertexBuffer, allocation.vertices, vertexStride, vertexData, allocation.indices, indexType, indexData, batch);
+    return allocation;
+}
+
+void vks::GeometryArena::uploadPositions(Allocation& allocation, const void* positionData, uint32_t positionCount, uint32_t positionStride, const void* indexData, uint32_t indexCount, vks::UploadBatch* batch)
+{
+    assert(allocation.valid() && !allocation.hasPositions());
+    allocation.positionStride = positionStride;
+    allocateStreams(positionRanges, positionCount, positionStride, indexCount, allocation.indexType, allocation.positions, allocation.positionIndices);
+    copyStreams(positionBuffer, allocation.positions, positionStride, positionData, allocation.positionIndices, allocation.indexType, indexData, batch);
+}
+
+void vks::GeometryArena::allocateStreams(RangeAllocator& streamRanges, uint32_t vertexCount, uint32_t vertexStride, uint32_t indexCount, VkIndexType indexType, Range& vertices, Range& indices)
+{
+    assert(vertexCount > 0 && indexCount > 0 && vertexStride > 0);
+
+    uint32_t vertexByteOffset = 0;
+    // Stride aligned, so the first vertex is a whole vertexOffset
+    if (!streamRanges.allocate(vertexCount * vertexStride, vertexStride, vertexByteOffset))
+    {
+        vks::tools::exitFatal("Geometry arena is out of vertex space!", VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    }
+    // Whole uint32 slots, a 16 bit range starts at an even index
+    const uint32_t size = indexSize(indexType);
+    const uint32_t indexSlots = (indexCount * size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    uint32_t indexSlotOffset = 0;
+    if (!indexRanges.allocate(indexSlots, 1, indexSlotOffset))
+    {
+        vks::tools::exitFatal("Geometry arena is out of index space!", VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    }
+    indices.offset = indexSlotOffset * sizeof(uint32_t) / size;
+    vertices.offset = vertexByteOffset / vertexStride;
+    vertices.count = vertexCount;
+    indices.count = indexCount;
+}
+
+void vks::GeometryArena::copyStreams(const vks::Buffer& streamBuffer, const Range& vertices, uint32_t vertexStride, const void* vertexData, const Range& indices, VkIndexType indexType, const void* indexData, vks::UploadBatch* batch)
+{
+    const VkDeviceSize vertexSize = static_cast<VkDeviceSize>(vertexStride) * vertices.count;
+    const VkDeviceSize indexStride = indexSize(indexType);
+    const VkDeviceSize indexBytes = indexStride * indices.count;
+
+    if (batch)
+    {
+        batch->copyBuffer(vertexData, vertexSize, streamBuffer.buffer, static_cast<VkDeviceSize>(vertexStride) * vertices.offset);
+        batch->copyBuffer(indexData, indexBytes, indexBuffer.buffer, indexStride * indices.offset);
+        return;
+    }
+
+    // One staging buffer for both streams
+    vks::Buffer staging;
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &staging, vertexSize + indexBytes));
+    VK_CHECK_RESULT(staging.map());
+    memcpy(staging.mapped, vertexData, vertexSize);
+    memcpy(static_cast<uint8_t*>(staging.mapped) + vertexSize, indexData, indexBytes);
+    staging.unmap();
+
+    VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = 0;
+    copyRegion.dstOffset = static_cast<VkDeviceSize>(vertexStride) * vertices.offset;
+    copyRegion.size = vertexSize;
+    vkCmdCopyBuffer(copyCmd, staging.buffer, streamBuffer.buffer, 1, &copyRegion);
+
+    copyRegion.srcOffset = vertexSize;
+    copyRegion.dstOffset = indexStride * indices.offset;
+    copyRegion.size = indexBytes;
+    vkCmdCopyBuffer(copyCmd, staging.buffer, indexBuffer.buffer, 1, &copyRegion);
+
+    vulkanDevice->flushCommandBuffer(copyCmd, transferQueue, true);
+    staging.destroy();
+}
+
+void vks::GeometryArena::free(const Allocation& allocation)
+{
+    if (!allocation.valid())
+    {
+        return;
+    }
+    vertexRanges.free(allocation.vertices.offset * allocation.vertexStride, allocation.vertices.count * allocation.vertexStride);
+    freeIndices(allocation.indices, allocation.indexType);
+    if (allocation.hasPositions())
+    {
+        positionRanges.free(allocation.positions.offset * allocation.positionStride, allocation.positions.count * allocation.positionStride);
+        freeIndices(allocation.positionIndices, allocation.indexType);
+    }
+}
+
+void vks::GeometryArena::freeIndices(const Range& indices, VkIndexType indexType)
+{
+    const uint32_t size = indexSize(indexType);
+    indexRanges.free(indices.offset * size / sizeof(uint32_t), (indices.count * size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+}
+
+bool vks::GeometryArena::acquireShared(const std::string& key, Allocation& allocation)
+{
+    auto it = sharedAllocations.find(key);
+    if (it == sharedAllocations.end())
+    {
+        return false;
+    }
+    it->second.refCount++;
+    allocation = it->second.allocation;
+    return true;
+}
+
+void vks::GeometryArena::registerShared(const std::string& key, const Allocation& allocation)
+{
+    SharedEntry& entry = sharedAllocations[key];
+    assert(entry.refCount == 0);
+    entry.allocation = allocation;
+    entry.refCount = 1;
+}
+
+void vks::GeometryArena::release(const Allocation& allocation)
+{
+    for (auto it = sharedAllocations.begin(); it != sharedAllocations.end(); ++it)
+    {
+        const Allocation& shared = it->second.allocation;
+        if (shared.vertices.offset != allocation.vertices.offset || shared.vertexStride != allocation.vertexStride || shared.indices.offset != allocation.indices.offset)
+        {
+            continue;
+        }
+        if (--it->second.refCount == 0)
+        {
+            free(it->second.allocation);
+            sharedAllocations.erase(it);
+        }
+        return;
+    }
+    // Never shared
+    free(allocation);
+}
+
+void vks::GeometryArena::bindBuffers(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+{
+    const VkDeviceSize offsets[1] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+    bindIndexBuffer(commandBuffer, indexType);
+}
+
+void vks::GeometryArena::bindPositionBuffers(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+{
+    const VkDeviceSize offsets[1] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positionBuffer.buffer, offsets);
+    bindIndexBuffer(commandBuffer, indexType);
+}
+
+void vks::GeometryArena::bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+{
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, indexType);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+    class UploadBatch;
+
+    /**
+     * Shared device local vertex & index buffers that all models are sub-allocated from
+     * Ranges are counted in elements (vertices / indices), draws address them through firstIndex & vertexOffset,
+     * so every arena model is drawn with the same two buffers bound
+     * 16 bit index ranges live in the same index buffer (4 byte aligned), passes rebind it with the allocation's index type
+     * Vertex ranges start at a multiple of their own stride, models with different vertex layouts can share the arena
+     * Models may add a position only stream (own vertex buffer, indices in the shared index buffer) for depth only passes
+     * Freed ranges go back to a coalescing free list, loading & unloading never touches device memory
+     */
+    class GeometryArena
+    {
+    public:
+        struct Range
+        {
+            uint32_t offset = 0;
+            uint32_t count = 0;
+        };
+
+        struct Allocation
+        {
+            Range vertices;
+            Range indices;
+            uint32_t vertexStride = 0;
+            // Of both index ranges, their offset & count are in elements of this type
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+            // Optional position only stream
+            Range positions;
+            Range positionIndices;
+            uint32_t positionStride = 0;
+            bool valid() const { return vertices.count > 0 && indices.count > 0; }
+            bool hasPositions() const { return positions.count > 0 && positionIndices.count > 0; }
+        };
+
+        GeometryArena() = delete;
+        GeometryArena(vks::VulkanDevice* inVulkanDevice, VkQueue inTransferQueue, uint32_t vertexCapacityBytes, uint32_t positionCapacityBytes, uint32_t indexCapacity, VkBufferUsageFlags extraUsageFlags = 0);
+        ~GeometryArena();
+        // Frees the device buffers ahead of the arena, for models outliving the device (ranges can still be released)
+        void destroy();
+
+        // Sub-allocate & upload, indices (uint16 or uint32) are relative to the allocation's first vertex
+        // With a batch the copies are only recorded, the range is readable once the batch is flushed
+        Allocation upload(const void* vertexData, uint32_t vertexCount, uint32_t vertexStride, const void* indexData, uint32_t indexCount, VkIndexType indexType = VK_INDEX_TYPE_UINT32, vks::UploadBatch* batch = nullptr);
+        // Add the position stream to an uploaded allocation, indices are relative to the first position & of the allocation's index type
+        void uploadPositions(Allocation& allocation, const void* positionData, uint32_t positionCount, uint32_t positionStride, const void* indexData, uint32_t indexCount, vks::UploadBatch* batch = nullptr);
+        void free(const Allocation& allocation);
+
+        // Same geometry loaded again (same file, flags & scale) shares one allocation, key must cover everything that changes the data
+        bool acquireShared(const std::string& key, Allocation& allocation);
+        void registerShared(const std::string& key, const Allocation& allocation);
+        // Drops one reference, the range is freed with the last one
+        void release(const Allocation& allocation);
+
+        void bindBuffers(VkCommandBuffer commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
+        // Position stream & shared index buffer, draws use the allocation's position ranges
+        void bindPositionBuffers(VkCommandBuffer commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
+        // Switch the shared index buffer's type between draws of differently indexed allocations
+        void bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType) const;
+
+        VkBuffer getVertexBuffer() const { return vertexBuffer.buffer; }
+        VkBuffer getIndexBuffer() const { return indexBuffer.buffer; }
+        // Whole index buffer as a storage buffer, needs VK_BUFFER_USAGE_STORAGE_BUFFER_BIT in extraUsageFlags
+        const VkDescriptorBufferInfo& getIndexDescriptor() const { return indexBuffer.descriptor; }
+
+    private:
+        // First fit over free ranges keyed by offset, neighbours are merged on free
+        class RangeAllocator
+        {
+        public:
+            explicit RangeAllocator(uint32_t capacity);
+            // offset is aligned to a multiple of alignment, the skipped head stays free
+            bool allocate(uint32_t count, uint32_t alignment, uint32_t& offset);
+            void free(uint32_t offset, uint32_t count);
+            uint32_t getFreeCount() const { return freeCount; }
+        private:
+            std::map<uint32_t, uint32_t> freeRanges;
+            uint32_t freeCount = 0;
+        };
+
+        void allocateStreams(RangeAllocator& streamRanges, uint32_t vertexCount, uint32_t vertexStride, uint32_t indexCount, VkIndexType indexType, Range& vertices, Range& indices);
+        void copyStreams(const vks::Buffer& streamBuffer, const Range& vertices, uint32_t vertexStride, const void* vertexData, const Range& indices, VkIndexType indexType, const void* indexData, vks::UploadBatch* batch);
+        void freeIndices(const Range& indices, VkIndexType indexType);
+
+        struct SharedEntry
+        {
+            Allocation allocation;
+            uint32_t refCount = 0;
+        };
+
+        vks::VulkanDevice* vulkanDevice = nullptr;
+        VkQueue transferQueue = VK_NULL_HANDLE;
+
+        vks::Buffer vertexBuffer;
+        vks::Buffer positionBuffer;
+        vks::Buffer indexBuffer;
+        // in bytes
+        RangeAllocator vertexRanges;
+        RangeAllocator positionRanges;
+        // in uint32 slots
+        RangeAllocator indexRanges;
+
+        std::unordered_map<std::string, SharedEntry> sharedAllocations;
+    };
+}
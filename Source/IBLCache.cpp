@@ -0,0 +1,160 @@
+#include "IBLCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+#include <ktx.h>
+
+#include "MeshCache.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace
+{
+    // gl_format.h isn't part of the public ktx headers
+    constexpr ktx_uint32_t GL_RG16F = 0x822F;
+    constexpr ktx_uint32_t GL_RGBA16F = 0x881A;
+    constexpr ktx_uint32_t GL_RGBA32F = 0x8814;
+    // Key value entry of cached maps
+    constexpr const char* KEY_KEY = "VokoIBLKey";
+
+    ktx_uint32_t glInternalFormat(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R16G16_SFLOAT:
+            return GL_RG16F;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return GL_RGBA16F;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return GL_RGBA32F;
+        default:
+            return 0;
+        }
+    }
+}
+
+uint64_t vks::iblcache::key(uint64_t sourceHash, const std::vector<uint32_t>& settings, const std::vector<std::string>& shaderFilenames)
+{
+    uint64_t key = vks::meshcache::hash(&VERSION, sizeof(VERSION));
+    key = vks::meshcache::hash(&sourceHash, sizeof(sourceHash), key);
+    key = vks::meshcache::hash(settings.data(), settings.size() * sizeof(uint32_t), key);
+    for (const std::string& filename : shaderFilenames)
+    {
+        const uint64_t shaderHash = vks::meshcache::hashFile(filename);
+        key = vks::meshcache::hash(&shaderHash, sizeof(shaderHash), key);
+    }
+    return key;
+}
+
+bool vks::iblcache::isCurrent(const std::string& filename, uint64_t key)
+{
+    ktxTexture* texture = nullptr;
+    if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &texture) != KTX_SUCCESS)
+    {
+        return false;
+    }
+    unsigned int valueLength = 0;
+    void* value = nullptr;
+    const bool current = ktxHashList_FindValue(&texture->kvDataHead, KEY_KEY, &valueLength, &value) == KTX_SUCCESS
+        && valueLength == sizeof(key) && memcmp(value, &key, sizeof(key)) == 0;
+    ktxTexture_Destroy(texture);
+    return current;
+}
+
+bool vks::iblcache::write(const std::string& filename, uint64_t key, VkImage image, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t faceCount,
+    vks::VulkanDevice* device, VkQueue queue)
+{
+    const ktx_uint32_t glFormat = glInternalFormat(format);
+    if (glFormat == 0)
+    {
+        return false;
+    }
+
+    ktxTextureCreateInfo createInfo{};
+    createInfo.glInternalformat = glFormat;
+    createInfo.baseWidth = dim;
+    createInfo.baseHeight = dim;
+    createInfo.baseDepth = 1;
+    createInfo.numDimensions = 2;
+    createInfo.numLevels = mipLevels;
+    createInfo.numLayers = 1;
+    createInfo.numFaces = faceCount;
+    createInfo.isArray = KTX_FALSE;
+    createInfo.generateMipmaps = KTX_FALSE;
+    ktxTexture* texture = nullptr;
+    if (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS)
+    {
+        return false;
+    }
+
+    // Read back into the ktx layout directly, texels are 4 / 8 / 16 bytes so rows & images need no padding
+    std::vector<VkBufferImageCopy> copyRegions;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        for (uint32_t face = 0; face < faceCount; face++)
+        {
+            ktx_size_t offset;
+            ktxTexture_GetImageOffset(texture, level, 0, face, &offset);
+            VkBufferImageCopy copyRegion{};
+            copyRegion.bufferOffset = offset;
+            copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.imageSubresource.mipLevel = level;
+            copyRegion.imageSubresource.baseArrayLayer = face;
+            copyRegion.imageSubresource.layerCount = 1;
+            copyRegion.imageExtent.width = std::max(1u, dim >> level);
+            copyRegion.imageExtent.height = std::max(1u, dim >> level);
+            copyRegion.imageExtent.depth = 1;
+            copyRegions.push_back(copyRegion);
+        }
+    }
+
+    const ktx_size_t dataSize = ktxTexture_GetDataSize(texture);
+    vks::Buffer readback;
+    VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &readback, dataSize));
+
+    VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    VkImageSubresourceRange subresourceRange = {};
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.levelCount = mipLevels;
+    subresourceRange.layerCount = faceCount;
+    vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+    vkCmdCopyImageToBuffer(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+    vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+    // Copy visible to the host once the fence signals
+    VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.buffer = readback.buffer;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+    device->flushCommandBuffer(copyCmd, queue);
+
+    VK_CHECK_RESULT(readback.map());
+    memcpy(ktxTexture_GetData(texture), readback.mapped, dataSize);
+    readback.destroy();
+
+    // Written to a temporary file & renamed like cooked textures, a failed write only costs the next launch another generation
+    ktxHashList_AddKVPair(&texture->kvDataHead, KEY_KEY, sizeof(key), &key);
+    const std::string tempFilename = filename + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    bool written = false;
+    if (ktxTexture_WriteToNamedFile(texture, tempFilename.c_str()) == KTX_SUCCESS)
+    {
+        std::error_code error;
+        std::filesystem::rename(tempFilename, filename, error);
+        written = !error;
+    }
+    if (!written)
+    {
+        std::remove(tempFilename.c_str());
+    }
+    ktxTexture_Destroy(texture);
+    return written;
+}
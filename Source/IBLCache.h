@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+
+    /**
+     * Precomputed image based lighting maps cached as KTX files
+     * Each file is stamped with a key of what it was generated from: the source's content, the settings & the generating shaders
+     * Stale or missing files are generated again & read back from the GPU once
+     */
+    namespace iblcache
+    {
+        // Bump when the generation changes in a way the settings & shaders don't cover
+        constexpr uint32_t VERSION = 1;
+
+        // sourceHash is 0 for maps that don't depend on a source (the BRDF LUT)
+        uint64_t key(uint64_t sourceHash, const std::vector<uint32_t>& settings, const std::vector<std::string>& shaderFilenames);
+
+        // Reads the key value data of filename only
+        bool isCurrent(const std::string& filename, uint64_t key);
+
+        // Reads every level & face of image (TRANSFER_SRC usage, SHADER_READ_ONLY layout before & after) back & writes it stamped with key
+        // Float formats the generation uses only, false when the file couldn't be written
+        bool write(const std::string& filename, uint64_t key, VkImage image, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t faceCount,
+            vks::VulkanDevice* device, VkQueue queue);
+    }
+}
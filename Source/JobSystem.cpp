@@ -0,0 +1,168 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+bool vks::JobSystem::Handle::done() const
+{
+    return !job || job->finished.load(std::memory_order_acquire);
+}
+
+vks::JobSystem::JobSystem(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+vks::JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobQueued.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+vks::JobSystem::Handle vks::JobSystem::submit(std::function<void()> function, const std::vector<Handle>& dependencies, Priority priority)
+{
+    Handle handle;
+    handle.job = std::make_shared<Job>();
+    handle.job->function = std::move(function);
+    handle.job->priority = priority;
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Handle& dependency : dependencies)
+        {
+            if (dependency.job && !dependency.job->finished)
+            {
+                dependency.job->dependents.push_back(handle.job);
+                handle.job->dependencies.push_back(dependency.job);
+                handle.job->pendingDependencies++;
+            }
+        }
+        ready = handle.job->pendingDependencies == 0;
+        if (ready)
+        {
+            enqueue(handle.job);
+        }
+    }
+    if (ready)
+    {
+        jobQueued.notify_one();
+    }
+    return handle;
+}
+
+void vks::JobSystem::wait(const Handle& handle)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!handle.done())
+    {
+        // Run the awaited job if it's still queued behind others, unrelated jobs could take arbitrarily long
+        std::shared_ptr<Job> job = takeQueued(handle.job);
+        if (job)
+        {
+            lock.unlock();
+            run(job);
+            lock.lock();
+            continue;
+        }
+        jobFinished.wait(lock);
+    }
+}
+
+void vks::JobSystem::wait(const std::vector<Handle>& handles)
+{
+    for (const Handle& handle : handles)
+    {
+        wait(handle);
+    }
+}
+
+void vks::JobSystem::workerLoop()
+{
+    for (;;)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobQueued.wait(lock, [this] { return stopping || !readyJobs.empty() || !frameJobs.empty(); });
+            // Queues are drained before stopping, dependents of running jobs are picked up by the last workers
+            std::deque<std::shared_ptr<Job>>& jobs = !frameJobs.empty() ? frameJobs : readyJobs;
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            job->queued = false;
+        }
+        run(job);
+    }
+}
+
+void vks::JobSystem::run(const std::shared_ptr<Job>& job)
+{
+    job->function();
+
+    size_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->function = nullptr;
+        job->finished.store(true, std::memory_order_release);
+        for (std::shared_ptr<Job>& dependent : job->dependents)
+        {
+            if (--dependent->pendingDependencies == 0)
+            {
+                enqueue(dependent);
+                queued++;
+            }
+        }
+        job->dependents.clear();
+    }
+    if (queued > 0)
+    {
+        jobQueued.notify_all();
+    }
+    jobFinished.notify_all();
+}
+
+void vks::JobSystem::enqueue(const std::shared_ptr<Job>& job)
+{
+    job->dependencies.clear();
+    job->queued = true;
+    (job->priority == Priority::Frame ? frameJobs : readyJobs).push_back(job);
+}
+
+std::shared_ptr<vks::JobSystem::Job> vks::JobSystem::takeQueued(const std::shared_ptr<Job>& job)
+{
+    if (job->queued)
+    {
+        std::deque<std::shared_ptr<Job>>& jobs = job->priority == Priority::Frame ? frameJobs : readyJobs;
+        jobs.erase(std::find(jobs.begin(), jobs.end(), job));
+        job->queued = false;
+        return job;
+    }
+    for (const std::shared_ptr<Job>& dependency : job->dependencies)
+    {
+        if (!dependency->finished)
+        {
+            if (std::shared_ptr<Job> queued = takeQueued(dependency))
+            {
+                return queued;
+            }
+        }
+    }
+    return nullptr;
+}
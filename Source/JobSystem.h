@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+    /**
+     * Fixed pool of worker threads for cpu side asset work (file reads, parsing, decoding, vertex processing) & per frame cpu culling
+     * A job is queued once every job it depends on has finished, its handle is waited on or passed as a dependency
+     * Frame jobs (per frame culling) have their own queue, workers take them before any queued asset job
+     * Jobs must not use the queue or its command pool, their gpu work is recorded on the main thread (vks::UploadBatch)
+     */
+    class JobSystem
+    {
+        struct Job;
+
+    public:
+        enum class Priority
+        {
+            // Asset loading, may run across many frames
+            Normal,
+            // Awaited by the render thread within the frame
+            Frame
+        };
+
+        class Handle
+        {
+        public:
+            bool valid() const { return job != nullptr; }
+            // Doesn't block, true for empty handles
+            bool done() const;
+
+        private:
+            friend class JobSystem;
+            std::shared_ptr<Job> job;
+        };
+
+        // 0: one worker per hardware thread besides the calling one, at least one
+        explicit JobSystem(uint32_t workerCount = 0);
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+        // Finishes every submitted job before joining the workers
+        ~JobSystem();
+
+        Handle submit(std::function<void()> function, const std::vector<Handle>& dependencies = {}, Priority priority = Priority::Normal);
+        // The calling thread runs the awaited jobs & their queued dependencies itself, never unrelated jobs, until they have finished
+        void wait(const Handle& handle);
+        void wait(const std::vector<Handle>& handles);
+
+        uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    private:
+        struct Job
+        {
+            std::function<void()> function;
+            // Queued when the last of their dependencies finishes
+            std::vector<std::shared_ptr<Job>> dependents;
+            // Unfinished ones until the job is queued, for waiters to run them
+            std::vector<std::shared_ptr<Job>> dependencies;
+            uint32_t pendingDependencies = 0;
+            Priority priority = Priority::Normal;
+            // In readyJobs / frameJobs, guarded by the mutex
+            bool queued = false;
+            std::atomic<bool> finished = false;
+        };
+
+        void workerLoop();
+        // Runs the job & queues its ready dependents, called without the lock
+        void run(const std::shared_ptr<Job>& job);
+        // Called with the lock held
+        void enqueue(const std::shared_ptr<Job>& job);
+        // Removes job, or else one of its dependencies, from the queues if it's waiting there, null otherwise. Called with the lock held
+        std::shared_ptr<Job> takeQueued(const std::shared_ptr<Job>& job);
+
+        std::mutex mutex;
+        std::condition_variable jobQueued;
+        std::condition_variable jobFinished;
+        std::deque<std::shared_ptr<Job>> readyJobs;
+        std::deque<std::shared_ptr<Job>> frameJobs;
+        std::vector<std::thread> workers;
+        bool stopping = false;
+    };
+}
@@ -0,0 +1,254 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+    namespace meshcache
+    {
+        namespace
+        {
+            constexpr uint64_t HASH_PRIME = 0x100000001b3ull;
+
+            uint64_t alignSection(uint64_t offset)
+            {
+                return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+            }
+        }
+
+        uint64_t hash(const void* data, size_t size, uint64_t seed)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            uint64_t result = seed;
+            for (size_t i = 0; i < size; i++)
+            {
+                result ^= bytes[i];
+                result *= HASH_PRIME;
+            }
+            return result;
+        }
+
+        uint64_t hashFile(const std::string& filename)
+        {
+            MappedFile file;
+            if (!file.open(filename))
+            {
+                return 0;
+            }
+            return hash(file.data(), file.size());
+        }
+
+        uint64_t fileStamp(const std::string& filename)
+        {
+            std::error_code error;
+            const uint64_t size = std::filesystem::file_size(filename, error);
+            if (error)
+            {
+                return 0;
+            }
+            const auto writeTime = std::filesystem::last_write_time(filename, error);
+            if (error)
+            {
+                return 0;
+            }
+            const int64_t ticks = writeTime.time_since_epoch().count();
+            return hash(&ticks, sizeof(ticks), hash(&size, sizeof(size)));
+        }
+
+        MappedFile::~MappedFile()
+        {
+            close();
+        }
+
+        bool MappedFile::open(const std::string& filename)
+        {
+            close();
+#if defined(_WIN32)
+            HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+            LARGE_INTEGER fileSize{};
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            {
+                CloseHandle(file);
+                return false;
+            }
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (!view)
+            {
+                if (mapping)
+                {
+                    CloseHandle(mapping);
+                }
+                CloseHandle(file);
+                return false;
+            }
+            fileHandle = file;
+            mappingHandle = mapping;
+            mappedData = static_cast<const uint8_t*>(view);
+            mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+            const int file = ::open(filename.c_str(), O_RDONLY);
+            if (file < 0)
+            {
+                return false;
+            }
+            struct stat fileStat{};
+            if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+            {
+                ::close(file);
+                return false;
+            }
+            void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+            // The mapping keeps the file referenced
+            ::close(file);
+            if (view == MAP_FAILED)
+            {
+                return false;
+            }
+            mappedData = static_cast<const uint8_t*>(view);
+            mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+            return true;
+        }
+
+        void MappedFile::close()
+        {
+            if (!mappedData)
+            {
+                return;
+            }
+#if defined(_WIN32)
+            UnmapViewOfFile(mappedData);
+            CloseHandle(static_cast<HANDLE>(mappingHandle));
+            CloseHandle(static_cast<HANDLE>(fileHandle));
+            mappingHandle = nullptr;
+            fileHandle = nullptr;
+#else
+            munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+#endif
+            mappedData = nullptr;
+            mappedSize = 0;
+        }
+
+        bool Reader::open(const std::string& filename, uint64_t settingsHash)
+        {
+            if (!file.open(filename))
+            {
+                return false;
+            }
+            if (file.size() < sizeof(Header) || header().magic != MAGIC || header().version != VERSION || header().settingsHash != settingsHash)
+            {
+                file.close();
+                return false;
+            }
+            const uint64_t tableEnd = sizeof(Header) + static_cast<uint64_t>(header().sectionCount) * sizeof(Section);
+            if (tableEnd > file.size())
+            {
+                file.close();
+                return false;
+            }
+            const Section* sections = reinterpret_cast<const Section*>(file.data() + sizeof(Header));
+            for (uint32_t i = 0; i < header().sectionCount; i++)
+            {
+                // Offset checked first, file.size() - offset would wrap around
+                if (sections[i].offset % SECTION_ALIGNMENT != 0 || sections[i].offset < tableEnd || sections[i].offset > file.size()
+                    || sections[i].size > file.size() - sections[i].offset)
+                {
+                    file.close();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        const void* Reader::section(uint32_t index, size_t& size) const
+        {
+            size = 0;
+            if (index >= header().sectionCount)
+            {
+                return nullptr;
+            }
+            const Section& range = reinterpret_cast<const Section*>(file.data() + sizeof(Header))[index];
+            size = static_cast<size_t>(range.size);
+            return size > 0 ? file.data() + range.offset : nullptr;
+        }
+
+        void Writer::addSection(const void* data, size_t size)
+        {
+            sections.emplace_back(data, size);
+        }
+
+        bool Writer::write(const std::string& filename, uint64_t sourceHash, uint64_t sourceStamp, uint64_t settingsHash) const
+        {
+            Header header{};
+            header.sectionCount = static_cast<uint32_t>(sections.size());
+            header.sourceHash = sourceHash;
+            header.sourceStamp = sourceStamp;
+            header.settingsHash = settingsHash;
+
+            std::vector<Section> table(sections.size());
+            uint64_t offset = alignSection(sizeof(Header) + table.size() * sizeof(Section));
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                table[i].offset = offset;
+                table[i].size = sections[i].second;
+                offset = alignSection(offset + sections[i].second);
+            }
+
+            // Per thread, models importing the same file in parallel don't write into each other's file
+            const std::string tempFilename = filename + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+            {
+                std::ofstream stream(tempFilename, std::ios::binary | std::ios::trunc);
+                if (!stream)
+                {
+                    return false;
+                }
+                stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                stream.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(Section)));
+                const char zeros[SECTION_ALIGNMENT] = {};
+                uint64_t written = sizeof(Header) + table.size() * sizeof(Section);
+                for (size_t i = 0; i < sections.size(); i++)
+                {
+                    stream.write(zeros, static_cast<std::streamsize>(table[i].offset - written));
+                    stream.write(static_cast<const char*>(sections[i].first), static_cast<std::streamsize>(sections[i].second));
+                    written = table[i].offset + sections[i].second;
+                }
+                if (!stream)
+                {
+                    stream.close();
+                    std::remove(tempFilename.c_str());
+                    return false;
+                }
+            }
+
+            std::error_code error;
+            std::filesystem::rename(tempFilename, filename, error);
+            if (error)
+            {
+                std::remove(tempFilename.c_str());
+                return false;
+            }
+            return true;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vks
+{
+    /**
+     * Cooked (preprocessed) mesh files
+     * A header, a section table & the sections, each aligned to SECTION_ALIGNMENT, written in one go
+     * Files are mapped read only when loaded, section data is copied straight into staging / the geometry arena
+     * What the sections hold is up to the writer, see vkglTF::Model::loadCooked
+     */
+    namespace meshcache
+    {
+        // "VKMC"
+        constexpr uint32_t MAGIC = 0x434d4b56;
+        // Bump when the layout of the header or of any section record changes
+        constexpr uint32_t VERSION = 2;
+        constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+        struct Section
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        struct Header
+        {
+            uint32_t magic = MAGIC;
+            uint32_t version = VERSION;
+            uint32_t sectionCount = 0;
+            uint32_t padding = 0;
+            // Content of the cooked source
+            uint64_t sourceHash = 0;
+            // Size & write time of the cooked source, the content is only rehashed when this changes
+            uint64_t sourceStamp = 0;
+            // Everything else the cooked data depends on (loading flags, scale, record layouts)
+            uint64_t settingsHash = 0;
+        };
+
+        // FNV-1a, chain calls through seed
+        constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+        uint64_t hash(const void* data, size_t size, uint64_t seed = HASH_SEED);
+        // Hash of the file's content, 0 when it can't be read
+        uint64_t hashFile(const std::string& filename);
+        // Size & last write time of the file, 0 when it doesn't exist
+        uint64_t fileStamp(const std::string& filename);
+
+        /**
+         * Read only memory mapping of a whole file
+         */
+        class MappedFile
+        {
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            ~MappedFile();
+
+            bool open(const std::string& filename);
+            void close();
+
+            const uint8_t* data() const { return mappedData; }
+            size_t size() const { return mappedSize; }
+
+        private:
+            const uint8_t* mappedData = nullptr;
+            size_t mappedSize = 0;
+#if defined(_WIN32)
+            void* fileHandle = nullptr;
+            void* mappingHandle = nullptr;
+#endif
+        };
+
+        /**
+         * Maps a cooked file & validates its header & section table
+         */
+        class Reader
+        {
+        public:
+            // False when the file is missing, truncated, of another version or cooked with other settings
+            bool open(const std::string& filename, uint64_t settingsHash);
+            void close() { file.close(); }
+
+            const Header& header() const { return *reinterpret_cast<const Header*>(file.data()); }
+            uint32_t sectionCount() const { return header().sectionCount; }
+
+            // Null for empty sections, stays valid until the reader is destroyed
+            const void* section(uint32_t index, size_t& size) const;
+            // Typed section, false when its size isn't a multiple of T
+            template <typename T>
+            bool section(uint32_t index, const T*& data, size_t& count) const
+            {
+                size_t size = 0;
+                data = static_cast<const T*>(section(index, size));
+                count = size / sizeof(T);
+                return size % sizeof(T) == 0;
+            }
+
+        private:
+            MappedFile file;
+        };
+
+        /**
+         * Collects sections & writes them as a cooked file
+         * Sections are referenced, not copied, their data must stay alive until write
+         */
+        class Writer
+        {
+        public:
+            void addSection(const void* data, size_t size);
+            template <typename T>
+            void addSection(const std::vector<T>& data)
+            {
+                addSection(data.data(), data.size() * sizeof(T));
+            }
+
+            // Written to a temporary file & renamed, readers never see a partial file
+            bool write(const std::string& filename, uint64_t sourceHash, uint64_t sourceStamp, uint64_t settingsHash) const;
+
+        private:
+            std::vector<std::pair<const void*, size_t>> sections;
+        };
+    }
+}
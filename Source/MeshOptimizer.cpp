@@ -0,0 +1,820 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+    // FIFO post-transform cache, entries are pushed on misses
+    class FifoCache
+    {
+    public:
+        FifoCache(size_t vertexCount, uint32_t inCacheSize) : timestamps(vertexCount, 0), cacheSize(inCacheSize), time(inCacheSize + 1) {}
+
+        // Returns true on a miss
+        bool access(uint32_t vertex)
+        {
+            if (time - timestamps[vertex] > cacheSize)
+            {
+                timestamps[vertex] = time++;
+                return true;
+            }
+            return false;
+        }
+        void reset() { time += cacheSize + 1; }
+
+    private:
+        std::vector<uint32_t> timestamps;
+        uint32_t cacheSize;
+        uint32_t time;
+    };
+
+    // Forsyth's scoring, tuned for a 32 entry LRU cache
+    constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+    constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    constexpr float FORSYTH_LAST_TRI_SCORE = 0.75f;
+    constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+    float vertexScore(int cachePosition, uint32_t remainingValence)
+    {
+        // No triangles left, never picked again
+        if (remainingValence == 0)
+        {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // The last triangle's vertices get a fixed score, so the next one doesn't just reuse its edge
+            if (cachePosition < 3)
+            {
+                score = FORSYTH_LAST_TRI_SCORE;
+            }
+            else
+            {
+                const float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+            }
+        }
+        // Finish off vertices with few triangles left, before they drop out of the cache
+        score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingValence), -FORSYTH_VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    glm::vec3 loadPosition(const float* positions, size_t positionStride, uint32_t vertex)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + positionStride * vertex);
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    // Symmetric 4x4 plane quadric (Garland & Heckbert) with its accumulated area weight
+    struct Quadric
+    {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+        double weight = 0.0;
+
+        void addPlane(const glm::vec3& n, float d, float w)
+        {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+            a22 += w * n.z * n.z; a23 += w * n.z * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            weight += q.weight;
+        }
+
+        // Area weighted sum of squared plane distances
+        double evaluate(const glm::vec3& p) const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+            return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                + a22 * z * z + 2.0 * a23 * z
+                + a33;
+        }
+    };
+}
+
+vks::optimizer::VertexCacheStatistics vks::optimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStatistics statistics;
+    if (indexCount < 3)
+    {
+        return statistics;
+    }
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t misses = 0;
+    size_t referencedCount = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        const uint32_t vertex = indices[i];
+        assert(vertex < vertexCount);
+        misses += cache.access(vertex) ? 1 : 0;
+        if (!referenced[vertex])
+        {
+            referenced[vertex] = true;
+            referencedCount++;
+        }
+    }
+    statistics.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    statistics.atvr = static_cast<float>(misses) / static_cast<float>(referencedCount);
+    return statistics;
+}
+
+size_t vks::optimizer::generateVertexRemap(std::vector<uint32_t>& remap, const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+    remap.resize(vertexCount);
+    std::unordered_map<std::string_view, uint32_t> unique;
+    unique.reserve(vertexCount);
+    const char* data = static_cast<const char*>(vertices);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const std::string_view key(data + i * vertexSize, vertexSize);
+        remap[i] = unique.try_emplace(key, static_cast<uint32_t>(unique.size())).first->second;
+    }
+    return unique.size();
+}
+
+void vks::optimizer::optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    assert(destination != indices);
+    assert(indexCount % 3 == 0);
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Vertex -> triangles adjacency
+    std::vector<uint32_t> remainingValence(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        remainingValence[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingValence[v];
+    }
+    std::vector<uint32_t> adjacency(indexCount);
+    {
+        std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            adjacency[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = vertexScore(-1, remainingValence[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    uint32_t bestTriangle = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        if (triangleScores[t] > triangleScores[bestTriangle])
+        {
+            bestTriangle = static_cast<uint32_t>(t);
+        }
+    }
+
+    // Simulated LRU cache, most recent first, 3 extra slots for the vertices pushed out by a triangle
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+    bool hasBest = true;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (!hasBest)
+        {
+            // Dead end: nothing in the cache has triangles left, continue in input order
+            while (emitted[scanCursor])
+            {
+                scanCursor++;
+            }
+            bestTriangle = static_cast<uint32_t>(scanCursor);
+        }
+
+        const uint32_t* triangle = &indices[static_cast<size_t>(bestTriangle) * 3];
+        memcpy(&destination[emittedCount * 3], triangle, sizeof(uint32_t) * 3);
+        emitted[bestTriangle] = true;
+
+        nextCache.clear();
+        for (int k = 0; k < 3; k++)
+        {
+            remainingValence[triangle[k]]--;
+            nextCache.push_back(triangle[k]);
+        }
+        for (uint32_t vertex : cache)
+        {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+            {
+                nextCache.push_back(vertex);
+            }
+        }
+
+        // Rescore every vertex whose cache position changed, including the ones pushed out
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            const uint32_t vertex = nextCache[i];
+            cachePositions[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+            vertexScores[vertex] = vertexScore(cachePositions[vertex], remainingValence[vertex]);
+        }
+
+        // Rescore their remaining triangles & pick the best one
+        hasBest = false;
+        float bestScore = -1.0f;
+        for (uint32_t vertex : nextCache)
+        {
+            for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+            {
+                const uint32_t t = adjacency[a];
+                if (emitted[t])
+                {
+                    continue;
+                }
+                const uint32_t* adjacent = &indices[static_cast<size_t>(t) * 3];
+                triangleScores[t] = vertexScores[adjacent[0]] + vertexScores[adjacent[1]] + vertexScores[adjacent[2]];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                    hasBest = true;
+                }
+            }
+        }
+
+        if (nextCache.size() > FORSYTH_CACHE_SIZE)
+        {
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        std::swap(cache, nextCache);
+    }
+}
+
+void vks::optimizer::optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, float threshold)
+{
+    assert(destination != indices);
+    assert(indexCount % 3 == 0);
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Hard boundaries: triangles missing the cache with all three vertices, splitting there costs nothing
+    std::vector<uint32_t> hardStarts;
+    {
+        FifoCache cache(vertexCount, 16);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            uint32_t misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                misses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+            }
+            if (t == 0 || misses == 3)
+            {
+                hardStarts.push_back(static_cast<uint32_t>(t));
+            }
+        }
+        hardStarts.push_back(static_cast<uint32_t>(triangleCount));
+    }
+
+    // Soft boundaries: split a hard cluster once its running ACMR is within threshold of the whole cluster's
+    std::vector<uint32_t> clusterStarts;
+    {
+        FifoCache cache(vertexCount, 16);
+        for (size_t c = 0; c + 1 < hardStarts.size(); c++)
+        {
+            const uint32_t begin = hardStarts[c];
+            const uint32_t end = hardStarts[c + 1];
+
+            cache.reset();
+            uint32_t clusterMisses = 0;
+            for (uint32_t t = begin; t < end; t++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    clusterMisses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+                }
+            }
+            const float clusterAcmr = static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+            cache.reset();
+            clusterStarts.push_back(begin);
+            uint32_t runningMisses = 0;
+            uint32_t runningTriangles = 0;
+            for (uint32_t t = begin; t < end; t++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    runningMisses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+                }
+                runningTriangles++;
+                if (t + 1 < end && static_cast<float>(runningMisses) <= clusterAcmr * threshold * static_cast<float>(runningTriangles))
+                {
+                    clusterStarts.push_back(t + 1);
+                    cache.reset();
+                    runningMisses = 0;
+                    runningTriangles = 0;
+                }
+            }
+        }
+        clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+    }
+
+    const size_t clusterCount = clusterStarts.size() - 1;
+
+    glm::vec3 meshCentroid(0.0f);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        meshCentroid += loadPosition(positions, positionStride, indices[i]);
+    }
+    meshCentroid /= static_cast<float>(indexCount);
+
+    // Clusters facing away from the mesh center are the likely occluders, draw them first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const glm::vec3 p0 = loadPosition(positions, positionStride, indices[t * 3]);
+            const glm::vec3 p1 = loadPosition(positions, positionStride, indices[t * 3 + 1]);
+            const glm::vec3 p2 = loadPosition(positions, positionStride, indices[t * 3 + 2]);
+            // Area weighted
+            const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            const float triangleArea = glm::length(n);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+        const float normalLength = glm::length(normal);
+        if (area <= 0.0f || normalLength <= 0.0f)
+        {
+            sortKeys[c] = 0.0f;
+            continue;
+        }
+        sortKeys[c] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+    }
+
+    std::vector<uint32_t> clusterOrder(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        clusterOrder[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    size_t written = 0;
+    for (uint32_t c : clusterOrder)
+    {
+        const size_t count = static_cast<size_t>(clusterStarts[c + 1] - clusterStarts[c]) * 3;
+        memcpy(&destination[written], &indices[static_cast<size_t>(clusterStarts[c]) * 3], sizeof(uint32_t) * count);
+        written += count;
+    }
+    assert(written == indexCount);
+}
+
+size_t vks::optimizer::simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride,
+    const float* attributes, size_t attributeStride, const float* attributeWeights, size_t attributeCount,
+    size_t targetIndexCount, float targetError, float* resultError)
+{
+    assert(indexCount % 3 == 0);
+    // Works on a copy, so destination may alias indices
+    std::vector<uint32_t> result(indices, indices + indexCount);
+    if (resultError)
+    {
+        *resultError = 0.0f;
+    }
+    if (indexCount <= targetIndexCount)
+    {
+        memcpy(destination, result.data(), sizeof(uint32_t) * indexCount);
+        return indexCount;
+    }
+
+    std::vector<bool> referenced(vertexCount, false);
+    glm::vec3 boundsMin(FLT_MAX);
+    glm::vec3 boundsMax(-FLT_MAX);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        assert(indices[i] < vertexCount);
+        referenced[indices[i]] = true;
+        const glm::vec3 p = loadPosition(positions, vertexStride, indices[i]);
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+
+    // Positions normalized to the mesh extent, so errors don't depend on the model's scale
+    const glm::vec3 extent = boundsMax - boundsMin;
+    const float scale = std::max(extent.x, std::max(extent.y, extent.z));
+    const float invScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+    std::vector<glm::vec3> normalized(vertexCount, glm::vec3(0.0f));
+
+    // Seams: vertices sharing a position with another vertex (split normals or uvs), locked along with their partners
+    std::vector<bool> locked(vertexCount, false);
+    std::vector<uint32_t> weld(vertexCount);
+    std::unordered_map<std::string_view, uint32_t> positionOwners;
+    positionOwners.reserve(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        weld[v] = static_cast<uint32_t>(v);
+        if (!referenced[v])
+        {
+            continue;
+        }
+        normalized[v] = (loadPosition(positions, vertexStride, static_cast<uint32_t>(v)) - boundsMin) * invScale;
+        const std::string_view key(reinterpret_cast<const char*>(positions) + vertexStride * v, sizeof(float) * 3);
+        const auto [owner, inserted] = positionOwners.try_emplace(key, static_cast<uint32_t>(v));
+        if (!inserted)
+        {
+            weld[v] = owner->second;
+            locked[v] = true;
+            locked[owner->second] = true;
+        }
+    }
+
+    // Borders: welded edges without an opposite half edge
+    const size_t triangleCount = indexCount / 3;
+    {
+        std::unordered_set<uint64_t> halfEdges;
+        halfEdges.reserve(indexCount);
+        auto edgeKey = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) << 32) | b; };
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            const size_t next = i - i % 3 + (i + 1) % 3;
+            halfEdges.insert(edgeKey(weld[indices[i]], weld[indices[next]]));
+        }
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            const size_t next = i - i % 3 + (i + 1) % 3;
+            if (halfEdges.count(edgeKey(weld[indices[next]], weld[indices[i]])) == 0)
+            {
+                locked[indices[i]] = true;
+                locked[indices[next]] = true;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = normalized[indices[t * 3]];
+        const glm::vec3& p1 = normalized[indices[t * 3 + 1]];
+        const glm::vec3& p2 = normalized[indices[t * 3 + 2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(n);
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+        n /= length;
+        const float d = -glm::dot(n, p0);
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[indices[t * 3 + k]].addPlane(n, d, length * 0.5f);
+        }
+    }
+
+    // Squared attribute difference, the collapsed vertex keeps the target's attributes
+    auto attributeError = [&](uint32_t from, uint32_t to)
+    {
+        if (attributes == nullptr)
+        {
+            return 0.0;
+        }
+        const float* a = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(attributes) + attributeStride * from);
+        const float* b = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(attributes) + attributeStride * to);
+        double error = 0.0;
+        for (size_t i = 0; i < attributeCount; i++)
+        {
+            const double difference = static_cast<double>(a[i] - b[i]) * attributeWeights[i];
+            error += difference * difference;
+        }
+        return error;
+    };
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+
+    // Moving from onto to turns a remaining triangle around
+    auto flips = [&](uint32_t from, uint32_t to)
+    {
+        for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+        {
+            const uint32_t* triangle = &result[static_cast<size_t>(adjacency[a]) * 3];
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            {
+                continue;
+            }
+            glm::vec3 p[3];
+            glm::vec3 moved[3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = normalized[triangle[k]];
+                moved[k] = triangle[k] == from ? normalized[to] : p[k];
+            }
+            const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.0f)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    const double maxCost = static_cast<double>(targetError) * targetError;
+    double largestCost = 0.0;
+    size_t currentCount = indexCount;
+
+    // Passes of independent half edge collapses, cheapest first
+    while (currentCount > targetIndexCount)
+    {
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (size_t i = 0; i < currentCount; i++)
+        {
+            adjacencyOffsets[result[i] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        adjacency.resize(currentCount);
+        {
+            std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < currentCount; i++)
+            {
+                adjacency[cursors[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < currentCount; i++)
+        {
+            const uint32_t from = result[i];
+            const uint32_t to = result[i - i % 3 + (i + 1) % 3];
+            // Both directions of every edge, interior edges are seen twice
+            for (const auto& [a, b] : { std::make_pair(from, to), std::make_pair(to, from) })
+            {
+                if (locked[a])
+                {
+                    continue;
+                }
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                const double positionError = q.weight > 0.0 ? std::max(q.evaluate(normalized[b]), 0.0) / q.weight : 0.0;
+                collapses.push_back({ a, b, positionError + attributeError(a, b) });
+            }
+        }
+        if (collapses.empty())
+        {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            remap[v] = static_cast<uint32_t>(v);
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        const size_t trianglesToRemove = (currentCount - targetIndexCount) / 3;
+        size_t removed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost > maxCost)
+            {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to] || flips(collapse.from, collapse.to))
+            {
+                continue;
+            }
+            // The neighbourhood is frozen for the rest of the pass, keeping the flip checks valid
+            for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++)
+            {
+                const uint32_t* triangle = &result[static_cast<size_t>(adjacency[a]) * 3];
+                removed += (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) ? 1 : 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    touched[triangle[k]] = true;
+                }
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            largestCost = std::max(largestCost, collapse.cost);
+            if (removed >= trianglesToRemove)
+            {
+                break;
+            }
+        }
+        if (removed == 0)
+        {
+            break;
+        }
+
+        // Drop the triangles that degenerated
+        size_t written = 0;
+        for (size_t i = 0; i < currentCount; i += 3)
+        {
+            const uint32_t a = remap[result[i]];
+            const uint32_t b = remap[result[i + 1]];
+            const uint32_t c = remap[result[i + 2]];
+            if (a != b && b != c && a != c)
+            {
+                result[written++] = a;
+                result[written++] = b;
+                result[written++] = c;
+            }
+        }
+        currentCount = written;
+    }
+
+    memcpy(destination, result.data(), sizeof(uint32_t) * currentCount);
+    if (resultError)
+    {
+        *resultError = static_cast<float>(std::sqrt(largestCost));
+    }
+    return currentCount;
+}
+
+size_t vks::optimizer::buildMeshlets(std::vector<Meshlet>& meshlets, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    size_t maxVertices, size_t maxTriangles)
+{
+    assert(indexCount % 3 == 0);
+    assert(maxVertices >= 3 && maxTriangles >= 1);
+    meshlets.clear();
+    if (indexCount == 0)
+    {
+        return 0;
+    }
+
+    // Vertices seen by the open meshlet carry its stamp
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    uint32_t stamp = 1;
+    Meshlet meshlet = { 0, 0 };
+    size_t meshletVertices = 0;
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        size_t newVertices = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t vertex = indices[i + k];
+            assert(vertex < vertexCount);
+            // Repeated vertices within the triangle count once
+            bool repeated = false;
+            for (int j = 0; j < k; j++)
+            {
+                repeated = repeated || indices[i + j] == vertex;
+            }
+            newVertices += (stamps[vertex] != stamp && !repeated) ? 1 : 0;
+        }
+        if (meshletVertices + newVertices > maxVertices || meshlet.indexCount / 3 + 1 > maxTriangles)
+        {
+            meshlets.push_back(meshlet);
+            meshlet = { static_cast<uint32_t>(i), 0 };
+            meshletVertices = 0;
+            stamp++;
+            newVertices = 3 - (indices[i] == indices[i + 1] || indices[i] == indices[i + 2]) - (indices[i + 1] == indices[i + 2]);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            stamps[indices[i + k]] = stamp;
+        }
+        meshletVertices += newVertices;
+        meshlet.indexCount += 3;
+    }
+    meshlets.push_back(meshlet);
+    return meshlets.size();
+}
+
+vks::optimizer::MeshletBounds vks::optimizer::computeMeshletBounds(const uint32_t* indices, size_t indexCount, const float* positions, const float* normals, size_t vertexCount, size_t vertexStride)
+{
+    assert(indexCount % 3 == 0);
+    MeshletBounds bounds = {};
+    bounds.coneCutoff = 1.0f;
+    if (indexCount == 0)
+    {
+        return bounds;
+    }
+
+    // Sphere around the box center
+    glm::vec3 boundsMin(FLT_MAX);
+    glm::vec3 boundsMax(-FLT_MAX);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        assert(indices[i] < vertexCount);
+        const glm::vec3 p = loadPosition(positions, vertexStride, indices[i]);
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        radius = std::max(radius, glm::length(loadPosition(positions, vertexStride, indices[i]) - center));
+    }
+    bounds.center[0] = center.x;
+    bounds.center[1] = center.y;
+    bounds.center[2] = center.z;
+    bounds.radius = radius;
+
+    std::vector<glm::vec3> triangleNormals;
+    triangleNormals.reserve(indexCount / 3);
+    glm::vec3 axis(0.0f);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const glm::vec3 p0 = loadPosition(positions, vertexStride, indices[i]);
+        const glm::vec3 p1 = loadPosition(positions, vertexStride, indices[i + 1]);
+        const glm::vec3 p2 = loadPosition(positions, vertexStride, indices[i + 2]);
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(n);
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+        n /= length;
+        const glm::vec3 shadingNormal = loadPosition(normals, vertexStride, indices[i]) + loadPosition(normals, vertexStride, indices[i + 1])
+            + loadPosition(normals, vertexStride, indices[i + 2]);
+        if (glm::dot(n, shadingNormal) < 0.0f)
+        {
+            n = n * -1.0f;
+        }
+        triangleNormals.push_back(n);
+        axis += n;
+    }
+    const float axisLength = glm::length(axis);
+    if (triangleNormals.empty() || axisLength <= 0.0f)
+    {
+        return bounds;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3& n : triangleNormals)
+    {
+        minDot = std::min(minDot, glm::dot(n, axis));
+    }
+    bounds.coneAxis[0] = axis.x;
+    bounds.coneAxis[1] = axis.y;
+    bounds.coneAxis[2] = axis.z;
+    // Wider than ~84 degrees: the test would (almost) never pass, keep it disabled
+    bounds.coneCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    return bounds;
+}
+
+size_t vks::optimizer::optimizeVertexFetchRemap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    remap.assign(vertexCount, ~0u);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        uint32_t& mapped = remap[indices[i]];
+        if (mapped == ~0u)
+        {
+            mapped = next++;
+        }
+    }
+    return next;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vks
+{
+    /**
+     * Import time index & vertex reordering of triangle lists
+     * Indices are relative to the vertex range being optimized, destination & source may not alias unless noted
+     */
+    namespace optimizer
+    {
+        // Post-transform cache efficiency of an index order, simulated with a FIFO cache
+        struct VertexCacheStatistics
+        {
+            // Average cache miss ratio: transformed vertices per triangle, 0.5 (ideal grid) .. 3
+            float acmr = 0.0f;
+            // Average transform to vertex ratio: transformed vertices per referenced vertex, 1 is ideal
+            float atvr = 0.0f;
+        };
+        VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+        // Bitwise identical vertices share one index, remap[i] is the new index of vertex i in first occurrence order
+        // Returns the unique vertex count
+        size_t generateVertexRemap(std::vector<uint32_t>& remap, const void* vertices, size_t vertexCount, size_t vertexSize);
+
+        // Triangle order for post-transform cache locality (Forsyth, linear-speed vertex cache optimisation)
+        void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+        // Splits a cache optimized order into clusters & draws outward facing clusters first
+        // threshold: allowed ACMR growth, 1.05 keeps 95% of the cache optimization
+        void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, float threshold = 1.05f);
+
+        // Quadric error edge collapse towards targetIndexCount, the result only references existing vertices
+        // attributes: attributeCount floats per vertex, their error is weighted by attributeWeights & added to the position error
+        // Errors are relative to the mesh extent, collapses above targetError are not taken, resultError gets the largest taken
+        // Border & seam (shared position) vertices are locked so the result stays crack free
+        // Returns the result index count
+        size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride,
+            const float* attributes, size_t attributeStride, const float* attributeWeights, size_t attributeCount,
+            size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+        // Contiguous run of an index order
+        struct Meshlet
+        {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+        };
+        // Greedy split of an index order into meshlets of at most maxVertices unique vertices & maxTriangles triangles
+        // Triangles keep their order (cache optimized input gives compact meshlets), so meshlets are index ranges of the input
+        // Returns the meshlet count
+        size_t buildMeshlets(std::vector<Meshlet>& meshlets, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+            size_t maxVertices = 64, size_t maxTriangles = 124);
+
+        struct MeshletBounds
+        {
+            float center[3];
+            float radius;
+            // Normal cone: backfacing from every point p with dot(center - p, coneAxis) >= coneCutoff * |center - p| + radius
+            // coneCutoff is 1 when the normals spread too far to ever be backfacing
+            float coneAxis[3];
+            float coneCutoff;
+        };
+        // Triangle normals are oriented by the vertex normals, so the cone matches the shaded front faces
+        MeshletBounds computeMeshletBounds(const uint32_t* indices, size_t indexCount, const float* positions, const float* normals, size_t vertexCount, size_t vertexStride);
+
+        // Vertices numbered in first use order for fetch locality, unreferenced vertices get ~0u
+        // Returns the referenced vertex count
+        size_t optimizeVertexFetchRemap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+    }
+}
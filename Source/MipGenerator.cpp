@@ -0,0 +1,343 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace
+{
+    // Destination levels per downsample dispatch (shader's outputLevels)
+    constexpr uint32_t DOWNSAMPLE_LEVELS = 4;
+    constexpr uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+
+    VkImageMemoryBarrier levelBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+    {
+        VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+        barrier.image = image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1 };
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
+        return barrier;
+    }
+
+    void pipelineBarrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, const std::vector<VkImageMemoryBarrier>& barriers)
+    {
+        if (!barriers.empty())
+        {
+            vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+        }
+    }
+}
+
+vks::MipGenerator::MipGenerator(vks::VulkanDevice* inVulkanDevice)
+    : vulkanDevice(inVulkanDevice),
+      device(inVulkanDevice->logicalDevice)
+{
+}
+
+vks::MipGenerator::~MipGenerator()
+{
+    reset();
+    if (pipeline != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    }
+}
+
+bool vks::MipGenerator::canBlit(VkFormat format) const
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(vulkanDevice->physicalDevice, format, &formatProperties);
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+bool vks::MipGenerator::canCompute(VkFormat format) const
+{
+    // The shader writes rgba8
+    if (format != VK_FORMAT_R8G8B8A8_UNORM)
+    {
+        return false;
+    }
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(vulkanDevice->physicalDevice, format, &formatProperties);
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+bool vks::MipGenerator::useCompute(VkFormat format) const
+{
+    return canCompute(format) && (preferCompute || !canBlit(format));
+}
+
+VkImageUsageFlags vks::MipGenerator::getRequiredUsage(VkFormat format) const
+{
+    return useCompute(format) ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+}
+
+void vks::MipGenerator::record(VkCommandBuffer cmdBuffer, const std::vector<Chain>& chains)
+{
+    std::vector<const Chain*> blitChains;
+    std::vector<const Chain*> computeChains;
+    for (const Chain& chain : chains)
+    {
+        if (useCompute(chain.format))
+        {
+            computeChains.push_back(&chain);
+        }
+        else if (canBlit(chain.format) || chain.mipLevels == 1)
+        {
+            blitChains.push_back(&chain);
+        }
+        else
+        {
+            vks::tools::exitFatal("Mip generation is not supported for format " + std::to_string(chain.format), VK_ERROR_FORMAT_NOT_SUPPORTED);
+        }
+    }
+    if (!blitChains.empty())
+    {
+        recordBlits(cmdBuffer, blitChains);
+    }
+    if (!computeChains.empty())
+    {
+        recordCompute(cmdBuffer, computeChains);
+    }
+}
+
+void vks::MipGenerator::reset()
+{
+    for (VkImageView view : levelViews)
+    {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    levelViews.clear();
+    if (descriptorPool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+}
+
+void vks::MipGenerator::recordBlits(VkCommandBuffer cmdBuffer, const std::vector<const Chain*>& chains)
+{
+    // Level 0 becomes the first blit source, the other levels blit destinations
+    std::vector<VkImageMemoryBarrier> barriers;
+    uint32_t maxLevels = 1;
+    for (const Chain* chain : chains)
+    {
+        barriers.push_back(levelBarrier(chain->image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+        if (chain->mipLevels > 1)
+        {
+            barriers.push_back(levelBarrier(chain->image, 1, chain->mipLevels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                0, VK_ACCESS_TRANSFER_WRITE_BIT));
+        }
+        maxLevels = std::max(maxLevels, chain->mipLevels);
+    }
+    pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, barriers);
+
+    // Level by level across all chains, the barrier after a level makes it the source of the next
+    for (uint32_t level = 1; level < maxLevels; level++)
+    {
+        barriers.clear();
+        for (const Chain* chain : chains)
+        {
+            if (level >= chain->mipLevels)
+            {
+                continue;
+            }
+            VkImageBlit imageBlit{};
+            imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+            imageBlit.srcOffsets[1] = { std::max(1, int32_t(chain->width >> (level - 1))), std::max(1, int32_t(chain->height >> (level - 1))), 1 };
+            imageBlit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+            imageBlit.dstOffsets[1] = { std::max(1, int32_t(chain->width >> level)), std::max(1, int32_t(chain->height >> level)), 1 };
+            vkCmdBlitImage(cmdBuffer, chain->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, chain->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+            barriers.push_back(levelBarrier(chain->image, level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+        }
+        pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, barriers);
+    }
+
+    barriers.clear();
+    for (const Chain* chain : chains)
+    {
+        barriers.push_back(levelBarrier(chain->image, 0, chain->mipLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, chain->finalLayout,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT));
+    }
+    pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, barriers);
+}
+
+void vks::MipGenerator::recordCompute(VkCommandBuffer cmdBuffer, const std::vector<const Chain*>& chains)
+{
+    prepareCompute();
+
+    // One view per level & one set per dispatch, sized for this recording
+    uint32_t dispatchCount = 0;
+    uint32_t passCount = 0;
+    for (const Chain* chain : chains)
+    {
+        const uint32_t chainDispatches = (chain->mipLevels - 1 + DOWNSAMPLE_LEVELS - 1) / DOWNSAMPLE_LEVELS;
+        dispatchCount += chainDispatches;
+        passCount = std::max(passCount, chainDispatches);
+    }
+    if (dispatchCount == 0)
+    {
+        // Single level chains only need their final layout
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (const Chain* chain : chains)
+        {
+            barriers.push_back(levelBarrier(chain->image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, chain->finalLayout,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+        }
+        pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, barriers);
+        return;
+    }
+    reset();
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, dispatchCount),
+        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, dispatchCount * DOWNSAMPLE_LEVELS),
+    };
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, dispatchCount);
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+    std::vector<uint32_t> firstViews(chains.size());
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (size_t Chain_Index = 0; Chain_Index < chains.size(); Chain_Index++)
+    {
+        const Chain* chain = chains[Chain_Index];
+        firstViews[Chain_Index] = static_cast<uint32_t>(levelViews.size());
+        VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+        viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewCI.format = chain->format;
+        viewCI.image = chain->image;
+        for (uint32_t level = 0; level < chain->mipLevels; level++)
+        {
+            viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+            VkImageView view;
+            VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &view));
+            levelViews.push_back(view);
+        }
+
+        // Level 0 is sampled, written levels stay in general (also sampled as the source of the next dispatch)
+        barriers.push_back(levelBarrier(chain->image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+        if (chain->mipLevels > 1)
+        {
+            barriers.push_back(levelBarrier(chain->image, 1, chain->mipLevels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                0, VK_ACCESS_SHADER_WRITE_BIT));
+        }
+    }
+    pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, barriers);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    // Pass p writes levels [p * 4 + 1, p * 4 + 4] of every chain, one barrier between passes
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        if (pass > 0)
+        {
+            VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+            memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        }
+        for (size_t Chain_Index = 0; Chain_Index < chains.size(); Chain_Index++)
+        {
+            const Chain* chain = chains[Chain_Index];
+            const uint32_t srcLevel = pass * DOWNSAMPLE_LEVELS;
+            if (srcLevel + 1 >= chain->mipLevels)
+            {
+                continue;
+            }
+            const uint32_t levelCount = std::min(DOWNSAMPLE_LEVELS, chain->mipLevels - 1 - srcLevel);
+            const VkImageView* views = &levelViews[firstViews[Chain_Index]];
+
+            VkDescriptorSet descriptorSet;
+            VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+            VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+            VkDescriptorImageInfo srcDescriptor = vks::initializers::descriptorImageInfo(sampler, views[srcLevel],
+                srcLevel == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL);
+            // Unused array elements repeat the last written level, the shader doesn't store to them
+            VkDescriptorImageInfo dstDescriptors[DOWNSAMPLE_LEVELS];
+            for (uint32_t i = 0; i < DOWNSAMPLE_LEVELS; i++)
+            {
+                dstDescriptors[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, views[srcLevel + 1 + std::min(i, levelCount - 1)], VK_IMAGE_LAYOUT_GENERAL);
+            }
+            std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+                vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcDescriptor),
+                vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, dstDescriptors, DOWNSAMPLE_LEVELS),
+            };
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+            PushConsts pushConsts = {};
+            pushConsts.srcSize[0] = std::max(1, int32_t(chain->width >> srcLevel));
+            pushConsts.srcSize[1] = std::max(1, int32_t(chain->height >> srcLevel));
+            pushConsts.levelCount = levelCount;
+            const uint32_t dstWidth = std::max(1u, chain->width >> (srcLevel + 1));
+            const uint32_t dstHeight = std::max(1u, chain->height >> (srcLevel + 1));
+
+            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+            vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConsts), &pushConsts);
+            vkCmdDispatch(cmdBuffer, (dstWidth + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE, (dstHeight + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE, 1);
+        }
+    }
+
+    barriers.clear();
+    for (const Chain* chain : chains)
+    {
+        barriers.push_back(levelBarrier(chain->image, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, chain->finalLayout,
+            VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_READ_BIT));
+        if (chain->mipLevels > 1)
+        {
+            barriers.push_back(levelBarrier(chain->image, 1, chain->mipLevels - 1, VK_IMAGE_LAYOUT_GENERAL, chain->finalLayout,
+                VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+        }
+    }
+    pipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, barriers);
+}
+
+void vks::MipGenerator::prepareCompute()
+{
+    if (pipeline != VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    // Edge texels repeat for odd sizes, the shader's bilinear tap covers the 2x2 footprint
+    VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+    samplerCI.magFilter = VK_FILTER_LINEAR;
+    samplerCI.minFilter = VK_FILTER_LINEAR;
+    samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCI.maxAnisotropy = 1.0f;
+    samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    sampler = vulkanDevice->getSampler(samplerCI);
+
+    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+        // Binding 0: Source level
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        // Binding 1: Destination levels
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, DOWNSAMPLE_LEVELS),
+    };
+    VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+    VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConsts), 0);
+    VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+    pipelineLayoutCI.pushConstantRangeCount = 1;
+    pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+    VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+    pipelineCI.stage = vks::tools::loadShader(getShaderBasePath() + "texture/downsample.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT, device);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+}
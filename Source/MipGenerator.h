@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+
+    /**
+     * Generates the mip chains of many uploaded images in one command buffer
+     * Blits run level by level across every chain with one barrier per level instead of one per image & level
+     * Formats without linear blits (or every format with preferCompute) use a compute downsampler writing up to 4 levels per dispatch
+     * Main thread only, recorded views & descriptor sets are kept until reset
+     */
+    class MipGenerator
+    {
+    public:
+        struct Chain
+        {
+            VkImage image = VK_NULL_HANDLE;
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t mipLevels = 1;
+            // Layout of every level once generated
+            VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        };
+
+        MipGenerator() = delete;
+        explicit MipGenerator(vks::VulkanDevice* inVulkanDevice);
+        MipGenerator(const MipGenerator&) = delete;
+        MipGenerator& operator=(const MipGenerator&) = delete;
+        ~MipGenerator();
+
+        // Usage a chain's image needs besides sampled & transfer dst
+        VkImageUsageFlags getRequiredUsage(VkFormat format) const;
+        // Level 0 of every chain is in transfer dst with its data, the other levels are undefined
+        void record(VkCommandBuffer cmdBuffer, const std::vector<Chain>& chains);
+        // Frees what record created, its command buffer must have finished
+        void reset();
+
+        // Compute downsampling for the formats it supports even when they could be blitted
+        bool preferCompute = false;
+
+    private:
+        bool canBlit(VkFormat format) const;
+        bool canCompute(VkFormat format) const;
+        bool useCompute(VkFormat format) const;
+
+        void recordBlits(VkCommandBuffer cmdBuffer, const std::vector<const Chain*>& chains);
+        void recordCompute(VkCommandBuffer cmdBuffer, const std::vector<const Chain*>& chains);
+        // Pipeline objects are only created once a chain needs them
+        void prepareCompute();
+
+        vks::VulkanDevice* vulkanDevice = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+
+        VkSampler sampler = VK_NULL_HANDLE;
+        VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+
+        // Per record, freed by reset
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        std::vector<VkImageView> levelViews;
+
+        struct PushConsts {
+            int32_t srcSize[2];
+            // Destination levels of the dispatch, 1..DOWNSAMPLE_LEVELS
+            uint32_t levelCount;
+        };
+    };
+}
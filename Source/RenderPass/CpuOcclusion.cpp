@@ -0,0 +1,141 @@
+#include "CpuOcclusion.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "voko_globals.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "SceneGraph/Mesh.h"
+
+CpuOcclusionCulling::CpuOcclusionCulling(vks::VulkanDevice* inVulkanDevice)
+    : drawCount(static_cast<uint32_t>(voko_global::SceneMeshes.size())),
+      jobSystem(voko_global::jobSystem),
+      // Quarter resolution is enough for large occluders
+      occlusionBuffer(voko_global::width / 4, voko_global::height / 4, jobSystem->getWorkerCount() + 1, jobSystem)
+{
+    const VkDeviceSize indirectSize = std::max<VkDeviceSize>(1, drawCount) * sizeof(VkDrawIndexedIndirectCommand);
+    VK_CHECK_RESULT(inVulkanDevice->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &indirectBuffer, indirectSize));
+    VK_CHECK_RESULT(indirectBuffer.map());
+
+    updateDrawBounds();
+
+    // Everything visible until the first cull
+    visibility.assign(drawCount, 1);
+    waitFrame();
+}
+
+CpuOcclusionCulling::~CpuOcclusionCulling()
+{
+    waitCull();
+    indirectBuffer.destroy();
+}
+
+void CpuOcclusionCulling::waitCull()
+{
+    if (cullJob.valid())
+    {
+        jobSystem->wait(cullJob);
+        cullJob = {};
+    }
+}
+
+void CpuOcclusionCulling::updateDrawBounds()
+{
+    // Bounds are read by the running cull
+    waitCull();
+
+    meshBounds.resize(drawCount);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+
+        glm::vec3 localMin, localMax;
+        mesh->get_instance_bounds(localMin, localMax);
+
+        // World AABB of the transformed local box
+        const glm::mat4 modelMatrix = mesh->get_node()->get_transform().get_matrix();
+        voko::AABB& bounds = meshBounds[Mesh_Index];
+        bounds.min = glm::vec3(FLT_MAX);
+        bounds.max = glm::vec3(-FLT_MAX);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            const glm::vec3 p = glm::vec3(
+                (corner & 1) ? localMax.x : localMin.x,
+                (corner & 2) ? localMax.y : localMin.y,
+                (corner & 4) ? localMax.z : localMin.z);
+            const glm::vec3 world = glm::vec3(modelMatrix * glm::vec4(p, 1.0f));
+            bounds.min = glm::min(bounds.min, world);
+            bounds.max = glm::max(bounds.max, world);
+        }
+    }
+}
+
+void CpuOcclusionCulling::beginFrame(const glm::mat4& viewProjection)
+{
+    waitCull();
+
+    // Snapshot on the main thread, the scene may change while the job runs
+    occluderDraws.clear();
+    for (Mesh* mesh : voko_global::SceneMeshes)
+    {
+        const auto& geometry = mesh->VkGltfModel.cpuGeometry;
+        if (!mesh->bOccluder || geometry.positions.empty())
+        {
+            continue;
+        }
+
+        const glm::mat4 modelViewProj = viewProjection * mesh->get_node()->get_transform().get_matrix();
+        if (mesh->Instances.empty())
+        {
+            occluderDraws.push_back({ modelViewProj, &geometry.positions, &geometry.indices });
+        }
+        for (const auto& instance : mesh->Instances)
+        {
+            occluderDraws.push_back({ modelViewProj * instance.get_transform(), &geometry.positions, &geometry.indices });
+        }
+    }
+
+    // Frame lane, loading & encoding jobs still running don't hold it up
+    cullJob = jobSystem->submit([this, viewProjection]() {
+        cull(viewProjection);
+    }, {}, vks::JobSystem::Priority::Frame);
+}
+
+void CpuOcclusionCulling::cull(const glm::mat4& viewProjection)
+{
+    occlusionBuffer.clear();
+    for (const OccluderDraw& draw : occluderDraws)
+    {
+        occlusionBuffer.addOccluder(draw.modelViewProj, *draw.positions, *draw.indices);
+    }
+
+    occlusionBuffer.rasterize();
+    occlusionBuffer.testVisibility(viewProjection, meshBounds, visibility);
+}
+
+void CpuOcclusionCulling::waitFrame()
+{
+    waitCull();
+
+    // Gpu of last frame is idle (submitFrame waits), mapped args can be rewritten
+    auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffer.mapped);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        const Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+        const uint32_t instanceCount = std::max(1u, mesh->get_instance_count());
+
+        commands[Mesh_Index].indexCount = mesh->get_index_count();
+        commands[Mesh_Index].instanceCount = visibility[Mesh_Index] ? instanceCount : 0;
+        commands[Mesh_Index].firstIndex = mesh->get_first_index();
+        commands[Mesh_Index].vertexOffset = static_cast<int32_t>(mesh->VkGltfModel.vertices.first);
+        commands[Mesh_Index].firstInstance = mesh->instanceOffset;
+    }
+}
+
+VkDeviceSize CpuOcclusionCulling::getIndirectOffset(uint32_t meshIndex, ECullPhase phase) const
+{
+    // Single phase, every pass draws the same results
+    return static_cast<VkDeviceSize>(meshIndex) * sizeof(VkDrawIndexedIndirectCommand);
+}
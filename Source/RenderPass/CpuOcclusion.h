@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "JobSystem.h"
+#include "RenderPass/OcclusionCulling.h"
+#include "SpatialStructure/OcclusionBuffer.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+}
+
+/**
+ * Software occlusion culling, for devices where the gpu Hi-Z path is not wanted
+ * Meshes flagged as occluders are rasterized on voko_global::jobSystem into a low resolution depth buffer,
+ * every mesh's world bounds are tested against it & the results written as indirect draw args
+ * Single phase: results are ready before the culled passes are submitted
+ * The job reads a snapshot taken on the main thread in beginFrame, plus the occluders' cpu geometry, which isn't changed after loading
+ */
+class CpuOcclusionCulling : public OcclusionCulling
+{
+public:
+    CpuOcclusionCulling() = delete;
+    explicit CpuOcclusionCulling(vks::VulkanDevice* inVulkanDevice);
+    ~CpuOcclusionCulling() override;
+
+    // Rebuild per mesh world bounds, call after mesh transforms/instances change (waits for a running cull)
+    void updateDrawBounds();
+
+    void beginFrame(const glm::mat4& viewProjection) override;
+    void waitFrame() override;
+
+    VkBuffer getIndirectBuffer() const override { return indirectBuffer.buffer; }
+    VkDeviceSize getIndirectOffset(uint32_t meshIndex, ECullPhase phase) const override;
+
+    const voko::OcclusionBuffer& get_occlusion_buffer() const { return occlusionBuffer; }
+
+private:
+    // Occluder mesh or instance of the frame's snapshot
+    struct OccluderDraw
+    {
+        glm::mat4 modelViewProj;
+        const std::vector<glm::vec3>* positions;
+        const std::vector<uint32_t>* indices;
+    };
+
+    void cull(const glm::mat4& viewProjection);
+    void waitCull();
+
+    uint32_t drawCount = 0;
+
+    vks::JobSystem* jobSystem;
+    voko::OcclusionBuffer occlusionBuffer;
+    std::vector<OccluderDraw> occluderDraws;
+    std::vector<voko::AABB> meshBounds;
+    std::vector<uint8_t> visibility;
+    vks::JobSystem::Handle cullJob;
+
+    // Host visible, drawCount commands, rewritten every frame
+    vks::Buffer indirectBuffer;
+};
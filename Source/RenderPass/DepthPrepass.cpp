@@ -0,0 +1,140 @@
+#include "DepthPrepass.h"
+
+#include <array>
+
+#include "voko.h"
+#include "voko_globals.h"
+#include "VulkanFrameBuffer.hpp"
+
+
+DepthPrepass::DepthPrepass(const std::string& name, vks::VulkanDevice* inVulkanDevice, uint32_t inWidth, uint32_t inHeight,
+                           ERenderPassType inPassType, EPassAttachmentType inAttachmentType,
+                           std::shared_ptr<LodSelection> inLodSelection):
+    RenderPass(name, inVulkanDevice, inWidth, inHeight, inPassType, inAttachmentType)
+{
+    // Depth only needs positions
+    bPositionOnly = true;
+    lodSelection = inLodSelection;
+    init();
+}
+
+void DepthPrepass::setupFrameBuffer()
+{
+    frameBuffer = new vks::Framebuffer(vulkanDevice);
+    frameBuffer->width = width;
+    frameBuffer->height = height;
+
+    // depth pre-pass depth stencil ops:
+    // clear -> write -> store, geometry pass loads it
+    frameBuffer->SetDepthStencilUsage(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+    // Create default renderpass for the framebuffer
+    VK_CHECK_RESULT(frameBuffer->createRenderPass());
+}
+
+void DepthPrepass::setupDescriptorSet()
+{
+    std::array<VkDescriptorSetLayout ,2> depthDsLayouts = {voko_global::SceneDescriptorSetLayout, voko_global::MeshDescriptorSetLayout};
+    // Mesh index of each draw
+    VkPushConstantRange meshPushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_ALL_GRAPHICS, sizeof(voko_buffer::MeshPushConsts), 0);
+    // Layout
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(
+        depthDsLayouts.data(), static_cast<uint32_t>(depthDsLayouts.size()));
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &meshPushConstantRange;
+    VK_CHECK_RESULT(
+        vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+}
+
+void DepthPrepass::preparePipeline()
+{
+    // Shader Paths:
+    // Vertex stage only, gl_Position is invariant & computed exactly like geometry.vert
+    std::string VSPath = "deferredshadows/depth.vert.spv";
+
+    // Pipelines
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+    // Same culling as the geometry pass
+    VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(
+        VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+    // Depth pre-pass doesn't use any color attachments
+    VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(
+        0, nullptr);
+    VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(
+        VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+    VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+    VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(
+        VK_SAMPLE_COUNT_1_BIT, 0);
+    std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(
+        dynamicStateEnables);
+    std::array<VkPipelineShaderStageCreateInfo, 1> shaderStages;
+    shaderStages[0] = vks::tools::loadShader(getShaderBasePath() + VSPath,
+                                             VK_SHADER_STAGE_VERTEX_BIT, vulkanDevice->logicalDevice);
+    // Vertex decoding matches the scene meshes' vertex layout (util/vertex.glsl)
+    const VkBool32 compactVertex = voko_global::bCompactVertices ? VK_TRUE : VK_FALSE;
+    const VkSpecializationMapEntry vertexSpecializationEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+    const VkSpecializationInfo vertexSpecializationInfo = vks::initializers::specializationInfo(1, &vertexSpecializationEntry, sizeof(VkBool32), &compactVertex);
+    shaderStages[0].pSpecializationInfo = &vertexSpecializationInfo;
+
+    VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(
+        pipelineLayout, frameBuffer->renderPass);
+    pipelineCI.pInputAssemblyState = &inputAssemblyState;
+    pipelineCI.pRasterizationState = &rasterizationState;
+    pipelineCI.pColorBlendState = &colorBlendState;
+    pipelineCI.pMultisampleState = &multisampleState;
+    pipelineCI.pViewportState = &viewportState;
+    pipelineCI.pDepthStencilState = &depthStencilState;
+    pipelineCI.pDynamicState = &dynamicState;
+    pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineCI.pStages = shaderStages.data();
+
+    // Position only stream of the scene meshes
+    pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelinePositionInputState(
+        voko_global::bCompactVertices ? vkglTF::VertexFormat::Compact : vkglTF::VertexFormat::Full);
+
+    VK_CHECK_RESULT(
+        vkCreateGraphicsPipelines(vulkanDevice->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+}
+
+void DepthPrepass::buildCommandBuffer()
+{
+    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+    VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+    std::array<VkClearValue, 1> clearValues = {};
+    clearValues[0].depthStencil = {1.0f, 0};
+
+    renderPassBeginInfo.renderPass = frameBuffer->renderPass;
+    renderPassBeginInfo.framebuffer = frameBuffer->framebuffer;
+    renderPassBeginInfo.renderArea.extent.width = frameBuffer->width;
+    renderPassBeginInfo.renderArea.extent.height = frameBuffer->height;
+    renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.pClearValues = clearValues.data();
+
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+    VkViewport viewport = vks::initializers::viewport((float)frameBuffer->width, (float)frameBuffer->height, 0.0f, 1.0f);
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    VkRect2D scissor = vks::initializers::rect2D(frameBuffer->width, frameBuffer->height, 0, 0);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    // Bind Scene Ds
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voko_global::SceneDescriptorSet,
+        voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
+
+    // Every instance, unculled: culling only drops instances that are off screen or behind this depth
+    RenderScene();
+
+    vkCmdEndRenderPass(cmdBuffer);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+}
+
+DepthPrepass::~DepthPrepass()
+{
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "RenderPass.h"
+
+
+/**
+ * Depth only pre-pass into voko_global::depthStencil from the scene meshes' position stream
+ * The geometry pass then loads the depth & shades with an EQUAL test, each pixel writes the G-buffer once
+ */
+class DepthPrepass : public RenderPass
+{
+public:
+    DepthPrepass(const std::string& name,
+                        vks::VulkanDevice* inVulkanDevice,
+                        uint32_t inWidth,
+                        uint32_t inHeight,
+                        ERenderPassType inPassType,
+                        EPassAttachmentType inAttachmentType,
+                        // must be the geometry pass' lod selection, EQUAL testing needs the same geometry
+                        std::shared_ptr<LodSelection> inLodSelection = nullptr);
+    virtual void setupFrameBuffer() override;
+    virtual void setupDescriptorSet() override;
+    virtual void preparePipeline() override;
+    virtual void buildCommandBuffer() override;
+    virtual ~DepthPrepass() override;
+};
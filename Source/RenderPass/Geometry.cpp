@@ -4,15 +4,28 @@
 
 
 GeometryPass::GeometryPass(const std::string& name, vks::VulkanDevice* inVulkanDevice, uint32_t inWidth,
-                           uint32_t inHeight, ERenderPassType inPassType, EPassAttachmentType inAttachmentType)
+                           uint32_t inHeight, ERenderPassType inPassType, EPassAttachmentType inAttachmentType,
+                           // Geometry pass specials:
+                           std::shared_ptr<OcclusionCulling> inOcclusionCulling,
+                           std::shared_ptr<InstanceCulling> inInstanceCulling,
+                           std::shared_ptr<LodSelection> inLodSelection,
+                           std::shared_ptr<MeshletCulling> inMeshletCulling)
         : RenderPass(name, inVulkanDevice, inWidth, inHeight, inPassType, inAttachmentType)
 {
+    occlusionCulling = inOcclusionCulling;
+    instanceCulling = inInstanceCulling;
+    lodSelection = inLodSelection;
+    meshletCulling = inMeshletCulling;
 
     init();
 }
 
 GeometryPass::~GeometryPass()
 {
+    if (lateRenderPass != VK_NULL_HANDLE)
+    {
+        vkDestroyRenderPass(device, lateRenderPass, nullptr);
+    }
 }
 
 void GeometryPass::setupFrameBuffer()
@@ -54,8 +67,8 @@ void GeometryPass::setupFrameBuffer()
     frameBuffer->addAttachment(attachmentInfo);
 
     // geometry pass depth stencil ops:
-    // clear -> write -> store
-    frameBuffer->SetDepthStencilUsage(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
+    // clear -> write -> store, or load -> test -> store after the depth pre-pass
+    frameBuffer->SetDepthStencilUsage(voko_global::bDepthPrepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
         VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE);
 
     // Create sampler to sample from the color attachments
@@ -63,14 +76,23 @@ void GeometryPass::setupFrameBuffer()
 
     // Create default renderpass for the framebuffer
     VK_CHECK_RESULT(frameBuffer->createRenderPass());
+
+    if (occlusionCulling && occlusionCulling->hasLatePhase())
+    {
+        VK_CHECK_RESULT(frameBuffer->createLoadRenderPass(&lateRenderPass));
+    }
 }
 
 void GeometryPass::setupDescriptorSet()
 {
-    std::array<VkDescriptorSetLayout ,2> geometryDsLayouts = {voko_global::SceneDescriptorSetLayout, voko_global::PerMeshDescriptorSetLayout};
+    std::array<VkDescriptorSetLayout ,2> geometryDsLayouts = {voko_global::SceneDescriptorSetLayout, voko_global::MeshDescriptorSetLayout};
+    // Mesh index of each draw
+    VkPushConstantRange meshPushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_ALL_GRAPHICS, sizeof(voko_buffer::MeshPushConsts), 0);
     // Layout
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(
         geometryDsLayouts.data(), static_cast<uint32_t>(geometryDsLayouts.size()));
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &meshPushConstantRange;
     VK_CHECK_RESULT(
         vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
     
@@ -96,8 +118,10 @@ void GeometryPass::preparePipeline()
     // Shadow pass doesn't use any color attachments
     VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(
         0, nullptr);
-    VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(
-        VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+    // Depth is complete after the pre-pass: only the visible surface passes, nothing is written
+    VkPipelineDepthStencilStateCreateInfo depthStencilState = voko_global::bDepthPrepass
+        ? vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_FALSE, VK_COMPARE_OP_EQUAL)
+        : vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
     VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
     VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(
         VK_SAMPLE_COUNT_1_BIT, 0);
@@ -107,6 +131,11 @@ void GeometryPass::preparePipeline()
     std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
     shaderStages[0] = vks::tools::loadShader(getShaderBasePath() + VSPath,
                                              VK_SHADER_STAGE_VERTEX_BIT, vulkanDevice->logicalDevice);
+    // Vertex decoding matches the scene meshes' vertex layout (util/vertex.glsl)
+    const VkBool32 compactVertex = voko_global::bCompactVertices ? VK_TRUE : VK_FALSE;
+    const VkSpecializationMapEntry vertexSpecializationEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+    const VkSpecializationInfo vertexSpecializationInfo = vks::initializers::specializationInfo(1, &vertexSpecializationEntry, sizeof(VkBool32), &compactVertex);
+    shaderStages[0].pSpecializationInfo = &vertexSpecializationInfo;
     shaderStages[1] = vks::tools::loadShader(getShaderBasePath() + FSPath,
                                              VK_SHADER_STAGE_FRAGMENT_BIT, vulkanDevice->logicalDevice);
 
@@ -123,7 +152,8 @@ void GeometryPass::preparePipeline()
     pipelineCI.pStages = shaderStages.data();
 
     // Vertex input state from glTF model for pipeline rendering models
-    pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent });
+    pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent },
+        voko_global::bCompactVertices ? vkglTF::VertexFormat::Compact : vkglTF::VertexFormat::Full);
     rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 
     
@@ -182,17 +212,49 @@ void GeometryPass::buildCommandBuffer()
     scissor = vks::initializers::rect2D(frameBuffer->width, frameBuffer->height, 0, 0);
     vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
+    // Compact visible instances of instanced meshes
+    if (instanceCulling)
+    {
+        instanceCulling->recordCull(cmdBuffer);
+    }
+    // Compact surviving meshlets of large meshes
+    if (meshletCulling)
+    {
+        meshletCulling->recordCull(cmdBuffer);
+    }
+
+    // Early phase: meshes visible last frame (gpu) or this frame's cpu results
+    if (occlusionCulling)
+    {
+        occlusionCulling->recordCull(cmdBuffer, ECullPhase::Early);
+    }
 
     vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
     // Bind Scene Ds
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voko_global::SceneDescriptorSet, 0 , NULL);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voko_global::SceneDescriptorSet,
+        voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
     // Bind Per Mesh Ds & Draw
-    RenderScene();
+    RenderScene(ECullPhase::Early);
 
     vkCmdEndRenderPass(cmdBuffer);
 
+    // Late phase: test all meshes against early depth, draw the newly visible ones
+    if (occlusionCulling && occlusionCulling->hasLatePhase())
+    {
+        occlusionCulling->recordBuildPyramid(cmdBuffer);
+        occlusionCulling->recordCull(cmdBuffer, ECullPhase::Late);
+
+        renderPassBeginInfo.renderPass = lateRenderPass;
+        vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voko_global::SceneDescriptorSet,
+        voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
+        RenderScene(ECullPhase::Late);
+        vkCmdEndRenderPass(cmdBuffer);
+    }
+
     VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 }
 
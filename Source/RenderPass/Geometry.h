@@ -9,10 +9,21 @@ class GeometryPass : public RenderPass
                         uint32_t inWidth,
                         uint32_t inHeight,
                         ERenderPassType inPassType,
-                        EPassAttachmentType inAttachmentType);
+                        EPassAttachmentType inAttachmentType,
+                        // Geometry pass specials: occlusion culled indirect draws when valid
+                        std::shared_ptr<OcclusionCulling> inOcclusionCulling = nullptr,
+                        // per instance culled indirect draws of instanced meshes when valid
+                        std::shared_ptr<InstanceCulling> inInstanceCulling = nullptr,
+                        // camera lod draws of meshes neither culler takes when valid
+                        std::shared_ptr<LodSelection> inLodSelection = nullptr,
+                        // meshlet culled indirect draws of large single instance meshes when valid
+                        std::shared_ptr<MeshletCulling> inMeshletCulling = nullptr);
     ~GeometryPass() override;
     virtual void setupFrameBuffer() override;
     virtual void setupDescriptorSet() override;
     virtual void preparePipeline() override;
     virtual void buildCommandBuffer() override;
+
+    // Same attachments loaded instead of cleared, for late phase draws after the Hi-Z build
+    VkRenderPass lateRenderPass = VK_NULL_HANDLE;
 };
\ No newline at end of file
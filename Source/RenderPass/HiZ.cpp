@@ -0,0 +1,370 @@
+#include "HiZ.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "voko_buffers.h"
+#include "voko_globals.h"
+#include "DescriptorAllocator.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+#include "SceneGraph/Mesh.h"
+
+HiZCulling::HiZCulling(vks::VulkanDevice* inVulkanDevice, uint32_t inDepthWidth, uint32_t inDepthHeight)
+    : vulkanDevice(inVulkanDevice),
+      device(inVulkanDevice->logicalDevice),
+      depthWidth(inDepthWidth),
+      depthHeight(inDepthHeight),
+      drawCount(static_cast<uint32_t>(voko_global::SceneMeshes.size()))
+{
+    createPyramid();
+    createBuffers();
+    setupDescriptorSets();
+    preparePipelines();
+    updateDrawBounds();
+}
+
+HiZCulling::~HiZCulling()
+{
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    vkDestroyPipeline(device, hizPipeline, nullptr);
+    vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, hizPipelineLayout, nullptr);
+    for (VkDescriptorSet hizDescriptorSet : hizDescriptorSets)
+    {
+        voko_global::descriptorAllocator->release(hizDescriptorSetLayout, hizDescriptorSet);
+    }
+    voko_global::descriptorAllocator->release(cullDescriptorSetLayout, cullDescriptorSet);
+
+    drawDataSSBO.destroy();
+    visibilitySSBO.destroy();
+    indirectBuffer.destroy();
+
+    for (auto mipView : pyramid.mipViews)
+    {
+        vkDestroyImageView(device, mipView, nullptr);
+    }
+    vkDestroyImageView(device, pyramid.view, nullptr);
+    vkDestroyImage(device, pyramid.image, nullptr);
+    vkFreeMemory(device, pyramid.memory, nullptr);
+}
+
+void HiZCulling::createPyramid()
+{
+    // Mip 0 already halves scene depth, so every pyramid texel is a reduction
+    pyramid.width = std::max(1u, (depthWidth + 1) / 2);
+    pyramid.height = std::max(1u, (depthHeight + 1) / 2);
+    pyramid.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(pyramid.width, pyramid.height)))) + 1;
+
+    VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+    imageCI.imageType = VK_IMAGE_TYPE_2D;
+    imageCI.format = VK_FORMAT_R32_SFLOAT;
+    imageCI.extent = { pyramid.width, pyramid.height, 1 };
+    imageCI.mipLevels = pyramid.mipLevels;
+    imageCI.arrayLayers = 1;
+    imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &pyramid.image));
+
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(device, pyramid.image, &memReqs);
+    VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+    memAlloc.allocationSize = memReqs.size;
+    memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &pyramid.memory));
+    VK_CHECK_RESULT(vkBindImageMemory(device, pyramid.image, pyramid.memory, 0));
+
+    VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+    viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCI.format = VK_FORMAT_R32_SFLOAT;
+    viewCI.image = pyramid.image;
+    viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.mipLevels, 0, 1 };
+    VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &pyramid.view));
+
+    pyramid.mipViews.resize(pyramid.mipLevels);
+    for (uint32_t mip = 0; mip < pyramid.mipLevels; mip++)
+    {
+        viewCI.subresourceRange.baseMipLevel = mip;
+        viewCI.subresourceRange.levelCount = 1;
+        VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &pyramid.mipViews[mip]));
+    }
+
+    // Nearest, no filtering across texels: cull shader does the max itself
+    VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+    samplerCI.magFilter = VK_FILTER_NEAREST;
+    samplerCI.minFilter = VK_FILTER_NEAREST;
+    samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCI.minLod = 0.0f;
+    samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+    samplerCI.maxAnisotropy = 1.0f;
+    samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    pyramid.sampler = vulkanDevice->getSampler(samplerCI);
+}
+
+void HiZCulling::createBuffers()
+{
+    const VkDeviceSize drawDataSize = sizeof(voko_buffer::CullDrawData) * drawCount;
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &drawDataSSBO, drawDataSize));
+    VK_CHECK_RESULT(drawDataSSBO.map());
+
+    // Start with nothing visible: first frame draws everything in late phase
+    const VkDeviceSize visibilitySize = sizeof(uint32_t) * drawCount;
+    std::vector<uint32_t> visibility(drawCount, 0);
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &visibilitySSBO, visibilitySize, visibility.data()));
+
+    const VkDeviceSize indirectSize = sizeof(VkDrawIndexedIndirectCommand) * drawCount * static_cast<uint32_t>(ECullPhase::CullPhaseNum);
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &indirectBuffer, indirectSize));
+}
+
+void HiZCulling::setupDescriptorSets()
+{
+    // One reduction set per mip + one cull set
+    // Hi-Z reduction
+    {
+        std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+            // Binding 0: Source depth (scene depth or previous mip)
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            // Binding 1: Destination mip
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        };
+        hizDescriptorSetLayout = voko_global::descriptorAllocator->getLayout(setLayoutBindings);
+
+        VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(HiZPushConsts), 0);
+        VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&hizDescriptorSetLayout, 1);
+        pipelineLayoutCI.pushConstantRangeCount = 1;
+        pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &hizPipelineLayout));
+
+        hizDescriptorSets.resize(pyramid.mipLevels);
+        for (uint32_t mip = 0; mip < pyramid.mipLevels; mip++)
+        {
+            hizDescriptorSets[mip] = voko_global::descriptorAllocator->allocate(hizDescriptorSetLayout);
+
+            VkDescriptorImageInfo srcDescriptor = (mip == 0) ?
+                vks::initializers::descriptorImageInfo(pyramid.sampler, voko_global::depthStencil.depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) :
+                vks::initializers::descriptorImageInfo(pyramid.sampler, pyramid.mipViews[mip - 1], VK_IMAGE_LAYOUT_GENERAL);
+            VkDescriptorImageInfo dstDescriptor =
+                vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, pyramid.mipViews[mip], VK_IMAGE_LAYOUT_GENERAL);
+            voko_global::descriptorAllocator->update(hizDescriptorSets[mip], hizDescriptorSetLayout, { srcDescriptor, dstDescriptor });
+        }
+    }
+
+    // Culling
+    {
+        std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+            // Binding 0: Per mesh bounds & draw args
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            // Binding 1: Indirect commands
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+            // Binding 2: Visibility of last frame
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+            // Binding 3: Hi-Z pyramid
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+        };
+        cullDescriptorSetLayout = voko_global::descriptorAllocator->getLayout(setLayoutBindings);
+
+        // ds layouts: 0 for scene, 1 for culling
+        std::array<VkDescriptorSetLayout, 2> cullDsLayouts = { voko_global::SceneDescriptorSetLayout, cullDescriptorSetLayout };
+        VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CullPushConsts), 0);
+        VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(cullDsLayouts.data(), static_cast<uint32_t>(cullDsLayouts.size()));
+        pipelineLayoutCI.pushConstantRangeCount = 1;
+        pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &cullPipelineLayout));
+
+        cullDescriptorSet = voko_global::descriptorAllocator->allocate(cullDescriptorSetLayout);
+        VkDescriptorImageInfo pyramidDescriptor =
+            vks::initializers::descriptorImageInfo(pyramid.sampler, pyramid.view, VK_IMAGE_LAYOUT_GENERAL);
+        voko_global::descriptorAllocator->update(cullDescriptorSet, cullDescriptorSetLayout, {
+            drawDataSSBO.descriptor,
+            indirectBuffer.descriptor,
+            visibilitySSBO.descriptor,
+            pyramidDescriptor
+        });
+    }
+}
+
+void HiZCulling::preparePipelines()
+{
+    VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(hizPipelineLayout, 0);
+    pipelineCI.stage = vks::tools::loadShader(getShaderBasePath() + "culling/hiz.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT, device);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &hizPipeline));
+
+    pipelineCI = vks::initializers::computePipelineCreateInfo(cullPipelineLayout, 0);
+    pipelineCI.stage = vks::tools::loadShader(getShaderBasePath() + "culling/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT, device);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &cullPipeline));
+}
+
+void HiZCulling::updateDrawBounds()
+{
+    // Buffers & the cull set are sized for the meshes at creation
+    assert(voko_global::SceneMeshes.size() == drawCount && "Scene meshes changed after Hi-Z culling was created");
+    auto* drawData = static_cast<voko_buffer::CullDrawData*>(drawDataSSBO.mapped);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+
+        glm::vec3 boundsMin, boundsMax;
+        mesh->get_instance_bounds(boundsMin, boundsMax);
+
+        const glm::mat4 modelMatrix = mesh->get_node()->get_transform().get_matrix();
+        const float maxScale = std::max({
+            glm::length(glm::vec3(modelMatrix[0])),
+            glm::length(glm::vec3(modelMatrix[1])),
+            glm::length(glm::vec3(modelMatrix[2]))});
+        const glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        const float radius = glm::length(boundsMax - boundsMin) * 0.5f * maxScale;
+
+        drawData[Mesh_Index].boundingSphere = glm::vec4(center, radius);
+        drawData[Mesh_Index].indexCount = mesh->get_index_count();
+        drawData[Mesh_Index].instanceCount = std::max(1u, mesh->get_instance_count());
+        drawData[Mesh_Index].firstIndex = mesh->get_first_index();
+        drawData[Mesh_Index].vertexOffset = static_cast<int32_t>(mesh->VkGltfModel.vertices.first);
+        drawData[Mesh_Index].firstInstance = mesh->instanceOffset;
+    }
+}
+
+void HiZCulling::beginFrame(const glm::mat4& viewProjection)
+{
+    assert(voko_global::SceneMeshes.size() == drawCount && "Scene meshes changed after Hi-Z culling was created");
+    // Gpu of last frame is idle (submitFrame waits), the cull shader copies these into this frame's commands
+    auto* drawData = static_cast<voko_buffer::CullDrawData*>(drawDataSSBO.mapped);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        const Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+        drawData[Mesh_Index].indexCount = mesh->get_index_count();
+        drawData[Mesh_Index].firstIndex = mesh->get_first_index();
+    }
+}
+
+VkDeviceSize HiZCulling::getIndirectOffset(uint32_t meshIndex, ECullPhase phase) const
+{
+    return (static_cast<VkDeviceSize>(phase) * drawCount + meshIndex) * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+void HiZCulling::recordCull(VkCommandBuffer cmdBuffer, ECullPhase phase)
+{
+    if (drawCount == 0)
+    {
+        return;
+    }
+
+    // Previous indirect reads & cull writes (visibility) must finish before this dispatch
+    VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+    memoryBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    CullPushConsts pushConsts = {};
+    pushConsts.drawCount = drawCount;
+    pushConsts.phase = static_cast<uint32_t>(phase);
+    pushConsts.pyramidSize[0] = static_cast<float>(pyramid.width);
+    pushConsts.pyramidSize[1] = static_cast<float>(pyramid.height);
+    pushConsts.pyramidLevels = static_cast<float>(pyramid.mipLevels);
+
+    std::array<VkDescriptorSet, 2> cullDescriptorSets = { voko_global::SceneDescriptorSet, cullDescriptorSet };
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0,
+        static_cast<uint32_t>(cullDescriptorSets.size()), cullDescriptorSets.data(),
+        voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
+    vkCmdPushConstants(cmdBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConsts), &pushConsts);
+    vkCmdDispatch(cmdBuffer, (drawCount + 63) / 64, 1, 1);
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void HiZCulling::recordBuildPyramid(VkCommandBuffer cmdBuffer)
+{
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    // Stencil aspect should only be set on depth + stencil formats
+    if (voko_global::depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
+    {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    // Scene depth: attachment -> sampled
+    // Pyramid: fully rewritten every frame, old contents can be discarded
+    std::array<VkImageMemoryBarrier, 2> imageBarriers = { vks::initializers::imageMemoryBarrier(), vks::initializers::imageMemoryBarrier() };
+    imageBarriers[0].image = voko_global::depthStencil.image;
+    imageBarriers[0].subresourceRange = { depthAspect, 0, 1, 0, 1 };
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    imageBarriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    imageBarriers[1].image = pyramid.image;
+    imageBarriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.mipLevels, 0, 1 };
+    imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarriers[1].srcAccessMask = 0;
+    imageBarriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipeline);
+
+    uint32_t srcWidth = depthWidth;
+    uint32_t srcHeight = depthHeight;
+    for (uint32_t mip = 0; mip < pyramid.mipLevels; mip++)
+    {
+        const uint32_t dstWidth = std::max(1u, pyramid.width >> mip);
+        const uint32_t dstHeight = std::max(1u, pyramid.height >> mip);
+
+        HiZPushConsts pushConsts = {
+            { static_cast<int32_t>(srcWidth), static_cast<int32_t>(srcHeight) },
+            { static_cast<int32_t>(dstWidth), static_cast<int32_t>(dstHeight) }
+        };
+
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipelineLayout, 0, 1, &hizDescriptorSets[mip], 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZPushConsts), &pushConsts);
+        vkCmdDispatch(cmdBuffer, (dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+        // Written mip is the source of the next one & is read by late culling
+        VkImageMemoryBarrier mipBarrier = vks::initializers::imageMemoryBarrier();
+        mipBarrier.image = pyramid.image;
+        mipBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+        mipBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        mipBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        mipBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        mipBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &mipBarrier);
+
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+
+    // Scene depth back to attachment for the late phase draws
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    imageBarriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageBarriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &imageBarriers[0]);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "RenderPass/OcclusionCulling.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+}
+
+/**
+ * Two-phase GPU occlusion culling against a Hi-Z (max depth) pyramid of the scene depth
+ * Not a pass itself: cull dispatches, pyramid build and indirect draws are recorded into the owning pass cmd buffer
+ * Culling granularity is one draw per scene mesh (all of its instances), the scene meshes are fixed once it's created
+ */
+class HiZCulling : public OcclusionCulling
+{
+public:
+    HiZCulling() = delete;
+    // Depth size: extent of the geometry pass' depth attachment, which may only cover part of the global scene depth
+    HiZCulling(vks::VulkanDevice* inVulkanDevice, uint32_t inDepthWidth, uint32_t inDepthHeight);
+    ~HiZCulling() override;
+
+    // Rewrite per mesh bounding spheres & draw args, call after mesh transforms/instances change
+    void updateDrawBounds();
+    // Index ranges of the meshes' current lod into the draw data
+    void beginFrame(const glm::mat4& viewProjection) override;
+
+    // Write the indirect commands of `phase`, recorded outside of a render pass
+    void recordCull(VkCommandBuffer cmdBuffer, ECullPhase phase) override;
+    // Downsample global scene depth into the pyramid, recorded outside of a render pass
+    void recordBuildPyramid(VkCommandBuffer cmdBuffer) override;
+    bool hasLatePhase() const override { return true; }
+
+    VkBuffer getIndirectBuffer() const override { return indirectBuffer.buffer; }
+    VkDeviceSize getIndirectOffset(uint32_t meshIndex, ECullPhase phase) const override;
+
+private:
+    void createPyramid();
+    void createBuffers();
+    void setupDescriptorSets();
+    void preparePipelines();
+
+    vks::VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    // Rendered scene depth size, pyramid mip 0 is half of it
+    uint32_t depthWidth = 0;
+    uint32_t depthHeight = 0;
+    uint32_t drawCount = 0;
+
+    struct {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        // Full mip chain view for culling, one view per mip for the reduction
+        VkImageView view = VK_NULL_HANDLE;
+        std::vector<VkImageView> mipViews;
+        VkSampler sampler = VK_NULL_HANDLE;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 0;
+    } pyramid;
+
+    vks::Buffer drawDataSSBO;
+    // Per mesh visibility of last frame, read by early phase & written by late phase
+    vks::Buffer visibilitySSBO;
+    // [Early | Late] sections of drawCount commands each
+    vks::Buffer indirectBuffer;
+
+    // From voko_global::descriptorAllocator
+    VkDescriptorSetLayout hizDescriptorSetLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> hizDescriptorSets;
+    VkPipelineLayout hizPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline hizPipeline = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+
+    struct HiZPushConsts {
+        int32_t srcSize[2];
+        int32_t dstSize[2];
+    };
+
+    struct CullPushConsts {
+        uint32_t drawCount;
+        uint32_t phase;
+        float pyramidSize[2];
+        float pyramidLevels;
+    };
+};
@@ -0,0 +1,145 @@
+#include "InstanceCulling.h"
+
+#include <algorithm>
+#include <array>
+
+#include "voko_buffers.h"
+#include "voko_globals.h"
+#include "DescriptorAllocator.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+#include "SceneGraph/Mesh.h"
+
+InstanceCulling::InstanceCulling(vks::VulkanDevice* inVulkanDevice)
+    : vulkanDevice(inVulkanDevice),
+      device(inVulkanDevice->logicalDevice),
+      drawCount(static_cast<uint32_t>(voko_global::SceneMeshes.size()))
+{
+    culledMeshes.resize(drawCount, false);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        culledMeshes[Mesh_Index] = voko_global::SceneMeshes[Mesh_Index]->get_instance_count() > 1;
+    }
+
+    const VkDeviceSize indirectSize = std::max<VkDeviceSize>(1, drawCount) * sizeof(VkDrawIndexedIndirectCommand);
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &indirectBuffer, indirectSize));
+    // Index ranges follow the meshes' lod, so the reset args are rewritten every frame
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &resetBuffer, indirectSize));
+    VK_CHECK_RESULT(resetBuffer.map());
+    beginFrame();
+
+    setupDescriptorSet();
+    preparePipeline();
+}
+
+InstanceCulling::~InstanceCulling()
+{
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    voko_global::descriptorAllocator->release(descriptorSetLayout, descriptorSet);
+
+    indirectBuffer.destroy();
+    resetBuffer.destroy();
+}
+
+void InstanceCulling::beginFrame()
+{
+    auto* resetCommands = static_cast<VkDrawIndexedIndirectCommand*>(resetBuffer.mapped);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        const Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+        resetCommands[Mesh_Index].indexCount = mesh->get_index_count();
+        resetCommands[Mesh_Index].instanceCount = 0;
+        resetCommands[Mesh_Index].firstIndex = mesh->get_first_index();
+        resetCommands[Mesh_Index].vertexOffset = static_cast<int32_t>(mesh->VkGltfModel.vertices.first);
+        resetCommands[Mesh_Index].firstInstance = mesh->instanceOffset;
+    }
+}
+
+void InstanceCulling::setupDescriptorSet()
+{
+    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+        // Binding 0: Indirect commands
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+    };
+    descriptorSetLayout = voko_global::descriptorAllocator->getLayout(setLayoutBindings);
+
+    // ds layouts: 0 for scene, 1 for meshes (instances & visible indices), 2 for culling
+    std::array<VkDescriptorSetLayout, 3> cullDsLayouts = { voko_global::SceneDescriptorSetLayout, voko_global::MeshDescriptorSetLayout, descriptorSetLayout };
+    VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(voko_buffer::MeshPushConsts), 0);
+    VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(cullDsLayouts.data(), static_cast<uint32_t>(cullDsLayouts.size()));
+    pipelineLayoutCI.pushConstantRangeCount = 1;
+    pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+    descriptorSet = voko_global::descriptorAllocator->allocate(descriptorSetLayout);
+    voko_global::descriptorAllocator->update(descriptorSet, descriptorSetLayout, { indirectBuffer.descriptor });
+}
+
+void InstanceCulling::preparePipeline()
+{
+    VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+    pipelineCI.stage = vks::tools::loadShader(getShaderBasePath() + "culling/instance_cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT, device);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+}
+
+VkDeviceSize InstanceCulling::getIndirectOffset(uint32_t meshIndex) const
+{
+    return static_cast<VkDeviceSize>(meshIndex) * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+void InstanceCulling::recordCull(VkCommandBuffer cmdBuffer)
+{
+    if (drawCount == 0)
+    {
+        return;
+    }
+
+    // Last frame's indirect & visible index reads must finish before the reset
+    VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+    memoryBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy resetRegion = {};
+    resetRegion.size = sizeof(VkDrawIndexedIndirectCommand) * drawCount;
+    vkCmdCopyBuffer(cmdBuffer, resetBuffer.buffer, indirectBuffer.buffer, 1, &resetRegion);
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    std::array<VkDescriptorSet, 3> cullDescriptorSets = { voko_global::SceneDescriptorSet, voko_global::MeshDescriptorSet, descriptorSet };
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0,
+        static_cast<uint32_t>(cullDescriptorSets.size()), cullDescriptorSets.data(),
+        voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
+
+    // One dispatch per instanced mesh, bounds & instance range come from its draw data
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        if (!culledMeshes[Mesh_Index])
+        {
+            continue;
+        }
+        const voko_buffer::MeshPushConsts pushConsts = { Mesh_Index };
+        vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(voko_buffer::MeshPushConsts), &pushConsts);
+        vkCmdDispatch(cmdBuffer, (voko_global::SceneMeshes[Mesh_Index]->get_instance_count() + 63) / 64, 1, 1);
+    }
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
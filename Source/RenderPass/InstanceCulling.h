@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+}
+
+/**
+ * Per instance GPU frustum culling of instanced scene meshes
+ * Visible instances are compacted into each mesh's visible instance indices & counted into one indirect command per mesh,
+ * the geometry pass then draws only those instances
+ * Meshes with a single instance are left to occlusion culling / plain draws
+ */
+class InstanceCulling
+{
+public:
+    InstanceCulling() = delete;
+    explicit InstanceCulling(vks::VulkanDevice* inVulkanDevice);
+    ~InstanceCulling();
+
+    // Whether the mesh's geometry pass draw comes from this culler
+    bool isCulled(uint32_t meshIndex) const { return meshIndex < culledMeshes.size() && culledMeshes[meshIndex]; }
+
+    // Rewrite the reset args with the meshes' current lod, gpu of last frame must be idle (submitFrame waits)
+    void beginFrame();
+    // Reset counts & compact visible instances, recorded outside of a render pass
+    void recordCull(VkCommandBuffer cmdBuffer);
+
+    VkBuffer getIndirectBuffer() const { return indirectBuffer.buffer; }
+    VkDeviceSize getIndirectOffset(uint32_t meshIndex) const;
+
+private:
+    void setupDescriptorSet();
+    void preparePipeline();
+
+    vks::VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    uint32_t drawCount = 0;
+    std::vector<bool> culledMeshes;
+    // Host visible draw args with instance count 0, copied over the indirect buffer before culling
+    vks::Buffer resetBuffer;
+
+    // One command per scene mesh, instance count written by culling
+    vks::Buffer indirectBuffer;
+
+    // From voko_global::descriptorAllocator
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+};
@@ -1,5 +1,6 @@
 #include "Lighting.h"
 #include "voko_globals.h"
+#include "DescriptorAllocator.h"
 #include "VulkanFrameBuffer.hpp"
 
 LightingPass::LightingPass(const std::string& name, vks::VulkanDevice* inVulkanDevice, uint32_t inWidth, uint32_t inHeight,
@@ -20,6 +21,15 @@ m_ShadowPass(ShadowPass), m_GeometryPass(GeometryPass)
     
 }
 
+LightingPass::~LightingPass()
+{
+	// Not allocated when init failed
+	if (descriptorSet != VK_NULL_HANDLE)
+	{
+		voko_global::descriptorAllocator->release(descriptorSetLayout, descriptorSet);
+	}
+}
+
 void LightingPass::setupFrameBuffer()
 {
 	frameBuffer = new vks::Framebuffer(vulkanDevice);
@@ -53,8 +63,7 @@ void LightingPass::setupDescriptorSet()
 		// Binding 6: Shadow map
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6)
 	};
-	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vulkanDevice->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+	descriptorSetLayout = voko_global::descriptorAllocator->getLayout(setLayoutBindings);
 
 	// ds layouts: 0 for scene, 1 for lighting samplers
 	std::vector<VkDescriptorSetLayout> lightingDSLayout = { voko_global::SceneDescriptorSetLayout, descriptorSetLayout };
@@ -64,23 +73,8 @@ void LightingPass::setupDescriptorSet()
 	VK_CHECK_RESULT(vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 
-	// create pool for ds allocation
-	std::vector<VkDescriptorPoolSize> poolSizes =
-		{
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
-		};
-
-	VkDescriptorPoolCreateInfo descriptorPoolInfo =
-		vks::initializers::descriptorPoolCreateInfo(
-			static_cast<uint32_t>(poolSizes.size()),
-			poolSizes.data(),
-			1);
-
-	VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
-
-	// allocate ds from pool
-	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &descriptorSet));
+	// allocate ds from the shared allocator
+	descriptorSet = voko_global::descriptorAllocator->allocate(descriptorSetLayout);
 
 	// update ds
 	
@@ -127,25 +121,16 @@ void LightingPass::setupDescriptorSet()
 		m_ShadowPass->getFrameBuffer()->attachments[0].view,
 		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 	
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-	writeDescriptorSets = {
-		// Binding 0: World space position texture
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &texDescriptorPosition),
-		// Binding 1: World space normals texture
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorNormal),
-		// Binding 2: Albedo texture
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorAlbedo),
-		// Binding 3: Metallic texture
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorMetallic),
-		// Binding 4: Roughness texture
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &texDescriptorRoughness),
-		// Binding 5: AO texture
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &texDescriptorAO),
-		// Binding 6: Shadow map
-		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &texDescriptorShadowMap),
-	};
-
-	vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	// Bindings 0-6: position, normals, albedo, metallic, roughness, AO, shadow map
+	voko_global::descriptorAllocator->update(descriptorSet, descriptorSetLayout, {
+		texDescriptorPosition,
+		texDescriptorNormal,
+		texDescriptorAlbedo,
+		texDescriptorMetallic,
+		texDescriptorRoughness,
+		texDescriptorAO,
+		texDescriptorShadowMap
+	});
 
 }
 
@@ -231,7 +216,8 @@ void LightingPass::buildCommandBuffer()
 
     // bind scene ds
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-                            &voko_global::SceneDescriptorSet, 0, nullptr);
+                            &voko_global::SceneDescriptorSet,
+                            voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
     // bind lighint pass ds
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &descriptorSet, 0,
                             nullptr);
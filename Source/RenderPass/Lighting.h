@@ -14,7 +14,7 @@ public:
                 // Lighting pass specials:
                 std::shared_ptr<RenderPass> ShadowPass,
                 std::shared_ptr<RenderPass> GeometryPass);
-    virtual ~LightingPass() override = default;
+    virtual ~LightingPass() override;
     virtual void setupFrameBuffer() override;
     virtual void setupDescriptorSet() override;
     virtual void preparePipeline() override;
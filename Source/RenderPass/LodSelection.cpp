@@ -0,0 +1,107 @@
+#include "LodSelection.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "voko_globals.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "SceneGraph/Mesh.h"
+
+namespace
+{
+    // [Full | Positions] sections per view
+    constexpr uint32_t LOD_STREAM_COUNT = 2;
+}
+
+LodSelection::LodSelection(vks::VulkanDevice* inVulkanDevice)
+    : drawCount(static_cast<uint32_t>(voko_global::SceneMeshes.size()))
+{
+    const VkDeviceSize indirectSize = std::max<VkDeviceSize>(1, drawCount) * static_cast<uint32_t>(ELodView::LodViewNum) * LOD_STREAM_COUNT
+        * sizeof(VkDrawIndexedIndirectCommand);
+    VK_CHECK_RESULT(inVulkanDevice->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &indirectBuffer, indirectSize));
+    VK_CHECK_RESULT(indirectBuffer.map());
+
+    // LOD0 until the first selection
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        writeDrawArgs(Mesh_Index);
+    }
+}
+
+LodSelection::~LodSelection()
+{
+    indirectBuffer.destroy();
+}
+
+VkDeviceSize LodSelection::getIndirectOffset(uint32_t meshIndex, ELodView view, bool positions) const
+{
+    const uint32_t section = static_cast<uint32_t>(view) * LOD_STREAM_COUNT + (positions ? 1 : 0);
+    return (static_cast<VkDeviceSize>(section) * drawCount + meshIndex) * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+void LodSelection::select(const glm::mat4& view, const glm::mat4& projection)
+{
+    // Pixels per view space unit at distance 1
+    const float pixelScale = 0.5f * static_cast<float>(voko_global::height) * std::abs(projection[1][1]);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+        if (mesh->VkGltfModel.lods.size() > 1)
+        {
+            // Pixels per model unit of the nearest instance's bounding sphere
+            const float pixelsPerUnit = mesh->get_pixels_per_unit(view, pixelScale);
+            mesh->lod = selectWithHysteresis(Mesh_Index, pixelsPerUnit, mesh->lod);
+            mesh->shadowLod = selectWithHysteresis(Mesh_Index, pixelsPerUnit * shadowLodBias, mesh->shadowLod);
+        }
+        writeDrawArgs(Mesh_Index);
+    }
+}
+
+uint32_t LodSelection::selectLod(uint32_t meshIndex, float pixelsPerUnit, float threshold) const
+{
+    // Errors grow along the chain
+    const auto& lods = voko_global::SceneMeshes[meshIndex]->VkGltfModel.lods;
+    uint32_t lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= threshold)
+    {
+        lod++;
+    }
+    return lod;
+}
+
+uint32_t LodSelection::selectWithHysteresis(uint32_t meshIndex, float pixelsPerUnit, uint32_t current) const
+{
+    // Switch finer once the error exceeds the upper band, coarser once it's below the lower one
+    const uint32_t finest = selectLod(meshIndex, pixelsPerUnit, pixelErrorThreshold * (1.0f - hysteresis));
+    const uint32_t coarsest = selectLod(meshIndex, pixelsPerUnit, pixelErrorThreshold * (1.0f + hysteresis));
+    return std::clamp(current, finest, coarsest);
+}
+
+void LodSelection::writeDrawArgs(uint32_t meshIndex)
+{
+    const Mesh* mesh = voko_global::SceneMeshes[meshIndex];
+    const auto& model = mesh->VkGltfModel;
+    const uint32_t instanceCount = std::max(1u, mesh->get_instance_count());
+    auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffer.mapped);
+
+    const uint32_t viewLods[] = { mesh->lod, mesh->shadowLod };
+    for (uint32_t view = 0; view < static_cast<uint32_t>(ELodView::LodViewNum); view++)
+    {
+        const auto& lod = model.lods[viewLods[view]];
+
+        VkDrawIndexedIndirectCommand& full = commands[getIndirectOffset(meshIndex, static_cast<ELodView>(view), false) / sizeof(VkDrawIndexedIndirectCommand)];
+        full.indexCount = lod.indexCount;
+        full.instanceCount = instanceCount;
+        full.firstIndex = model.indices.first + lod.firstIndex;
+        full.vertexOffset = static_cast<int32_t>(model.vertices.first);
+        full.firstInstance = mesh->instanceOffset;
+
+        VkDrawIndexedIndirectCommand& positions = commands[getIndirectOffset(meshIndex, static_cast<ELodView>(view), true) / sizeof(VkDrawIndexedIndirectCommand)];
+        positions = full;
+        positions.firstIndex = model.positionStream.firstIndex + lod.firstIndex;
+        positions.vertexOffset = static_cast<int32_t>(model.positionStream.first);
+    }
+}
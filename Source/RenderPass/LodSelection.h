@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+}
+
+// Views with their own lod choice
+enum class ELodView
+{
+    Camera = 0,
+    // Shadow casters, selected from the camera with a coarser bias
+    Shadow = 1,
+    LodViewNum
+};
+
+/**
+ * Screen size LOD selection of scene meshes (vkglTF::Model::lods)
+ * Per mesh, the nearest instance's bounding sphere gives the pixels per model unit, the coarsest level whose error stays
+ * below pixelErrorThreshold is taken, with a hysteresis band so meshes near a threshold don't flip every frame
+ * Selected levels are stored on the meshes & written as indirect draw args, rewritten every frame like CpuOcclusionCulling
+ */
+class LodSelection
+{
+public:
+    LodSelection() = delete;
+    explicit LodSelection(vks::VulkanDevice* inVulkanDevice);
+    ~LodSelection();
+
+    // Gpu of last frame must be idle (submitFrame waits), mapped args are rewritten
+    void select(const glm::mat4& view, const glm::mat4& projection);
+
+    VkBuffer getIndirectBuffer() const { return indirectBuffer.buffer; }
+    // positions: args of the mesh's position stream instead of its full vertex stream
+    VkDeviceSize getIndirectOffset(uint32_t meshIndex, ELodView view, bool positions) const;
+
+    // Allowed projected error in pixels
+    float pixelErrorThreshold = 1.0f;
+    // Relative band around the threshold in which the current level is kept
+    float hysteresis = 0.25f;
+    // Scales the shadow view's pixel size, < 1 picks coarser casters
+    float shadowLodBias = 0.5f;
+
+private:
+    // Coarsest level of the mesh whose projected error is within threshold
+    uint32_t selectLod(uint32_t meshIndex, float pixelsPerUnit, float threshold) const;
+    uint32_t selectWithHysteresis(uint32_t meshIndex, float pixelsPerUnit, uint32_t current) const;
+    void writeDrawArgs(uint32_t meshIndex);
+
+    uint32_t drawCount = 0;
+
+    // Host visible, [Camera | Shadow] x [Full | Positions] sections of drawCount commands each
+    vks::Buffer indirectBuffer;
+};
@@ -0,0 +1,228 @@
+#include "MeshletCulling.h"
+
+#include <algorithm>
+#include <array>
+
+#include "voko_buffers.h"
+#include "voko_globals.h"
+#include "DescriptorAllocator.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+#include "SceneGraph/Mesh.h"
+
+namespace
+{
+    // Fewer meshlets than this aren't worth the cull dispatch & index copy
+    constexpr uint32_t MESHLET_CULL_MIN_COUNT = 8;
+}
+
+MeshletCulling::MeshletCulling(vks::VulkanDevice* inVulkanDevice, VkQueue transferQueue)
+    : vulkanDevice(inVulkanDevice),
+      device(inVulkanDevice->logicalDevice),
+      drawCount(static_cast<uint32_t>(voko_global::SceneMeshes.size()))
+{
+    culledMeshes.resize(drawCount, false);
+    meshletOffsets.resize(drawCount, 0);
+    outputOffsets.resize(drawCount, 0);
+    dispatchMeshletCounts.resize(drawCount, 0);
+
+    std::vector<voko_buffer::MeshletData> meshletData;
+    uint32_t outputSize = 0;
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        const Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+        const auto& model = mesh->VkGltfModel;
+        // Source indices are read from the arena, instanced meshes belong to instance culling
+        if (!model.arena || model.meshlets.empty() || mesh->get_instance_count() > 1 || model.lods[0].meshletCount < MESHLET_CULL_MIN_COUNT)
+        {
+            continue;
+        }
+        culledMeshes[Mesh_Index] = true;
+
+        meshletOffsets[Mesh_Index] = static_cast<uint32_t>(meshletData.size());
+        for (const auto& meshlet : model.meshlets)
+        {
+            voko_buffer::MeshletData data = {};
+            data.boundingSphere = meshlet.boundingSphere;
+            data.cone = meshlet.cone;
+            data.firstIndex = model.indices.first + meshlet.firstIndex;
+            data.indexCount = meshlet.indexCount;
+            data.index16 = model.indices.type == VK_INDEX_TYPE_UINT16 ? 1 : 0;
+            meshletData.push_back(data);
+        }
+        for (const auto& lod : model.lods)
+        {
+            dispatchMeshletCounts[Mesh_Index] = std::max(dispatchMeshletCounts[Mesh_Index], lod.meshletCount);
+        }
+        // LOD0 is the largest level
+        outputOffsets[Mesh_Index] = outputSize;
+        outputSize += model.lods[0].indexCount;
+    }
+
+    // Static meshlet data, device local
+    const VkDeviceSize meshletSize = std::max<size_t>(1, meshletData.size()) * sizeof(voko_buffer::MeshletData);
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &meshletSSBO, meshletSize));
+    if (!meshletData.empty())
+    {
+        vks::Buffer staging;
+        VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &staging, meshletSize, meshletData.data()));
+        vulkanDevice->copyBuffer(&staging, &meshletSSBO, transferQueue);
+        staging.destroy();
+    }
+
+    const VkDeviceSize perMeshSize = std::max<VkDeviceSize>(1, drawCount);
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &cullMeshSSBO, perMeshSize * sizeof(voko_buffer::MeshletCullMesh)));
+    VK_CHECK_RESULT(cullMeshSSBO.map());
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &culledIndexBuffer, std::max<VkDeviceSize>(1, outputSize) * sizeof(uint32_t)));
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &indirectBuffer, perMeshSize * sizeof(VkDrawIndexedIndirectCommand)));
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &resetBuffer, perMeshSize * sizeof(VkDrawIndexedIndirectCommand)));
+    VK_CHECK_RESULT(resetBuffer.map());
+    beginFrame();
+
+    setupDescriptorSet();
+    preparePipeline();
+}
+
+MeshletCulling::~MeshletCulling()
+{
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    voko_global::descriptorAllocator->release(descriptorSetLayout, descriptorSet);
+
+    meshletSSBO.destroy();
+    cullMeshSSBO.destroy();
+    culledIndexBuffer.destroy();
+    indirectBuffer.destroy();
+    resetBuffer.destroy();
+}
+
+void MeshletCulling::beginFrame()
+{
+    auto* cullMeshes = static_cast<voko_buffer::MeshletCullMesh*>(cullMeshSSBO.mapped);
+    auto* resetCommands = static_cast<VkDrawIndexedIndirectCommand*>(resetBuffer.mapped);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        if (!culledMeshes[Mesh_Index])
+        {
+            continue;
+        }
+        const Mesh* mesh = voko_global::SceneMeshes[Mesh_Index];
+        const auto& lod = mesh->VkGltfModel.lods[mesh->lod];
+
+        cullMeshes[Mesh_Index].firstMeshlet = meshletOffsets[Mesh_Index] + lod.firstMeshlet;
+        cullMeshes[Mesh_Index].meshletCount = lod.meshletCount;
+        cullMeshes[Mesh_Index].outputOffset = outputOffsets[Mesh_Index];
+
+        resetCommands[Mesh_Index].indexCount = 0;
+        resetCommands[Mesh_Index].instanceCount = 1;
+        resetCommands[Mesh_Index].firstIndex = outputOffsets[Mesh_Index];
+        resetCommands[Mesh_Index].vertexOffset = static_cast<int32_t>(mesh->VkGltfModel.vertices.first);
+        resetCommands[Mesh_Index].firstInstance = mesh->instanceOffset;
+    }
+}
+
+void MeshletCulling::setupDescriptorSet()
+{
+    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+        // Binding 0: Meshlets
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        // Binding 1: Per mesh meshlet ranges
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        // Binding 2: Arena indices
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+        // Binding 3: Culled indices
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+        // Binding 4: Indirect commands
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+    };
+    descriptorSetLayout = voko_global::descriptorAllocator->getLayout(setLayoutBindings);
+
+    // ds layouts: 0 for scene, 1 for meshes, 2 for culling
+    std::array<VkDescriptorSetLayout, 3> cullDsLayouts = { voko_global::SceneDescriptorSetLayout, voko_global::MeshDescriptorSetLayout, descriptorSetLayout };
+    VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(voko_buffer::MeshPushConsts), 0);
+    VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(cullDsLayouts.data(), static_cast<uint32_t>(cullDsLayouts.size()));
+    pipelineLayoutCI.pushConstantRangeCount = 1;
+    pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+    descriptorSet = voko_global::descriptorAllocator->allocate(descriptorSetLayout);
+    voko_global::descriptorAllocator->update(descriptorSet, descriptorSetLayout, {
+        meshletSSBO.descriptor,
+        cullMeshSSBO.descriptor,
+        vkglTF::geometryArena->getIndexDescriptor(),
+        culledIndexBuffer.descriptor,
+        indirectBuffer.descriptor
+    });
+}
+
+void MeshletCulling::preparePipeline()
+{
+    VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+    pipelineCI.stage = vks::tools::loadShader(getShaderBasePath() + "culling/meshlet_cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT, device);
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+}
+
+VkDeviceSize MeshletCulling::getIndirectOffset(uint32_t meshIndex) const
+{
+    return static_cast<VkDeviceSize>(meshIndex) * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+void MeshletCulling::recordCull(VkCommandBuffer cmdBuffer)
+{
+    if (std::none_of(culledMeshes.begin(), culledMeshes.end(), [](bool culled) { return culled; }))
+    {
+        return;
+    }
+
+    // Last frame's indirect & index reads must finish before the reset
+    VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+    memoryBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy resetRegion = {};
+    resetRegion.size = sizeof(VkDrawIndexedIndirectCommand) * drawCount;
+    vkCmdCopyBuffer(cmdBuffer, resetBuffer.buffer, indirectBuffer.buffer, 1, &resetRegion);
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    std::array<VkDescriptorSet, 3> cullDescriptorSets = { voko_global::SceneDescriptorSet, voko_global::MeshDescriptorSet, descriptorSet };
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0,
+        static_cast<uint32_t>(cullDescriptorSets.size()), cullDescriptorSets.data(),
+        voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
+
+    // One dispatch per culled mesh, sized for its largest lod
+    for (uint32_t Mesh_Index = 0; Mesh_Index < drawCount; Mesh_Index++)
+    {
+        if (!culledMeshes[Mesh_Index])
+        {
+            continue;
+        }
+        const voko_buffer::MeshPushConsts pushConsts = { Mesh_Index };
+        vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(voko_buffer::MeshPushConsts), &pushConsts);
+        vkCmdDispatch(cmdBuffer, (dispatchMeshletCounts[Mesh_Index] + 63) / 64, 1, 1);
+    }
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+}
+
+/**
+ * GPU cluster culling of single instance scene meshes built with vkglTF::FileLoadingFlags::BuildMeshlets
+ * Meshlets of each mesh's current lod are frustum & normal cone culled in compute, the surviving index ranges are
+ * compacted into a 32 bit index buffer & drawn with one indirect command per mesh (no mesh shaders needed)
+ * Instanced meshes are left to instance culling, small meshes to occlusion culling / plain draws
+ */
+class MeshletCulling
+{
+public:
+    MeshletCulling() = delete;
+    // transferQueue: upload of the static meshlet data
+    MeshletCulling(vks::VulkanDevice* inVulkanDevice, VkQueue transferQueue);
+    ~MeshletCulling();
+
+    // Whether the mesh's geometry pass draw comes from this culler
+    bool isCulled(uint32_t meshIndex) const { return meshIndex < culledMeshes.size() && culledMeshes[meshIndex]; }
+
+    // Rewrite the culled meshes' meshlet ranges & reset args for their current lod, gpu of last frame must be idle (submitFrame waits)
+    void beginFrame();
+    // Reset counts & compact surviving meshlet indices, recorded outside of a render pass
+    void recordCull(VkCommandBuffer cmdBuffer);
+
+    // Bind as VK_INDEX_TYPE_UINT32 for the culled meshes' draws, vertexOffset stays the mesh's
+    VkBuffer getIndexBuffer() const { return culledIndexBuffer.buffer; }
+    VkBuffer getIndirectBuffer() const { return indirectBuffer.buffer; }
+    VkDeviceSize getIndirectOffset(uint32_t meshIndex) const;
+
+private:
+    void setupDescriptorSet();
+    void preparePipeline();
+
+    vks::VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    uint32_t drawCount = 0;
+    std::vector<bool> culledMeshes;
+    // Per mesh: first of its meshlets in meshletSSBO, its output range in culledIndexBuffer & the dispatch size (largest lod)
+    std::vector<uint32_t> meshletOffsets;
+    std::vector<uint32_t> outputOffsets;
+    std::vector<uint32_t> dispatchMeshletCounts;
+
+    vks::Buffer meshletSSBO;
+    // Host visible, voko_buffer::MeshletCullMesh per mesh, rewritten every frame
+    vks::Buffer cullMeshSSBO;
+    vks::Buffer culledIndexBuffer;
+    // One command per scene mesh, index count written by culling
+    vks::Buffer indirectBuffer;
+    // Host visible draw args with index count 0, copied over the indirect buffer before culling
+    vks::Buffer resetBuffer;
+
+    // From voko_global::descriptorAllocator
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "glm/glm.hpp"
+
+// Indirect command section a pass draws from
+enum class ECullPhase
+{
+    // Meshes visible last frame, frustum tested
+    Early = 0x00,
+    // Meshes that passed the Hi-Z test but were not drawn in the early phase
+    Late = 0x01,
+    CullPhaseNum
+};
+
+/**
+ * Occlusion culling interface used by mesh passes
+ * Culled passes draw scene meshes indirect, instance count 0 for culled meshes
+ */
+class OcclusionCulling
+{
+public:
+    virtual ~OcclusionCulling() = default;
+
+    // Cpu side work of a frame, started before & finished before submitting the culled passes
+    virtual void beginFrame(const glm::mat4& viewProjection) {}
+    virtual void waitFrame() {}
+
+    // Gpu side work, recorded into the culled pass cmd buffer outside of a render pass
+    virtual void recordCull(VkCommandBuffer cmdBuffer, ECullPhase phase) {}
+    virtual void recordBuildPyramid(VkCommandBuffer cmdBuffer) {}
+    // Whether ECullPhase::Late draws are needed after the early ones
+    virtual bool hasLatePhase() const { return false; }
+
+    virtual VkBuffer getIndirectBuffer() const = 0;
+    virtual VkDeviceSize getIndirectOffset(uint32_t meshIndex, ECullPhase phase) const = 0;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <memory>
 #include <string>
 #include <variant>
 #include <vector>
@@ -7,6 +9,10 @@
 #include <vulkan/vulkan_core.h>
 
 #include "voko_globals.h"
+#include "RenderPass/InstanceCulling.h"
+#include "RenderPass/LodSelection.h"
+#include "RenderPass/MeshletCulling.h"
+#include "RenderPass/OcclusionCulling.h"
 #include "SceneGraph/Mesh.h"
 
 namespace vks
@@ -82,10 +88,12 @@ public:
             VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &commandBufferAllocateInfo, drawCmdBuffers.data()));
         }else
         {
-            if (cmdBuffer == VK_NULL_HANDLE)
+            // One per frame slot, each binds its slot's scene uniforms
+            for (VkCommandBuffer& frameCmdBuffer : frameCmdBuffers)
             {
-                cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+                frameCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
             }
+            cmdBuffer = frameCmdBuffers[0];
         }
     }
     
@@ -97,17 +105,98 @@ public:
         setupFrameBuffer();
         setupDescriptorSet();
         preparePipeline();
-        buildCommandBuffer();
+        if (passAttachmentType == EPassAttachmentType::OffScreen)
+        {
+            for (uint32_t slot = 0; slot < voko_global::FRAME_SLOTS; slot++)
+            {
+                voko_global::frameSlot = slot;
+                cmdBuffer = frameCmdBuffers[slot];
+                buildCommandBuffer();
+            }
+        }else
+        {
+            buildCommandBuffer();
+        }
         bInitialized = true;
     }
-    virtual void RenderScene()
+    // phase: indirect command section to draw when occlusion culling is enabled
+    // pipelineLayout: set 1 is voko_global::MeshDescriptorSetLayout & has a voko_buffer::MeshPushConsts range for all graphics stages
+    virtual void RenderScene(ECullPhase phase = ECullPhase::Early)
     {
-        for (int Mesh_Index = 0; Mesh_Index < voko_global::SceneMeshes.size(); Mesh_Index++)
+        // Bind Mesh Ds once, draws select their mesh by push constant
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &voko_global::MeshDescriptorSet, 0, NULL);
+        if (bPositionOnly)
+        {
+            RenderScenePositions();
+            return;
+        }
+        // Arena models share one vertex & index buffer, draws address them by firstIndex & vertexOffset
+        VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+        if (vkglTF::geometryArena)
+        {
+            vkglTF::geometryArena->bindBuffers(cmdBuffer, boundIndexType);
+        }
+        for (uint32_t Mesh_Index = 0; Mesh_Index < voko_global::SceneMeshes.size(); Mesh_Index++)
         {
             const auto mesh = voko_global::SceneMeshes[Mesh_Index];
-            // Bind Per Mesh Ds
-            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &voko_global::PerMeshDescriptorSets[Mesh_Index], 0, NULL);
-            mesh->draw_mesh(cmdBuffer);
+            bindArenaIndexType(mesh, boundIndexType);
+            const voko_buffer::MeshPushConsts meshPushConsts = { Mesh_Index };
+            vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(voko_buffer::MeshPushConsts), &meshPushConsts);
+            if (instanceCulling && instanceCulling->isCulled(Mesh_Index))
+            {
+                // Visible instances were compacted before the pass, drawn once in the early phase
+                if (phase == ECullPhase::Early)
+                {
+                    mesh->draw_mesh_indirect(cmdBuffer, instanceCulling->getIndirectBuffer(), instanceCulling->getIndirectOffset(Mesh_Index));
+                }
+            }else if (meshletCulling && meshletCulling->isCulled(Mesh_Index))
+            {
+                // Surviving meshlets' indices were compacted before the pass (32 bit), drawn once in the early phase
+                if (phase == ECullPhase::Early)
+                {
+                    vkCmdBindIndexBuffer(cmdBuffer, meshletCulling->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+                    mesh->draw_mesh_indirect(cmdBuffer, meshletCulling->getIndirectBuffer(), meshletCulling->getIndirectOffset(Mesh_Index));
+                    mesh->VkGltfModel.arena->bindIndexBuffer(cmdBuffer, boundIndexType);
+                }
+            }else if (occlusionCulling)
+            {
+                mesh->draw_mesh_indirect(cmdBuffer, occlusionCulling->getIndirectBuffer(), occlusionCulling->getIndirectOffset(Mesh_Index, phase));
+            }else if (lodSelection)
+            {
+                mesh->draw_mesh_indirect(cmdBuffer, lodSelection->getIndirectBuffer(), lodSelection->getIndirectOffset(Mesh_Index, lodView, false));
+            }else
+            {
+                mesh->draw_mesh(cmdBuffer);
+            }
+        }
+    }
+    // Depth only: every instance from the position stream, the pipeline uses vkglTF::Vertex::getPipelinePositionInputState
+    void RenderScenePositions()
+    {
+        VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+        vkglTF::geometryArena->bindPositionBuffers(cmdBuffer, boundIndexType);
+        for (uint32_t Mesh_Index = 0; Mesh_Index < voko_global::SceneMeshes.size(); Mesh_Index++)
+        {
+            bindArenaIndexType(voko_global::SceneMeshes[Mesh_Index], boundIndexType);
+            const voko_buffer::MeshPushConsts meshPushConsts = { Mesh_Index };
+            vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(voko_buffer::MeshPushConsts), &meshPushConsts);
+            if (lodSelection)
+            {
+                voko_global::SceneMeshes[Mesh_Index]->draw_mesh_indirect(cmdBuffer, lodSelection->getIndirectBuffer(), lodSelection->getIndirectOffset(Mesh_Index, lodView, true));
+            }else
+            {
+                voko_global::SceneMeshes[Mesh_Index]->draw_mesh_positions(cmdBuffer);
+            }
+        }
+    }
+    // Arena index ranges are 16 or 32 bit per model, rebind the shared index buffer when the type changes
+    void bindArenaIndexType(Mesh* mesh, VkIndexType& boundIndexType)
+    {
+        const VkIndexType indexType = mesh->VkGltfModel.indices.type;
+        if (mesh->VkGltfModel.arena && indexType != boundIndexType)
+        {
+            mesh->VkGltfModel.arena->bindIndexBuffer(cmdBuffer, indexType);
+            boundIndexType = indexType;
         }
     }
     virtual void setupFrameBuffer(){}
@@ -142,13 +231,13 @@ public:
             
         }else if(passAttachmentType == EPassAttachmentType::OffScreen)
         {
-            if(cmdBuffer == VK_NULL_HANDLE)
+            if(frameCmdBuffers[voko_global::frameSlot] == VK_NULL_HANDLE)
             {
                 vks::tools::exitFatal("Pass Doesn't Build a Command Buffer!", 1);
                 return nullptr;
             }
 
-            return &cmdBuffer;
+            return &frameCmdBuffers[voko_global::frameSlot];
 
             
         }
@@ -164,16 +253,29 @@ public:
     uint32_t height = 0;
     vks::Framebuffer *frameBuffer = nullptr;
 
-    // Pass ds related:
-    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    // Pass ds related, from voko_global::descriptorAllocator:
     VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
     VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
     VkPipelineCache pipelineCache = VK_NULL_HANDLE;
     VkPipeline pipeline = VK_NULL_HANDLE;
+    // Offscreen: the frame slot's cmd buffer while building
     VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+    std::array<VkCommandBuffer, voko_global::FRAME_SLOTS> frameCmdBuffers{};
     VkSemaphore passSemaphore = VK_NULL_HANDLE;
+
+    // Optional gpu occlusion culling, scene meshes are drawn indirect when set
+    std::shared_ptr<OcclusionCulling> occlusionCulling;
+    // Optional per instance culling, takes over the draws of instanced meshes when set
+    std::shared_ptr<InstanceCulling> instanceCulling;
+    // Optional meshlet culling, takes over the draws of large single instance meshes when set
+    std::shared_ptr<MeshletCulling> meshletCulling;
+    // Draw the scene meshes' position only stream (no culling), for depth only passes
+    bool bPositionOnly = false;
+    // Optional per view lod selection, unculled draws take their args from it when set (culled draws read Mesh::lod)
+    std::shared_ptr<LodSelection> lodSelection;
+    ELodView lodView = ELodView::Camera;
     
 
     ERenderPassType PassType;
@@ -11,11 +11,16 @@ ShadowPass::ShadowPass(const std::string& name, vks::VulkanDevice* inVulkanDevic
                        ERenderPassType inPassType, EPassAttachmentType inAttachmentType,
                        // Shadow Pass Specials:
                        float inDepthBiasConstant,
-                       float inDepthBiasSlope):
+                       float inDepthBiasSlope,
+                       std::shared_ptr<LodSelection> inLodSelection):
     RenderPass(name, inVulkanDevice, inWidth, inHeight, inPassType, inAttachmentType),
     // Shadow Pass Specials:
     depthBiasConstant(inDepthBiasConstant), depthBiasSlope(inDepthBiasSlope)
 {
+    // Shadow casters only need positions
+    bPositionOnly = true;
+    lodSelection = inLodSelection;
+    lodView = ELodView::Shadow;
     init();
 }
 
@@ -54,10 +59,14 @@ void ShadowPass::setupFrameBuffer()
 
 void ShadowPass::setupDescriptorSet()
 {
-    std::array<VkDescriptorSetLayout ,2> shadowDsLayouts = {voko_global::SceneDescriptorSetLayout, voko_global::PerMeshDescriptorSetLayout};
+    std::array<VkDescriptorSetLayout ,2> shadowDsLayouts = {voko_global::SceneDescriptorSetLayout, voko_global::MeshDescriptorSetLayout};
+    // Mesh index of each draw
+    VkPushConstantRange meshPushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_ALL_GRAPHICS, sizeof(voko_buffer::MeshPushConsts), 0);
     // Layout
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(
         shadowDsLayouts.data(), static_cast<uint32_t>(shadowDsLayouts.size()));
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &meshPushConstantRange;
     VK_CHECK_RESULT(
         vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 }
@@ -94,6 +103,11 @@ void ShadowPass::preparePipeline()
     std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
     shaderStages[0] = vks::tools::loadShader(getShaderBasePath() + VSPath,
                                              VK_SHADER_STAGE_VERTEX_BIT, vulkanDevice->logicalDevice);
+    // Vertex decoding matches the scene meshes' vertex layout (util/vertex.glsl)
+    const VkBool32 compactVertex = voko_global::bCompactVertices ? VK_TRUE : VK_FALSE;
+    const VkSpecializationMapEntry vertexSpecializationEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+    const VkSpecializationInfo vertexSpecializationInfo = vks::initializers::specializationInfo(1, &vertexSpecializationEntry, sizeof(VkBool32), &compactVertex);
+    shaderStages[0].pSpecializationInfo = &vertexSpecializationInfo;
     shaderStages[1] = vks::tools::loadShader(getShaderBasePath() + GSPath,
                                              VK_SHADER_STAGE_GEOMETRY_BIT, vulkanDevice->logicalDevice);
 
@@ -110,7 +124,9 @@ void ShadowPass::preparePipeline()
     pipelineCI.pStages = shaderStages.data();
 
     // Vertex input state from glTF model for pipeline rendering models
-    pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent });
+    // Position only stream of the scene meshes
+    pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelinePositionInputState(
+        voko_global::bCompactVertices ? vkglTF::VertexFormat::Compact : vkglTF::VertexFormat::Full);
     
     // Cull front faces
     rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
@@ -167,7 +183,8 @@ void ShadowPass::buildCommandBuffer()
     vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
     // Bind Scene Ds
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voko_global::SceneDescriptorSet, 0 , NULL);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voko_global::SceneDescriptorSet,
+        voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
     
     RenderScene();
     
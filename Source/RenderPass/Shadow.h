@@ -15,7 +15,9 @@ public:
 
                         // Shadow Pass Specials: used for pipeline
                         float inDepthBiasConstant = 1.25f,
-                        float inDepthBiasSlope = 1.75f);
+                        float inDepthBiasSlope = 1.75f,
+                        // casters drawn at their shadow lod when valid
+                        std::shared_ptr<LodSelection> inLodSelection = nullptr);
     virtual void setupFrameBuffer() override;
     virtual void setupDescriptorSet() override;
     virtual void preparePipeline() override;
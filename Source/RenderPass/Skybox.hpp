@@ -111,7 +111,8 @@ public:
 
     	// bind scene ds
     	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-								&voko_global::SceneDescriptorSet, 0, nullptr);
+								&voko_global::SceneDescriptorSet,
+								voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
 
     	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
 
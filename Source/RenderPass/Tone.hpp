@@ -2,6 +2,7 @@
 
 #include "RenderPass.h"
 #include "voko_globals.h"
+#include "DescriptorAllocator.h"
 #include "VulkanFrameBuffer.hpp"
 
 
@@ -57,8 +58,7 @@ public:
     		// Binding 0: Position texture
     		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0)
     	};
-    	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-    	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vulkanDevice->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+    	descriptorSetLayout = voko_global::descriptorAllocator->getLayout(setLayoutBindings);
 
     	// ds layouts: 0 for scene, 1 for scene color samplers
     	std::array<VkDescriptorSetLayout ,2> toneDsLayouts = {voko_global::SceneDescriptorSetLayout, descriptorSetLayout};
@@ -72,23 +72,8 @@ public:
 
 
 
-    	// create pool for ds allocation
-    	std::vector<VkDescriptorPoolSize> poolSizes =
-			{
-    		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
-			};
-
-    	VkDescriptorPoolCreateInfo descriptorPoolInfo =
-			vks::initializers::descriptorPoolCreateInfo(
-				static_cast<uint32_t>(poolSizes.size()),
-				poolSizes.data(),
-				1);
-
-    	VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
-
-    	// allocate ds from pool
-    	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-    	VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &descriptorSet));
+    	// allocate ds from the shared allocator
+    	descriptorSet = voko_global::descriptorAllocator->allocate(descriptorSetLayout);
 
 
     	// create sampler for scene color sampling
@@ -104,7 +89,7 @@ public:
     	samplerInfo.minLod = 0.0f;
     	samplerInfo.maxLod = 1.0f;
     	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    	VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sceneColorSampler));
+    	sceneColorSampler = vulkanDevice->getSampler(samplerInfo);
 
     	// Image descriptors for color attachments
     	VkDescriptorImageInfo sceneColorTexDesc =
@@ -113,13 +98,8 @@ public:
 				voko_global::sceneColor.view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-    	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-    	writeDescriptorSets = {
-    		// Binding 0: Scene Color after toning
-    		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sceneColorTexDesc),
-		};
-
-    	vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+    	// Binding 0: Scene Color after toning
+    	voko_global::descriptorAllocator->update(descriptorSet, descriptorSetLayout, { sceneColorTexDesc });
 
     }
     virtual void preparePipeline() override
@@ -200,7 +180,8 @@ public:
 
     	// bind scene ds
     	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-								&voko_global::SceneDescriptorSet, 0, nullptr);
+								&voko_global::SceneDescriptorSet,
+								voko_global::SCENE_UNIFORM_BLOCK_COUNT, voko_global::SceneDynamicOffsets[voko_global::frameSlot].data());
 		// bind tone pass ds
     	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1,
 								&descriptorSet, 0, nullptr);
@@ -272,5 +253,7 @@ public:
 
     	VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
     }
-    virtual ~TonePass() override {};
+    virtual ~TonePass() override {
+    	voko_global::descriptorAllocator->release(descriptorSetLayout, descriptorSet);
+    };
 };
\ No newline at end of file
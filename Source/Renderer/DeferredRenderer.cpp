@@ -3,8 +3,14 @@
 
 #include "voko_globals.h"
 #include "RenderPass/FullScreen.hpp"
+#include "RenderPass/CpuOcclusion.h"
+#include "RenderPass/DepthPrepass.h"
 #include "RenderPass/Geometry.h"
+#include "RenderPass/HiZ.h"
+#include "RenderPass/InstanceCulling.h"
 #include "RenderPass/Lighting.h"
+#include "RenderPass/LodSelection.h"
+#include "RenderPass/MeshletCulling.h"
 #include "RenderPass/Shadow.h"
 #include "RenderPass/Skybox.hpp"
 #include "RenderPass/Tone.hpp"
@@ -57,14 +63,21 @@ DeferredRenderer::DeferredRenderer(
 #else
         (2048, 2048);
 #endif
-    
+
+    // screen size lod selection, shared by every pass drawing the scene meshes
+    if (voko_global::bMeshLods)
+    {
+        lod_selection = std::make_shared<LodSelection>(vulkanDevice);
+    }
+
     shadow_pass = std::make_shared<ShadowPass>(
         "ShadowPass",
         vulkanDevice,
         ShadowResolution.first, ShadowResolution.second,
         ERenderPassType::Mesh,
         EPassAttachmentType::OffScreen,
-        1.25f, 1.75f);
+        1.25f, 1.75f,
+        lod_selection);
     // RenderPasses.push_back(shadow_pass);
 
     // geometry pass
@@ -74,12 +87,49 @@ DeferredRenderer::DeferredRenderer(
 #else
     (voko_global::width, voko_global::height);
 #endif
+    // occlusion culling of geometry pass meshes
+    // shadow pass keeps drawing everything: casters hidden from the camera still cast
+    switch (voko_global::occlusionCulling)
+    {
+        case voko_global::EOcclusionCulling::GPU:
+            // pyramid of the depth the geometry pass renders, not the whole scene depth image
+            occlusion_culling = std::make_shared<HiZCulling>(vulkanDevice, GBufferResolution.first, GBufferResolution.second);
+            break;
+        case voko_global::EOcclusionCulling::CPU:
+            occlusion_culling = std::make_shared<CpuOcclusionCulling>(vulkanDevice);
+            break;
+        default:
+            break;
+    }
+    if (voko_global::bInstanceCulling)
+    {
+        instance_culling = std::make_shared<InstanceCulling>(vulkanDevice);
+    }
+    if (voko_global::bMeshletCulling)
+    {
+        meshlet_culling = std::make_shared<MeshletCulling>(vulkanDevice, gfxQueue);
+    }
+    // depth pre-pass, writes the depth the geometry pass tests EQUAL against
+    if (voko_global::bDepthPrepass)
+    {
+        depth_prepass = std::make_shared<DepthPrepass>(
+            "DepthPrepass",
+            vulkanDevice,
+            GBufferResolution.first, GBufferResolution.second,
+            ERenderPassType::Mesh,
+            EPassAttachmentType::OffScreen,
+            lod_selection);
+    }
     geometry_pass = std::make_shared<GeometryPass>(
         "GeometryPass",
         vulkanDevice,
         GBufferResolution.first, GBufferResolution.second,
         ERenderPassType::Mesh,
-        EPassAttachmentType::OffScreen);
+        EPassAttachmentType::OffScreen,
+        occlusion_culling,
+        instance_culling,
+        lod_selection,
+        meshlet_culling);
     // RenderPasses.push_back(geometry_pass);
     
     // lighting pass
@@ -154,10 +204,30 @@ void DeferredRenderer::Render()
     submitInfo.pCommandBuffers = shadow_pass->getCommandBuffer(voko_global::currentBuffer);
     VK_CHECK_RESULT(vkQueueSubmit(gfxQueue, 1, &submitInfo, VK_NULL_HANDLE));
 
-    // geometry waits for presentComplete
+    // cpu culling results must be written before geometry runs
+    if (occlusion_culling)
+    {
+        occlusion_culling->waitFrame();
+    }
+
+    // depth pre-pass waits for shadow
+    // its depth clear & the geometry pass' depth test run before color output, wait at the fragment tests
+    VkPipelineStageFlags depthTestStageFlags = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    if (depth_prepass)
+    {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitDstStageMask = &depthTestStageFlags;
+        submitInfo.pWaitSemaphores = &shadow_pass->passSemaphore;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &depth_prepass->passSemaphore;
+        submitInfo.pCommandBuffers = depth_prepass->getCommandBuffer(voko_global::currentBuffer);
+        VK_CHECK_RESULT(vkQueueSubmit(gfxQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    }
+
+    // geometry waits for depth pre-pass or shadow
     submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitDstStageMask = &defaultSubmitPipelineStageFlags;
-    submitInfo.pWaitSemaphores = &shadow_pass->passSemaphore;
+    submitInfo.pWaitDstStageMask = depth_prepass ? &depthTestStageFlags : &defaultSubmitPipelineStageFlags;
+    submitInfo.pWaitSemaphores = depth_prepass ? &depth_prepass->passSemaphore : &shadow_pass->passSemaphore;
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &geometry_pass->passSemaphore;
     submitInfo.pCommandBuffers = geometry_pass->getCommandBuffer(voko_global::currentBuffer);
@@ -209,6 +279,28 @@ void DeferredRenderer::Render()
 
 }
 
+void DeferredRenderer::UpdateView(const glm::mat4& view, const glm::mat4& projection)
+{
+    // lods first, culled draw args take the selected index ranges
+    if (lod_selection)
+    {
+        lod_selection->select(view, projection);
+    }
+    if (instance_culling)
+    {
+        instance_culling->beginFrame();
+    }
+    if (meshlet_culling)
+    {
+        meshlet_culling->beginFrame();
+    }
+    // kick cpu culling early, runs while the frame is acquired & shadows are submitted
+    if (occlusion_culling)
+    {
+        occlusion_culling->beginFrame(projection * view);
+    }
+}
+
 void DeferredRenderer::buildBlitPass() {
     // Build blitBuffers for swapChain images
     blitCmdBuffers.resize(voko_global::swapChain->images.size());
@@ -5,7 +5,12 @@ class TonePass;
 class SkyboxPass;
 class LightingPass;
 class GeometryPass;
+class DepthPrepass;
 class ShadowPass;
+class OcclusionCulling;
+class InstanceCulling;
+class LodSelection;
+class MeshletCulling;
 
 class DeferredRenderer : public SceneRenderer
 {
@@ -19,6 +24,8 @@ public:
     
     virtual void Render() override;
 
+    virtual void UpdateView(const glm::mat4& view, const glm::mat4& projection) override;
+
     std::vector< std::shared_ptr<RenderPass> > RenderPasses;
 
     // Capsulated vks device ptr
@@ -36,7 +43,12 @@ public:
     std::vector<VkCommandBuffer> blitCmdBuffers;
 
 private:
+    std::shared_ptr<OcclusionCulling> occlusion_culling;
+    std::shared_ptr<InstanceCulling> instance_culling;
+    std::shared_ptr<LodSelection> lod_selection;
+    std::shared_ptr<MeshletCulling> meshlet_culling;
     std::shared_ptr<ShadowPass> shadow_pass;
+    std::shared_ptr<DepthPrepass> depth_prepass;
     std::shared_ptr<GeometryPass> geometry_pass;
     std::unique_ptr<LightingPass> lighting_pass;
     std::unique_ptr<SkyboxPass> skybox_pass;
@@ -9,4 +9,7 @@ public:
     virtual ~SceneRenderer() = default;
     
     virtual void Render();
+
+    // Called once camera matrices of the frame are known, before Render()
+    virtual void UpdateView(const glm::mat4& view, const glm::mat4& projection) {}
 };
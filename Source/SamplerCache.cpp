@@ -0,0 +1,52 @@
+#include "SamplerCache.h"
+
+#include <cassert>
+
+#include "VulkanTools.h"
+
+namespace
+{
+    bool sameState(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b)
+    {
+        return a.flags == b.flags
+            && a.magFilter == b.magFilter && a.minFilter == b.minFilter && a.mipmapMode == b.mipmapMode
+            && a.addressModeU == b.addressModeU && a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW
+            && a.mipLodBias == b.mipLodBias
+            && a.anisotropyEnable == b.anisotropyEnable && (!a.anisotropyEnable || a.maxAnisotropy == b.maxAnisotropy)
+            && a.compareEnable == b.compareEnable && (!a.compareEnable || a.compareOp == b.compareOp)
+            && a.minLod == b.minLod && a.maxLod == b.maxLod
+            && a.borderColor == b.borderColor
+            && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+    }
+}
+
+vks::SamplerCache::SamplerCache(VkDevice inDevice)
+    : device(inDevice)
+{
+}
+
+vks::SamplerCache::~SamplerCache()
+{
+    for (const Entry& entry : entries)
+    {
+        vkDestroySampler(device, entry.sampler, nullptr);
+    }
+}
+
+VkSampler vks::SamplerCache::get(const VkSamplerCreateInfo& createInfo)
+{
+    assert(createInfo.pNext == nullptr);
+    std::lock_guard<std::mutex> lock(mutex);
+    // Few distinct states, a linear search beats hashing them
+    for (const Entry& entry : entries)
+    {
+        if (sameState(entry.createInfo, createInfo))
+        {
+            return entry.sampler;
+        }
+    }
+    Entry entry{ createInfo, VK_NULL_HANDLE };
+    VK_CHECK_RESULT(vkCreateSampler(device, &createInfo, nullptr, &entry.sampler));
+    entries.push_back(entry);
+    return entry.sampler;
+}
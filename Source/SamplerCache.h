@@ -0,0 +1,38 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+    /**
+     * Samplers deduplicated by their create info, a handful of states serve every texture, attachment & pass
+     * Samplers live as long as the cache (the device), callers never destroy them
+     * Thread safe, textures are created on the loading jobs too
+     */
+    class SamplerCache
+    {
+    public:
+        SamplerCache() = delete;
+        explicit SamplerCache(VkDevice inDevice);
+        SamplerCache(const SamplerCache&) = delete;
+        SamplerCache& operator=(const SamplerCache&) = delete;
+        ~SamplerCache();
+
+        // No chained structs, flags & every state but sType/pNext make the key
+        VkSampler get(const VkSamplerCreateInfo& createInfo);
+
+    private:
+        struct Entry
+        {
+            VkSamplerCreateInfo createInfo;
+            VkSampler sampler;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        std::mutex mutex;
+        std::vector<Entry> entries;
+    };
+}
@@ -1,5 +1,12 @@
 #include "Mesh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
 #include "voko_buffers.h"
+#include "SpatialStructure/Frustum.h"
 
 Mesh::Mesh(const std::string& name) : Component{name}
 {}
@@ -24,15 +31,123 @@ void Mesh::draw_mesh()
     
 }
 
+void Mesh::set_instance(uint32_t index, const voko_buffer::PerInstanceSSBO& instance)
+{
+    if (index >= Instances.size())
+    {
+        std::cerr << "Mesh " << get_name() << ": instance " << index << " out of range, instance count is fixed after upload\n";
+        return;
+    }
+    Instances[index] = instance;
+    dirtyBegin = std::min(dirtyBegin, index);
+    dirtyEnd = std::max(dirtyEnd, index + 1);
+}
+
+void Mesh::flush_instances()
+{
+    if (dirtyBegin >= dirtyEnd || mappedInstances == nullptr)
+    {
+        return;
+    }
+    memcpy(mappedInstances + dirtyBegin,
+        Instances.data() + dirtyBegin,
+        sizeof(voko_buffer::PerInstanceSSBO) * (dirtyEnd - dirtyBegin));
+    dirtyBegin = UINT32_MAX;
+    dirtyEnd = 0;
+}
+
+void Mesh::get_instance_bounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    const auto& dimensions = VkGltfModel.dimensions;
+    if (Instances.empty())
+    {
+        boundsMin = dimensions.min;
+        boundsMax = dimensions.max;
+        return;
+    }
+
+    boundsMin = glm::vec3(FLT_MAX);
+    boundsMax = glm::vec3(-FLT_MAX);
+    const glm::vec3 center = (dimensions.min + dimensions.max) * 0.5f;
+    const glm::vec3 extent = (dimensions.max - dimensions.min) * 0.5f;
+    for (const auto& instance : Instances)
+    {
+        // Transformed box extent: |M| * extent
+        const glm::mat4 transform = instance.get_transform();
+        const glm::mat3 rotScale = glm::mat3(transform);
+        const glm::vec3 instanceCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+        const glm::vec3 instanceExtent =
+            glm::abs(rotScale[0]) * extent.x + glm::abs(rotScale[1]) * extent.y + glm::abs(rotScale[2]) * extent.z;
+        boundsMin = glm::min(boundsMin, instanceCenter - instanceExtent);
+        boundsMax = glm::max(boundsMax, instanceCenter + instanceExtent);
+    }
+}
+
+float Mesh::get_pixels_per_unit(const glm::mat4& view, float pixelScale, voko::Frustum* frustum)
+{
+    const auto& dimensions = VkGltfModel.dimensions;
+    const glm::mat4 modelMatrix = get_node()->get_transform().get_matrix();
+
+    float pixelsPerUnit = 0.0f;
+    auto measure = [&](const glm::mat4& transform)
+    {
+        const float scale = std::max({
+            glm::length(glm::vec3(transform[0])),
+            glm::length(glm::vec3(transform[1])),
+            glm::length(glm::vec3(transform[2]))});
+        if (frustum && !frustum->check_sphere(glm::vec3(transform * glm::vec4(dimensions.center, 1.0f)), dimensions.radius * scale))
+        {
+            return;
+        }
+        const glm::vec3 viewCenter = glm::vec3(view * transform * glm::vec4(dimensions.center, 1.0f));
+        const float distance = glm::length(viewCenter) - dimensions.radius * scale;
+        // Camera inside the sphere: full detail
+        pixelsPerUnit = distance > 0.0f ? std::max(pixelsPerUnit, pixelScale * scale / distance) : FLT_MAX;
+    };
+    if (Instances.empty())
+    {
+        measure(modelMatrix);
+    }
+    for (const auto& instance : Instances)
+    {
+        measure(modelMatrix * instance.get_transform());
+    }
+    return pixelsPerUnit;
+}
+
+uint32_t Mesh::get_first_index() const
+{
+    return VkGltfModel.indices.first + VkGltfModel.lods[lod].firstIndex;
+}
+
+uint32_t Mesh::get_index_count() const
+{
+    return VkGltfModel.lods[lod].indexCount;
+}
+
 void Mesh::draw_mesh(VkCommandBuffer cmdBuffer)
 {
-    size_t instanceCount = Instances.size();
-    if(instanceCount > 0)
+    // Arena geometry is bound once per pass
+    if (!VkGltfModel.arena)
     {
         VkGltfModel.bindBuffers(cmdBuffer);
-        vkCmdDrawIndexed(cmdBuffer, VkGltfModel.indices.count, 3, 0, 0, 0);
-    }else
+    }
+    vkCmdDrawIndexed(cmdBuffer, VkGltfModel.indices.count, std::max(1u, get_instance_count()),
+        VkGltfModel.indices.first, static_cast<int32_t>(VkGltfModel.vertices.first), instanceOffset);
+}
+
+void Mesh::draw_mesh_positions(VkCommandBuffer cmdBuffer)
+{
+    const auto& positionStream = VkGltfModel.positionStream;
+    vkCmdDrawIndexed(cmdBuffer, VkGltfModel.indices.count, std::max(1u, get_instance_count()),
+        positionStream.firstIndex, static_cast<int32_t>(positionStream.first), instanceOffset);
+}
+
+void Mesh::draw_mesh_indirect(VkCommandBuffer cmdBuffer, VkBuffer indirectBuffer, VkDeviceSize offset)
+{
+    if (!VkGltfModel.arena)
     {
-        VkGltfModel.draw(cmdBuffer);
+        VkGltfModel.bindBuffers(cmdBuffer);
     }
+    vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand));
 }
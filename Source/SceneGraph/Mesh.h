@@ -10,6 +10,7 @@
 #include "VulkanglTFModel.h"
 #include "VulkanTexture.h"
 
+namespace voko { class Frustum; }
 
 class Mesh : public Component
 {
@@ -30,9 +31,8 @@ public:
     {
         vks::Texture2D albedoMap;
         vks::Texture2D normalMap;
-        vks::Texture2D aoMap;
-        vks::Texture2D metallicMap;
-        vks::Texture2D roughnessMap;
+        // Occlusion, roughness & metallic in one texture (voko::loadORMTexture)
+        vks::Texture2D ormMap;
 
         vks::Texture2D& GetTexture(voko_global::EMeshSamplerFlags flag)
         {
@@ -42,12 +42,8 @@ public:
                     return albedoMap;
                 case voko_global::EMeshSamplerFlags::NORMAL:
                     return normalMap;
-                case voko_global::EMeshSamplerFlags::METALLIC:
-                    return metallicMap;
-                case voko_global::EMeshSamplerFlags::ROUGHNESS:
-                    return roughnessMap;
-                case voko_global::EMeshSamplerFlags::AO:
-                    return aoMap;
+                case voko_global::EMeshSamplerFlags::ORM:
+                    return ormMap;
                 default:
                     throw std::invalid_argument("Invalid EMeshSamplerFlags value.");
             }
@@ -56,17 +52,51 @@ public:
 
 
 
+    // Material source, packed into the global material ssbo on upload
     voko_buffer::MeshProperty meshProperty;
-    vks::Buffer meshPropSSBO;
+    // Into the global material ssbo, shared by meshes with the same material
+    uint32_t materialIndex = 0;
 
+    // Every mesh is drawn instanced, meshes without explicit instances get one identity instance on upload
     std::vector<voko_buffer::PerInstanceSSBO> Instances;
-    vks::Buffer instanceSSBO;
+    // Range of Instances in the global instance ssbo (host visible, kept mapped)
+    uint32_t instanceOffset = 0;
+    voko_buffer::PerInstanceSSBO* mappedInstances = nullptr;
+
+    // Rasterized by cpu occlusion culling, model needs FileLoadingFlags::KeepCpuGeometry
+    bool bOccluder = false;
+
+    // Levels of VkGltfModel.lods picked per frame by LodSelection, 0 without it
+    uint32_t lod = 0;
+    uint32_t shadowLod = 0;
+    // Index range of the camera lod in the full vertex stream, for draw args built outside of LodSelection (culling)
+    uint32_t get_first_index() const;
+    uint32_t get_index_count() const;
     
+    uint32_t get_instance_count() const { return static_cast<uint32_t>(Instances.size()); }
+    // Edit an uploaded instance, only the dirty range is copied on flush_instances
+    void set_instance(uint32_t index, const voko_buffer::PerInstanceSSBO& instance);
+    // Copy dirty instances to the instance ssbo, gpu must not be reading it (frames are waited for in submitFrame)
+    void flush_instances();
+    // Mesh local bounds over all instance transforms
+    void get_instance_bounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+    // Projected pixels per model unit of the nearest instance's bounding sphere, FLT_MAX with the camera inside one
+    // pixelScale: pixels per view space unit at distance 1, frustum: instances outside it are skipped (0 when all are)
+    float get_pixels_per_unit(const glm::mat4& view, float pixelScale, voko::Frustum* frustum = nullptr);
+
     void draw_mesh();
     void draw_mesh(VkCommandBuffer cmdBuffer);
+    // Depth only draw from the arena position stream, bound by the pass (vks::GeometryArena::bindPositionBuffers)
+    void draw_mesh_positions(VkCommandBuffer cmdBuffer);
+    // Draw args (incl. instance count) come from a gpu written indirect command
+    void draw_mesh_indirect(VkCommandBuffer cmdBuffer, VkBuffer indirectBuffer, VkDeviceSize offset);
     
     
     
 private:
     Node* node;
+
+    // [dirtyBegin, dirtyEnd) of Instances not yet in the instance ssbo
+    uint32_t dirtyBegin = UINT32_MAX;
+    uint32_t dirtyEnd = 0;
 };
@@ -0,0 +1,395 @@
+//
+// Software occlusion culling: low resolution depth buffer rasterized on the cpu
+//
+
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+#include "JobSystem.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace voko {
+
+    namespace {
+        // Clip space w below this is treated as crossing the near plane
+        constexpr float W_EPSILON = 1e-5f;
+
+        float elapsedMs(std::chrono::high_resolution_clock::time_point start)
+        {
+            return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+
+    OcclusionBuffer::OcclusionBuffer(uint32_t inWidth, uint32_t inHeight, uint32_t inThreadCount, vks::JobSystem* inJobSystem)
+        : jobSystem(inJobSystem)
+    {
+        tilesX = std::max(1u, (inWidth + TILE_WIDTH - 1) / TILE_WIDTH);
+        tilesY = std::max(1u, (inHeight + TILE_HEIGHT - 1) / TILE_HEIGHT);
+        width = tilesX * TILE_WIDTH;
+        height = tilesY * TILE_HEIGHT;
+
+        threadCount = inThreadCount ? inThreadCount : std::max(1u, std::thread::hardware_concurrency());
+        // Bands are whole tile rows
+        threadCount = std::min(threadCount, tilesY);
+
+        depth.resize(static_cast<size_t>(width) * height);
+        tileMaxDepth.resize(static_cast<size_t>(tilesX) * tilesY);
+        clear();
+    }
+
+    const char* OcclusionBuffer::get_simd_name()
+    {
+#if defined(__AVX2__)
+        return "AVX2";
+#else
+        return "Scalar";
+#endif
+    }
+
+    void OcclusionBuffer::clear()
+    {
+        std::fill(depth.begin(), depth.end(), 1.0f);
+        std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+        triangles.clear();
+        stats = Stats();
+    }
+
+    void OcclusionBuffer::addOccluder(const glm::mat4& modelViewProj,
+                                      const std::vector<glm::vec3>& positions,
+                                      const std::vector<uint32_t>& indices)
+    {
+        std::vector<glm::vec4> clipPositions(positions.size());
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            clipPositions[i] = modelViewProj * glm::vec4(positions[i], 1.0f);
+        }
+
+        triangles.reserve(triangles.size() + indices.size() / 3);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const std::array<glm::vec4, 3> clip = {
+                clipPositions[indices[i]], clipPositions[indices[i + 1]], clipPositions[indices[i + 2]] };
+
+            // Occluders are optional: dropping a triangle only loses occlusion, never hides anything
+            // so triangles crossing the near plane are skipped instead of clipped
+            bool nearClipped = false;
+            for (const auto& c : clip)
+            {
+                nearClipped |= (c.w < W_EPSILON) || (c.z < 0.0f);
+            }
+            if (nearClipped)
+            {
+                continue;
+            }
+
+            ScreenTriangle tri;
+            for (int v = 0; v < 3; v++)
+            {
+                const glm::vec3 ndc = glm::vec3(clip[v]) / clip[v].w;
+                tri.v[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, std::min(ndc.z, 1.0f));
+            }
+
+            // Rasterize both windings, keep counter clockwise
+            const float area = (tri.v[1].x - tri.v[0].x) * (tri.v[2].y - tri.v[0].y) - (tri.v[2].x - tri.v[0].x) * (tri.v[1].y - tri.v[0].y);
+            if (std::abs(area) < 1e-6f)
+            {
+                continue;
+            }
+            if (area < 0.0f)
+            {
+                std::swap(tri.v[1], tri.v[2]);
+            }
+
+            const float minX = std::min({ tri.v[0].x, tri.v[1].x, tri.v[2].x });
+            const float maxX = std::max({ tri.v[0].x, tri.v[1].x, tri.v[2].x });
+            const float minY = std::min({ tri.v[0].y, tri.v[1].y, tri.v[2].y });
+            const float maxY = std::max({ tri.v[0].y, tri.v[1].y, tri.v[2].y });
+            tri.minX = std::max(0, static_cast<int32_t>(std::floor(minX)));
+            tri.maxX = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil(maxX)));
+            tri.minY = std::max(0, static_cast<int32_t>(std::floor(minY)));
+            tri.maxY = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil(maxY)));
+            if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            {
+                continue;
+            }
+
+            triangles.push_back(tri);
+        }
+        stats.occluderTriangles = static_cast<uint32_t>(triangles.size());
+    }
+
+    void OcclusionBuffer::rasterize()
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        // Each band owns whole tile rows: no two threads touch the same pixels
+        const uint32_t tileRowsPerBand = (tilesY + threadCount - 1) / threadCount;
+        std::vector<std::function<void()>> bands;
+        for (uint32_t tileRow = 0; tileRow < tilesY; tileRow += tileRowsPerBand)
+        {
+            const uint32_t rowBegin = tileRow * TILE_HEIGHT;
+            const uint32_t rowEnd = std::min(tilesY, tileRow + tileRowsPerBand) * TILE_HEIGHT;
+            bands.push_back([this, rowBegin, rowEnd]() {
+                rasterizeBand(rowBegin, rowEnd);
+            });
+        }
+        runTasks(bands);
+
+        stats.rasterizeMs = elapsedMs(start);
+    }
+
+    void OcclusionBuffer::runTasks(const std::vector<std::function<void()>>& tasks) const
+    {
+        if (jobSystem)
+        {
+            // Frame lane: ahead of queued asset jobs. The calling thread runs its own queued tasks only, which also keeps this safe to call from a job
+            std::vector<vks::JobSystem::Handle> jobs;
+            jobs.reserve(tasks.size());
+            for (const auto& task : tasks)
+            {
+                jobs.push_back(jobSystem->submit(task, {}, vks::JobSystem::Priority::Frame));
+            }
+            jobSystem->wait(jobs);
+            return;
+        }
+
+        std::vector<std::future<void>> futures;
+        futures.reserve(tasks.size());
+        for (const auto& task : tasks)
+        {
+            futures.push_back(std::async(std::launch::async, task));
+        }
+        for (auto& future : futures)
+        {
+            future.get();
+        }
+    }
+
+    void OcclusionBuffer::rasterizeBand(uint32_t rowBegin, uint32_t rowEnd)
+    {
+        for (const auto& tri : triangles)
+        {
+            const int32_t begin = std::max(tri.minY, static_cast<int32_t>(rowBegin));
+            const int32_t end = std::min(tri.maxY, static_cast<int32_t>(rowEnd) - 1);
+            if (begin <= end)
+            {
+                rasterizeTriangle(tri, begin, end);
+            }
+        }
+        buildTileMax(rowBegin, rowEnd);
+    }
+
+    void OcclusionBuffer::rasterizeTriangle(const ScreenTriangle& tri, int32_t rowBegin, int32_t rowEnd)
+    {
+        const glm::vec3& v0 = tri.v[0];
+        const glm::vec3& v1 = tri.v[1];
+        const glm::vec3& v2 = tri.v[2];
+
+        // Edge functions E(x, y) = A * x + B * y + C, positive inside
+        // Edge i is opposite to vertex i
+        const std::array<float, 3> A = { v1.y - v2.y, v2.y - v0.y, v0.y - v1.y };
+        const std::array<float, 3> B = { v2.x - v1.x, v0.x - v2.x, v1.x - v0.x };
+        std::array<float, 3> C = {
+            v1.x * v2.y - v2.x * v1.y,
+            v2.x * v0.y - v0.x * v2.y,
+            v0.x * v1.y - v1.x * v0.y };
+
+        // Depth plane from barycentrics
+        const float invArea = 1.0f / (C[0] + C[1] + C[2]);
+        const float zA = (A[0] * v0.z + A[1] * v1.z + A[2] * v2.z) * invArea;
+        const float zB = (B[0] * v0.z + B[1] * v1.z + B[2] * v2.z) * invArea;
+        // Farthest depth of the pixel square instead of its center's
+        const float zC = (C[0] * v0.z + C[1] * v1.z + C[2] * v2.z) * invArea + 0.5f * (std::abs(zA) + std::abs(zB));
+
+        // Conservative coverage: edges pulled in by half a pixel, so a center inside means the whole pixel is
+        // Partly covered pixels keep their depth, a box seen through their uncovered part isn't culled
+        for (int e = 0; e < 3; e++)
+        {
+            C[e] -= 0.5f * (std::abs(A[e]) + std::abs(B[e]));
+        }
+
+        // 8 wide spans, width is a multiple of 8
+        const int32_t spanBegin = tri.minX & ~7;
+
+#if defined(__AVX2__)
+        const __m256 laneX = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 a0 = _mm256_set1_ps(A[0]);
+        const __m256 a1 = _mm256_set1_ps(A[1]);
+        const __m256 a2 = _mm256_set1_ps(A[2]);
+        const __m256 za = _mm256_set1_ps(zA);
+#endif
+
+        for (int32_t y = rowBegin; y <= rowEnd; y++)
+        {
+            const float py = static_cast<float>(y) + 0.5f;
+            float* row = depth.data() + static_cast<size_t>(y) * width;
+
+#if defined(__AVX2__)
+            const __m256 rowE0 = _mm256_set1_ps(B[0] * py + C[0]);
+            const __m256 rowE1 = _mm256_set1_ps(B[1] * py + C[1]);
+            const __m256 rowE2 = _mm256_set1_ps(B[2] * py + C[2]);
+            const __m256 rowZ = _mm256_set1_ps(zB * py + zC);
+
+            for (int32_t x = spanBegin; x <= tri.maxX; x += 8)
+            {
+                const __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneX);
+                const __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), rowE0);
+                const __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), rowE1);
+                const __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), rowE2);
+                const __m256 inside = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                    _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+                if (_mm256_testz_ps(inside, inside))
+                {
+                    continue;
+                }
+
+                const __m256 z = _mm256_add_ps(_mm256_mul_ps(za, px), rowZ);
+                const __m256 current = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+            }
+#else
+            for (int32_t x = spanBegin; x <= tri.maxX; x++)
+            {
+                const float px = static_cast<float>(x) + 0.5f;
+                const float e0 = A[0] * px + B[0] * py + C[0];
+                const float e1 = A[1] * px + B[1] * py + C[1];
+                const float e2 = A[2] * px + B[2] * py + C[2];
+                if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+                {
+                    const float z = zA * px + zB * py + zC;
+                    row[x] = std::min(row[x], z);
+                }
+            }
+#endif
+        }
+    }
+
+    void OcclusionBuffer::buildTileMax(uint32_t rowBegin, uint32_t rowEnd)
+    {
+        for (uint32_t tileY = rowBegin / TILE_HEIGHT; tileY < rowEnd / TILE_HEIGHT; tileY++)
+        {
+            for (uint32_t tileX = 0; tileX < tilesX; tileX++)
+            {
+                float maxDepth = 0.0f;
+                for (uint32_t y = tileY * TILE_HEIGHT; y < (tileY + 1) * TILE_HEIGHT; y++)
+                {
+                    const float* row = depth.data() + static_cast<size_t>(y) * width + tileX * TILE_WIDTH;
+#if defined(__AVX2__)
+                    // TILE_WIDTH == 8: one register per tile row
+                    __m256 rowMax = _mm256_loadu_ps(row);
+                    __m128 m = _mm_max_ps(_mm256_castps256_ps128(rowMax), _mm256_extractf128_ps(rowMax, 1));
+                    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+                    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+                    maxDepth = std::max(maxDepth, _mm_cvtss_f32(m));
+#else
+                    maxDepth = std::max(maxDepth, *std::max_element(row, row + TILE_WIDTH));
+#endif
+                }
+                tileMaxDepth[tileY * tilesX + tileX] = maxDepth;
+            }
+        }
+    }
+
+    bool OcclusionBuffer::isVisible(const glm::mat4& viewProj, const AABB& box) const
+    {
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+        float minZ = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            const glm::vec3 p = glm::vec3(
+                (corner & 1) ? box.max.x : box.min.x,
+                (corner & 2) ? box.max.y : box.min.y,
+                (corner & 4) ? box.max.z : box.min.z);
+            const glm::vec4 clip = viewProj * glm::vec4(p, 1.0f);
+            // Box crosses the near plane, can't be tested
+            if (clip.w < W_EPSILON || clip.z < 0.0f)
+            {
+                return true;
+            }
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            minX = std::min(minX, ndc.x);
+            maxX = std::max(maxX, ndc.x);
+            minY = std::min(minY, ndc.y);
+            maxY = std::max(maxY, ndc.y);
+            minZ = std::min(minZ, ndc.z);
+        }
+
+        // Off screen or beyond far plane
+        if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || minZ > 1.0f)
+        {
+            return false;
+        }
+
+        const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor((minX * 0.5f + 0.5f) * width)));
+        const int32_t x1 = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil((maxX * 0.5f + 0.5f) * width)));
+        const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor((minY * 0.5f + 0.5f) * height)));
+        const int32_t y1 = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil((maxY * 0.5f + 0.5f) * height)));
+
+        for (int32_t tileY = y0 / TILE_HEIGHT; tileY <= y1 / static_cast<int32_t>(TILE_HEIGHT); tileY++)
+        {
+            for (int32_t tileX = x0 / TILE_WIDTH; tileX <= x1 / static_cast<int32_t>(TILE_WIDTH); tileX++)
+            {
+                // Coarse: whole tile is in front of the box
+                if (minZ > tileMaxDepth[tileY * tilesX + tileX])
+                {
+                    continue;
+                }
+
+                // Fine: any covered pixel farther than the box
+                const int32_t px0 = std::max(x0, tileX * static_cast<int32_t>(TILE_WIDTH));
+                const int32_t px1 = std::min(x1, (tileX + 1) * static_cast<int32_t>(TILE_WIDTH) - 1);
+                const int32_t py0 = std::max(y0, tileY * static_cast<int32_t>(TILE_HEIGHT));
+                const int32_t py1 = std::min(y1, (tileY + 1) * static_cast<int32_t>(TILE_HEIGHT) - 1);
+                for (int32_t y = py0; y <= py1; y++)
+                {
+                    const float* row = depth.data() + static_cast<size_t>(y) * width;
+                    for (int32_t x = px0; x <= px1; x++)
+                    {
+                        if (minZ <= row[x])
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void OcclusionBuffer::testVisibility(const glm::mat4& viewProj, const std::vector<AABB>& boxes, std::vector<uint8_t>& visible) const
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        visible.resize(boxes.size());
+        const size_t chunkSize = std::max<size_t>(64, (boxes.size() + threadCount - 1) / threadCount);
+        std::vector<std::function<void()>> chunks;
+        for (size_t begin = 0; begin < boxes.size(); begin += chunkSize)
+        {
+            const size_t end = std::min(boxes.size(), begin + chunkSize);
+            chunks.push_back([this, &viewProj, &boxes, &visible, begin, end]() {
+                for (size_t i = begin; i < end; i++)
+                {
+                    visible[i] = isVisible(viewProj, boxes[i]) ? 1 : 0;
+                }
+            });
+        }
+        runTasks(chunks);
+
+        stats.testedBoxes = static_cast<uint32_t>(boxes.size());
+        stats.occludedBoxes = static_cast<uint32_t>(std::count(visible.begin(), visible.end(), 0));
+        stats.testMs = elapsedMs(start);
+    }
+
+}
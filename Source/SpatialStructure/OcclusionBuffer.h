@@ -0,0 +1,101 @@
+//
+// Software occlusion culling: low resolution depth buffer rasterized on the cpu
+// Independent of vulkan, can be driven & measured without a gpu
+//
+
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace vks {
+    class JobSystem;
+}
+
+namespace voko {
+
+    struct AABB
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    class OcclusionBuffer {
+    public:
+        // Depth hierarchy: one max depth per tile
+        static constexpr uint32_t TILE_WIDTH = 8;
+        static constexpr uint32_t TILE_HEIGHT = 8;
+
+        // Sizes are rounded up to whole tiles, threadCount 0: hardware concurrency
+        // Bands & test chunks run as jobs of jobSystem when given, else on threads of their own
+        OcclusionBuffer(uint32_t inWidth = 320, uint32_t inHeight = 192, uint32_t inThreadCount = 0, vks::JobSystem* inJobSystem = nullptr);
+
+        // Reset depth to far plane & drop queued occluders
+        void clear();
+
+        // Queue occluder triangles, positions are transformed by modelViewProj (depth range [0, 1])
+        void addOccluder(const glm::mat4& modelViewProj,
+                         const std::vector<glm::vec3>& positions,
+                         const std::vector<uint32_t>& indices);
+
+        // Rasterize queued occluders in parallel screen bands & build tile max depths
+        // Occluders only write pixels they fully cover, with the farthest depth inside the pixel
+        // Pixels along edges shared by an occluder's triangles are partly covered by each & stay open (one pixel cracks)
+        void rasterize();
+
+        // Conservative test: false only when the box is off screen or fully behind occluders
+        bool isVisible(const glm::mat4& viewProj, const AABB& box) const;
+        // Parallel batch version of isVisible, visible[i] is 0 or 1
+        void testVisibility(const glm::mat4& viewProj, const std::vector<AABB>& boxes, std::vector<uint8_t>& visible) const;
+
+        uint32_t get_width() const { return width; }
+        uint32_t get_height() const { return height; }
+        const std::vector<float>& get_depth() const { return depth; }
+
+        struct Stats {
+            uint32_t occluderTriangles = 0;
+            uint32_t testedBoxes = 0;
+            uint32_t occludedBoxes = 0;
+            float rasterizeMs = 0.0f;
+            float testMs = 0.0f;
+        };
+        const Stats& get_stats() const { return stats; }
+
+        // Rasterizer path compiled in, for logging / benchmarks
+        static const char* get_simd_name();
+
+    private:
+        // Screen space triangle: xy in pixels, z in [0, 1], counter clockwise
+        struct ScreenTriangle {
+            glm::vec3 v[3];
+            int32_t minX, maxX, minY, maxY;
+        };
+
+        // Runs the tasks in parallel & returns once all have finished
+        void runTasks(const std::vector<std::function<void()>>& tasks) const;
+
+        void rasterizeBand(uint32_t rowBegin, uint32_t rowEnd);
+        void rasterizeTriangle(const ScreenTriangle& tri, int32_t rowBegin, int32_t rowEnd);
+        void buildTileMax(uint32_t rowBegin, uint32_t rowEnd);
+
+        uint32_t width;
+        uint32_t height;
+        uint32_t tilesX;
+        uint32_t tilesY;
+        uint32_t threadCount;
+        vks::JobSystem* jobSystem;
+
+        std::vector<float> depth;
+        std::vector<float> tileMaxDepth;
+        std::vector<ScreenTriangle> triangles;
+
+        mutable Stats stats;
+    };
+
+}
+
+#endif //OCCLUSIONBUFFER_H
@@ -0,0 +1,377 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "VulkanDevice.h"
+
+namespace
+{
+    // gl_format.h isn't part of the public ktx headers
+    constexpr ktx_uint32_t GL_COMPRESSED_RED_RGTC1 = 0x8DBB;
+    constexpr ktx_uint32_t GL_COMPRESSED_RG_RGTC2 = 0x8DBD;
+    constexpr ktx_uint32_t GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+
+    // BC7 4 bit index interpolation weights (/64)
+    constexpr int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // LSB first bit packing of a block
+    struct BitWriter
+    {
+        uint8_t* data;
+        uint32_t position = 0;
+
+        void write(uint32_t value, uint32_t bits)
+        {
+            for (uint32_t i = 0; i < bits; i++, position++)
+            {
+                data[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1u) << (position & 7));
+            }
+        }
+    };
+
+    // Mode 6 endpoint: 7 bits per channel & a shared p bit
+    struct Bc7Endpoint
+    {
+        int value[4];
+        int pbit;
+
+        int expanded(int channel) const { return (value[channel] << 1) | pbit; }
+    };
+
+    Bc7Endpoint quantizeBc7Endpoint(const float color[4])
+    {
+        Bc7Endpoint best{};
+        float bestError = INFINITY;
+        for (int pbit = 0; pbit < 2; pbit++)
+        {
+            Bc7Endpoint endpoint{};
+            endpoint.pbit = pbit;
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                endpoint.value[c] = std::clamp(static_cast<int>(std::lround((color[c] - pbit) * 0.5f)), 0, 127);
+                const float delta = color[c] - static_cast<float>(endpoint.expanded(c));
+                error += delta * delta;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                best = endpoint;
+            }
+        }
+        return best;
+    }
+
+    // Nearest palette entry per texel, returns the summed squared error
+    int indexBc7(const uint8_t* texels, const Bc7Endpoint& e0, const Bc7Endpoint& e1, uint8_t indices[16])
+    {
+        int palette[16][4];
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * e0.expanded(c) + BC7_WEIGHTS4[i] * e1.expanded(c) + 32) >> 6;
+            }
+        }
+        int totalError = 0;
+        for (int t = 0; t < 16; t++)
+        {
+            int bestError = INT32_MAX;
+            for (int i = 0; i < 16; i++)
+            {
+                int error = 0;
+                for (int c = 0; c < 4; c++)
+                {
+                    const int delta = palette[i][c] - texels[t * 4 + c];
+                    error += delta * delta;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    indices[t] = static_cast<uint8_t>(i);
+                }
+            }
+            totalError += bestError;
+        }
+        return totalError;
+    }
+
+    // Least squares endpoints for fixed indices, false when the indices don't span a line
+    bool refitBc7(const uint8_t* texels, const uint8_t indices[16], float e0[4], float e1[4])
+    {
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+        float rhs0[4] = {}, rhs1[4] = {};
+        for (int t = 0; t < 16; t++)
+        {
+            const float w = BC7_WEIGHTS4[indices[t]] / 64.0f;
+            a += (1.0f - w) * (1.0f - w);
+            b += (1.0f - w) * w;
+            c += w * w;
+            for (int ch = 0; ch < 4; ch++)
+            {
+                rhs0[ch] += (1.0f - w) * texels[t * 4 + ch];
+                rhs1[ch] += w * texels[t * 4 + ch];
+            }
+        }
+        const float det = a * c - b * b;
+        if (std::abs(det) < 1e-6f)
+        {
+            return false;
+        }
+        for (int ch = 0; ch < 4; ch++)
+        {
+            e0[ch] = std::clamp((c * rhs0[ch] - b * rhs1[ch]) / det, 0.0f, 255.0f);
+            e1[ch] = std::clamp((a * rhs1[ch] - b * rhs0[ch]) / det, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    uint32_t blockBytes(VkFormat format)
+    {
+        return format == VK_FORMAT_BC4_UNORM_BLOCK ? 8 : 16;
+    }
+}
+
+VkFormat vks::compression::selectFormat(vks::VulkanDevice* device, TextureContent content, VkFormat sourceFormat)
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    switch (content)
+    {
+        case TextureContent::Color:
+            format = sourceFormat == VK_FORMAT_R8G8B8A8_UNORM ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_UNDEFINED;
+            break;
+        case TextureContent::NormalMap:
+            format = sourceFormat == VK_FORMAT_R8G8B8A8_UNORM ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_UNDEFINED;
+            break;
+        case TextureContent::SingleChannel:
+            format = sourceFormat == VK_FORMAT_R8_UNORM || sourceFormat == VK_FORMAT_R8G8B8A8_UNORM ? VK_FORMAT_BC4_UNORM_BLOCK : VK_FORMAT_UNDEFINED;
+            break;
+    }
+    if (format == VK_FORMAT_UNDEFINED || !device->enabledFeatures.textureCompressionBC)
+    {
+        return sourceFormat;
+    }
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+    return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) ? format : sourceFormat;
+}
+
+ktxResult vks::compression::compressTexture(ktxTexture* source, VkFormat sourceFormat, VkFormat format, ktxTexture** target)
+{
+    ktxTextureCreateInfo createInfo{};
+    switch (format)
+    {
+        case VK_FORMAT_BC4_UNORM_BLOCK: createInfo.glInternalformat = GL_COMPRESSED_RED_RGTC1; break;
+        case VK_FORMAT_BC5_UNORM_BLOCK: createInfo.glInternalformat = GL_COMPRESSED_RG_RGTC2; break;
+        case VK_FORMAT_BC7_UNORM_BLOCK: createInfo.glInternalformat = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+        default: return KTX_INVALID_VALUE;
+    }
+    const uint32_t texelBytes = sourceFormat == VK_FORMAT_R8G8B8A8_UNORM ? 4 : 1;
+    if ((sourceFormat != VK_FORMAT_R8G8B8A8_UNORM && sourceFormat != VK_FORMAT_R8_UNORM) || source->isCompressed || source->numFaces != 1 || source->numLayers != 1)
+    {
+        return KTX_INVALID_VALUE;
+    }
+    createInfo.baseWidth = source->baseWidth;
+    createInfo.baseHeight = source->baseHeight;
+    createInfo.baseDepth = 1;
+    createInfo.numDimensions = 2;
+    createInfo.numLevels = source->numLevels;
+    createInfo.numLayers = 1;
+    createInfo.numFaces = 1;
+    createInfo.isArray = KTX_FALSE;
+    createInfo.generateMipmaps = KTX_FALSE;
+    ktxResult result = ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, target);
+    if (result != KTX_SUCCESS)
+    {
+        return result;
+    }
+
+    const uint32_t bytesPerBlock = blockBytes(format);
+    for (uint32_t level = 0; level < source->numLevels; level++)
+    {
+        ktx_size_t sourceOffset, targetOffset;
+        ktxTexture_GetImageOffset(source, level, 0, 0, &sourceOffset);
+        ktxTexture_GetImageOffset(*target, level, 0, 0, &targetOffset);
+        const uint8_t* sourceLevel = ktxTexture_GetData(source) + sourceOffset;
+        uint8_t* targetLevel = ktxTexture_GetData(*target) + targetOffset;
+        // Rows of uncompressed ktx levels are padded to 4 bytes
+        const ktx_uint32_t rowPitch = ktxTexture_GetRowPitch(source, level);
+        const uint32_t width = std::max(1u, source->baseWidth >> level);
+        const uint32_t height = std::max(1u, source->baseHeight >> level);
+
+        uint8_t texels[16 * 4];
+        for (uint32_t blockY = 0; blockY < (height + 3) / 4; blockY++)
+        {
+            for (uint32_t blockX = 0; blockX < (width + 3) / 4; blockX++)
+            {
+                // Gather as rgba, single channel sources fill r
+                for (uint32_t y = 0; y < 4; y++)
+                {
+                    const uint8_t* row = sourceLevel + std::min(blockY * 4 + y, height - 1) * rowPitch;
+                    for (uint32_t x = 0; x < 4; x++)
+                    {
+                        const uint8_t* texel = row + std::min(blockX * 4 + x, width - 1) * texelBytes;
+                        uint8_t* gathered = texels + (y * 4 + x) * 4;
+                        memset(gathered, 0, 4);
+                        memcpy(gathered, texel, texelBytes);
+                    }
+                }
+                uint8_t* block = targetLevel + (blockY * ((width + 3) / 4) + blockX) * bytesPerBlock;
+                switch (format)
+                {
+                    case VK_FORMAT_BC4_UNORM_BLOCK: encodeBC4(texels, 4, block); break;
+                    case VK_FORMAT_BC5_UNORM_BLOCK: encodeBC5(texels, 4, block); break;
+                    default: encodeBC7(texels, block); break;
+                }
+            }
+        }
+    }
+    return KTX_SUCCESS;
+}
+
+void vks::compression::encodeBC4(const uint8_t* texels, uint32_t stride, uint8_t block[8])
+{
+    uint8_t minValue = 255, maxValue = 0;
+    for (uint32_t t = 0; t < 16; t++)
+    {
+        minValue = std::min(minValue, texels[t * stride]);
+        maxValue = std::max(maxValue, texels[t * stride]);
+    }
+    memset(block, 0, 8);
+    // red0 > red1: 8 value ramp, index 0 is red0, 1 is red1, 2..7 interpolate from red0 towards red1
+    block[0] = maxValue;
+    block[1] = minValue;
+    if (maxValue == minValue)
+    {
+        return;
+    }
+    const float scale = 7.0f / static_cast<float>(maxValue - minValue);
+    BitWriter writer{ block, 16 };
+    for (uint32_t t = 0; t < 16; t++)
+    {
+        const uint32_t step = static_cast<uint32_t>(std::lround((maxValue - texels[t * stride]) * scale));
+        writer.write(step == 0 ? 0 : step == 7 ? 1 : step + 1, 3);
+    }
+}
+
+void vks::compression::encodeBC5(const uint8_t* texels, uint32_t stride, uint8_t block[16])
+{
+    encodeBC4(texels, stride, block);
+    encodeBC4(texels + 1, stride, block + 8);
+}
+
+void vks::compression::encodeBC7(const uint8_t* texels, uint8_t block[16])
+{
+    // Principal axis of the block's colors by power iteration, endpoints at the extreme projections
+    float mean[4] = {};
+    for (int t = 0; t < 16; t++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            mean[c] += texels[t * 4 + c] / 16.0f;
+        }
+    }
+    float covariance[4][4] = {};
+    for (int t = 0; t < 16; t++)
+    {
+        float delta[4];
+        for (int c = 0; c < 4; c++)
+        {
+            delta[c] = texels[t * 4 + c] - mean[c];
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                covariance[i][j] += delta[i] * delta[j];
+            }
+        }
+    }
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                next[i] += covariance[i][j] * axis[j];
+            }
+        }
+        const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (length < 1e-6f)
+        {
+            break;
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+    float minProjection = INFINITY, maxProjection = -INFINITY;
+    for (int t = 0; t < 16; t++)
+    {
+        float projection = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            projection += (texels[t * 4 + c] - mean[c]) * axis[c];
+        }
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float color0[4], color1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        color0[c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+        color1[c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+    }
+
+    Bc7Endpoint e0 = quantizeBc7Endpoint(color0);
+    Bc7Endpoint e1 = quantizeBc7Endpoint(color1);
+    uint8_t indices[16];
+    int error = indexBc7(texels, e0, e1, indices);
+
+    // One least squares pass on the chosen indices, kept when it lowers the error
+    if (error > 0 && refitBc7(texels, indices, color0, color1))
+    {
+        const Bc7Endpoint refit0 = quantizeBc7Endpoint(color0);
+        const Bc7Endpoint refit1 = quantizeBc7Endpoint(color1);
+        uint8_t refitIndices[16];
+        const int refitError = indexBc7(texels, refit0, refit1, refitIndices);
+        if (refitError < error)
+        {
+            e0 = refit0;
+            e1 = refit1;
+            memcpy(indices, refitIndices, sizeof(indices));
+        }
+    }
+
+    // Anchor texel's index MSB is implicitly 0
+    if (indices[0] & 8)
+    {
+        std::swap(e0, e1);
+        for (uint8_t& index : indices)
+        {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    memset(block, 0, 16);
+    BitWriter writer{ block };
+    writer.write(1u << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.write(static_cast<uint32_t>(e0.value[c]), 7);
+        writer.write(static_cast<uint32_t>(e1.value[c]), 7);
+    }
+    writer.write(static_cast<uint32_t>(e0.pbit), 1);
+    writer.write(static_cast<uint32_t>(e1.pbit), 1);
+    writer.write(indices[0], 3);
+    for (int t = 1; t < 16; t++)
+    {
+        writer.write(indices[t], 4);
+    }
+}
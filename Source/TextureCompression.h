@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+
+#include <ktx.h>
+
+namespace vks
+{
+    struct VulkanDevice;
+
+    /**
+     * Load time block compression of uncompressed KTX textures (R8G8B8A8 / R8) into BCn
+     * Blocks are 4x4 texels, edge blocks of levels that aren't a multiple of 4 repeat their last row / column
+     */
+    namespace compression
+    {
+        // What a texture holds, picks its block format
+        enum class TextureContent
+        {
+            // BC7, rgba
+            Color,
+            // BC5, tangent space xy, z is reconstructed when sampled
+            NormalMap,
+            // BC4, r
+            SingleChannel,
+        };
+
+        // Block format of the content, sourceFormat when the device can't sample it (no textureCompressionBC)
+        VkFormat selectFormat(vks::VulkanDevice* device, TextureContent content, VkFormat sourceFormat);
+
+        // Encodes every level of source into a new texture of format (from selectFormat), touches no Vulkan objects & is safe on any thread
+        ktxResult compressTexture(ktxTexture* source, VkFormat sourceFormat, VkFormat format, ktxTexture** target);
+
+        // Single blocks, texels row major, stride in bytes between the texels' channels
+        void encodeBC4(const uint8_t* texels, uint32_t stride, uint8_t block[8]);
+        void encodeBC5(const uint8_t* texels, uint32_t stride, uint8_t block[16]);
+        // Mode 6 only: one rgba line per block with 4 bit indices
+        void encodeBC7(const uint8_t* texels, uint8_t block[16]);
+    }
+}
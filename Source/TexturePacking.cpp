@@ -0,0 +1,170 @@
+#include "TexturePacking.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+#include "MeshCache.h"
+#include "VulkanTexture.h"
+
+namespace
+{
+    // gl_format.h isn't part of the public ktx headers
+    constexpr ktx_uint32_t GL_RGBA8 = 0x8058;
+    // Key value entry of cooked files, hash of the packing settings & the sources' stamps
+    constexpr const char* SOURCES_KEY = "VokoPackedSources";
+}
+
+ktxResult vks::packing::packORM(const std::array<ktxTexture*, ORM_CHANNEL_COUNT>& sources, const std::array<uint8_t, ORM_CHANNEL_COUNT>& fallbacks,
+    ktxTexture** target)
+{
+    const ktxTexture* reference = nullptr;
+    uint32_t levels = UINT32_MAX;
+    for (ktxTexture* source : sources)
+    {
+        if (!source)
+        {
+            continue;
+        }
+        if (source->isCompressed || source->numFaces != 1 || source->numLayers != 1
+            || (reference && (source->baseWidth != reference->baseWidth || source->baseHeight != reference->baseHeight)))
+        {
+            return KTX_INVALID_VALUE;
+        }
+        reference = source;
+        levels = std::min(levels, source->numLevels);
+    }
+    if (!reference)
+    {
+        return KTX_INVALID_VALUE;
+    }
+
+    ktxTextureCreateInfo createInfo{};
+    createInfo.glInternalformat = GL_RGBA8;
+    createInfo.baseWidth = reference->baseWidth;
+    createInfo.baseHeight = reference->baseHeight;
+    createInfo.baseDepth = 1;
+    createInfo.numDimensions = 2;
+    createInfo.numLevels = levels;
+    createInfo.numLayers = 1;
+    createInfo.numFaces = 1;
+    createInfo.isArray = KTX_FALSE;
+    createInfo.generateMipmaps = KTX_FALSE;
+    ktxResult result = ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, target);
+    if (result != KTX_SUCCESS)
+    {
+        return result;
+    }
+
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        const uint32_t width = std::max(1u, reference->baseWidth >> level);
+        const uint32_t height = std::max(1u, reference->baseHeight >> level);
+        ktx_size_t targetOffset;
+        ktxTexture_GetImageOffset(*target, level, 0, 0, &targetOffset);
+        uint8_t* targetLevel = ktxTexture_GetData(*target) + targetOffset;
+        // 4 byte texels, rows need no padding
+        for (uint32_t texel = 0; texel < width * height; texel++)
+        {
+            uint8_t* packed = targetLevel + texel * 4;
+            packed[0] = fallbacks[ORM_OCCLUSION];
+            packed[1] = fallbacks[ORM_ROUGHNESS];
+            packed[2] = fallbacks[ORM_METALLIC];
+            packed[3] = 255;
+        }
+
+        for (uint32_t channel = 0; channel < ORM_CHANNEL_COUNT; channel++)
+        {
+            ktxTexture* source = sources[channel];
+            if (!source)
+            {
+                continue;
+            }
+            ktx_size_t sourceOffset;
+            ktxTexture_GetImageOffset(source, level, 0, 0, &sourceOffset);
+            const uint8_t* sourceLevel = ktxTexture_GetData(source) + sourceOffset;
+            // Rows of uncompressed ktx levels are padded to 4 bytes
+            const ktx_uint32_t rowPitch = ktxTexture_GetRowPitch(source, level);
+            const ktx_uint32_t texelBytes = ktxTexture_GetElementSize(source);
+            for (uint32_t y = 0; y < height; y++)
+            {
+                const uint8_t* row = sourceLevel + y * rowPitch;
+                uint8_t* packed = targetLevel + y * width * 4 + channel;
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    packed[x * 4] = row[x * texelBytes];
+                }
+            }
+        }
+    }
+    return KTX_SUCCESS;
+}
+
+ktxResult vks::packing::loadORM(const std::string& cookedFilename, const std::array<std::string, ORM_CHANNEL_COUNT>& sourceFilenames,
+    const std::array<uint8_t, ORM_CHANNEL_COUNT>& fallbacks, ktxTexture** target)
+{
+    uint64_t stamp = vks::meshcache::hash(&VERSION, sizeof(VERSION));
+    stamp = vks::meshcache::hash(fallbacks.data(), fallbacks.size(), stamp);
+    for (const std::string& filename : sourceFilenames)
+    {
+        const uint64_t fileStamp = filename.empty() ? 0 : vks::meshcache::fileStamp(filename);
+        stamp = vks::meshcache::hash(filename.data(), filename.size(), vks::meshcache::hash(&fileStamp, sizeof(fileStamp), stamp));
+    }
+
+    // Cooked from the same sources
+    if (ktxTexture_CreateFromNamedFile(cookedFilename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target) == KTX_SUCCESS)
+    {
+        unsigned int valueLength = 0;
+        void* value = nullptr;
+        if (ktxHashList_FindValue(&(*target)->kvDataHead, SOURCES_KEY, &valueLength, &value) == KTX_SUCCESS
+            && valueLength == sizeof(stamp) && memcmp(value, &stamp, sizeof(stamp)) == 0)
+        {
+            return KTX_SUCCESS;
+        }
+        ktxTexture_Destroy(*target);
+        *target = nullptr;
+    }
+
+    std::array<ktxTexture*, ORM_CHANNEL_COUNT> sources{};
+    ktxResult result = KTX_SUCCESS;
+    for (uint32_t channel = 0; channel < ORM_CHANNEL_COUNT && result == KTX_SUCCESS; channel++)
+    {
+        if (!sourceFilenames[channel].empty())
+        {
+            result = vks::Texture::loadKTXFile(sourceFilenames[channel], &sources[channel]);
+        }
+    }
+    if (result == KTX_SUCCESS)
+    {
+        result = packORM(sources, fallbacks, target);
+    }
+    for (ktxTexture* source : sources)
+    {
+        if (source)
+        {
+            ktxTexture_Destroy(source);
+        }
+    }
+    if (result != KTX_SUCCESS)
+    {
+        return result;
+    }
+
+    // Written to a temporary file & renamed like cooked meshes, a failed write only costs the next load another pack
+    ktxHashList_AddKVPair(&(*target)->kvDataHead, SOURCES_KEY, sizeof(stamp), &stamp);
+    const std::string tempFilename = cookedFilename + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    if (ktxTexture_WriteToNamedFile(*target, tempFilename.c_str()) == KTX_SUCCESS)
+    {
+        std::error_code error;
+        std::filesystem::rename(tempFilename, cookedFilename, error);
+        if (!error)
+        {
+            return KTX_SUCCESS;
+        }
+    }
+    std::remove(tempFilename.c_str());
+    return KTX_SUCCESS;
+}
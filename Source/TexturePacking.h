@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <ktx.h>
+
+namespace vks
+{
+    /**
+     * Cook step that packs single channel material textures into one texture, sampled with one fetch
+     * Cooked files are KTX, stamped with the sources they were packed from & repacked once any of them changes
+     */
+    namespace packing
+    {
+        // Bump when the packed layout changes
+        constexpr uint32_t VERSION = 1;
+
+        // Channels of a packed occlusion / roughness / metallic texture, glTF's order (a is 255)
+        enum OrmChannel : uint32_t
+        {
+            ORM_OCCLUSION = 0,
+            ORM_ROUGHNESS = 1,
+            ORM_METALLIC = 2,
+            ORM_CHANNEL_COUNT = 3
+        };
+
+        // Packs the first channel of each source (uncompressed 8 bit, same size) into an R8G8B8A8 texture with the levels all of them have
+        // Null sources are filled with their fallback, touches no Vulkan objects & is safe on any thread
+        ktxResult packORM(const std::array<ktxTexture*, ORM_CHANNEL_COUNT>& sources, const std::array<uint8_t, ORM_CHANNEL_COUNT>& fallbacks,
+            ktxTexture** target);
+
+        // Loads cookedFilename, cooked from the source files first when it's missing or stale, empty source names use their fallback
+        ktxResult loadORM(const std::string& cookedFilename, const std::array<std::string, ORM_CHANNEL_COUNT>& sourceFilenames,
+            const std::array<uint8_t, ORM_CHANNEL_COUNT>& fallbacks, ktxTexture** target);
+    }
+}
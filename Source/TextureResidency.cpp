@@ -0,0 +1,126 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+
+#include "UploadBatch.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+
+vks::TextureResidency::TextureResidency(vks::VulkanDevice* inVulkanDevice, VkDeviceSize inBudget, PFN_vkGetPhysicalDeviceMemoryProperties2KHR inGetMemoryProperties2)
+    : vulkanDevice(inVulkanDevice),
+      getMemoryProperties2(inGetMemoryProperties2),
+      configuredBudget(inBudget),
+      budget(inBudget)
+{
+}
+
+void vks::TextureResidency::track(vks::Texture* texture)
+{
+    entries[texture].texture = texture;
+}
+
+void vks::TextureResidency::trackStreamed(vks::Texture2D* texture)
+{
+    Entry& entry = entries[texture];
+    entry.texture = texture;
+    entry.streamed = texture;
+    entry.lastVisible = frame;
+}
+
+void vks::TextureResidency::beginFrame()
+{
+    frame++;
+    if (!getMemoryProperties2)
+    {
+        return;
+    }
+
+    // Textures may grow into what the device local heaps have left of their budget (usage includes the textures)
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudget{};
+    memoryBudget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2KHR memoryProperties{};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+    memoryProperties.pNext = &memoryBudget;
+    getMemoryProperties2(vulkanDevice->physicalDevice, &memoryProperties);
+
+    VkDeviceSize heapBudget = 0;
+    VkDeviceSize heapUsage = 0;
+    for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; i++)
+    {
+        if (memoryProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            heapBudget += memoryBudget.heapBudget[i];
+            heapUsage += memoryBudget.heapUsage[i];
+        }
+    }
+    const VkDeviceSize available = heapBudget > heapUsage ? heapBudget - heapUsage : 0;
+    budget = std::min(configuredBudget, getUsage() + available);
+}
+
+void vks::TextureResidency::markVisible(vks::Texture2D* texture)
+{
+    auto entry = entries.find(texture);
+    if (entry != entries.end())
+    {
+        entry->second.lastVisible = frame;
+    }
+}
+
+bool vks::TextureResidency::reserve(VkDeviceSize bytes, vks::UploadBatch& batch, std::vector<vks::Texture2D*>& evicted)
+{
+    VkDeviceSize usage = getUsage();
+    if (usage + bytes <= budget)
+    {
+        return true;
+    }
+
+    // Least recently visible first
+    std::vector<Entry*> candidates;
+    for (auto& entry : entries)
+    {
+        const vks::Texture2D* texture = entry.second.streamed;
+        if (texture && texture->isStreaming() && entry.second.lastVisible != frame && texture->residentMip < texture->tailMip)
+        {
+            candidates.push_back(&entry.second);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b)
+    {
+        return a->lastVisible < b->lastVisible;
+    });
+
+    for (Entry* candidate : candidates)
+    {
+        // Finest levels first, down to the tail at most
+        vks::Texture2D* texture = candidate->streamed;
+        const VkDeviceSize residentSize = texture->getLevelsSize(texture->residentMip);
+        uint32_t level = texture->residentMip;
+        do
+        {
+            level++;
+        } while (level < texture->tailMip && usage + bytes > budget + residentSize - texture->getLevelsSize(level));
+
+        const VkDeviceSize previousSize = texture->memorySize;
+        texture->setResidentMip(level, batch);
+        usage = usage - previousSize + texture->memorySize;
+        if (std::find(evicted.begin(), evicted.end(), texture) == evicted.end())
+        {
+            evicted.push_back(texture);
+        }
+        if (usage + bytes <= budget)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+VkDeviceSize vks::TextureResidency::getUsage() const
+{
+    VkDeviceSize usage = 0;
+    for (const auto& entry : entries)
+    {
+        usage += entry.second.texture->memorySize;
+    }
+    return usage;
+}
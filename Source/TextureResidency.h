@@ -0,0 +1,63 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+    class Texture;
+    class Texture2D;
+    class UploadBatch;
+
+    /**
+     * Device memory of textures counted against a budget
+     * Exceeding it evicts the finest mips of the least recently visible streamed textures into smaller images,
+     * they're streamed back in once visible again (Texture2D::setResidentMip), other tracked textures only count
+     * With VK_EXT_memory_budget the budget also shrinks to what the device local heaps have left
+     * Main thread only
+     */
+    class TextureResidency
+    {
+    public:
+        TextureResidency() = delete;
+        // getMemoryProperties2: null without VK_EXT_memory_budget, the budget stays fixed
+        TextureResidency(vks::VulkanDevice* inVulkanDevice, VkDeviceSize inBudget, PFN_vkGetPhysicalDeviceMemoryProperties2KHR inGetMemoryProperties2 = nullptr);
+        TextureResidency(const TextureResidency&) = delete;
+        TextureResidency& operator=(const TextureResidency&) = delete;
+
+        void track(vks::Texture* texture);
+        // Evictable, the texture needs its stream source (Texture2D::loadMipTail)
+        void trackStreamed(vks::Texture2D* texture);
+
+        // Starts a frame & refreshes the budget
+        void beginFrame();
+        // Texture is sampled by the frame's visible draws, it's kept by reserve
+        void markVisible(vks::Texture2D* texture);
+
+        // Evicts until bytes more fit in the budget, evicted gets the textures whose view changed
+        // False when they don't fit after evicting every texture that isn't visible down to its tail
+        bool reserve(VkDeviceSize bytes, vks::UploadBatch& batch, std::vector<vks::Texture2D*>& evicted);
+
+        VkDeviceSize getUsage() const;
+        VkDeviceSize getBudget() const { return budget; }
+
+    private:
+        struct Entry
+        {
+            vks::Texture* texture = nullptr;
+            // Null for textures that can't be evicted
+            vks::Texture2D* streamed = nullptr;
+            uint64_t lastVisible = 0;
+        };
+
+        vks::VulkanDevice* vulkanDevice = nullptr;
+        PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+        VkDeviceSize configuredBudget = 0;
+        VkDeviceSize budget = 0;
+        std::unordered_map<const vks::Texture*, Entry> entries;
+        uint64_t frame = 0;
+    };
+}
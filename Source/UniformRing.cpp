@@ -0,0 +1,89 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace
+{
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+vks::UniformRing::UniformRing(vks::VulkanDevice* inVulkanDevice, uint32_t inFrameSlots)
+    : vulkanDevice(inVulkanDevice),
+      frameSlots(inFrameSlots)
+{
+}
+
+vks::UniformRing::~UniformRing()
+{
+    buffer.destroy();
+}
+
+uint32_t vks::UniformRing::addBlock(const void* source, VkDeviceSize size)
+{
+    if (buffer.buffer != VK_NULL_HANDLE)
+    {
+        vks::tools::exitFatal("Uniform ring blocks have to be added before the ring is created", VK_ERROR_INITIALIZATION_FAILED);
+    }
+    // Block offsets & the slot stride are both dynamic offset aligned
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(vulkanDevice->properties.limits.minUniformBufferOffsetAlignment, 16);
+    Block block;
+    block.source = source;
+    block.size = size;
+    block.offset = slotStride;
+    block.slotVersions.resize(frameSlots, 0);
+    slotStride = alignUp(slotStride + size, alignment);
+    blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void vks::UniformRing::create()
+{
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &buffer, slotStride * frameSlots));
+    // Map persistent
+    VK_CHECK_RESULT(buffer.map());
+
+    for (Block& block : blocks)
+    {
+        const auto* source = static_cast<const uint8_t*>(block.source);
+        block.written.assign(source, source + block.size);
+        for (uint32_t slot = 0; slot < frameSlots; slot++)
+        {
+            memcpy(static_cast<uint8_t*>(buffer.mapped) + slot * slotStride + block.offset, block.source, block.size);
+        }
+    }
+}
+
+void vks::UniformRing::update(uint32_t slot)
+{
+    for (Block& block : blocks)
+    {
+        // Compared in cached memory, the mapping is never read back
+        if (memcmp(block.written.data(), block.source, block.size) != 0)
+        {
+            memcpy(block.written.data(), block.source, block.size);
+            block.version++;
+        }
+        if (block.slotVersions[slot] != block.version)
+        {
+            memcpy(static_cast<uint8_t*>(buffer.mapped) + slot * slotStride + block.offset, block.written.data(), block.size);
+            block.slotVersions[slot] = block.version;
+        }
+    }
+}
+
+VkDescriptorBufferInfo vks::UniformRing::getDescriptor(uint32_t block) const
+{
+    VkDescriptorBufferInfo descriptor{};
+    descriptor.buffer = buffer.buffer;
+    descriptor.offset = blocks[block].offset;
+    descriptor.range = blocks[block].size;
+    return descriptor;
+}
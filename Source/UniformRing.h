@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+
+    /**
+     * Uniform blocks with one copy per frame slot in a persistently mapped buffer, bound as dynamic uniform buffers
+     * A frame slot's copies sit at slot * slot stride, the dynamic offset of every block of that slot
+     * Blocks are compared against their last written data, changed blocks are copied into each slot as it comes around,
+     * unchanged ones aren't written to the (write combined) mapping at all
+     * Main thread only
+     */
+    class UniformRing
+    {
+    public:
+        UniformRing() = delete;
+        UniformRing(vks::VulkanDevice* inVulkanDevice, uint32_t inFrameSlots);
+        UniformRing(const UniformRing&) = delete;
+        UniformRing& operator=(const UniformRing&) = delete;
+        ~UniformRing();
+
+        // source is read by update until the ring is destroyed, blocks are added before create
+        uint32_t addBlock(const void* source, VkDeviceSize size);
+        // Buffer of every slot, each block's copies start with its source's data
+        void create();
+
+        // Copies the blocks that changed since slot last was written, the GPU must be done with slot
+        void update(uint32_t slot);
+
+        // Slot 0 copy, with the slot's dynamic offset added when bound
+        VkDescriptorBufferInfo getDescriptor(uint32_t block) const;
+        uint32_t getDynamicOffset(uint32_t slot) const { return static_cast<uint32_t>(slot * slotStride); }
+
+    private:
+        struct Block
+        {
+            const void* source = nullptr;
+            VkDeviceSize size = 0;
+            VkDeviceSize offset = 0;
+            // Source data of the last version
+            std::vector<uint8_t> written;
+            uint64_t version = 0;
+            // Version each slot's copy holds
+            std::vector<uint64_t> slotVersions;
+        };
+
+        vks::VulkanDevice* vulkanDevice = nullptr;
+        uint32_t frameSlots = 0;
+        VkDeviceSize slotStride = 0;
+        std::vector<Block> blocks;
+        vks::Buffer buffer;
+    };
+}
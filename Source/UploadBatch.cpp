@@ -0,0 +1,127 @@
+#include "UploadBatch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace
+{
+    // Larger uploads get a block of their own
+    constexpr VkDeviceSize STAGING_BLOCK_SIZE = 32ull * 1024 * 1024;
+    // Covers the texel size of every uploaded format (buffer to image copy offsets)
+    constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+}
+
+vks::UploadBatch::UploadBatch(vks::VulkanDevice* inVulkanDevice, vks::MipGenerator* inMipGenerator)
+    : vulkanDevice(inVulkanDevice),
+      mipGenerator(inMipGenerator)
+{
+}
+
+vks::UploadBatch::~UploadBatch()
+{
+    if (commandBuffer != VK_NULL_HANDLE)
+    {
+        vkFreeCommandBuffers(vulkanDevice->logicalDevice, vulkanDevice->commandPool, 1, &commandBuffer);
+    }
+    releaseStaging();
+    runReleases();
+}
+
+vks::UploadBatch::Staging vks::UploadBatch::stage(const void* data, VkDeviceSize size)
+{
+    const VkDeviceSize alignment = std::max(STAGING_ALIGNMENT, vulkanDevice->properties.limits.optimalBufferCopyOffsetAlignment);
+    VkDeviceSize offset = (blockOffset + alignment - 1) & ~(alignment - 1);
+    if (stagingBlocks.empty() || offset + size > stagingBlocks.back().size)
+    {
+        vks::Buffer block;
+        VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &block, std::max(size, STAGING_BLOCK_SIZE)));
+        VK_CHECK_RESULT(block.map());
+        stagingBlocks.push_back(block);
+        offset = 0;
+    }
+    vks::Buffer& block = stagingBlocks.back();
+    memcpy(static_cast<uint8_t*>(block.mapped) + offset, data, static_cast<size_t>(size));
+    blockOffset = offset + size;
+    return { block.buffer, offset };
+}
+
+void vks::UploadBatch::copyBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    const Staging staging = stage(data, size);
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = staging.offset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(getCommandBuffer(), staging.buffer, dstBuffer, 1, &copyRegion);
+}
+
+VkCommandBuffer vks::UploadBatch::getCommandBuffer()
+{
+    if (commandBuffer == VK_NULL_HANDLE)
+    {
+        commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    }
+    return commandBuffer;
+}
+
+void vks::UploadBatch::generateMips(const vks::MipGenerator::Chain& chain)
+{
+    if (!mipGenerator)
+    {
+        vks::tools::exitFatal("Upload batch has no mip generator", -1);
+    }
+    mipChains.push_back(chain);
+    getCommandBuffer();
+}
+
+void vks::UploadBatch::releaseAfterFlush(std::function<void()> release)
+{
+    releases.push_back(std::move(release));
+}
+
+void vks::UploadBatch::flush(VkQueue queue)
+{
+    if (commandBuffer != VK_NULL_HANDLE)
+    {
+        if (!mipChains.empty())
+        {
+            mipGenerator->record(commandBuffer, mipChains);
+            mipChains.clear();
+        }
+        vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+        commandBuffer = VK_NULL_HANDLE;
+        if (mipGenerator)
+        {
+            mipGenerator->reset();
+        }
+    }
+    releaseStaging();
+    runReleases();
+}
+
+void vks::UploadBatch::releaseStaging()
+{
+    for (vks::Buffer& block : stagingBlocks)
+    {
+        block.destroy();
+    }
+    stagingBlocks.clear();
+    blockOffset = 0;
+}
+
+void vks::UploadBatch::runReleases()
+{
+    for (const std::function<void()>& release : releases)
+    {
+        release();
+    }
+    releases.clear();
+}
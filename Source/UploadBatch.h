@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "MipGenerator.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+
+    /**
+     * Records the staging copies of many uploads (geometry, textures) into one command buffer, submitted by a single flush
+     * Source data is copied into staging when it's recorded, callers don't have to keep it alive
+     * Staging is sub-allocated from large host visible blocks that are freed after the flush
+     * Mip chains queued with generateMips are recorded after every copy, right before the submit
+     * Main thread only, like every other use of the queue & the device's command pool
+     */
+    class UploadBatch
+    {
+    public:
+        struct Staging
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+        };
+
+        UploadBatch() = delete;
+        // mipGenerator is only needed by batches that queue mip chains
+        explicit UploadBatch(vks::VulkanDevice* inVulkanDevice, vks::MipGenerator* inMipGenerator = nullptr);
+        UploadBatch(const UploadBatch&) = delete;
+        UploadBatch& operator=(const UploadBatch&) = delete;
+        // Work that was never flushed is dropped
+        ~UploadBatch();
+
+        // Copy into staging, offset is aligned for buffer & buffer to image copies
+        Staging stage(const void* data, VkDeviceSize size);
+        // Stage & record a copy into dstBuffer
+        void copyBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+        // Begun on first use, for image copies & layout transitions of the batch
+        VkCommandBuffer getCommandBuffer();
+        vks::MipGenerator* getMipGenerator() const { return mipGenerator; }
+        // Levels past 0 of chain are generated from level 0 at the flush, level 0 is in transfer dst by then
+        void generateMips(const vks::MipGenerator::Chain& chain);
+        // Runs once the recorded work finished (or with the batch when it's never flushed), for resources the batch still reads
+        void releaseAfterFlush(std::function<void()> release);
+
+        bool empty() const { return commandBuffer == VK_NULL_HANDLE; }
+        // One submit for everything recorded, waits for it & frees staging, the batch can be reused afterwards
+        void flush(VkQueue queue);
+
+    private:
+        void releaseStaging();
+        void runReleases();
+
+        vks::VulkanDevice* vulkanDevice = nullptr;
+        vks::MipGenerator* mipGenerator = nullptr;
+        std::vector<vks::MipGenerator::Chain> mipChains;
+        std::vector<std::function<void()>> releases;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        // Persistently mapped, allocations go to the last block
+        std::vector<vks::Buffer> stagingBlocks;
+        VkDeviceSize blockOffset = 0;
+    };
+}
@@ -0,0 +1,531 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "UploadBatch.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+vks::VirtualTextureCache::VirtualTextureCache(vks::VulkanDevice* inVulkanDevice, vks::JobSystem* inJobSystem, uint32_t inCacheSlots, uint32_t inFrameUploads)
+    : vulkanDevice(inVulkanDevice),
+      jobSystem(inJobSystem),
+      cacheSlots(inCacheSlots),
+      frameUploads(inFrameUploads)
+{
+    if (cacheSlots == 0 || cacheSlots > 256)
+    {
+        vks::tools::exitFatal("Virtual texture cache needs 1 to 256 slots per side", -1);
+    }
+}
+
+vks::VirtualTextureCache::~VirtualTextureCache()
+{
+    for (const auto& texture : textures)
+    {
+        if (texture->pageTable->image != VK_NULL_HANDLE)
+        {
+            texture->pageTable->destroy();
+        }
+        ktxTexture_Destroy(texture->source);
+    }
+    if (prepared)
+    {
+        cache.destroy();
+        infoBuffer.destroy();
+        feedbackBuffer.destroy();
+    }
+}
+
+void vks::VirtualTextureCache::add(vks::Texture2D& pageTable, const std::string& filename, VkFormat format)
+{
+    if (prepared)
+    {
+        vks::tools::exitFatal("Virtual textures have to be added before the cache is prepared", -1);
+    }
+    if (!vks::tools::fileExists(filename))
+    {
+        vks::tools::exitFatal("Could not load virtual texture from " + filename, -1);
+    }
+
+    auto texture = std::make_unique<VirtualTexture>();
+    texture->pageTable = &pageTable;
+    texture->filename = filename;
+    switch (format)
+    {
+    case VK_FORMAT_R8_UNORM: texture->bytesPerTexel = 1; break;
+    case VK_FORMAT_R8G8_UNORM: texture->bytesPerTexel = 2; break;
+    case VK_FORMAT_R8G8B8_UNORM: texture->bytesPerTexel = 3; break;
+    case VK_FORMAT_R8G8B8A8_UNORM: texture->bytesPerTexel = 4; break;
+    default:
+        vks::tools::exitFatal("Virtual texture " + filename + " isn't 8 bit unorm", VK_ERROR_FORMAT_NOT_SUPPORTED);
+    }
+
+    // Header only, pages are decoded from the data read on a job
+    if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &texture->source) != KTX_SUCCESS)
+    {
+        vks::tools::exitFatal("Could not load virtual texture from " + filename, -1);
+    }
+    const ktxTexture* source = texture->source;
+    texture->width = source->baseWidth;
+    texture->height = source->baseHeight;
+    const auto isPowerOfTwo = [](uint32_t size) { return (size & (size - 1)) == 0; };
+    if (source->isCompressed || source->numDimensions != 2 || source->isCubemap || source->isArray
+        || texture->width < PAGE_SIZE || texture->height < PAGE_SIZE || !isPowerOfTwo(texture->width) || !isPowerOfTwo(texture->height))
+    {
+        vks::tools::exitFatal("Virtual texture " + filename + " needs uncompressed power of two levels of at least one page", -1);
+    }
+    // Down to the level whose larger side is one page
+    texture->levelCount = 1;
+    while ((std::max(texture->width, texture->height) >> texture->levelCount) >= PAGE_SIZE)
+    {
+        texture->levelCount++;
+    }
+    if (source->numLevels < texture->levelCount)
+    {
+        vks::tools::exitFatal("Virtual texture " + filename + " is missing mip levels", -1);
+    }
+
+    texture->pagesX = texture->width / PAGE_SIZE;
+    texture->pagesY = texture->height / PAGE_SIZE;
+    uint32_t pageCount = 0;
+    for (uint32_t level = 0; level < texture->levelCount; level++)
+    {
+        texture->levelOffsets.push_back(pageCount);
+        pageCount += std::max(texture->pagesX >> level, 1u) * std::max(texture->pagesY >> level, 1u);
+    }
+    texture->pages.resize(pageCount);
+    // Word aligned, a texture's feedback words are its own
+    texture->feedbackOffset = feedbackWords * 32;
+    feedbackWords += (pageCount + 31) / 32;
+
+    VirtualTexture* target = texture.get();
+    texture->readJob = jobSystem->submit([target]()
+    {
+        target->readResult = ktxTexture_LoadImageData(target->source, nullptr, 0);
+    });
+    textures.push_back(std::move(texture));
+
+    // Coarsest page first, the texture is sampleable once it's resident
+    const uint32_t index = static_cast<uint32_t>(textures.size() - 1);
+    requestPage(index, pageCount - 1, { target->readJob });
+}
+
+void vks::VirtualTextureCache::prepare()
+{
+    prepared = true;
+
+    // A single slot without textures, the descriptor set still points at the cache
+    const uint32_t slotsPerSide = textures.empty() ? 1 : cacheSlots;
+    createTexture(cache, slotsPerSide * SLOT_SIZE, slotsPerSide * SLOT_SIZE, 1, VK_FILTER_LINEAR);
+    slots.resize(textures.empty() ? 0 : cacheSlots * cacheSlots);
+    if (textures.size() > slots.size())
+    {
+        vks::tools::exitFatal("Virtual textures exceed the page cache slots", VK_ERROR_TOO_MANY_OBJECTS);
+    }
+
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &infoBuffer, std::max<size_t>(textures.size(), 1) * sizeof(TextureInfo)));
+    VK_CHECK_RESULT(infoBuffer.map());
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        writeInfo(i);
+    }
+
+    const VkDeviceSize feedbackSize = sizeof(uint32_t) * (1 + std::max(feedbackWords, 1u));
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &feedbackBuffer, feedbackSize));
+    VK_CHECK_RESULT(feedbackBuffer.map());
+    memset(feedbackBuffer.mapped, 0, static_cast<size_t>(feedbackSize));
+}
+
+uint32_t vks::VirtualTextureCache::find(const vks::Texture2D* pageTable) const
+{
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        if (textures[i]->pageTable == pageTable)
+        {
+            return i;
+        }
+    }
+    return INVALID;
+}
+
+bool vks::VirtualTextureCache::isLoading(const vks::Texture2D* pageTable) const
+{
+    const uint32_t texture = find(pageTable);
+    return texture != INVALID && !textures[texture]->ready;
+}
+
+void vks::VirtualTextureCache::setPageTableIndex(uint32_t texture, uint32_t pageTableIndex)
+{
+    textures[texture]->pageTableIndex = pageTableIndex;
+    writeInfo(texture);
+}
+
+std::vector<vks::Texture2D*> vks::VirtualTextureCache::update(vks::UploadBatch& batch)
+{
+    std::vector<vks::Texture2D*> readyTables;
+    if (!prepared || textures.empty())
+    {
+        return readyTables;
+    }
+    frame++;
+
+    // Pages the last frame sampled keep their slots, missing ones & their missing ancestors are requested
+    struct Request
+    {
+        uint32_t texture;
+        uint32_t page;
+        uint32_t level;
+    };
+    std::vector<Request> requests;
+    uint32_t* header = static_cast<uint32_t*>(feedbackBuffer.mapped);
+    uint32_t* feedback = header + 1;
+    for (uint32_t index = 0; index < textures.size(); index++)
+    {
+        VirtualTexture& texture = *textures[index];
+        if (!texture.ready)
+        {
+            continue;
+        }
+        const uint32_t firstWord = texture.feedbackOffset / 32;
+        const uint32_t pageCount = static_cast<uint32_t>(texture.pages.size());
+        for (uint32_t word = firstWord; word < firstWord + (pageCount + 31) / 32; word++)
+        {
+            uint32_t bits = feedback[word];
+            for (uint32_t bit = 0; bits != 0; bit++, bits >>= 1)
+            {
+                if (!(bits & 1))
+                {
+                    continue;
+                }
+                // Ancestors of a touched page were touched with it
+                for (uint32_t page = (word - firstWord) * 32 + bit; page != INVALID; page = getParent(texture, page))
+                {
+                    Page& entry = texture.pages[page];
+                    if (entry.touched == frame)
+                    {
+                        break;
+                    }
+                    entry.touched = frame;
+                    if (entry.slot != INVALID)
+                    {
+                        Slot& slot = slots[entry.slot];
+                        slot.lastUsed = slot.lastUsed == PINNED ? PINNED : frame;
+                    }
+                    else if (!entry.pending)
+                    {
+                        requests.push_back({ index, page, getLevel(texture, page) });
+                    }
+                }
+            }
+        }
+    }
+    memset(feedback, 0, feedbackWords * sizeof(uint32_t));
+    // Rotates the feedback pixel of the next frame
+    header[0] = static_cast<uint32_t>(frame);
+
+    // Coarse pages first, they back the most of the view until finer ones arrive
+    std::stable_sort(requests.begin(), requests.end(), [](const Request& a, const Request& b)
+    {
+        return a.level > b.level;
+    });
+    for (const Request& request : requests)
+    {
+        if (pendingPages.size() >= 2 * frameUploads)
+        {
+            break;
+        }
+        requestPage(request.texture, request.page);
+    }
+
+    // Decoded pages into the cache
+    VkCommandBuffer copyCmd = VK_NULL_HANDLE;
+    const VkImageSubresourceRange cacheRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    uint32_t uploads = 0;
+    for (auto it = pendingPages.begin(); it != pendingPages.end() && uploads < frameUploads;)
+    {
+        PendingPage& pending = **it;
+        if (!pending.job.done())
+        {
+            ++it;
+            continue;
+        }
+        VirtualTexture& texture = *textures[pending.texture];
+        if (pending.texels.empty())
+        {
+            vks::tools::exitFatal("Could not load virtual texture from " + texture.filename, -1);
+        }
+        const uint32_t slot = allocateSlot();
+        if (slot == INVALID)
+        {
+            // The view samples more pages than the cache holds
+            break;
+        }
+
+        if (copyCmd == VK_NULL_HANDLE)
+        {
+            copyCmd = batch.getCommandBuffer();
+            vks::tools::setImageLayout(copyCmd, cache.image, cacheUploaded ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cacheRange);
+        }
+        const vks::UploadBatch::Staging staging = batch.stage(pending.texels.data(), pending.texels.size());
+        VkBufferImageCopy region{};
+        region.bufferOffset = staging.offset;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageOffset = { static_cast<int32_t>((slot % cacheSlots) * SLOT_SIZE), static_cast<int32_t>((slot / cacheSlots) * SLOT_SIZE), 0 };
+        region.imageExtent = { SLOT_SIZE, SLOT_SIZE, 1 };
+        vkCmdCopyBufferToImage(copyCmd, staging.buffer, cache.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        const bool coarsest = pending.page + 1 == texture.pages.size();
+        slots[slot] = { pending.texture, pending.page, coarsest ? PINNED : frame };
+        texture.pages[pending.page].slot = slot;
+        texture.pages[pending.page].pending = false;
+        texture.dirty = true;
+        if (coarsest && !texture.ready)
+        {
+            texture.ready = true;
+            readyTables.push_back(texture.pageTable);
+        }
+        it = pendingPages.erase(it);
+        uploads++;
+    }
+    if (copyCmd != VK_NULL_HANDLE)
+    {
+        vks::tools::setImageLayout(copyCmd, cache.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cacheRange);
+        cacheUploaded = true;
+    }
+
+    // Evictions & new pages remap the page tables
+    for (const auto& texture : textures)
+    {
+        if (texture->ready && texture->dirty)
+        {
+            uploadPageTable(*texture, batch);
+        }
+    }
+    return readyTables;
+}
+
+uint32_t vks::VirtualTextureCache::getLevel(const VirtualTexture& texture, uint32_t page)
+{
+    uint32_t level = 0;
+    while (level + 1 < texture.levelCount && page >= texture.levelOffsets[level + 1])
+    {
+        level++;
+    }
+    return level;
+}
+
+uint32_t vks::VirtualTextureCache::getParent(const VirtualTexture& texture, uint32_t page)
+{
+    const uint32_t level = getLevel(texture, page);
+    if (level + 1 == texture.levelCount)
+    {
+        return INVALID;
+    }
+    const uint32_t levelPagesX = std::max(texture.pagesX >> level, 1u);
+    const uint32_t parentPagesX = std::max(texture.pagesX >> (level + 1), 1u);
+    const uint32_t parentPagesY = std::max(texture.pagesY >> (level + 1), 1u);
+    const uint32_t x = (page - texture.levelOffsets[level]) % levelPagesX;
+    const uint32_t y = (page - texture.levelOffsets[level]) / levelPagesX;
+    return texture.levelOffsets[level + 1] + std::min(y / 2, parentPagesY - 1) * parentPagesX + std::min(x / 2, parentPagesX - 1);
+}
+
+void vks::VirtualTextureCache::decodePage(const VirtualTexture& texture, uint32_t page, std::vector<uint8_t>& texels)
+{
+    if (texture.readResult != KTX_SUCCESS)
+    {
+        return;
+    }
+    const uint32_t level = getLevel(texture, page);
+    const uint32_t levelPagesX = std::max(texture.pagesX >> level, 1u);
+    const uint32_t pageX = (page - texture.levelOffsets[level]) % levelPagesX;
+    const uint32_t pageY = (page - texture.levelOffsets[level]) / levelPagesX;
+    const uint32_t levelWidth = std::max(texture.width >> level, 1u);
+    const uint32_t levelHeight = std::max(texture.height >> level, 1u);
+
+    ktx_size_t levelOffset = 0;
+    ktxTexture_GetImageOffset(texture.source, level, 0, 0, &levelOffset);
+    const ktx_uint32_t rowPitch = ktxTexture_GetRowPitch(texture.source, level);
+    const uint8_t* levelData = ktxTexture_GetData(texture.source) + levelOffset;
+
+    // Borders repeat the neighbouring pages (wrapping at the level's edges) for bilinear filtering up to a page's edge
+    // Levels smaller than a page repeat within it, the shader only samples their extent
+    texels.resize(SLOT_SIZE * SLOT_SIZE * 4);
+    const uint32_t bytesPerTexel = texture.bytesPerTexel;
+    for (uint32_t y = 0; y < SLOT_SIZE; y++)
+    {
+        const uint32_t sourceY = (pageY * PAGE_SIZE + y + levelHeight - PAGE_BORDER) % levelHeight;
+        const uint8_t* row = levelData + static_cast<size_t>(sourceY) * rowPitch;
+        uint8_t* target = &texels[y * SLOT_SIZE * 4];
+        for (uint32_t x = 0; x < SLOT_SIZE; x++, target += 4)
+        {
+            const uint8_t* texel = row + ((pageX * PAGE_SIZE + x + levelWidth - PAGE_BORDER) % levelWidth) * bytesPerTexel;
+            target[0] = texel[0];
+            target[1] = bytesPerTexel > 1 ? texel[1] : 0;
+            target[2] = bytesPerTexel > 2 ? texel[2] : 0;
+            target[3] = bytesPerTexel > 3 ? texel[3] : 255;
+        }
+    }
+}
+
+void vks::VirtualTextureCache::requestPage(uint32_t texture, uint32_t page, const std::vector<vks::JobSystem::Handle>& dependencies)
+{
+    textures[texture]->pages[page].pending = true;
+    auto pending = std::make_unique<PendingPage>();
+    pending->texture = texture;
+    pending->page = page;
+    PendingPage* target = pending.get();
+    const VirtualTexture* source = textures[texture].get();
+    pending->job = jobSystem->submit([target, source]()
+    {
+        decodePage(*source, target->page, target->texels);
+    }, dependencies);
+    pendingPages.push_back(std::move(pending));
+}
+
+uint32_t vks::VirtualTextureCache::allocateSlot()
+{
+    uint32_t oldest = INVALID;
+    for (uint32_t i = 0; i < slots.size(); i++)
+    {
+        const Slot& slot = slots[i];
+        if (slot.texture == INVALID)
+        {
+            return i;
+        }
+        if (slot.lastUsed < frame && (oldest == INVALID || slot.lastUsed < slots[oldest].lastUsed))
+        {
+            oldest = i;
+        }
+    }
+    if (oldest != INVALID)
+    {
+        Slot& slot = slots[oldest];
+        VirtualTexture& owner = *textures[slot.texture];
+        owner.pages[slot.page].slot = INVALID;
+        owner.dirty = true;
+        slot.texture = INVALID;
+    }
+    return oldest;
+}
+
+void vks::VirtualTextureCache::createTexture(vks::Texture2D& texture, uint32_t textureWidth, uint32_t textureHeight, uint32_t levels, VkFilter filter)
+{
+    texture.device = vulkanDevice;
+    texture.width = textureWidth;
+    texture.height = textureHeight;
+    texture.mipLevels = levels;
+    texture.layerCount = 1;
+
+    VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageCreateInfo.mipLevels = levels;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.extent = { textureWidth, textureHeight, 1 };
+    imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, texture.image, &memReqs);
+    VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+    memAllocInfo.allocationSize = memReqs.size;
+    memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &texture.deviceMemory));
+    VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, texture.image, texture.deviceMemory, 0));
+    texture.memorySize = memReqs.size;
+
+    // Page tables are fetched, the cache is filtered within a page (clamped, pages carry their own borders)
+    VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+    samplerCreateInfo.magFilter = filter;
+    samplerCreateInfo.minFilter = filter;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerCreateInfo.maxAnisotropy = 1.0f;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    texture.sampler = vulkanDevice->getSampler(samplerCreateInfo);
+
+    VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+    viewCreateInfo.image = texture.image;
+    VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &viewCreateInfo, nullptr, &texture.view));
+
+    texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    texture.updateDescriptor();
+}
+
+void vks::VirtualTextureCache::uploadPageTable(VirtualTexture& texture, vks::UploadBatch& batch)
+{
+    // Level by level from the coarsest, pages that aren't resident point at their parent's entry
+    // Entry: cache slot xy, level of the page in it, a = 255
+    std::vector<uint32_t> entries(texture.pages.size());
+    for (uint32_t level = texture.levelCount; level-- > 0;)
+    {
+        const uint32_t levelPages = (level + 1 < texture.levelCount ? texture.levelOffsets[level + 1] : static_cast<uint32_t>(texture.pages.size())) - texture.levelOffsets[level];
+        for (uint32_t i = 0; i < levelPages; i++)
+        {
+            const uint32_t page = texture.levelOffsets[level] + i;
+            const uint32_t slot = texture.pages[page].slot;
+            if (slot != INVALID)
+            {
+                entries[page] = (slot % cacheSlots) | ((slot / cacheSlots) << 8) | (level << 16) | (255u << 24);
+            }
+            else
+            {
+                // The coarsest page is pinned once the texture is ready
+                entries[page] = entries[getParent(texture, page)];
+            }
+        }
+    }
+
+    const bool created = texture.pageTable->image == VK_NULL_HANDLE;
+    if (created)
+    {
+        createTexture(*texture.pageTable, texture.pagesX, texture.pagesY, texture.levelCount, VK_FILTER_NEAREST);
+    }
+    const vks::UploadBatch::Staging staging = batch.stage(entries.data(), entries.size() * sizeof(uint32_t));
+    std::vector<VkBufferImageCopy> regions(texture.levelCount);
+    for (uint32_t level = 0; level < texture.levelCount; level++)
+    {
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = staging.offset + texture.levelOffsets[level] * sizeof(uint32_t);
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        region.imageExtent = { std::max(texture.pagesX >> level, 1u), std::max(texture.pagesY >> level, 1u), 1 };
+    }
+
+    VkCommandBuffer copyCmd = batch.getCommandBuffer();
+    const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.levelCount, 0, 1 };
+    vks::tools::setImageLayout(copyCmd, texture.pageTable->image, created ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+    vkCmdCopyBufferToImage(copyCmd, staging.buffer, texture.pageTable->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+    vks::tools::setImageLayout(copyCmd, texture.pageTable->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+    texture.dirty = false;
+}
+
+void vks::VirtualTextureCache::writeInfo(uint32_t texture)
+{
+    if (!infoBuffer.mapped)
+    {
+        return;
+    }
+    const VirtualTexture& source = *textures[texture];
+    TextureInfo info{};
+    info.pageTableIndex = source.pageTableIndex;
+    info.feedbackOffset = source.feedbackOffset;
+    info.levelCount = source.levelCount;
+    memcpy(static_cast<TextureInfo*>(infoBuffer.mapped) + texture, &info, sizeof(TextureInfo));
+}
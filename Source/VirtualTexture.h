@@ -0,0 +1,157 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include <ktx.h>
+
+#include "JobSystem.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+
+namespace vks
+{
+    struct VulkanDevice;
+    class UploadBatch;
+
+    /**
+     * Software virtual texturing: textures are split into pages per level, decoded on jobs & uploaded on demand into one physical page cache
+     * Each texture's page table (sampled from the bindless array) maps every page of every level to the cache slot of its finest resident ancestor
+     * The geometry pass marks the pages it samples in a feedback buffer at a fraction of its pixels, read after the frame finished
+     * Core sampling only (texelFetch of the page table, bilinear within a bordered page), device memory is the cache & the page tables whatever the textures' size
+     * Main thread only, besides the decode jobs
+     */
+    class VirtualTextureCache
+    {
+    public:
+        // Texels of a page & of its border on each side, same as util/virtual_texture.glsl
+        static constexpr uint32_t PAGE_SIZE = 128;
+        static constexpr uint32_t PAGE_BORDER = 1;
+        static constexpr uint32_t SLOT_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+        static constexpr uint32_t INVALID = UINT32_MAX;
+
+        VirtualTextureCache() = delete;
+        // cacheSlots: pages per side of the physical cache (page table entries hold 8 bit slot coordinates), frameUploads: pages uploaded per update at most
+        VirtualTextureCache(vks::VulkanDevice* inVulkanDevice, vks::JobSystem* inJobSystem, uint32_t inCacheSlots, uint32_t inFrameUploads);
+        VirtualTextureCache(const VirtualTextureCache&) = delete;
+        VirtualTextureCache& operator=(const VirtualTextureCache&) = delete;
+        // Decode jobs must have finished (job system destroyed or waited for)
+        ~VirtualTextureCache();
+
+        // pageTable becomes the texture's page table once its coarsest page is resident (update), the header is read here, the data on a job
+        // Power of two sizes of at least PAGE_SIZE with their mips, 8 bit unorm texels (R, RG, RGB or RGBA), decoded to RGBA
+        void add(vks::Texture2D& pageTable, const std::string& filename, VkFormat format);
+        // After the last add: creates the cache & the buffers of the mesh descriptor set
+        void prepare();
+
+        // Texture whose page table this is, INVALID for other textures
+        uint32_t find(const vks::Texture2D* pageTable) const;
+        // Added but not sampleable yet
+        bool isLoading(const vks::Texture2D* pageTable) const;
+        // Slot of the texture's page table in the bindless texture array
+        void setPageTableIndex(uint32_t texture, uint32_t pageTableIndex);
+        bool empty() const { return textures.empty(); }
+
+        // Per frame once the last one finished: reads its feedback, queues decodes of the pages it missed & uploads decoded pages into the
+        // least recently sampled slots, returns the page tables that became sampleable (their descriptor is new)
+        std::vector<vks::Texture2D*> update(vks::UploadBatch& batch);
+
+        vks::Texture2D& getCache() { return cache; }
+        VkDescriptorBufferInfo& getInfoDescriptor() { return infoBuffer.descriptor; }
+        VkDescriptorBufferInfo& getFeedbackDescriptor() { return feedbackBuffer.descriptor; }
+
+    private:
+        struct Page
+        {
+            // Cache slot while resident
+            uint32_t slot = INVALID;
+            bool pending = false;
+            // Frame whose feedback reached the page last
+            uint64_t touched = 0;
+        };
+
+        struct VirtualTexture
+        {
+            vks::Texture2D* pageTable = nullptr;
+            std::string filename;
+            // Header from add, data read by readJob
+            ktxTexture* source = nullptr;
+            ktxResult readResult = KTX_SUCCESS;
+            vks::JobSystem::Handle readJob;
+            uint32_t bytesPerTexel = 4;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t levelCount = 0;
+            // Pages of level 0, level l has max(pagesX >> l, 1) by max(pagesY >> l, 1)
+            uint32_t pagesX = 0;
+            uint32_t pagesY = 0;
+            // First page of each level, pages (& their feedback bits) are stored level by level, row by row
+            std::vector<uint32_t> levelOffsets;
+            std::vector<Page> pages;
+            uint32_t feedbackOffset = 0;
+            uint32_t pageTableIndex = 0;
+            bool ready = false;
+            // Pages were mapped or evicted since the page table's upload
+            bool dirty = false;
+        };
+
+        struct Slot
+        {
+            uint32_t texture = INVALID;
+            uint32_t page = 0;
+            // Feedback frame that last sampled the page (or one it backs), PINNED for the coarsest pages
+            uint64_t lastUsed = 0;
+        };
+        static constexpr uint64_t PINNED = UINT64_MAX;
+
+        struct PendingPage
+        {
+            uint32_t texture = 0;
+            uint32_t page = 0;
+            // SLOT_SIZE² RGBA texels, empty when the source couldn't be read
+            std::vector<uint8_t> texels;
+            vks::JobSystem::Handle job;
+        };
+
+        // Per texture, same as VirtualTextureInfo in util/mesh.glsl
+        struct TextureInfo
+        {
+            uint32_t pageTableIndex;
+            uint32_t feedbackOffset;
+            uint32_t levelCount;
+            uint32_t padding;
+        };
+
+        static uint32_t getLevel(const VirtualTexture& texture, uint32_t page);
+        // Page of the next coarser level covering page, INVALID for the coarsest
+        static uint32_t getParent(const VirtualTexture& texture, uint32_t page);
+        static void decodePage(const VirtualTexture& texture, uint32_t page, std::vector<uint8_t>& texels);
+
+        void requestPage(uint32_t texture, uint32_t page, const std::vector<vks::JobSystem::Handle>& dependencies = {});
+        // Free slot or the least recently used one the last frame didn't sample, INVALID when every slot is in use
+        uint32_t allocateSlot();
+        void createTexture(vks::Texture2D& texture, uint32_t textureWidth, uint32_t textureHeight, uint32_t levels, VkFilter filter);
+        void uploadPageTable(VirtualTexture& texture, vks::UploadBatch& batch);
+        void writeInfo(uint32_t texture);
+
+        vks::VulkanDevice* vulkanDevice = nullptr;
+        vks::JobSystem* jobSystem = nullptr;
+        uint32_t cacheSlots = 0;
+        uint32_t frameUploads = 0;
+        bool prepared = false;
+        uint64_t frame = 0;
+
+        std::vector<std::unique_ptr<VirtualTexture>> textures;
+        std::vector<std::unique_ptr<PendingPage>> pendingPages;
+        std::vector<Slot> slots;
+        vks::Texture2D cache;
+        bool cacheUploaded = false;
+
+        // Host visible, the feedback holds the frame counter then one bit per page of every texture
+        vks::Buffer infoBuffer;
+        vks::Buffer feedbackBuffer;
+        uint32_t feedbackWords = 0;
+    };
+}
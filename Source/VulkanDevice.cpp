@@ -14,6 +14,7 @@
 #endif
 #include <VulkanDevice.h>
 #include <unordered_set>
+#include "SamplerCache.h"
 
 namespace vks
 {	
@@ -64,6 +65,7 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		samplerCache.reset();
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -301,6 +303,8 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		samplerCache = std::make_unique<SamplerCache>(logicalDevice);
+
 		return result;
 	}
 
@@ -586,4 +590,16 @@ namespace vks
 		throw std::runtime_error("Could not find a matching depth format");
 	}
 
+	/**
+	* Get a sampler with the given state, shared with every other user of the same state
+	*
+	* @param createInfo Sampler state (no chained structs)
+	*
+	* @return Sampler owned by the device, must not be destroyed by the caller
+	*/
+	VkSampler VulkanDevice::getSampler(const VkSamplerCreateInfo &createInfo)
+	{
+		return samplerCache->get(createInfo);
+	}
+
 };
@@ -16,9 +16,12 @@
 #include <algorithm>
 #include <assert.h>
 #include <exception>
+#include <memory>
 
 namespace vks
 {
+class SamplerCache;
+
 struct VulkanDevice
 {
 	/** @brief Physical device representation */
@@ -39,6 +42,8 @@ struct VulkanDevice
 	std::vector<std::string> supportedExtensions;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	/** @brief Samplers shared by every texture & pass, created with the logical device (see getSampler) */
+	std::unique_ptr<SamplerCache> samplerCache;
 	/** @brief Contains queue family indices */
 	struct
 	{
@@ -65,5 +70,6 @@ struct VulkanDevice
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
 	bool            extensionSupported(std::string extension);
 	VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
+	VkSampler       getSampler(const VkSamplerCreateInfo &createInfo);
 };
 }        // namespace vks
@@ -123,7 +123,6 @@ namespace vks
 				vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, nullptr);
 				vkFreeMemory(vulkanDevice->logicalDevice, attachment.memory, nullptr);
 			}
-			vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
 			vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, nullptr);
 			vkDestroyFramebuffer(vulkanDevice->logicalDevice, framebuffer, nullptr);
 		}
@@ -278,7 +277,7 @@ namespace vks
 			return static_cast<uint32_t>(attachments.size() - 1);
 		}
 		/**
-		* Creates a default sampler for sampling from any of the framebuffer attachments
+		* Gets a default sampler for sampling from any of the framebuffer attachments, shared through the device's sampler cache
 		* Applications are free to create their own samplers for different use cases 
 		*
 		* @param magFilter Magnification filter for lookups
@@ -301,7 +300,8 @@ namespace vks
 			samplerInfo.minLod = 0.0f;
 			samplerInfo.maxLod = 1.0f;
 			samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			return vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sampler);
+			sampler = vulkanDevice->getSampler(samplerInfo);
+			return VK_SUCCESS;
 		}
 
 		/**
@@ -317,6 +317,70 @@ namespace vks
 				attachmentDescriptions.push_back(attachment.description);
 			};
 
+			VK_CHECK_RESULT(createRenderPass(attachmentDescriptions, &renderPass));
+
+			std::vector<VkImageView> attachmentViews;
+			for (auto attachment : attachments)
+			{
+				attachmentViews.push_back(attachment.view);
+			}
+
+			// Find. max number of layers across attachments
+			uint32_t maxLayers = 0;
+			for (auto attachment : attachments)
+			{
+				if (attachment.subresourceRange.layerCount > maxLayers)
+				{
+					maxLayers = attachment.subresourceRange.layerCount;
+				}
+			}
+
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = renderPass;
+			framebufferInfo.pAttachments = attachmentViews.data();
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachmentViews.size());
+			framebufferInfo.width = width;
+			framebufferInfo.height = height;
+			framebufferInfo.layers = maxLayers;
+			VK_CHECK_RESULT(vkCreateFramebuffer(vulkanDevice->logicalDevice, &framebufferInfo, nullptr, &framebuffer));
+
+			return VK_SUCCESS;
+		}
+
+		/**
+		* Creates a render pass compatible with the default one that keeps the attachment contents
+		* Used to continue rendering into the same framebuffer after an intermediate (e.g. compute) step
+		*
+		* @param loadRenderPass Render pass handle to be created, owned by the caller
+		*
+		* @return VK_SUCCESS if the render pass has been created successfully
+		*/
+		VkResult createLoadRenderPass(VkRenderPass* loadRenderPass)
+		{
+			std::vector<VkAttachmentDescription> attachmentDescriptions;
+			for (auto& attachment : attachments)
+			{
+				VkAttachmentDescription description = attachment.description;
+				description.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				if (description.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_CLEAR)
+				{
+					description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				}
+				// Owned attachments were left in their final layout by the previous pass
+				if (description.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+				{
+					description.initialLayout = description.finalLayout;
+				}
+				attachmentDescriptions.push_back(description);
+			}
+
+			return createRenderPass(attachmentDescriptions, loadRenderPass);
+		}
+
+	private:
+		VkResult createRenderPass(const std::vector<VkAttachmentDescription>& attachmentDescriptions, VkRenderPass* outRenderPass)
+		{
 			// Collect attachment references
 			std::vector<VkAttachmentReference> colorReferences;
 			VkAttachmentReference depthReference = {};
@@ -402,33 +466,7 @@ namespace vks
 			renderPassInfo.pSubpasses = &subpass;
 			renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
-
-			std::vector<VkImageView> attachmentViews;
-			for (auto attachment : attachments)
-			{
-				attachmentViews.push_back(attachment.view);
-			}
-
-			// Find. max number of layers across attachments
-			uint32_t maxLayers = 0;
-			for (auto attachment : attachments)
-			{
-				if (attachment.subresourceRange.layerCount > maxLayers)
-				{
-					maxLayers = attachment.subresourceRange.layerCount;
-				}
-			}
-
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = renderPass;
-			framebufferInfo.pAttachments = attachmentViews.data();
-			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachmentViews.size());
-			framebufferInfo.width = width;
-			framebufferInfo.height = height;
-			framebufferInfo.layers = maxLayers;
-			VK_CHECK_RESULT(vkCreateFramebuffer(vulkanDevice->logicalDevice, &framebufferInfo, nullptr, &framebuffer));
+			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, outRenderPass));
 
 			return VK_SUCCESS;
 		}
@@ -7,6 +7,7 @@
 */
 #define NOMINMAX // Prevent min/max macros in Windows headers
 #include <VulkanTexture.h>
+#include "UploadBatch.h"
 
 namespace vks
 {
@@ -21,11 +22,14 @@ namespace vks
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		if (sampler)
+		// The sampler belongs to the device's sampler cache
+		sampler = VK_NULL_HANDLE;
+		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		if (streamSource)
 		{
-			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+			ktxTexture_Destroy(streamSource);
+			streamSource = nullptr;
 		}
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
 	}
 
 	ktxResult Texture::loadKTXFile(std::string filename, ktxTexture **target)
@@ -70,227 +74,372 @@ namespace vks
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
 
+		// Only use linear tiling if requested (and supported by the device)
+		// Support for linear tiling is mostly limited, so prefer to use
+		// optimal tiling instead
+		// On most implementations linear tiling will only support a very
+		// limited amount of formats and features (mip maps, cubemaps, arrays, etc.)
+		if (!forceLinear)
+		{
+			// Same staged path as streamed textures, in a batch of its own
+			vks::UploadBatch batch(device);
+			loadFromKtx(ktxTexture, format, device, batch, imageUsageFlags, imageLayout);
+			batch.flush(copyQueue);
+			return;
+		}
+
 		this->device = device;
 		width = ktxTexture->baseWidth;
 		height = ktxTexture->baseHeight;
 		mipLevels = ktxTexture->numLevels;
 
 		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
 
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 
-		// Only use linear tiling if requested (and supported by the device)
-		// Support for linear tiling is mostly limited, so prefer to use
-		// optimal tiling instead
-		// On most implementations linear tiling will only support a very
-		// limited amount of formats and features (mip maps, cubemaps, arrays, etc.)
-		VkBool32 useStaging = !forceLinear;
-
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
 		// Use a separate command buffer for texture loading
 		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-		if (useStaging)
-		{
-			// Create a host-visible staging buffer that contains the raw image data
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
+		// Prefer using optimal tiling, as linear tiling 
+		// may support only a small set of features 
+		// depending on implementation (e.g. no mip maps, only one layer, etc.)
+
+		// Check if this support is supported for linear tiling
+		assert(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+		VkImage mappableImage;
+		VkDeviceMemory mappableMemory;
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
+		imageCreateInfo.usage = imageUsageFlags;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = ktxTextureSize;
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		// Load mip map level 0 to linear tiling image
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &mappableImage));
 
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+		// Get memory requirements for this image 
+		// like size and alignment
+		vkGetImageMemoryRequirements(device->logicalDevice, mappableImage, &memReqs);
+		// Set memory allocation size to required memory size
+		memAllocInfo.allocationSize = memReqs.size;
 
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+		// Get memory type that can be mapped to host memory
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		// Allocate host memory
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &mappableMemory));
 
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+		// Bind allocated image for use
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, mappableImage, mappableMemory, 0));
 
-			// Copy texture data into staging buffer
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, ktxTextureData, ktxTextureSize);
-			vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Get sub resource layout
+		// Mip map count, array layer, etc.
+		VkImageSubresource subRes = {};
+		subRes.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subRes.mipLevel = 0;
 
-			// Setup buffer copy regions for each mip level
-			std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkSubresourceLayout subResLayout;
+		void *data;
 
-			for (uint32_t i = 0; i < mipLevels; i++)
-			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-				assert(result == KTX_SUCCESS);
+		// Get sub resources layout 
+		// Includes row pitch, size offsets, etc.
+		vkGetImageSubresourceLayout(device->logicalDevice, mappableImage, &subRes, &subResLayout);
 
-				VkBufferImageCopy bufferCopyRegion = {};
-				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				bufferCopyRegion.imageSubresource.mipLevel = i;
-				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-				bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
-				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
+		// Map image memory
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
 
-				bufferCopyRegions.push_back(bufferCopyRegion);
-			}
+		// Copy image data into memory
+		memcpy(data, ktxTextureData, memReqs.size);
 
-			// Create optimal tiled target image
-			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.mipLevels = mipLevels;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.extent = { width, height, 1 };
-			imageCreateInfo.usage = imageUsageFlags;
-			// Ensure that the TRANSFER_DST bit is set for staging
-			if (!(imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
-			{
-				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-			}
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-			VkImageSubresourceRange subresourceRange = {};
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.baseMipLevel = 0;
-			subresourceRange.levelCount = mipLevels;
-			subresourceRange.layerCount = 1;
-
-			// Image barrier for optimal image (target)
-			// Optimal image will be used as destination for the copy
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-
-			// Copy mip levels from staging buffer
-			vkCmdCopyBufferToImage(
-				copyCmd,
-				stagingBuffer,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				static_cast<uint32_t>(bufferCopyRegions.size()),
-				bufferCopyRegions.data()
-			);
-
-			// Change texture image layout to shader read after all mip levels have been copied
-			this->imageLayout = imageLayout;
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				imageLayout,
-				subresourceRange);
-
-			device->flushCommandBuffer(copyCmd, copyQueue);
-
-			// Clean up staging resources
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		vkUnmapMemory(device->logicalDevice, mappableMemory);
+
+		// Linear tiled images don't need to be staged
+		// and can be directly used as textures
+		image = mappableImage;
+		deviceMemory = mappableMemory;
+		memorySize = memReqs.size;
+		this->imageLayout = imageLayout;
+
+		// Setup image memory barrier
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
+
+		device->flushCommandBuffer(copyCmd, copyQueue);
+
+		ktxTexture_Destroy(ktxTexture);
+
+		// Linear tiling usually won't support mip maps
+		mipLevels = 1;
+		createSampler(1);
+		imageFormat = format;
+		createView(0);
+	}
+
+	/**
+	* Create a 2D texture from a loaded ktx texture, staged through a batch
+	*
+	* @param ktxTexture Texture read by loadKTXFile (may happen on any thread), destroyed once its data is staged
+	* @param format Vulkan format of the image data stored in the file
+	* @param device Vulkan device to create the texture on
+	* @param batch Batch the staging copy & layout transitions are recorded into, the texture is usable after its flush
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	*/
+	void Texture2D::loadFromKtx(ktxTexture* ktxTexture, VkFormat format, vks::VulkanDevice *device, vks::UploadBatch &batch, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		createFromKtx(ktxTexture, format, device, batch, 0, imageUsageFlags, imageLayout);
+		ktxTexture_Destroy(ktxTexture);
+	}
+
+	/**
+	* Create a 2D texture from a loaded ktx texture with only its mip tail resident, finer mips follow through setResidentMip
+	*
+	* @param ktxTexture Texture read by loadKTXFile, kept as the source of the levels that aren't resident
+	* @param format Vulkan format of the image data stored in the file
+	* @param device Vulkan device to create the texture on
+	* @param batch Batch the tail's staging copy & layout transitions are recorded into, the texture is usable after its flush
+	* @param tailSize Largest dimension (in texels) of the mips staged now
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	*/
+	void Texture2D::loadMipTail(ktxTexture* ktxTexture, VkFormat format, vks::VulkanDevice *device, vks::UploadBatch &batch, uint32_t tailSize, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		uint32_t firstLevel = 0;
+		while (firstLevel + 1 < ktxTexture->numLevels && std::max(ktxTexture->baseWidth, ktxTexture->baseHeight) >> firstLevel > tailSize)
+		{
+			firstLevel++;
+		}
+		if (firstLevel == 0)
+		{
+			loadFromKtx(ktxTexture, format, device, batch, imageUsageFlags, imageLayout);
+			return;
 		}
-		else
+		// Resident levels move to the next image on the gpu
+		createFromKtx(ktxTexture, format, device, batch, firstLevel, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, imageLayout);
+		streamSource = ktxTexture;
+		tailMip = firstLevel;
+	}
+
+	/**
+	* Record the move of a streamed texture to a new image of the levels [level, mipLevels)
+	* Levels both images hold are copied from the current image, finer ones are staged from the stream source
+	*
+	* @param level Finest resident level, clamped to [0, tailMip]
+	* @param batch Batch the copies are recorded into, the new view (descriptor) may be sampled after its flush, the old image is destroyed by it
+	*
+	* @return Staged bytes
+	*/
+	VkDeviceSize Texture2D::setResidentMip(uint32_t level, vks::UploadBatch &batch)
+	{
+		level = std::min(level, tailMip);
+		if (!streamSource || level == residentMip)
+		{
+			return 0;
+		}
+		const uint32_t oldMip = residentMip;
+		const VkImage oldImage = image;
+		const VkDeviceMemory oldMemory = deviceMemory;
+		const VkImageView oldView = view;
+		createImage(level);
+
+		VkCommandBuffer copyCmd = batch.getCommandBuffer();
+		vks::tools::setImageLayout(
+			copyCmd,
+			image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels - level, 0, 1 });
+
+		// Levels both images hold
+		const uint32_t keptLevel = std::max(level, oldMip);
+		vks::tools::setImageLayout(
+			copyCmd,
+			oldImage,
+			imageLayout,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, keptLevel - oldMip, mipLevels - keptLevel, 0, 1 });
+		std::vector<VkImageCopy> imageCopyRegions;
+		for (uint32_t i = keptLevel; i < mipLevels; i++)
 		{
-			// Prefer using optimal tiling, as linear tiling 
-			// may support only a small set of features 
-			// depending on implementation (e.g. no mip maps, only one layer, etc.)
+			VkImageCopy imageCopyRegion = {};
+			imageCopyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - oldMip, 0, 1 };
+			imageCopyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - level, 0, 1 };
+			imageCopyRegion.extent = { std::max(1u, width >> i), std::max(1u, height >> i), 1 };
+			imageCopyRegions.push_back(imageCopyRegion);
+		}
+		vkCmdCopyImage(
+			copyCmd,
+			oldImage,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(imageCopyRegions.size()),
+			imageCopyRegions.data());
 
-			// Check if this support is supported for linear tiling
-			assert(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+		// Finer levels than the old image had
+		const VkDeviceSize staged = level < oldMip ? copyLevels(streamSource, level, oldMip, level, batch) : 0;
 
-			VkImage mappableImage;
-			VkDeviceMemory mappableMemory;
+		vks::tools::setImageLayout(
+			copyCmd,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			imageLayout,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels - level, 0, 1 });
+		createView(level);
 
-			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.extent = { width, height, 1 };
-			imageCreateInfo.mipLevels = 1;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
-			imageCreateInfo.usage = imageUsageFlags;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// The old image is read by the batch, its view may still be in a descriptor until the caller rewrites it
+		VkDevice logicalDevice = device->logicalDevice;
+		batch.releaseAfterFlush([logicalDevice, oldImage, oldMemory, oldView]()
+		{
+			vkDestroyImageView(logicalDevice, oldView, nullptr);
+			vkDestroyImage(logicalDevice, oldImage, nullptr);
+			vkFreeMemory(logicalDevice, oldMemory, nullptr);
+		});
+		return staged;
+	}
 
-			// Load mip map level 0 to linear tiling image
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &mappableImage));
+	VkDeviceSize Texture2D::getLevelsSize(uint32_t level) const
+	{
+		VkDeviceSize size = 0;
+		for (uint32_t i = level; streamSource && i < mipLevels; i++)
+		{
+			size += ktxTexture_GetImageSize(streamSource, i);
+		}
+		return size;
+	}
 
-			// Get memory requirements for this image 
-			// like size and alignment
-			vkGetImageMemoryRequirements(device->logicalDevice, mappableImage, &memReqs);
-			// Set memory allocation size to required memory size
-			memAllocInfo.allocationSize = memReqs.size;
+	// Image of the levels [firstLevel, numLevels), staged & transitioned to imageLayout
+	void Texture2D::createFromKtx(ktxTexture* ktxTexture, VkFormat format, vks::VulkanDevice *device, vks::UploadBatch &batch, uint32_t firstLevel, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		this->device = device;
+		width = ktxTexture->baseWidth;
+		height = ktxTexture->baseHeight;
+		mipLevels = ktxTexture->numLevels;
+		imageFormat = format;
+		// Ensure that the TRANSFER_DST bit is set for staging
+		imageUsage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		createImage(firstLevel);
 
-			// Get memory type that can be mapped to host memory
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mipLevels - firstLevel;
+		subresourceRange.layerCount = 1;
 
-			// Allocate host memory
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &mappableMemory));
+		VkCommandBuffer copyCmd = batch.getCommandBuffer();
 
-			// Bind allocated image for use
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, mappableImage, mappableMemory, 0));
+		// Image barrier for optimal image (target)
+		// Optimal image will be used as destination for the copy
+		vks::tools::setImageLayout(
+			copyCmd,
+			image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresourceRange);
 
-			// Get sub resource layout
-			// Mip map count, array layer, etc.
-			VkImageSubresource subRes = {};
-			subRes.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subRes.mipLevel = 0;
+		copyLevels(ktxTexture, firstLevel, mipLevels, firstLevel, batch);
 
-			VkSubresourceLayout subResLayout;
-			void *data;
+		// Change texture image layout to shader read after all mip levels have been copied
+		this->imageLayout = imageLayout;
+		vks::tools::setImageLayout(
+			copyCmd,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			imageLayout,
+			subresourceRange);
 
-			// Get sub resources layout 
-			// Includes row pitch, size offsets, etc.
-			vkGetImageSubresourceLayout(device->logicalDevice, mappableImage, &subRes, &subResLayout);
+		// Sampler covers the whole chain, the image only holds the resident levels
+		createSampler(mipLevels);
+		createView(firstLevel);
+	}
 
-			// Map image memory
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
+	void Texture2D::createImage(uint32_t baseLevel)
+	{
+		// Create optimal tiled target image
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = imageFormat;
+		imageCreateInfo.mipLevels = mipLevels - baseLevel;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { std::max(1u, width >> baseLevel), std::max(1u, height >> baseLevel), 1 };
+		imageCreateInfo.usage = imageUsage;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-			// Copy image data into memory
-			memcpy(data, ktxTextureData, memReqs.size);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 
-			vkUnmapMemory(device->logicalDevice, mappableMemory);
+		memAllocInfo.allocationSize = memReqs.size;
+		memorySize = memReqs.size;
 
-			// Linear tiled images don't need to be staged
-			// and can be directly used as textures
-			image = mappableImage;
-			deviceMemory = mappableMemory;
-			this->imageLayout = imageLayout;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+	}
 
-			// Setup image memory barrier
-			vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
+	VkDeviceSize Texture2D::copyLevels(ktxTexture* ktxTexture, uint32_t beginLevel, uint32_t endLevel, uint32_t imageBaseLevel, vks::UploadBatch &batch)
+	{
+		// Levels are stored finest first, so the range is contiguous
+		ktx_size_t stagedBegin;
+		ktx_size_t stagedLast;
+		KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, beginLevel, 0, 0, &stagedBegin);
+		assert(result == KTX_SUCCESS);
+		result = ktxTexture_GetImageOffset(ktxTexture, endLevel - 1, 0, 0, &stagedLast);
+		assert(result == KTX_SUCCESS);
+		const VkDeviceSize stagedSize = stagedLast + ktxTexture_GetImageSize(ktxTexture, endLevel - 1) - stagedBegin;
+		const vks::UploadBatch::Staging staging = batch.stage(ktxTexture_GetData(ktxTexture) + stagedBegin, stagedSize);
 
-			device->flushCommandBuffer(copyCmd, copyQueue);
+		// Setup buffer copy regions for each staged mip level
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t i = beginLevel; i < endLevel; i++)
+		{
+			ktx_size_t offset;
+			result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+			assert(result == KTX_SUCCESS);
+
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = i - imageBaseLevel;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
+			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = staging.offset + offset - stagedBegin;
+
+			bufferCopyRegions.push_back(bufferCopyRegion);
 		}
 
-		ktxTexture_Destroy(ktxTexture);
+		// Copy mip levels from staging buffer
+		vkCmdCopyBufferToImage(
+			batch.getCommandBuffer(),
+			staging.buffer,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(bufferCopyRegions.size()),
+			bufferCopyRegions.data()
+		);
+		return stagedSize;
+	}
 
+	void Texture2D::createSampler(uint32_t levels)
+	{
 		// Create a default sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
 		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -303,13 +452,18 @@ namespace vks
 		samplerCreateInfo.mipLodBias = 0.0f;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		// Max level-of-detail should match mip level count
-		samplerCreateInfo.maxLod = (useStaging) ? (float)mipLevels : 0.0f;
+		// The view bounds the levels, textures of any level count share the sampler
+		samplerCreateInfo.maxLod = levels > 1 ? VK_LOD_CLAMP_NONE : 0.0f;
 		// Only enable anisotropic filtering if enabled on the device
 		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSampler(samplerCreateInfo);
+	}
+
+	void Texture2D::createView(uint32_t baseLevel)
+	{
+		residentMip = baseLevel;
 
 		// Create image view
 		// Textures are not directly accessed by the shaders and
@@ -318,11 +472,9 @@ namespace vks
 		VkImageViewCreateInfo viewCreateInfo = {};
 		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewCreateInfo.format = format;
+		viewCreateInfo.format = imageFormat;
 		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		// Linear tiling usually won't support mip maps
-		// Only set mip map count if optimal tiling is used
-		viewCreateInfo.subresourceRange.levelCount = (useStaging) ? mipLevels : 1;
+		viewCreateInfo.subresourceRange.levelCount = mipLevels - baseLevel;
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
@@ -422,6 +574,7 @@ namespace vks
 
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		memorySize = memAllocInfo.allocationSize;
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
 		VkImageSubresourceRange subresourceRange = {};
@@ -478,7 +631,7 @@ namespace vks
 		samplerCreateInfo.minLod = 0.0f;
 		samplerCreateInfo.maxLod = 0.0f;
 		samplerCreateInfo.maxAnisotropy = 1.0f;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSampler(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = {};
@@ -603,6 +756,7 @@ namespace vks
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		memorySize = memAllocInfo.allocationSize;
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
 		// Use a separate command buffer for texture loading
@@ -656,9 +810,9 @@ namespace vks
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSampler(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -790,6 +944,7 @@ namespace vks
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		memorySize = memAllocInfo.allocationSize;
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
 		// Use a separate command buffer for texture loading
@@ -843,9 +998,9 @@ namespace vks
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSampler(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
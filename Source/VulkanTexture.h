@@ -28,23 +28,32 @@
 
 namespace vks
 {
+class UploadBatch;
+
 class Texture
 {
   public:
-	vks::VulkanDevice *   device;
-	VkImage               image;
+	vks::VulkanDevice *   device = nullptr;
+	VkImage               image = VK_NULL_HANDLE;
 	VkImageLayout         imageLayout;
-	VkDeviceMemory        deviceMemory;
-	VkImageView           view;
+	VkDeviceMemory        deviceMemory = VK_NULL_HANDLE;
+	VkImageView           view = VK_NULL_HANDLE;
 	uint32_t              width, height;
 	uint32_t              mipLevels;
 	uint32_t              layerCount;
 	VkDescriptorImageInfo descriptor;
-	VkSampler             sampler;
+	VkSampler             sampler = VK_NULL_HANDLE;
+	// Size of deviceMemory, counted against the texture budget (TextureResidency)
+	VkDeviceSize          memorySize = 0;
+	// Finest mip level in the image, > 0 while finer levels are streamed or evicted (Texture2D::setResidentMip)
+	uint32_t              residentMip = 0;
+	// Source of the levels that aren't resident
+	ktxTexture *          streamSource = nullptr;
 
 	void      updateDescriptor();
 	void      destroy();
-	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+	// Reads the whole file, touches no Vulkan objects & is safe on any thread
+	static ktxResult loadKTXFile(std::string filename, ktxTexture **target);
 };
 
 class Texture2D : public Texture
@@ -58,6 +67,30 @@ class Texture2D : public Texture
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 	    bool               forceLinear     = false);
+	// Gpu half of loadFromFile for files read elsewhere (loadKTXFile on a job), takes ownership of ktxTexture
+	void loadFromKtx(
+	    ktxTexture *       ktxTexture,
+	    VkFormat           format,
+	    vks::VulkanDevice *device,
+	    vks::UploadBatch & batch,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Progressive variant of loadFromKtx, only the mips of at most tailSize texels are staged
+	void loadMipTail(
+	    ktxTexture *       ktxTexture,
+	    VkFormat           format,
+	    vks::VulkanDevice *device,
+	    vks::UploadBatch & batch,
+	    uint32_t           tailSize,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Moves a loadMipTail texture to the levels [level, mipLevels) in a new image, replaces view & descriptor, returns the staged bytes
+	VkDeviceSize setResidentMip(uint32_t level, vks::UploadBatch &batch);
+	bool         isStreaming() const { return streamSource != nullptr; }
+	// Bytes of the levels [level, mipLevels) in the stream source
+	VkDeviceSize getLevelsSize(uint32_t level) const;
+	// Coarsest level of the image, resident from loadMipTail on
+	uint32_t     tailMip = 0;
 	void fromBuffer(
 	    void *             buffer,
 	    VkDeviceSize       bufferSize,
@@ -69,6 +102,19 @@ class Texture2D : public Texture
 	    VkFilter           filter          = VK_FILTER_LINEAR,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  private:
+	void createFromKtx(ktxTexture *ktxTexture, VkFormat format, vks::VulkanDevice *device, vks::UploadBatch &batch, uint32_t firstLevel, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout);
+	// Image & memory for the levels [baseLevel, mipLevels), image level 0 is baseLevel
+	void createImage(uint32_t baseLevel);
+	// Stages the levels [beginLevel, endLevel) of ktxTexture into the image (in transfer dst) that starts at imageBaseLevel, returns the staged bytes
+	VkDeviceSize copyLevels(ktxTexture *ktxTexture, uint32_t beginLevel, uint32_t endLevel, uint32_t imageBaseLevel, vks::UploadBatch &batch);
+	void createSampler(uint32_t levels);
+	// View of the whole image, which holds the levels [baseLevel, mipLevels), sets residentMip & the descriptor
+	void createView(uint32_t baseLevel);
+
+	VkFormat          imageFormat = VK_FORMAT_UNDEFINED;
+	VkImageUsageFlags imageUsage = 0;
 };
 
 class Texture2DArray : public Texture
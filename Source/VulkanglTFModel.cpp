@@ -19,7 +19,29 @@
 
 #include "VulkanglTFModel.h"
 
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <future>
 #include <iostream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/gtc/packing.hpp>
+
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+
+// SSSE3 rgb to rgba shuffle, selected at runtime: x86-64 only guarantees SSE2
+#if defined(__x86_64__) || defined(_M_X64)
+#define VKGLTF_SSSE3_EXPANSION
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 
 
@@ -27,6 +49,63 @@ VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+std::shared_ptr<vks::GeometryArena> vkglTF::geometryArena = nullptr;
+std::shared_ptr<vks::MipGenerator> vkglTF::mipGenerator = nullptr;
+
+#if defined(VKGLTF_SSSE3_EXPANSION)
+static bool cpuSupportsSsse3()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// 4 texels per shuffle, the 16 byte load reads 4 bytes past them so the last texels are left to the caller, returns the texels expanded
+#if !defined(_MSC_VER)
+__attribute__((target("ssse3")))
+#endif
+static size_t expandRgbToRgbaSsse3(const unsigned char* src, unsigned char* dst, size_t texelCount)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+	size_t i = 0;
+	for (; i + 6 <= texelCount; i += 4) {
+		const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+	}
+	return i;
+}
+#endif
+
+/*
+	Most devices don't support RGB only on Vulkan, so decoded rgb images are expanded to rgba (opaque) on the loading thread
+*/
+static void expandRgbToRgba(tinygltf::Image& image)
+{
+	const size_t texelCount = static_cast<size_t>(image.width) * static_cast<size_t>(image.height);
+	std::vector<unsigned char> rgba(texelCount * 4);
+	const unsigned char* src = image.image.data();
+	unsigned char* dst = rgba.data();
+	size_t i = 0;
+#if defined(VKGLTF_SSSE3_EXPANSION)
+	static const bool ssse3 = cpuSupportsSsse3();
+	if (ssse3) {
+		i = expandRgbToRgbaSsse3(src, dst, texelCount);
+	}
+#endif
+	for (; i < texelCount; i++) {
+		dst[i * 4 + 0] = src[i * 3 + 0];
+		dst[i * 4 + 1] = src[i * 3 + 1];
+		dst[i * 4 + 2] = src[i * 3 + 2];
+		dst[i * 4 + 3] = 255;
+	}
+	image.image.swap(rgba);
+	image.component = 4;
+}
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
@@ -40,7 +119,13 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	if (!tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData)) {
+		return false;
+	}
+	if (image->component == 3) {
+		expandRgbToRgba(*image);
+	}
+	return true;
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -68,11 +153,12 @@ void vkglTF::Texture::destroy()
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
 		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
-		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		// The sampler belongs to the device's sampler cache
+		sampler = VK_NULL_HANDLE;
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, vks::UploadBatch &batch)
 {
 	this->device = device;
 
@@ -87,105 +173,40 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	VkFormat format;
 
 	if (!isKtx) {
-		// Texture was loaded using STB_Image
-
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		if (gltfimage.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
-			deleteBuffer = true;
-		}
-		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
-		}
+		// Texture was loaded using STB_Image, rgb was expanded by loadImageDataFunc
+		assert(gltfimage.component == 4);
 
 		format = VK_FORMAT_R8G8B8A8_UNORM;
 
-		VkFormatProperties formatProperties;
-
 		width = gltfimage.width;
 		height = gltfimage.height;
 		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
 
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
-
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+		vks::MipGenerator* mipGenerator = batch.getMipGenerator();
+		assert(mipGenerator);
 
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		VkImageCreateInfo imageCreateInfo{};
-		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
 		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageCreateInfo.format = format;
 		imageCreateInfo.mipLevels = mipLevels;
 		imageCreateInfo.arrayLayers = 1;
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | mipGenerator->getRequiredUsage(format);
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
-		subresourceRange.layerCount = 1;
-
-		VkImageMemoryBarrier imageMemoryBarrier{};
-
-		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageMemoryBarrier.srcAccessMask = 0;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageMemoryBarrier.image = image;
-		imageMemoryBarrier.subresourceRange = subresourceRange;
-		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		const vks::UploadBatch::Staging staging = batch.stage(gltfimage.image.data(), gltfimage.image.size());
 
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -195,92 +216,25 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		bufferCopyRegion.imageExtent.width = width;
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = staging.offset;
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		imageMemoryBarrier.image = image;
-		imageMemoryBarrier.subresourceRange = subresourceRange;
-  		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		VkCommandBuffer copyCmd = batch.getCommandBuffer();
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
 		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
-
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-		}
-
-		subresourceRange.levelCount = mipLevels;
+		// Recorded with the chains of every other image of the batch when it's flushed
+		vks::MipGenerator::Chain chain;
+		chain.image = image;
+		chain.format = format;
+		chain.width = width;
+		chain.height = height;
+		chain.mipLevels = mipLevels;
+		chain.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		batch.generateMips(chain);
 		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		imageMemoryBarrier.image = image;
-		imageMemoryBarrier.subresourceRange = subresourceRange;
-		vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-
-        if (deleteBuffer) {
-            delete[] buffer;
-        }
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
 	}
 	else {
 		// Texture is stored in an external ktx file
@@ -319,33 +273,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
 		format = VK_FORMAT_R8G8B8A8_UNORM;
 
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		const vks::UploadBatch::Staging staging = batch.stage(ktxTextureData, ktxTextureSize);
 
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
 		for (uint32_t i = 0; i < mipLevels; i++)
@@ -361,7 +289,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
 			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
 			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegion.bufferOffset = staging.offset + offset;
 			bufferCopyRegions.push_back(bufferCopyRegion);
 		}
 
@@ -379,6 +307,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -391,15 +321,13 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		subresourceRange.levelCount = mipLevels;
 		subresourceRange.layerCount = 1;
 
+		VkCommandBuffer copyCmd = batch.getCommandBuffer();
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-
+		// Staged, the data isn't needed until the batch is flushed
 		ktxTexture_Destroy(ktxTexture);
 	}
 
@@ -415,10 +343,11 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 	samplerInfo.maxAnisotropy = 1.0;
 	samplerInfo.anisotropyEnable = VK_FALSE;
-	samplerInfo.maxLod = (float)mipLevels;
+	// The view bounds the levels, images of any level count share the sampler
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 	samplerInfo.maxAnisotropy = 8.0f;
 	samplerInfo.anisotropyEnable = VK_TRUE;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &sampler));
+	sampler = device->getSampler(samplerInfo);
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -570,11 +499,56 @@ VkVertexInputBindingDescription vkglTF::Vertex::vertexInputBindingDescription;
 std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttributeDescriptions;
 VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
 
-VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding) {
-	return VkVertexInputBindingDescription({ binding, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX });
+uint32_t vkglTF::Vertex::stride(VertexFormat format) {
+	switch (format) {
+		case VertexFormat::Compact:
+			return sizeof(CompactVertex);
+		case VertexFormat::CompactSkinned:
+			return sizeof(CompactSkinnedVertex);
+		default:
+			return sizeof(Vertex);
+	}
+}
+
+uint32_t vkglTF::Vertex::positionStride(VertexFormat format) {
+	return format == VertexFormat::Full ? sizeof(glm::vec3) : sizeof(CompactVertex::pos);
 }
 
-VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) {
+VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding, VertexFormat format) {
+	return VkVertexInputBindingDescription({ binding, stride(format), VK_VERTEX_INPUT_RATE_VERTEX });
+}
+
+VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component, VertexFormat format) {
+	if (format != VertexFormat::Full) {
+		// Compact components are decoded in the vertex shader (see util/vertex.glsl)
+		const uint32_t base = format == VertexFormat::CompactSkinned ? offsetof(CompactSkinnedVertex, base) : 0;
+		switch (component) {
+			case VertexComponent::Position:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16B16A16_UNORM, base + offsetof(CompactVertex, pos) });
+			case VertexComponent::Normal:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SNORM, base + offsetof(CompactVertex, normal) });
+			case VertexComponent::UV:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SFLOAT, base + offsetof(CompactVertex, uv) });
+			case VertexComponent::Color:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_UNORM, base + offsetof(CompactVertex, color) });
+			case VertexComponent::Tangent:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SNORM, base + offsetof(CompactVertex, tangent) });
+			case VertexComponent::Joint0:
+				if (format == VertexFormat::CompactSkinned) {
+					return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_USCALED, offsetof(CompactSkinnedVertex, joint0) });
+				}
+				break;
+			case VertexComponent::Weight0:
+				if (format == VertexFormat::CompactSkinned) {
+					return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactSkinnedVertex, weight0) });
+				}
+				break;
+			default:
+				break;
+		}
+		vks::tools::exitFatal("Vertex component is not part of the compact vertex layout", -1);
+		return VkVertexInputAttributeDescription({});
+	}
 	switch (component) {
 		case VertexComponent::Position: 
 			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) });
@@ -595,20 +569,33 @@ VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint
 	}
 }
 
-std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) {
+std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components, VertexFormat format) {
 	std::vector<VkVertexInputAttributeDescription> result;
 	uint32_t location = 0;
 	for (VertexComponent component : components) {
-		result.push_back(Vertex::inputAttributeDescription(binding, location, component));
+		result.push_back(Vertex::inputAttributeDescription(binding, location, component, format));
 		location++;
 	}
 	return result;
 }
 
 /** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
-VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components) {
-	vertexInputBindingDescription = Vertex::inputBindingDescription(0);
-	Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components);
+VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components, VertexFormat format) {
+	vertexInputBindingDescription = Vertex::inputBindingDescription(0, format);
+	Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components, format);
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &Vertex::vertexInputBindingDescription;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(Vertex::vertexInputAttributeDescriptions.size());
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = Vertex::vertexInputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
+VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelinePositionInputState(VertexFormat format) {
+	vertexInputBindingDescription = VkVertexInputBindingDescription({ 0, positionStride(format), VK_VERTEX_INPUT_RATE_VERTEX });
+	Vertex::vertexInputAttributeDescriptions = {
+		VkVertexInputAttributeDescription({ 0, 0, format == VertexFormat::Full ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R16G16B16A16_UNORM, 0 })
+	};
 	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
 	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &Vertex::vertexInputBindingDescription;
@@ -617,6 +604,194 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
+namespace
+{
+	int16_t packSnorm16(float v) {
+		return static_cast<int16_t>(std::round(glm::clamp(v, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	// Octahedral unit vector encoding. A Survey of Efficient Representations for Independent Unit Vectors. Cigolle et al. 2014
+	void packOctahedral(glm::vec3 n, int16_t out[2]) {
+		const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		glm::vec2 p = l1 > 0.0f ? glm::vec2(n.x, n.y) / l1 : glm::vec2(0.0f);
+		if (n.z < 0.0f) {
+			const glm::vec2 signNotZero(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+			p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signNotZero;
+		}
+		out[0] = packSnorm16(p.x);
+		out[1] = packSnorm16(p.y);
+	}
+
+	void quantizeVertex(const vkglTF::Vertex& vertex, const vkglTF::Model::Dequantization& dequantization, vkglTF::CompactVertex& out) {
+		const glm::vec3 unorm = glm::clamp((vertex.pos - dequantization.offset) / dequantization.scale, 0.0f, 1.0f);
+		for (int i = 0; i < 3; i++) {
+			out.pos[i] = static_cast<uint16_t>(std::round(unorm[i] * 65535.0f));
+		}
+		out.pos[3] = vertex.tangent.w < 0.0f ? 0 : 65535;
+		packOctahedral(vertex.normal, out.normal);
+		packOctahedral(glm::vec3(vertex.tangent), out.tangent);
+		out.uv[0] = glm::packHalf1x16(vertex.uv.x);
+		out.uv[1] = glm::packHalf1x16(vertex.uv.y);
+		for (int i = 0; i < 4; i++) {
+			out.color[i] = static_cast<uint8_t>(std::round(glm::clamp(vertex.color[i], 0.0f, 1.0f) * 255.0f));
+		}
+	}
+
+	// Vertices & indices converted per worker, ranges below this stay on the calling thread
+	constexpr size_t CONVERSION_CHUNK_SIZE = 16384;
+
+	// Splits [0, count) into chunks run on worker threads, function(begin, end)
+	template <typename Function>
+	void parallelFor(size_t count, Function function) {
+		const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+		const size_t chunkSize = std::max(CONVERSION_CHUNK_SIZE, (count + threadCount - 1) / threadCount);
+		if (count <= chunkSize) {
+			function(size_t(0), count);
+			return;
+		}
+		std::vector<std::future<void>> chunks;
+		for (size_t begin = chunkSize; begin < count; begin += chunkSize) {
+			const size_t end = std::min(count, begin + chunkSize);
+			chunks.push_back(std::async(std::launch::async, [&function, begin, end]() { function(begin, end); }));
+		}
+		function(size_t(0), chunkSize);
+		for (auto& chunk : chunks) {
+			chunk.get();
+		}
+	}
+
+	/*
+		Read only strided view of an accessor's elements in place in their buffer
+		Handles interleaved buffer views (byteStride) & integer / normalized component types
+	*/
+	struct AccessorView {
+		const unsigned char* data = nullptr;
+		size_t stride = 0;
+		size_t count = 0;
+		int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		int components = 0;
+		bool normalized = false;
+
+		AccessorView() = default;
+		// Empty for sparse only accessors & ranges outside of their buffer
+		AccessorView(const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
+			if (accessor.bufferView < 0) {
+				return;
+			}
+			const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+			const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+			const int byteStride = accessor.ByteStride(bufferView);
+			const int componentSize = tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+			components = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+			if (byteStride <= 0 || componentSize <= 0 || components <= 0) {
+				return;
+			}
+			const size_t offset = bufferView.byteOffset + accessor.byteOffset;
+			const size_t elementSize = static_cast<size_t>(componentSize) * components;
+			if (accessor.count > 0 && offset + (accessor.count - 1) * static_cast<size_t>(byteStride) + elementSize > buffer.data.size()) {
+				return;
+			}
+			data = buffer.data.data() + offset;
+			stride = static_cast<size_t>(byteStride);
+			count = accessor.count;
+			componentType = accessor.componentType;
+			normalized = accessor.normalized;
+		}
+
+		bool valid() const { return data != nullptr; }
+
+		// Up to 4 components of element i, components the accessor doesn't have are left untouched
+		void read(size_t i, float* out, int outComponents) const {
+			const unsigned char* element = data + i * stride;
+			const int n = std::min(components, outComponents);
+			if (componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+				memcpy(out, element, n * sizeof(float));
+				return;
+			}
+			for (int c = 0; c < n; c++) {
+				out[c] = component(element, c);
+			}
+		}
+
+		// Index buffers are unsigned byte, short or int
+		uint32_t index(size_t i) const {
+			const unsigned char* element = data + i * stride;
+			switch (componentType) {
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+					uint32_t value;
+					memcpy(&value, element, sizeof(value));
+					return value;
+				}
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+					uint16_t value;
+					memcpy(&value, element, sizeof(value));
+					return value;
+				}
+				default:
+					return element[0];
+			}
+		}
+
+	private:
+		float component(const unsigned char* element, int c) const {
+			switch (componentType) {
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+					const uint8_t value = element[c];
+					return normalized ? value / 255.0f : static_cast<float>(value);
+				}
+				case TINYGLTF_COMPONENT_TYPE_BYTE: {
+					const int8_t value = static_cast<int8_t>(element[c]);
+					return normalized ? std::max(value / 127.0f, -1.0f) : static_cast<float>(value);
+				}
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+					uint16_t value;
+					memcpy(&value, element + c * sizeof(value), sizeof(value));
+					return normalized ? value / 65535.0f : static_cast<float>(value);
+				}
+				case TINYGLTF_COMPONENT_TYPE_SHORT: {
+					int16_t value;
+					memcpy(&value, element + c * sizeof(value), sizeof(value));
+					return normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+				}
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+					uint32_t value;
+					memcpy(&value, element + c * sizeof(value), sizeof(value));
+					return static_cast<float>(value);
+				}
+				default: {
+					float value;
+					memcpy(&value, element + c * sizeof(value), sizeof(value));
+					return value;
+				}
+			}
+		}
+	};
+
+	AccessorView attributeView(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const char* attribute) {
+		const auto it = primitive.attributes.find(attribute);
+		return it != primitive.attributes.end() ? AccessorView(model, model.accessors[it->second]) : AccessorView();
+	}
+
+	// Vertex & index counts loadNode will emit for a node & its children
+	void countNodeGeometry(const tinygltf::Model& model, int nodeIndex, size_t& vertexCount, size_t& indexCount) {
+		const tinygltf::Node& node = model.nodes[nodeIndex];
+		for (int child : node.children) {
+			countNodeGeometry(model, child, vertexCount, indexCount);
+		}
+		if (node.mesh < 0) {
+			return;
+		}
+		for (const tinygltf::Primitive& primitive : model.meshes[node.mesh].primitives) {
+			const auto position = primitive.attributes.find("POSITION");
+			if (primitive.indices < 0 || position == primitive.attributes.end()) {
+				continue;
+			}
+			vertexCount += model.accessors[position->second].count;
+			indexCount += model.accessors[primitive.indices].count;
+		}
+	}
+}
+
 vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 {
 
@@ -626,7 +801,7 @@ vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 	return nullptr;
 }
 
-void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
+void vkglTF::Model::createEmptyTexture(vks::UploadBatch& batch)
 {
 	emptyTexture.device = device;
 	emptyTexture.width = 1;
@@ -634,32 +809,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	emptyTexture.layerCount = 1;
 	emptyTexture.mipLevels = 1;
 
-	size_t bufferSize = emptyTexture.width * emptyTexture.height * 4;
-	unsigned char* buffer = new unsigned char[bufferSize];
-	memset(buffer, 0, bufferSize);
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	const uint8_t buffer[4] = {};
+	const vks::UploadBatch::Staging staging = batch.stage(buffer, sizeof(buffer));
 
 	VkBufferImageCopy bufferCopyRegion = {};
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -667,6 +818,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	bufferCopyRegion.imageExtent.width = emptyTexture.width;
 	bufferCopyRegion.imageExtent.height = emptyTexture.height;
 	bufferCopyRegion.imageExtent.depth = 1;
+	bufferCopyRegion.bufferOffset = staging.offset;
 
 	// Create optimal tiled target image
 	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -682,6 +834,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
+	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+	VkMemoryRequirements memReqs;
 	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
 	memAllocInfo.allocationSize = memReqs.size;
 	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -694,17 +848,12 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
 
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	VkCommandBuffer copyCmd = batch.getCommandBuffer();
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Clean up staging resources
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
@@ -714,7 +863,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 	samplerCreateInfo.maxAnisotropy = 1.0f;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &emptyTexture.sampler));
+	emptyTexture.sampler = device->getSampler(samplerCreateInfo);
 
 	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
 	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -732,12 +881,21 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 /*
 	glTF model loading and rendering class
 */
+vkglTF::Model::Model()
+{
+}
+
 vkglTF::Model::~Model()
 {
-	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	if (arena) {
+		arena->release(arenaAllocation);
+	}
+	else {
+		vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	}
 	for (auto texture : textures) {
 		texture.destroy();
 	}
@@ -800,7 +958,7 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 
 	// Node contains mesh data
 	if (node.mesh > -1) {
-		const tinygltf::Mesh mesh = model.meshes[node.mesh];
+		const tinygltf::Mesh &mesh = model.meshes[node.mesh];
 		Mesh *newMesh = new Mesh(device, newNode->matrix);
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
@@ -808,142 +966,91 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			if (primitive.indices < 0) {
 				continue;
 			}
-			uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
-			uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-			uint32_t indexCount = 0;
-			uint32_t vertexCount = 0;
-			glm::vec3 posMin{};
-			glm::vec3 posMax{};
-			bool hasSkin = false;
-			// Vertices
-			{
-				const float *bufferPos = nullptr;
-				const float *bufferNormals = nullptr;
-				const float *bufferTexCoords = nullptr;
-				const float* bufferColors = nullptr;
-				const float *bufferTangents = nullptr;
-				uint32_t numColorComponents;
-				const uint16_t *bufferJoints = nullptr;
-				const float *bufferWeights = nullptr;
-
-				// Position attribute is required
-				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-					// Color buffer are either of type vec3 or vec4
-					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-				}
+			// Position attribute is required
+			const AccessorView positions = attributeView(model, primitive, "POSITION");
+			const tinygltf::Accessor &indexAccessor = model.accessors[primitive.indices];
+			const AccessorView indexView(model, indexAccessor);
+			if (!positions.valid() || !indexView.valid()) {
+				std::cerr << "Primitive of mesh \"" << mesh.name << "\" has no readable positions or indices, skipped" << std::endl;
+				continue;
+			}
+			if (indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT && indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+				&& indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+				std::cerr << "Index component type " << indexAccessor.componentType << " not supported!" << std::endl;
+				continue;
+			}
 
-				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
-				}
+			const uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
+			const uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
+			const uint32_t vertexCount = static_cast<uint32_t>(positions.count);
+			const uint32_t indexCount = static_cast<uint32_t>(indexView.count);
 
+			// Vertices, converted in place from the accessors
+			{
+				const AccessorView normals = attributeView(model, primitive, "NORMAL");
+				const AccessorView texCoords = attributeView(model, primitive, "TEXCOORD_0");
+				const AccessorView colors = attributeView(model, primitive, "COLOR_0");
+				const AccessorView tangents = attributeView(model, primitive, "TANGENT");
 				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
-
-				hasSkin = (bufferJoints && bufferWeights);
-
-				vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-					if (bufferColors) {
-						switch (numColorComponents) {
-							case 3: 
-								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-							case 4:
-								vert.color = glm::make_vec4(&bufferColors[v * 4]);
+				const AccessorView joints = attributeView(model, primitive, "JOINTS_0");
+				const AccessorView weights = attributeView(model, primitive, "WEIGHTS_0");
+				const bool hasSkin = joints.valid() && weights.valid();
+
+				vertexBuffer.resize(vertexStart + vertexCount);
+				Vertex* vertices = vertexBuffer.data() + vertexStart;
+				parallelFor(vertexCount, [&](size_t begin, size_t end) {
+					for (size_t v = begin; v < end; v++) {
+						Vertex& vert = vertices[v];
+						vert = Vertex{};
+						positions.read(v, &vert.pos.x, 3);
+						if (normals.valid()) {
+							normals.read(v, &vert.normal.x, 3);
+							vert.normal = glm::normalize(vert.normal);
 						}
-					}
-					else {
+						if (texCoords.valid()) {
+							texCoords.read(v, &vert.uv.x, 2);
+						}
+						// Color buffer are either of type vec3 or vec4
 						vert.color = glm::vec4(1.0f);
+						if (colors.valid()) {
+							colors.read(v, &vert.color.x, 4);
+						}
+						if (tangents.valid()) {
+							tangents.read(v, &vert.tangent.x, 4);
+						}
+						if (hasSkin) {
+							joints.read(v, &vert.joint0.x, 4);
+							weights.read(v, &vert.weight0.x, 4);
+						}
 					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-					vertexBuffer.push_back(vert);
-				}
+				});
 			}
 			// Indices
 			{
-				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
-
-				indexCount = static_cast<uint32_t>(accessor.count);
-
-				switch (accessor.componentType) {
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
+				indexBuffer.resize(indexStart + indexCount);
+				uint32_t* indices = indexBuffer.data() + indexStart;
+				parallelFor(indexCount, [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++) {
+						indices[i] = indexView.index(i) + vertexStart;
 					}
-                    delete[] buf;
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				default:
-					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-					return;
+				});
+			}
+
+			// Bounds from the accessor, computed when the optional min & max are missing
+			const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+			glm::vec3 posMin(FLT_MAX);
+			glm::vec3 posMax(-FLT_MAX);
+			if (posAccessor.minValues.size() >= 3 && posAccessor.maxValues.size() >= 3) {
+				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+			}
+			else {
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					posMin = glm::min(posMin, vertexBuffer[vertexStart + v].pos);
+					posMax = glm::max(posMax, vertexBuffer[vertexStart + v].pos);
 				}
 			}
+
 			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
 			newPrimitive->firstVertex = vertexStart;
 			newPrimitive->vertexCount = vertexCount;
@@ -992,16 +1099,16 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, vks::UploadBatch &batch)
 {
 	for (tinygltf::Image &image : gltfModel.images) {
 		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
+		texture.fromglTfImage(image, path, device, batch);
 		texture.index = static_cast<uint32_t>(textures.size());
 		textures.push_back(texture);
 	}
 	// Create an empty texture to be used for empty material images
-	createEmptyTexture(transferQueue);
+	createEmptyTexture(batch);
 }
 
 void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
@@ -1168,7 +1275,376 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 	}
 }
 
+void vkglTF::Model::optimizeGeometry(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer)
+{
+	const vks::optimizer::VertexCacheStatistics before = vks::optimizer::analyzeVertexCache(indexBuffer.data(), indexBuffer.size(), vertexBuffer.size());
+	optimizationStatistics.vertexCountBefore = static_cast<uint32_t>(vertexBuffer.size());
+	optimizationStatistics.acmrBefore = before.acmr;
+	optimizationStatistics.atvrBefore = before.atvr;
+
+	std::vector<Vertex> optimizedVertices;
+	optimizedVertices.reserve(vertexBuffer.size());
+	std::vector<uint32_t> remap;
+	std::vector<uint32_t> localIndices;
+	std::vector<uint32_t> reordered;
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		// Primitives own their vertex range, they are optimized separately & keep their index range
+		for (Primitive* primitive : node->mesh->primitives) {
+			uint32_t* primitiveIndices = indexBuffer.data() + primitive->firstIndex;
+			const Vertex* primitiveVertices = vertexBuffer.data() + primitive->firstVertex;
+
+			// Dedup
+			const size_t uniqueCount = vks::optimizer::generateVertexRemap(remap, primitiveVertices, primitive->vertexCount, sizeof(Vertex));
+			std::vector<Vertex> uniqueVertices(uniqueCount);
+			for (uint32_t v = 0; v < primitive->vertexCount; v++) {
+				uniqueVertices[remap[v]] = primitiveVertices[v];
+			}
+			localIndices.resize(primitive->indexCount);
+			for (uint32_t i = 0; i < primitive->indexCount; i++) {
+				localIndices[i] = remap[primitiveIndices[i] - primitive->firstVertex];
+			}
+
+			// Triangle order, only for triangle lists
+			if (primitive->indexCount > 0 && primitive->indexCount % 3 == 0) {
+				reordered.resize(localIndices.size());
+				vks::optimizer::optimizeVertexCache(reordered.data(), localIndices.data(), localIndices.size(), uniqueCount);
+				vks::optimizer::optimizeOverdraw(localIndices.data(), reordered.data(), reordered.size(), &uniqueVertices[0].pos.x, uniqueCount, sizeof(Vertex));
+			}
+
+			// Vertex order
+			const size_t fetchedCount = vks::optimizer::optimizeVertexFetchRemap(remap, localIndices.data(), localIndices.size(), uniqueCount);
+			const uint32_t firstVertex = static_cast<uint32_t>(optimizedVertices.size());
+			optimizedVertices.resize(optimizedVertices.size() + fetchedCount);
+			for (size_t v = 0; v < uniqueCount; v++) {
+				if (remap[v] != ~0u) {
+					optimizedVertices[firstVertex + remap[v]] = uniqueVertices[v];
+				}
+			}
+			for (uint32_t i = 0; i < primitive->indexCount; i++) {
+				primitiveIndices[i] = remap[localIndices[i]] + firstVertex;
+			}
+			primitive->firstVertex = firstVertex;
+			primitive->vertexCount = static_cast<uint32_t>(fetchedCount);
+		}
+	}
+	vertexBuffer = std::move(optimizedVertices);
+
+	const vks::optimizer::VertexCacheStatistics after = vks::optimizer::analyzeVertexCache(indexBuffer.data(), indexBuffer.size(), vertexBuffer.size());
+	optimizationStatistics.vertexCountAfter = static_cast<uint32_t>(vertexBuffer.size());
+	optimizationStatistics.acmrAfter = after.acmr;
+	optimizationStatistics.atvrAfter = after.atvr;
+}
+
+void vkglTF::Model::generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, bool optimizeLods)
+{
+	// Each level halves the triangles, primitives stop below LOD_MIN_TRIANGLES
+	const float LOD_REDUCTION = 0.5f;
+	const uint32_t LOD_MIN_TRIANGLES = 32;
+	// Relative to the primitive's extent, coarser simplifications are not taken
+	const float LOD_MAX_ERROR = 0.1f;
+	// Normal & uv drift, positions are normalized to the primitive's extent
+	const float attributeWeights[5] = { 0.5f, 0.5f, 0.5f, 0.25f, 0.25f };
+
+	std::vector<Primitive*> primitives;
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			primitives.insert(primitives.end(), node->mesh->primitives.begin(), node->mesh->primitives.end());
+		}
+	}
+
+	// Simplification errors add up over the chain
+	std::vector<float> primitiveErrors(primitives.size(), 0.0f);
+	std::vector<uint32_t> localIndices;
+	std::vector<uint32_t> simplified;
+	std::vector<uint32_t> reordered;
+	for (uint32_t level = 1; level < MAX_LOD_COUNT; level++) {
+		const uint32_t levelFirst = static_cast<uint32_t>(indexBuffer.size());
+		float levelError = lods.back().error;
+		bool simplifiedAny = false;
+		for (size_t p = 0; p < primitives.size(); p++) {
+			Primitive* primitive = primitives[p];
+			const Primitive::Lod source = primitive->lods.back();
+			localIndices.resize(source.indexCount);
+			for (uint32_t i = 0; i < source.indexCount; i++) {
+				localIndices[i] = indexBuffer[source.firstIndex + i] - primitive->firstVertex;
+			}
+
+			size_t resultCount = source.indexCount;
+			const uint32_t triangleCount = source.indexCount / 3;
+			if (source.indexCount % 3 == 0 && triangleCount > LOD_MIN_TRIANGLES) {
+				const Vertex* primitiveVertices = vertexBuffer.data() + primitive->firstVertex;
+				glm::vec3 posMin(FLT_MAX);
+				glm::vec3 posMax(-FLT_MAX);
+				for (uint32_t index : localIndices) {
+					posMin = glm::min(posMin, primitiveVertices[index].pos);
+					posMax = glm::max(posMax, primitiveVertices[index].pos);
+				}
+				const glm::vec3 extent = posMax - posMin;
+
+				float error = 0.0f;
+				const size_t targetCount = static_cast<size_t>(static_cast<float>(triangleCount) * LOD_REDUCTION) * 3;
+				simplified.resize(localIndices.size());
+				const size_t count = vks::optimizer::simplify(simplified.data(), localIndices.data(), localIndices.size(),
+					&primitiveVertices[0].pos.x, primitive->vertexCount, sizeof(Vertex),
+					&primitiveVertices[0].normal.x, sizeof(Vertex), attributeWeights, 5,
+					targetCount, LOD_MAX_ERROR, &error);
+				// Mostly locked (borders, seams) or out of error budget, the previous level is reused
+				if (count > 0 && count * 20 <= localIndices.size() * 17) {
+					resultCount = count;
+					simplifiedAny = true;
+					primitiveErrors[p] += error * std::max(extent.x, std::max(extent.y, extent.z));
+					if (optimizeLods) {
+						reordered.resize(count);
+						vks::optimizer::optimizeVertexCache(reordered.data(), simplified.data(), count, primitive->vertexCount);
+						std::swap(simplified, reordered);
+					}
+					localIndices.assign(simplified.begin(), simplified.begin() + count);
+				}
+			}
+
+			primitive->lods.push_back({ static_cast<uint32_t>(indexBuffer.size()), static_cast<uint32_t>(resultCount) });
+			for (uint32_t index : localIndices) {
+				indexBuffer.push_back(index + primitive->firstVertex);
+			}
+			levelError = std::max(levelError, primitiveErrors[p]);
+		}
+
+		// Nothing left to simplify, drop the copy
+		if (!simplifiedAny) {
+			indexBuffer.resize(levelFirst);
+			for (Primitive* primitive : primitives) {
+				primitive->lods.pop_back();
+			}
+			break;
+		}
+		lods.push_back({ levelFirst, static_cast<uint32_t>(indexBuffer.size()) - levelFirst, levelError });
+	}
+}
+
+void vkglTF::Model::buildMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+{
+	std::vector<Primitive*> primitives;
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			primitives.insert(primitives.end(), node->mesh->primitives.begin(), node->mesh->primitives.end());
+		}
+	}
+
+	meshlets.clear();
+	std::vector<vks::optimizer::Meshlet> primitiveMeshlets;
+	std::vector<uint32_t> localIndices;
+	for (size_t level = 0; level < lods.size(); level++) {
+		lods[level].firstMeshlet = static_cast<uint32_t>(meshlets.size());
+		for (Primitive* primitive : primitives) {
+			const Primitive::Lod& range = primitive->lods[level];
+			// Culled draws only cover meshlets, everything must be in one
+			if (range.indexCount % 3 != 0) {
+				std::cerr << "Model " << path << ": primitive is not a triangle list, no meshlets built" << std::endl;
+				meshlets.clear();
+				for (Lod& lod : lods) {
+					lod.firstMeshlet = 0;
+					lod.meshletCount = 0;
+				}
+				return;
+			}
+			localIndices.resize(range.indexCount);
+			for (uint32_t i = 0; i < range.indexCount; i++) {
+				localIndices[i] = indexBuffer[range.firstIndex + i] - primitive->firstVertex;
+			}
+
+			const Vertex* primitiveVertices = vertexBuffer.data() + primitive->firstVertex;
+			vks::optimizer::buildMeshlets(primitiveMeshlets, localIndices.data(), localIndices.size(), primitive->vertexCount);
+			for (const vks::optimizer::Meshlet& meshlet : primitiveMeshlets) {
+				const vks::optimizer::MeshletBounds bounds = vks::optimizer::computeMeshletBounds(localIndices.data() + meshlet.firstIndex, meshlet.indexCount,
+					&primitiveVertices[0].pos.x, &primitiveVertices[0].normal.x, primitive->vertexCount, sizeof(Vertex));
+				meshlets.push_back({
+					range.firstIndex + meshlet.firstIndex,
+					meshlet.indexCount,
+					glm::vec4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius),
+					glm::vec4(bounds.coneAxis[0], bounds.coneAxis[1], bounds.coneAxis[2], bounds.coneCutoff) });
+			}
+		}
+		lods[level].meshletCount = static_cast<uint32_t>(meshlets.size()) - lods[level].firstMeshlet;
+	}
+}
+
+namespace
+{
+	// Sections of a cooked model file, in file order
+	enum class CookedSection : uint32_t {
+		Model,
+		Strings,
+		Dependencies,
+		Images,
+		Materials,
+		Nodes,
+		Primitives,
+		PrimitiveLods,
+		Lods,
+		Meshlets,
+		Vertices,
+		Indices,
+		Positions,
+		PositionIndices,
+		CpuPositions,
+		CpuIndices,
+		Count
+	};
+
+	// Range in the strings section
+	struct CookedString {
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct CookedModel {
+		uint32_t vertexFormat;
+		uint32_t vertexCount;
+		uint32_t vertexStride;
+		uint32_t indexType;
+		// LOD0 & every level
+		uint32_t indexCount;
+		uint32_t indexTotal;
+		// 0 without a position stream
+		uint32_t positionCount;
+		uint32_t positionStride;
+		uint32_t metallicRoughnessWorkflow;
+		float dequantizationScale[3];
+		float dequantizationOffset[3];
+	};
+
+	// External buffer or image, the cooked file is stale once its size or write time changes
+	struct CookedDependency {
+		CookedString uri;
+		uint64_t stamp;
+	};
+
+	// Material textures are image indices or one of these
+	constexpr int32_t COOKED_NO_TEXTURE = -1;
+	constexpr int32_t COOKED_EMPTY_TEXTURE = -2;
+
+	struct CookedMaterial {
+		uint32_t alphaMode;
+		float alphaCutoff;
+		float metallicFactor;
+		float roughnessFactor;
+		float baseColorFactor[4];
+		int32_t baseColorTexture;
+		int32_t metallicRoughnessTexture;
+		int32_t normalTexture;
+		int32_t occlusionTexture;
+		int32_t emissiveTexture;
+	};
+
+	// In Model::linearNodes order, children come before their parent
+	struct CookedNode {
+		int32_t parent;
+		uint32_t index;
+		CookedString name;
+		float matrix[16];
+		float translation[3];
+		float scale[3];
+		float rotation[4];
+		uint32_t hasMesh;
+		CookedString meshName;
+		uint32_t firstPrimitive;
+		uint32_t primitiveCount;
+	};
+
+	struct CookedPrimitive {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t material;
+		// Range in the primitive lods section
+		uint32_t firstLod;
+		uint32_t lodCount;
+		float min[3];
+		float max[3];
+	};
+
+	template <typename T>
+	bool cookedSection(const vks::meshcache::Reader& reader, CookedSection section, const T*& data, size_t& count) {
+		return reader.section(static_cast<uint32_t>(section), data, count);
+	}
+
+	std::string cookedString(const char* strings, size_t stringsSize, CookedString string) {
+		if (static_cast<size_t>(string.offset) + string.length > stringsSize) {
+			return std::string();
+		}
+		return std::string(strings + string.offset, string.length);
+	}
+
+	// Loading flags, scale & the layouts of everything stored
+	uint64_t cookedSettingsHash(uint32_t fileLoadingFlags, float scale) {
+		const uint32_t settings[] = {
+			fileLoadingFlags & ~static_cast<uint32_t>(vkglTF::FileLoadingFlags::CookedCache),
+			sizeof(CookedModel),
+			sizeof(CookedDependency),
+			sizeof(CookedMaterial),
+			sizeof(CookedNode),
+			sizeof(CookedPrimitive),
+			sizeof(vkglTF::Primitive::Lod),
+			sizeof(vkglTF::Model::Lod),
+			sizeof(vkglTF::Model::Meshlet),
+			sizeof(vkglTF::Vertex),
+			sizeof(vkglTF::CompactVertex)
+		};
+		return vks::meshcache::hash(&scale, sizeof(scale), vks::meshcache::hash(settings, sizeof(settings)));
+	}
+
+	// Next to the source, one file per setting
+	std::string cookedFilename(const std::string& filename, uint64_t settingsHash) {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx.meshcache", static_cast<unsigned long long>(settingsHash));
+		return filename + suffix;
+	}
+
+	// Static models whose loaded images are files of their own
+	bool isCookable(const tinygltf::Model& gltfModel, uint32_t fileLoadingFlags) {
+		if (!gltfModel.skins.empty() || !gltfModel.animations.empty()) {
+			return false;
+		}
+		if (!(fileLoadingFlags & vkglTF::FileLoadingFlags::DontLoadImages)) {
+			for (const tinygltf::Image& image : gltfModel.images) {
+				if (image.uri.empty() || image.uri.rfind("data:", 0) == 0) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+struct vkglTF::Model::PendingUpload {
+	std::string arenaKey;
+	bool loadImages = false;
+	// Decoded images (or the uri of ktx ones), one per entry of textures
+	std::vector<tinygltf::Image> images;
+	GeometryUpload geometry;
+	// What geometry points to, owned for glTF imports, the mapped file for cooked ones
+	std::vector<Vertex> vertexBuffer;
+	std::vector<CompactVertex> compactVertices;
+	std::vector<CompactSkinnedVertex> compactSkinnedVertices;
+	std::vector<uint32_t> indexBuffer;
+	std::vector<uint16_t> indexBuffer16;
+	std::vector<uint8_t> positionData;
+	std::vector<uint32_t> positionIndices;
+	std::vector<uint16_t> positionIndices16;
+	vks::meshcache::Reader cooked;
+};
+
 void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+{
+	importFile(filename, device, fileLoadingFlags, scale);
+	upload(transferQueue);
+}
+
+void vkglTF::Model::importFile(std::string filename, vks::VulkanDevice *device, uint32_t fileLoadingFlags, float scale)
 {
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
@@ -1194,19 +1670,57 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+	pending = std::make_unique<PendingUpload>();
+	// Loading flags & scale change the vertex data, identical loads share one allocation
+	pending->arenaKey = filename + "|" + std::to_string(fileLoadingFlags & ~static_cast<uint32_t>(FileLoadingFlags::CookedCache)) + "|" + std::to_string(scale);
+	pending->loadImages = !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
 
-	std::vector<uint32_t> indexBuffer;
-	std::vector<Vertex> vertexBuffer;
+#if defined(__ANDROID__)
+	// Assets are read through the asset manager, there is nothing to map or write next to them
+	const bool cookedCache = false;
+#else
+	const bool cookedCache = fileLoadingFlags & FileLoadingFlags::CookedCache;
+#endif
+	const uint64_t settingsHash = cookedSettingsHash(fileLoadingFlags, scale);
+	const std::string cookedFile = cookedFilename(filename, settingsHash);
+	if (cookedCache) {
+		if (loadCooked(filename, cookedFile, settingsHash)) {
+			getSceneDimensions();
+			return;
+		}
+		// A rejected file is rewritten below, it can't stay mapped
+		pending->cooked.close();
+	}
+
+	// Binary glTF by extension, its buffers are read in one go with the file
+	std::string extension = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	const bool binary = extension == "glb";
+	bool fileLoaded = binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning, filename) : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+
+	std::vector<uint32_t>& indexBuffer = pending->indexBuffer;
+	std::vector<Vertex>& vertexBuffer = pending->vertexBuffer;
 
 	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
+		if (pending->loadImages) {
+			// Images are decoded by now & created on upload, materials point into the sized list
+			textures.resize(gltfModel.images.size());
+			for (size_t i = 0; i < textures.size(); i++) {
+				textures[i].index = static_cast<uint32_t>(i);
+			}
 		}
 		loadMaterials(gltfModel);
 		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+		// Primitives are converted in place, sized once for the whole scene
+		size_t vertexTotal = 0;
+		size_t indexTotal = 0;
+		for (int nodeIndex : scene.nodes) {
+			countNodeGeometry(gltfModel, nodeIndex, vertexTotal, indexTotal);
+		}
+		vertexBuffer.reserve(vertexTotal);
+		indexBuffer.reserve(indexTotal);
 		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+			const tinygltf::Node &node = gltfModel.nodes[scene.nodes[i]];
 			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
 		}
 		if (gltfModel.animations.size() > 0) {
@@ -1238,24 +1752,29 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		for (Node* node : linearNodes) {
 			if (node->mesh) {
 				const glm::mat4 localMatrix = node->getMatrix();
+				const glm::mat3 normalMatrix = glm::mat3(localMatrix);
 				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
+					Vertex* vertices = vertexBuffer.data() + primitive->firstVertex;
+					const glm::vec4 baseColorFactor = primitive->material.baseColorFactor;
+					parallelFor(primitive->vertexCount, [&](size_t begin, size_t end) {
+						for (size_t i = begin; i < end; i++) {
+							Vertex& vertex = vertices[i];
+							// Pre-transform vertex positions by node-hierarchy
+							if (preTransform) {
+								vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
+								vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+							}
+							// Flip Y-Axis of vertex positions
+							if (flipY) {
+								vertex.pos.y *= -1.0f;
+								vertex.normal.y *= -1.0f;
+							}
+							// Pre-Multiply vertex colors with material base color
+							if (preMultiplyColor) {
+								vertex.color = baseColorFactor * vertex.color;
+							}
 						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
-						}
-					}
+					});
 				}
 			}
 		}
@@ -1268,73 +1787,280 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
+	// After the pre-calculations above, they address the loaded vertex ranges
+	if (fileLoadingFlags & FileLoadingFlags::OptimizeGeometry) {
+		optimizeGeometry(indexBuffer, vertexBuffer);
+	}
+
+	if (fileLoadingFlags & FileLoadingFlags::KeepCpuGeometry) {
+		cpuGeometry.positions.resize(vertexBuffer.size());
+		for (size_t i = 0; i < vertexBuffer.size(); i++) {
+			cpuGeometry.positions[i] = vertexBuffer[i].pos;
+		}
+		cpuGeometry.indices = indexBuffer;
+	}
+
+	// LOD0 is the loaded geometry, LODs are appended after the cpu copy (occluders rasterize LOD0)
+	lods.assign(1, { 0, static_cast<uint32_t>(indexBuffer.size()), 0.0f });
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			for (Primitive* primitive : node->mesh->primitives) {
+				primitive->lods.assign(1, { primitive->firstIndex, primitive->indexCount });
+			}
+		}
+	}
+	if (fileLoadingFlags & FileLoadingFlags::GenerateLods) {
+		generateLods(indexBuffer, vertexBuffer, fileLoadingFlags & FileLoadingFlags::OptimizeGeometry);
+	}
+	if (fileLoadingFlags & FileLoadingFlags::BuildMeshlets) {
+		buildMeshlets(indexBuffer, vertexBuffer);
+	}
+
+	// Device side vertex data in the requested layout
+	const void* vertexData = vertexBuffer.data();
+	std::vector<CompactVertex>& compactVertices = pending->compactVertices;
+	std::vector<CompactSkinnedVertex>& compactSkinnedVertices = pending->compactSkinnedVertices;
+	vertexFormat = VertexFormat::Full;
+	if (fileLoadingFlags & FileLoadingFlags::CompactVertices) {
+		// Joints & weights only for skinned models
+		vertexFormat = skins.empty() ? VertexFormat::Compact : VertexFormat::CompactSkinned;
+
+		glm::vec3 posMin(FLT_MAX);
+		glm::vec3 posMax(-FLT_MAX);
+		for (const Vertex& vertex : vertexBuffer) {
+			posMin = glm::min(posMin, vertex.pos);
+			posMax = glm::max(posMax, vertex.pos);
+		}
+		const glm::vec3 extent = posMax - posMin;
+		dequantization.offset = posMin;
+		// Flat axes keep a non zero scale, they quantize to 0
+		dequantization.scale = glm::vec3(extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f);
+
+		if (vertexFormat == VertexFormat::Compact) {
+			compactVertices.resize(vertexBuffer.size());
+			for (size_t i = 0; i < vertexBuffer.size(); i++) {
+				quantizeVertex(vertexBuffer[i], dequantization, compactVertices[i]);
+			}
+			vertexData = compactVertices.data();
+		}
+		else {
+			compactSkinnedVertices.resize(vertexBuffer.size());
+			for (size_t i = 0; i < vertexBuffer.size(); i++) {
+				const Vertex& vertex = vertexBuffer[i];
+				CompactSkinnedVertex& compact = compactSkinnedVertices[i];
+				quantizeVertex(vertex, dequantization, compact.base);
+				for (int c = 0; c < 4; c++) {
+					compact.joint0[c] = static_cast<uint8_t>(glm::clamp(vertex.joint0[c], 0.0f, 255.0f));
+					compact.weight0[c] = static_cast<uint8_t>(std::round(glm::clamp(vertex.weight0[c], 0.0f, 1.0f) * 255.0f));
+				}
+			}
+			vertexData = compactSkinnedVertices.data();
+		}
+	}
+	const uint32_t vertexStride = Vertex::stride(vertexFormat);
+
+	// 16 bit indices when every vertex of the model is addressable, draws still add vertices.first
+	const void* indexData = indexBuffer.data();
+	std::vector<uint16_t>& indexBuffer16 = pending->indexBuffer16;
+	indices.type = VK_INDEX_TYPE_UINT32;
+	if ((fileLoadingFlags & FileLoadingFlags::OptimizeGeometry) && vertexBuffer.size() <= 0x10000) {
+		indices.type = VK_INDEX_TYPE_UINT16;
+		indexBuffer16.resize(indexBuffer.size());
+		for (size_t i = 0; i < indexBuffer.size(); i++) {
+			indexBuffer16[i] = static_cast<uint16_t>(indexBuffer[i]);
+		}
+		indexData = indexBuffer16.data();
+	}
+
+	// Draws of the whole model use LOD0, buffers hold every level
+	indices.count = lods[0].indexCount;
 	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
 
-	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+	assert((vertexBuffer.size() > 0) && (indexBuffer.size() > 0));
+
+	GeometryUpload& geometry = pending->geometry;
+	geometry.vertexData = vertexData;
+	geometry.vertexCount = static_cast<uint32_t>(vertexBuffer.size());
+	geometry.vertexStride = vertexStride;
+	geometry.indexData = indexData;
+	geometry.indexCount = static_cast<uint32_t>(indexBuffer.size());
+
+	const bool cook = cookedCache && isCookable(gltfModel, fileLoadingFlags);
+	// Drawn by arena models only, cooked files keep it for them
+	std::vector<uint8_t>& positionData = pending->positionData;
+	std::vector<uint32_t>& positionIndices = pending->positionIndices;
+	std::vector<uint16_t>& positionIndices16 = pending->positionIndices16;
+	if ((fileLoadingFlags & FileLoadingFlags::PositionStream) && (geometryArena || cook)) {
+		// Positions as the pipelines read them, tangent handedness dropped so more vertices weld
+		const uint32_t posStride = Vertex::positionStride(vertexFormat);
+		std::vector<uint8_t> vertexPositions(vertexBuffer.size() * posStride);
+		for (size_t i = 0; i < vertexBuffer.size(); i++) {
+			uint8_t* dst = vertexPositions.data() + i * posStride;
+			if (vertexFormat == VertexFormat::Full) {
+				memcpy(dst, &vertexBuffer[i].pos, posStride);
+				continue;
+			}
+			const CompactVertex& compact = vertexFormat == VertexFormat::Compact ? compactVertices[i] : compactSkinnedVertices[i].base;
+			const uint16_t pos[4] = { compact.pos[0], compact.pos[1], compact.pos[2], 0 };
+			memcpy(dst, pos, posStride);
+		}
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
+		// Weld vertices that only differ in other attributes, numbered in first use order for fetch locality
+		positionIndices.resize(indexBuffer.size());
+		std::unordered_map<std::string_view, uint32_t> welded;
+		welded.reserve(vertexBuffer.size());
+		for (size_t i = 0; i < indexBuffer.size(); i++) {
+			const std::string_view key(reinterpret_cast<const char*>(vertexPositions.data()) + static_cast<size_t>(indexBuffer[i]) * posStride, posStride);
+			auto [it, inserted] = welded.try_emplace(key, static_cast<uint32_t>(welded.size()));
+			if (inserted) {
+				positionData.insert(positionData.end(), key.begin(), key.end());
+			}
+			positionIndices[i] = it->second;
+		}
+		// Same index type as the model, welding never adds positions
+		const void* positionIndexData = positionIndices.data();
+		if (indices.type == VK_INDEX_TYPE_UINT16) {
+			positionIndices16.resize(positionIndices.size());
+			for (size_t i = 0; i < positionIndices.size(); i++) {
+				positionIndices16[i] = static_cast<uint16_t>(positionIndices[i]);
+			}
+			positionIndexData = positionIndices16.data();
+		}
+		geometry.positionData = positionData.data();
+		geometry.positionCount = static_cast<uint32_t>(welded.size());
+		geometry.positionStride = posStride;
+		geometry.positionIndexData = positionIndexData;
+	}
 
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+	if (cook) {
+		writeCooked(gltfModel, filename, cookedFile, settingsHash, geometry);
+	}
+	if (pending->loadImages) {
+		pending->images = std::move(gltfModel.images);
+	}
 
-	// Create device local buffers
-	// Vertex buffer
-	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferSize,
-		&vertices.buffer,
-		&vertices.memory));
-	// Index buffer
-	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBufferSize,
-		&indices.buffer,
-		&indices.memory));
+	getSceneDimensions();
+}
 
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+void vkglTF::Model::upload(VkQueue transferQueue, vks::UploadBatch* batch)
+{
+	assert(pending);
+	if (pending->loadImages) {
+		if (!mipGenerator) {
+			mipGenerator = std::make_shared<vks::MipGenerator>(device);
+		}
+		// Images share the caller's submit, their mip chains are generated together when it's flushed
+		vks::UploadBatch imageBatch(device, mipGenerator.get());
+		vks::UploadBatch& target = batch ? *batch : imageBatch;
+		for (size_t i = 0; i < pending->images.size(); i++) {
+			textures[i].fromglTfImage(pending->images[i], path, device, target);
+		}
+		// Create an empty texture to be used for empty material images
+		createEmptyTexture(target);
+		imageBatch.flush(transferQueue);
+	}
+	uploadGeometry(pending->geometry, pending->arenaKey, transferQueue, batch);
+	setupDescriptors();
+	// Releases the cpu side geometry & unmaps a cooked file
+	pending.reset();
+}
+
+void vkglTF::Model::uploadGeometry(const GeometryUpload& geometry, const std::string& arenaKey, VkQueue transferQueue, vks::UploadBatch* batch)
+{
+	const VkDeviceSize vertexBufferSize = static_cast<VkDeviceSize>(geometry.vertexCount) * geometry.vertexStride;
+	const VkDeviceSize indexBufferSize = static_cast<VkDeviceSize>(geometry.indexCount) * (indices.type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+
+	if (geometryArena) {
+		arena = geometryArena;
+		if (!arena->acquireShared(arenaKey, arenaAllocation)) {
+			arenaAllocation = arena->upload(geometry.vertexData, geometry.vertexCount, geometry.vertexStride, geometry.indexData, geometry.indexCount, indices.type, batch);
+			if (geometry.positionData) {
+				arena->uploadPositions(arenaAllocation, geometry.positionData, geometry.positionCount, geometry.positionStride, geometry.positionIndexData, geometry.indexCount, batch);
+			}
+			arena->registerShared(arenaKey, arenaAllocation);
+		}
+		if (arenaAllocation.hasPositions()) {
+			positionStream.valid = true;
+			positionStream.first = arenaAllocation.positions.offset;
+			positionStream.firstIndex = arenaAllocation.positionIndices.offset;
+			positionStream.count = arenaAllocation.positions.count;
+		}
+		vertices.buffer = arena->getVertexBuffer();
+		vertices.memory = VK_NULL_HANDLE;
+		vertices.first = arenaAllocation.vertices.offset;
+		indices.buffer = arena->getIndexBuffer();
+		indices.memory = VK_NULL_HANDLE;
+		indices.first = arenaAllocation.indices.offset;
+	}
+	else {
+		// Create device local buffers
+		// Vertex buffer
+		VK_CHECK_RESULT(device->createBuffer(
+		    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vertexBufferSize,
+			&vertices.buffer,
+			&vertices.memory));
+		// Index buffer
+		VK_CHECK_RESULT(device->createBuffer(
+		    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			indexBufferSize,
+			&indices.buffer,
+			&indices.memory));
+
+		if (batch) {
+			batch->copyBuffer(geometry.vertexData, vertexBufferSize, vertices.buffer);
+			batch->copyBuffer(geometry.indexData, indexBufferSize, indices.buffer);
+			return;
+		}
 
-	VkBufferCopy copyRegion = {};
+		struct StagingBuffer {
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+		} vertexStaging, indexStaging;
+
+		// Create staging buffers
+		// Vertex data
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			vertexBufferSize,
+			&vertexStaging.buffer,
+			&vertexStaging.memory,
+			const_cast<void*>(geometry.vertexData)));
+		// Index data
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			indexBufferSize,
+			&indexStaging.buffer,
+			&indexStaging.memory,
+			const_cast<void*>(geometry.indexData)));
+
+		// Copy from staging buffers
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+		VkBufferCopy copyRegion = {};
 
-	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+		copyRegion.size = vertexBufferSize;
+		vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+		copyRegion.size = indexBufferSize;
+		vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+		device->flushCommandBuffer(copyCmd, transferQueue, true);
 
-	getSceneDimensions();
+		vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	}
 
-	// Setup descriptors
+}
+
+void vkglTF::Model::setupDescriptors()
+{
 	uint32_t uboCount{ 0 };
 	uint32_t imageCount{ 0 };
 	for (auto node : linearNodes) {
@@ -1408,11 +2134,351 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	}
 }
 
+bool vkglTF::Model::loadCooked(const std::string& filename, const std::string& cookedFilename, uint64_t settingsHash)
+{
+	// Stays mapped until upload, the geometry is staged straight from it
+	vks::meshcache::Reader& reader = pending->cooked;
+	if (!reader.open(cookedFilename, settingsHash)) {
+		return false;
+	}
+	// Hashing the whole source on every warm start costs about as much as reading it, only do so when its stamp changed
+	const vks::meshcache::Header& header = reader.header();
+	const bool sourceChanged = header.sourceStamp != vks::meshcache::fileStamp(filename) && header.sourceHash != vks::meshcache::hashFile(filename);
+	if (reader.sectionCount() != static_cast<uint32_t>(CookedSection::Count) || sourceChanged) {
+		std::cout << "Cooked mesh \"" << cookedFilename << "\" is stale" << std::endl;
+		return false;
+	}
+
+	const CookedModel* info = nullptr;
+	const char* strings = nullptr;
+	const CookedDependency* dependencies = nullptr;
+	const CookedString* images = nullptr;
+	const CookedMaterial* cookedMaterials = nullptr;
+	const CookedNode* cookedNodes = nullptr;
+	const CookedPrimitive* cookedPrimitives = nullptr;
+	const Primitive::Lod* primitiveLods = nullptr;
+	const Lod* cookedLods = nullptr;
+	const Meshlet* cookedMeshlets = nullptr;
+	const uint8_t* vertexData = nullptr;
+	const uint8_t* indexData = nullptr;
+	const uint8_t* positionData = nullptr;
+	const uint8_t* positionIndexData = nullptr;
+	const glm::vec3* cpuPositions = nullptr;
+	const uint32_t* cpuIndices = nullptr;
+	size_t infoCount = 0, stringsSize = 0, dependencyCount = 0, imageCount = 0, materialCount = 0, nodeCount = 0, primitiveCount = 0, primitiveLodCount = 0, lodCount = 0, meshletCount = 0;
+	size_t vertexSize = 0, indexSize = 0, positionSize = 0, positionIndexSize = 0, cpuPositionCount = 0, cpuIndexCount = 0;
+	bool valid = cookedSection(reader, CookedSection::Model, info, infoCount) && infoCount == 1
+		&& cookedSection(reader, CookedSection::Strings, strings, stringsSize)
+		&& cookedSection(reader, CookedSection::Dependencies, dependencies, dependencyCount)
+		&& cookedSection(reader, CookedSection::Images, images, imageCount)
+		&& cookedSection(reader, CookedSection::Materials, cookedMaterials, materialCount) && materialCount > 0
+		&& cookedSection(reader, CookedSection::Nodes, cookedNodes, nodeCount)
+		&& cookedSection(reader, CookedSection::Primitives, cookedPrimitives, primitiveCount)
+		&& cookedSection(reader, CookedSection::PrimitiveLods, primitiveLods, primitiveLodCount)
+		&& cookedSection(reader, CookedSection::Lods, cookedLods, lodCount) && lodCount > 0
+		&& cookedSection(reader, CookedSection::Meshlets, cookedMeshlets, meshletCount)
+		&& cookedSection(reader, CookedSection::Vertices, vertexData, vertexSize)
+		&& cookedSection(reader, CookedSection::Indices, indexData, indexSize)
+		&& cookedSection(reader, CookedSection::Positions, positionData, positionSize)
+		&& cookedSection(reader, CookedSection::PositionIndices, positionIndexData, positionIndexSize)
+		&& cookedSection(reader, CookedSection::CpuPositions, cpuPositions, cpuPositionCount)
+		&& cookedSection(reader, CookedSection::CpuIndices, cpuIndices, cpuIndexCount);
+
+	// Everything is checked before the first object is created, a rejected file leaves the model untouched for the glTF path
+	if (valid) {
+		const size_t indexStride = info->indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		valid = (info->indexType == VK_INDEX_TYPE_UINT16 || info->indexType == VK_INDEX_TYPE_UINT32)
+			&& info->vertexFormat <= static_cast<uint32_t>(VertexFormat::CompactSkinned)
+			&& info->vertexStride == Vertex::stride(static_cast<VertexFormat>(info->vertexFormat))
+			&& info->vertexCount > 0 && vertexSize == static_cast<size_t>(info->vertexCount) * info->vertexStride
+			&& info->indexTotal > 0 && indexSize == static_cast<size_t>(info->indexTotal) * indexStride
+			&& cookedLods[0].indexCount == info->indexCount
+			&& positionSize == static_cast<size_t>(info->positionCount) * info->positionStride
+			&& positionIndexSize == (positionSize > 0 ? indexSize : 0);
+	}
+	auto validTexture = [imageCount](int32_t texture) {
+		return texture == COOKED_NO_TEXTURE || texture == COOKED_EMPTY_TEXTURE || (texture >= 0 && static_cast<size_t>(texture) < imageCount);
+	};
+	for (size_t i = 0; valid && i < materialCount; i++) {
+		const CookedMaterial& material = cookedMaterials[i];
+		valid = material.alphaMode <= Material::ALPHAMODE_BLEND && validTexture(material.baseColorTexture) && validTexture(material.metallicRoughnessTexture)
+			&& validTexture(material.normalTexture) && validTexture(material.occlusionTexture) && validTexture(material.emissiveTexture);
+	}
+	for (size_t i = 0; valid && i < nodeCount; i++) {
+		const CookedNode& node = cookedNodes[i];
+		valid = (node.parent == -1 || (node.parent > static_cast<int32_t>(i) && static_cast<size_t>(node.parent) < nodeCount))
+			&& static_cast<size_t>(node.firstPrimitive) + node.primitiveCount <= primitiveCount;
+	}
+	for (size_t i = 0; valid && i < primitiveCount; i++) {
+		const CookedPrimitive& primitive = cookedPrimitives[i];
+		valid = primitive.material < materialCount && static_cast<size_t>(primitive.firstLod) + primitive.lodCount <= primitiveLodCount;
+	}
+	if (!valid) {
+		std::cerr << "Cooked mesh \"" << cookedFilename << "\" is invalid" << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < dependencyCount; i++) {
+		if (dependencies[i].stamp != vks::meshcache::fileStamp(path + "/" + cookedString(strings, stringsSize, dependencies[i].uri))) {
+			std::cout << "Cooked mesh \"" << cookedFilename << "\" is stale" << std::endl;
+			return false;
+		}
+	}
+
+	// Decoded like tinyglTF would, image files are read without it
+	if (pending->loadImages) {
+		pending->images.resize(imageCount);
+		textures.resize(imageCount);
+		for (size_t i = 0; i < imageCount; i++) {
+			tinygltf::Image& image = pending->images[i];
+			image.uri = cookedString(strings, stringsSize, images[i]);
+			vks::meshcache::MappedFile imageFile;
+			std::string error, warning;
+			if (!imageFile.open(path + "/" + image.uri) || imageFile.size() > static_cast<size_t>(INT_MAX)
+				|| !loadImageDataFunc(&image, static_cast<int>(i), &error, &warning, 0, 0, imageFile.data(), static_cast<int>(imageFile.size()), nullptr)) {
+				vks::tools::exitFatal("Could not load image \"" + image.uri + "\" of cooked mesh \"" + cookedFilename + "\": " + error, -1);
+				return false;
+			}
+			textures[i].index = static_cast<uint32_t>(i);
+		}
+	}
+
+	auto getCookedTexture = [this](int32_t texture) -> vkglTF::Texture* {
+		if (texture == COOKED_EMPTY_TEXTURE) {
+			return &emptyTexture;
+		}
+		return texture >= 0 ? getTexture(static_cast<uint32_t>(texture)) : nullptr;
+	};
+	materials.reserve(materialCount);
+	for (size_t i = 0; i < materialCount; i++) {
+		const CookedMaterial& cooked = cookedMaterials[i];
+		vkglTF::Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(cooked.alphaMode);
+		material.alphaCutoff = cooked.alphaCutoff;
+		material.metallicFactor = cooked.metallicFactor;
+		material.roughnessFactor = cooked.roughnessFactor;
+		material.baseColorFactor = glm::make_vec4(cooked.baseColorFactor);
+		material.baseColorTexture = getCookedTexture(cooked.baseColorTexture);
+		material.metallicRoughnessTexture = getCookedTexture(cooked.metallicRoughnessTexture);
+		material.normalTexture = getCookedTexture(cooked.normalTexture);
+		material.occlusionTexture = getCookedTexture(cooked.occlusionTexture);
+		material.emissiveTexture = getCookedTexture(cooked.emissiveTexture);
+		materials.push_back(material);
+	}
+
+	std::vector<Node*> loadedNodes(nodeCount);
+	for (size_t i = 0; i < nodeCount; i++) {
+		const CookedNode& cooked = cookedNodes[i];
+		vkglTF::Node* node = new Node{};
+		node->index = cooked.index;
+		node->name = cookedString(strings, stringsSize, cooked.name);
+		node->matrix = glm::make_mat4x4(cooked.matrix);
+		node->translation = glm::make_vec3(cooked.translation);
+		node->scale = glm::make_vec3(cooked.scale);
+		node->rotation = glm::make_quat(cooked.rotation);
+		if (cooked.hasMesh) {
+			Mesh* mesh = new Mesh(device, node->matrix);
+			mesh->name = cookedString(strings, stringsSize, cooked.meshName);
+			for (uint32_t p = 0; p < cooked.primitiveCount; p++) {
+				const CookedPrimitive& cookedPrimitive = cookedPrimitives[cooked.firstPrimitive + p];
+				Primitive* primitive = new Primitive(cookedPrimitive.firstIndex, cookedPrimitive.indexCount, materials[cookedPrimitive.material]);
+				primitive->firstVertex = cookedPrimitive.firstVertex;
+				primitive->vertexCount = cookedPrimitive.vertexCount;
+				primitive->setDimensions(glm::make_vec3(cookedPrimitive.min), glm::make_vec3(cookedPrimitive.max));
+				primitive->lods.assign(primitiveLods + cookedPrimitive.firstLod, primitiveLods + cookedPrimitive.firstLod + cookedPrimitive.lodCount);
+				mesh->primitives.push_back(primitive);
+			}
+			node->mesh = mesh;
+		}
+		loadedNodes[i] = node;
+	}
+	// Same hierarchy & order as loadNode builds
+	for (size_t i = 0; i < nodeCount; i++) {
+		vkglTF::Node* node = loadedNodes[i];
+		if (cookedNodes[i].parent >= 0) {
+			node->parent = loadedNodes[cookedNodes[i].parent];
+			node->parent->children.push_back(node);
+		} else {
+			nodes.push_back(node);
+		}
+		linearNodes.push_back(node);
+	}
+	for (auto node : linearNodes) {
+		// Initial pose
+		if (node->mesh) {
+			node->update();
+		}
+	}
+
+	metallicRoughnessWorkflow = info->metallicRoughnessWorkflow != 0;
+	vertexFormat = static_cast<VertexFormat>(info->vertexFormat);
+	dequantization.scale = glm::make_vec3(info->dequantizationScale);
+	dequantization.offset = glm::make_vec3(info->dequantizationOffset);
+	indices.type = static_cast<VkIndexType>(info->indexType);
+	indices.count = info->indexCount;
+	vertices.count = info->vertexCount;
+	lods.assign(cookedLods, cookedLods + lodCount);
+	meshlets.assign(cookedMeshlets, cookedMeshlets + meshletCount);
+	cpuGeometry.positions.assign(cpuPositions, cpuPositions + cpuPositionCount);
+	cpuGeometry.indices.assign(cpuIndices, cpuIndices + cpuIndexCount);
+
+	// Straight from the mapping into staging
+	GeometryUpload& geometry = pending->geometry;
+	geometry.vertexData = vertexData;
+	geometry.vertexCount = info->vertexCount;
+	geometry.vertexStride = info->vertexStride;
+	geometry.indexData = indexData;
+	geometry.indexCount = info->indexTotal;
+	if (positionSize > 0) {
+		geometry.positionData = positionData;
+		geometry.positionCount = info->positionCount;
+		geometry.positionStride = info->positionStride;
+		geometry.positionIndexData = positionIndexData;
+	}
+	return true;
+}
+
+void vkglTF::Model::writeCooked(const tinygltf::Model& gltfModel, const std::string& filename, const std::string& cookedFilename, uint64_t settingsHash, const GeometryUpload& geometry)
+{
+	std::string strings;
+	auto addString = [&strings](const std::string& value) {
+		const CookedString string{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(value.size()) };
+		strings += value;
+		return string;
+	};
+
+	// External buffers & the loaded images, embedded data is covered by the source hash
+	std::vector<CookedDependency> dependencies;
+	bool resolved = true;
+	auto addDependency = [&](const std::string& uri) {
+		dependencies.push_back({ addString(uri), vks::meshcache::fileStamp(path + "/" + uri) });
+		// Escaped uris aren't decoded by cooked loads
+		resolved = resolved && dependencies.back().stamp != 0;
+		return dependencies.back().uri;
+	};
+	for (const tinygltf::Buffer& buffer : gltfModel.buffers) {
+		if (!buffer.uri.empty() && buffer.uri.rfind("data:", 0) != 0) {
+			addDependency(buffer.uri);
+		}
+	}
+	std::vector<CookedString> images;
+	if (!textures.empty()) {
+		for (const tinygltf::Image& image : gltfModel.images) {
+			images.push_back(addDependency(image.uri));
+		}
+	}
+	if (!resolved) {
+		std::cout << "Model " << filename << ": external file not found by its uri, not cooked" << std::endl;
+		return;
+	}
+
+	auto getTextureIndex = [this](const vkglTF::Texture* texture) {
+		if (!texture) {
+			return COOKED_NO_TEXTURE;
+		}
+		return texture == &emptyTexture ? COOKED_EMPTY_TEXTURE : static_cast<int32_t>(texture->index);
+	};
+	std::vector<CookedMaterial> cookedMaterials;
+	cookedMaterials.reserve(materials.size());
+	for (const Material& material : materials) {
+		CookedMaterial cooked{};
+		cooked.alphaMode = material.alphaMode;
+		cooked.alphaCutoff = material.alphaCutoff;
+		cooked.metallicFactor = material.metallicFactor;
+		cooked.roughnessFactor = material.roughnessFactor;
+		memcpy(cooked.baseColorFactor, glm::value_ptr(material.baseColorFactor), sizeof(cooked.baseColorFactor));
+		cooked.baseColorTexture = getTextureIndex(material.baseColorTexture);
+		cooked.metallicRoughnessTexture = getTextureIndex(material.metallicRoughnessTexture);
+		cooked.normalTexture = getTextureIndex(material.normalTexture);
+		cooked.occlusionTexture = getTextureIndex(material.occlusionTexture);
+		cooked.emissiveTexture = getTextureIndex(material.emissiveTexture);
+		cookedMaterials.push_back(cooked);
+	}
+
+	std::unordered_map<const Node*, int32_t> linearIndices;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		linearIndices[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	std::vector<CookedNode> cookedNodes;
+	std::vector<CookedPrimitive> cookedPrimitives;
+	std::vector<Primitive::Lod> primitiveLods;
+	cookedNodes.reserve(linearNodes.size());
+	for (const Node* node : linearNodes) {
+		CookedNode cooked{};
+		cooked.parent = node->parent ? linearIndices[node->parent] : -1;
+		cooked.index = node->index;
+		cooked.name = addString(node->name);
+		memcpy(cooked.matrix, glm::value_ptr(node->matrix), sizeof(cooked.matrix));
+		memcpy(cooked.translation, glm::value_ptr(node->translation), sizeof(cooked.translation));
+		memcpy(cooked.scale, glm::value_ptr(node->scale), sizeof(cooked.scale));
+		memcpy(cooked.rotation, glm::value_ptr(node->rotation), sizeof(cooked.rotation));
+		if (node->mesh) {
+			cooked.hasMesh = 1;
+			cooked.meshName = addString(node->mesh->name);
+			cooked.firstPrimitive = static_cast<uint32_t>(cookedPrimitives.size());
+			cooked.primitiveCount = static_cast<uint32_t>(node->mesh->primitives.size());
+			for (const Primitive* primitive : node->mesh->primitives) {
+				CookedPrimitive cookedPrimitive{};
+				cookedPrimitive.firstIndex = primitive->firstIndex;
+				cookedPrimitive.indexCount = primitive->indexCount;
+				cookedPrimitive.firstVertex = primitive->firstVertex;
+				cookedPrimitive.vertexCount = primitive->vertexCount;
+				cookedPrimitive.material = static_cast<uint32_t>(&primitive->material - materials.data());
+				cookedPrimitive.firstLod = static_cast<uint32_t>(primitiveLods.size());
+				cookedPrimitive.lodCount = static_cast<uint32_t>(primitive->lods.size());
+				memcpy(cookedPrimitive.min, glm::value_ptr(primitive->dimensions.min), sizeof(cookedPrimitive.min));
+				memcpy(cookedPrimitive.max, glm::value_ptr(primitive->dimensions.max), sizeof(cookedPrimitive.max));
+				primitiveLods.insert(primitiveLods.end(), primitive->lods.begin(), primitive->lods.end());
+				cookedPrimitives.push_back(cookedPrimitive);
+			}
+		}
+		cookedNodes.push_back(cooked);
+	}
+
+	CookedModel info{};
+	info.vertexFormat = static_cast<uint32_t>(vertexFormat);
+	info.vertexCount = geometry.vertexCount;
+	info.vertexStride = geometry.vertexStride;
+	info.indexType = static_cast<uint32_t>(indices.type);
+	info.indexCount = static_cast<uint32_t>(indices.count);
+	info.indexTotal = geometry.indexCount;
+	info.positionCount = geometry.positionData ? geometry.positionCount : 0;
+	info.positionStride = geometry.positionData ? geometry.positionStride : 0;
+	info.metallicRoughnessWorkflow = metallicRoughnessWorkflow ? 1 : 0;
+	memcpy(info.dequantizationScale, glm::value_ptr(dequantization.scale), sizeof(info.dequantizationScale));
+	memcpy(info.dequantizationOffset, glm::value_ptr(dequantization.offset), sizeof(info.dequantizationOffset));
+	const size_t indexBufferSize = static_cast<size_t>(geometry.indexCount) * (indices.type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+
+	// In CookedSection order
+	vks::meshcache::Writer writer;
+	writer.addSection(&info, sizeof(info));
+	writer.addSection(strings.data(), strings.size());
+	writer.addSection(dependencies);
+	writer.addSection(images);
+	writer.addSection(cookedMaterials);
+	writer.addSection(cookedNodes);
+	writer.addSection(cookedPrimitives);
+	writer.addSection(primitiveLods);
+	writer.addSection(lods);
+	writer.addSection(meshlets);
+	writer.addSection(geometry.vertexData, static_cast<size_t>(geometry.vertexCount) * geometry.vertexStride);
+	writer.addSection(geometry.indexData, indexBufferSize);
+	writer.addSection(geometry.positionData, static_cast<size_t>(info.positionCount) * info.positionStride);
+	writer.addSection(geometry.positionIndexData, geometry.positionData ? indexBufferSize : 0);
+	writer.addSection(cpuGeometry.positions);
+	writer.addSection(cpuGeometry.indices);
+	if (writer.write(cookedFilename, vks::meshcache::hashFile(filename), vks::meshcache::fileStamp(filename), settingsHash)) {
+		std::cout << "Model " << filename << ": cooked to " << cookedFilename << std::endl;
+	}
+	else {
+		std::cerr << "Could not write cooked mesh \"" << cookedFilename << "\"" << std::endl;
+	}
+}
+
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 {
 	const VkDeviceSize offsets[1] = {0};
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
 	buffersBound = true;
 }
 
@@ -1435,7 +2501,7 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 				if (renderFlags & RenderFlags::BindImages) {
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 				}
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, indices.first + primitive->firstIndex, static_cast<int32_t>(vertices.first), 0);
 			}
 		}
 	}
@@ -1449,7 +2515,7 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 	if (!buffersBound) {
 		const VkDeviceSize offsets[1] = {0};
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
 	}
 	for (auto& node : nodes) {
 		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
@@ -19,9 +19,12 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "GeometryArena.h"
+#include "UploadBatch.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -56,6 +59,10 @@ namespace vkglTF
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	// When set, models sub-allocate their geometry from this arena instead of owning buffers
+	extern std::shared_ptr<vks::GeometryArena> geometryArena;
+	// Generates the mip chains of glTF images, created by the first upload when not set
+	extern std::shared_ptr<vks::MipGenerator> mipGenerator;
 
 	struct Node;
 
@@ -76,7 +83,8 @@ namespace vkglTF
 		uint32_t index;
 		void updateDescriptor();
 		void destroy();
-		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		// Recorded into batch, which needs a mip generator
+		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, vks::UploadBatch& batch);
 	};
 
 	/*
@@ -123,6 +131,13 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		// Index ranges of the primitive's LOD chain, [0] is firstIndex/indexCount (FileLoadingFlags::GenerateLods)
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+		};
+		std::vector<Lod> lods;
+
 		void setDimensions(glm::vec3 min, glm::vec3 max);
 		Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), material(material) {};
 	};
@@ -221,6 +236,36 @@ namespace vkglTF
 	*/
 	enum class VertexComponent { Position, Normal, UV, Color, Tangent, Joint0, Weight0 };
 
+	/*
+		Vertex layouts in device memory
+		Full: Vertex, 96 bytes
+		Compact: CompactVertex, 24 bytes, static meshes
+		CompactSkinned: CompactSkinnedVertex, 32 bytes, CompactVertex + joints & weights
+	*/
+	enum class VertexFormat { Full, Compact, CompactSkinned };
+
+	/*
+		Quantized vertex, shaders read every component as floats:
+		pos: unorm16 over the model's bounds, dequantized with Model::dequantization, w: tangent handedness (0: -1, 1: +1)
+		normal & tangent: octahedral snorm16
+		uv: half float
+		color: unorm8
+	*/
+	struct CompactVertex {
+		uint16_t pos[4];
+		int16_t normal[2];
+		uint16_t uv[2];
+		uint8_t color[4];
+		int16_t tangent[2];
+	};
+
+	struct CompactSkinnedVertex {
+		CompactVertex base;
+		// uscaled, read as float joint indices
+		uint8_t joint0[4];
+		uint8_t weight0[4];
+	};
+
 	struct Vertex {
 		glm::vec3 pos;
 		glm::vec3 normal;
@@ -232,11 +277,16 @@ namespace vkglTF
 		static VkVertexInputBindingDescription vertexInputBindingDescription;
 		static std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
 		static VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo;
-		static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding);
-		static VkVertexInputAttributeDescription inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component);
-		static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components);
+		static uint32_t stride(VertexFormat format);
+		// Position only stream: float3 for Full, unorm16x4 for compact formats
+		static uint32_t positionStride(VertexFormat format);
+		static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding, VertexFormat format = VertexFormat::Full);
+		static VkVertexInputAttributeDescription inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component, VertexFormat format = VertexFormat::Full);
+		static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components, VertexFormat format = VertexFormat::Full);
 		/** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
-		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components, VertexFormat format = VertexFormat::Full);
+		/** @brief Returns the pipeline vertex input state for the position only stream, position at location 0 */
+		static VkPipelineVertexInputStateCreateInfo* getPipelinePositionInputState(VertexFormat format = VertexFormat::Full);
 	};
 
 	enum FileLoadingFlags {
@@ -244,9 +294,27 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		// Keep a cpu copy of vertex positions & indices (e.g. for software occlusion)
+		KeepCpuGeometry = 0x00000010,
+		// Store vertices quantized (VertexFormat::Compact, CompactSkinned for models with skins)
+		CompactVertices = 0x00000020,
+		// Also emit a welded position only stream for depth only passes (geometry arena models)
+		PositionStream = 0x00000040,
+		// Dedup vertices, reorder triangles for vertex cache & overdraw, vertices for fetch & use 16 bit indices when they fit
+		OptimizeGeometry = 0x00000080,
+		// Simplified LOD chain appended to the index buffer, see Model::lods
+		GenerateLods = 0x00000100,
+		// Meshlets of every lod level for cluster culling, see Model::meshlets
+		BuildMeshlets = 0x00000200,
+		// Load from a cooked binary (vks::meshcache) keyed by source & the other flags, cooked on first load
+		// Only static models are cooked: no skins, no animations & images (unless DontLoadImages) in external files
+		CookedCache = 0x00000400
 	};
 
+	// LOD0 included
+	constexpr uint32_t MAX_LOD_COUNT = 5;
+
 	enum RenderFlags {
 		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
@@ -261,7 +329,31 @@ namespace vkglTF
 	private:
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
-		void createEmptyTexture(VkQueue transferQueue);
+		void createEmptyTexture(vks::UploadBatch& batch);
+
+		// Device ready geometry of the import pipeline or of a cooked file
+		struct GeometryUpload {
+			const void* vertexData = nullptr;
+			uint32_t vertexCount = 0;
+			uint32_t vertexStride = 0;
+			// Every lod level, of type indices.type
+			const void* indexData = nullptr;
+			uint32_t indexCount = 0;
+			// Welded position stream, null without FileLoadingFlags::PositionStream
+			const void* positionData = nullptr;
+			uint32_t positionCount = 0;
+			uint32_t positionStride = 0;
+			const void* positionIndexData = nullptr;
+		};
+		// Into the geometry arena (shared by arenaKey) or own device local buffers, recorded into batch when given
+		void uploadGeometry(const GeometryUpload& geometry, const std::string& arenaKey, VkQueue transferQueue, vks::UploadBatch* batch);
+		void setupDescriptors();
+		// Everything importFile leaves for upload (decoded images, device ready geometry & the data it points to)
+		struct PendingUpload;
+		std::unique_ptr<PendingUpload> pending;
+		// FileLoadingFlags::CookedCache, false (nothing loaded) when the cooked file is missing, stale or invalid
+		bool loadCooked(const std::string& filename, const std::string& cookedFilename, uint64_t settingsHash);
+		void writeCooked(const tinygltf::Model& gltfModel, const std::string& filename, const std::string& cookedFilename, uint64_t settingsHash, const GeometryUpload& geometry);
 	public:
 		vks::VulkanDevice* device;
 		VkDescriptorPool descriptorPool;
@@ -270,13 +362,66 @@ namespace vkglTF
 			int count;
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			// First vertex in buffer, used as the draws' vertexOffset
+			uint32_t first = 0;
 		} vertices;
 		struct Indices {
 			int count;
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			// First index in buffer, added to the draws' firstIndex
+			uint32_t first = 0;
+			// UINT16 when every index fits, the buffer is bound with this type
+			VkIndexType type = VK_INDEX_TYPE_UINT32;
 		} indices;
 
+		// Layout of the vertex buffer, pipelines drawing the model must use the same
+		VertexFormat vertexFormat = VertexFormat::Full;
+		// Compact formats: position = inPos.xyz * scale + offset
+		struct Dequantization {
+			glm::vec3 scale = glm::vec3(1.0f);
+			glm::vec3 offset = glm::vec3(0.0f);
+		} dequantization;
+
+		// LODs of the whole model, each level holds every primitive's indices (coarser levels reuse a primitive's previous one when it can't simplify further)
+		// firstIndex is relative to indices.first & positionStream.firstIndex, [0] is the loaded geometry with indices.count
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			// Largest geometric deviation from LOD0 in model units
+			float error;
+			// Range of the level in meshlets
+			uint32_t firstMeshlet = 0;
+			uint32_t meshletCount = 0;
+		};
+		std::vector<Lod> lods;
+
+		// Index ranges of at most 64 vertices & 124 triangles with culling bounds, empty unless every primitive is a triangle list
+		struct Meshlet {
+			// Relative to indices.first, like Lod::firstIndex
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			// xyz: model space center, w: radius
+			glm::vec4 boundingSphere;
+			// xyz: model space normal cone axis, w: cutoff (vks::optimizer::MeshletBounds)
+			glm::vec4 cone;
+		};
+		std::vector<Meshlet> meshlets;
+
+		// Position only stream in the arena, same index layout as indices
+		struct PositionStream {
+			bool valid = false;
+			// vertexOffset & firstIndex of the stream's draws
+			uint32_t first = 0;
+			uint32_t firstIndex = 0;
+			// Welded positions, at most vertices.count
+			uint32_t count = 0;
+		} positionStream;
+
+		// Arena the buffers above belong to, null when the model owns them
+		std::shared_ptr<vks::GeometryArena> arena;
+		vks::GeometryArena::Allocation arenaAllocation;
+
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
 
@@ -294,18 +439,47 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		// Import optimization results, only filled when FileLoadingFlags::OptimizeGeometry ran on the glTF file (not on cooked loads)
+		// ACMR / ATVR of the whole index buffer, see vks::optimizer::VertexCacheStatistics
+		struct OptimizationStatistics {
+			uint32_t vertexCountBefore = 0;
+			uint32_t vertexCountAfter = 0;
+			float acmrBefore = 0.0f;
+			float acmrAfter = 0.0f;
+			float atvrBefore = 0.0f;
+			float atvrAfter = 0.0f;
+		} optimizationStatistics;
+
+		// Only filled when loaded with FileLoadingFlags::KeepCpuGeometry
+		struct CpuGeometry {
+			std::vector<glm::vec3> positions;
+			std::vector<uint32_t> indices;
+		} cpuGeometry;
+
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
 
-		Model() {};
+		// Out of line, pending is an incomplete type here
+		Model();
 		~Model();
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
-		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
+		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, vks::UploadBatch& batch);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
+		// Per primitive import optimization, rewrites both buffers & the primitives' vertex ranges & fills optimizationStatistics
+		void optimizeGeometry(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer);
+		// Appends simplified levels of every primitive to indexBuffer & fills lods
+		void generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, bool optimizeLods);
+		// Splits every lod level of every primitive into meshlets
+		void buildMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
+		// importFile & upload in one go
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		// Cpu half of loadFromFile: reading, parsing, image decoding & vertex processing, safe on a job thread (one model per thread)
+		void importFile(std::string filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		// Gpu half, main thread: creates the textures & descriptors, geometry copies go into batch (drawable after its flush) or are submitted right away
+		void upload(VkQueue transferQueue, vks::UploadBatch* batch = nullptr);
 		void bindBuffers(VkCommandBuffer commandBuffer);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
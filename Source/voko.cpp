@@ -4,6 +4,9 @@
 #define VMA_IMPLEMENTATION 
 #include <vk_mem_alloc.h>
 
+#include <map>
+#include <unordered_map>
+
 #include "VulkanglTFModel.h"
 #include "SceneGraph/Light.h"
 #include "SceneGraph/Mesh.h"
@@ -59,6 +62,31 @@ void voko::prepare()
     camera.setPerspective(60.0f, (float)voko_global::width / (float)voko_global::height, zNear, zFar);
     timerSpeed *= 0.25f;
     
+    // All models sub-allocate their vertices & indices from one arena, meshlet culling reads its indices as storage
+    vkglTF::geometryArena = std::make_shared<vks::GeometryArena>(vulkanDevice, queue,
+        voko_global::GEOMETRY_ARENA_VERTEX_BYTES, voko_global::GEOMETRY_ARENA_POSITION_BYTES, voko_global::GEOMETRY_ARENA_INDEX_MAX,
+        vkglTF::memoryPropertyFlags | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    // glTF images of every model loaded together get their mips in one pass
+    vkglTF::mipGenerator = std::make_shared<vks::MipGenerator>(vulkanDevice);
+    vkglTF::mipGenerator->preferCompute = voko_global::bComputeMipmaps;
+
+    // Scene loaders queue their assets as jobs, geometry is waited for before the mesh buffers are built
+    jobSystem = std::make_unique<vks::JobSystem>();
+    voko_global::jobSystem = jobSystem.get();
+
+    descriptorAllocator = std::make_unique<vks::DescriptorAllocator>(vulkanDevice);
+    voko_global::descriptorAllocator = descriptorAllocator.get();
+
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+    if (vulkanDevice->extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+    {
+        getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+    }
+    textureResidency = std::make_unique<vks::TextureResidency>(vulkanDevice, voko_global::TEXTURE_BUDGET_BYTES, getMemoryProperties2);
+    virtualTextures = std::make_unique<vks::VirtualTextureCache>(vulkanDevice, jobSystem.get(),
+        voko_global::VIRTUAL_TEXTURE_CACHE_PAGES, voko_global::VIRTUAL_TEXTURE_FRAME_PAGES);
+
     // Load Assets & Create Scene graph
     // loadScene();
     // loadScene2();
@@ -67,7 +95,7 @@ void voko::prepare()
     buildScene();
 
     // Scene Renderer
-    SceneRenderer = new DeferredRenderer(
+    SceneRenderer = std::make_unique<DeferredRenderer>(
         vulkanDevice,
         semaphores.presentComplete,
         semaphores.renderComplete,
@@ -101,9 +129,58 @@ void voko::getEnabledFeatures()
         vks::tools::exitFatal("Selected GPU does not support samplerAnisotropy!", VK_ERROR_FEATURE_NOT_PRESENT);
     }
 
+    // Virtual texture feedback is written by the geometry pass
+    if (deviceFeatures.fragmentStoresAndAtomics) {
+        enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+    }else {
+        vks::tools::exitFatal("Selected GPU does not support fragmentStoresAndAtomics!", VK_ERROR_FEATURE_NOT_PRESENT);
+    }
+
+    // Optional, scene textures stay uncompressed without it
+    if (deviceFeatures.textureCompressionBC) {
+        enabledFeatures.textureCompressionBC = VK_TRUE;
+    }
+
+    // Descriptor indexing support, queried through the instance extension (the instance targets Vulkan 1.0)
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingSupport{};
+    descriptorIndexingSupport.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2KHR deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    deviceFeatures2.pNext = &descriptorIndexingSupport;
+    auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+    if (getFeatures2) {
+        getFeatures2(physicalDevice, &deviceFeatures2);
+    }
+
     // enable descriptor partially bound features
     physicalDeviceDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
-    physicalDeviceDescriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    if (descriptorIndexingSupport.descriptorBindingPartiallyBound) {
+        physicalDeviceDescriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    }else {
+        vks::tools::exitFatal("Selected GPU does not support descriptorBindingPartiallyBound!", VK_ERROR_FEATURE_NOT_PRESENT);
+    }
+    // bindless mesh textures: unsized, non uniformly indexed sampler array
+    if (descriptorIndexingSupport.runtimeDescriptorArray) {
+        physicalDeviceDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    }else {
+        vks::tools::exitFatal("Selected GPU does not support runtimeDescriptorArray!", VK_ERROR_FEATURE_NOT_PRESENT);
+    }
+    if (descriptorIndexingSupport.shaderSampledImageArrayNonUniformIndexing) {
+        physicalDeviceDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    }else {
+        vks::tools::exitFatal("Selected GPU does not support shaderSampledImageArrayNonUniformIndexing!", VK_ERROR_FEATURE_NOT_PRESENT);
+    }
+    if (descriptorIndexingSupport.descriptorBindingVariableDescriptorCount) {
+        physicalDeviceDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    }else {
+        vks::tools::exitFatal("Selected GPU does not support descriptorBindingVariableDescriptorCount!", VK_ERROR_FEATURE_NOT_PRESENT);
+    }
+    // streamed mesh textures are written into the bound set
+    if (descriptorIndexingSupport.descriptorBindingSampledImageUpdateAfterBind) {
+        physicalDeviceDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }else {
+        vks::tools::exitFatal("Selected GPU does not support descriptorBindingSampledImageUpdateAfterBind!", VK_ERROR_FEATURE_NOT_PRESENT);
+    }
     deviceCreatepNextChain = &physicalDeviceDescriptorIndexingFeatures;
 }
 
@@ -119,6 +196,16 @@ void voko::getEnabledExtensions() {
     enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
     // Add device ext for dynamic ds & partially bind ds
     enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    // Heap budgets for the texture residency
+    if (vulkanDevice->extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+    {
+        enabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    // Descriptor allocator writes whole sets through templates, plain writes without it
+    if (vulkanDevice->extensionSupported(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME))
+    {
+        enabledDeviceExtensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+    }
 }
 
 
@@ -231,27 +318,32 @@ VkShaderModule voko::loadSPIRVShader(std::string filename)
 void voko::loadScene()
 {
     CurrentScene = std::make_unique<Scene>("Scene1: Deferred + Shadow");
-    const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+    // Instanced knights in front of each other & the floor
+    voko_global::bDepthPrepass = true;
+    const uint32_t glTFLoadingFlags = sceneLoadingFlags(vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors
+        | vkglTF::FileLoadingFlags::FlipY);
 
     // Meshes: model + texture
     
     std::unique_ptr<Node> ArmorKnightMeshNode = std::make_unique<Node>(0, "ArmorKnight");;
     std::unique_ptr<Mesh> ArmorKnight = std::make_unique<Mesh>("ArmorKnight");
-    ArmorKnight->VkGltfModel.loadFromFile(getAssetPath() + "models/armor/armor.gltf", vulkanDevice, queue, glTFLoadingFlags);
-    ArmorKnight->Textures.albedoMap.loadFromFile(getAssetPath() + "models/armor/colormap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-    ArmorKnight->Textures.normalMap.loadFromFile(getAssetPath() + "models/armor/normalmap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+    loadModel(ArmorKnight->VkGltfModel, getAssetPath() + "models/armor/armor.gltf", glTFLoadingFlags);
+    loadTexture(ArmorKnight->Textures.albedoMap, getAssetPath() + "models/armor/colormap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+    loadTexture(ArmorKnight->Textures.normalMap, getAssetPath() + "models/armor/normalmap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vks::compression::TextureContent::NormalMap);
     // Set per instance pos for mesh instance drawing
-    ArmorKnight->Instances.push_back(voko_buffer::PerInstanceSSBO{.instancePos = glm::vec4(0.0f)});
-    ArmorKnight->Instances.push_back(voko_buffer::PerInstanceSSBO{.instancePos = glm::vec4(-7.0f, 0.0, -4.0f, 0.0f)});
-    ArmorKnight->Instances.push_back(voko_buffer::PerInstanceSSBO{.instancePos = glm::vec4(4.0f, 0.0, -6.0f, 0.0f)});
+    ArmorKnight->Instances.emplace_back(glm::mat4(1.0f));
+    ArmorKnight->Instances.emplace_back(glm::translate(glm::mat4(1.0f), glm::vec3(-7.0f, 0.0f, -4.0f)));
+    ArmorKnight->Instances.emplace_back(glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, 0.0f, -6.0f)));
     ArmorKnight->set_node(*ArmorKnightMeshNode);
 
     
     std::unique_ptr<Node> StoneFloor02Node = std::make_unique<Node>(0, "StoneFloor02");
     std::unique_ptr<Mesh> StoneFloor02 = std::make_unique<Mesh>("StoneFloor02");
-    StoneFloor02->VkGltfModel.loadFromFile(getAssetPath() + "models/deferred_box.gltf", vulkanDevice, queue, glTFLoadingFlags);
-    StoneFloor02->Textures.albedoMap.loadFromFile(getAssetPath() + "textures/stonefloor02_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-    StoneFloor02->Textures.normalMap.loadFromFile(getAssetPath() + "textures/stonefloor02_normal_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+    loadModel(StoneFloor02->VkGltfModel, getAssetPath() + "models/deferred_box.gltf", glTFLoadingFlags | vkglTF::FileLoadingFlags::KeepCpuGeometry);
+    // Large background box, used as cpu occluder
+    StoneFloor02->bOccluder = true;
+    loadTexture(StoneFloor02->Textures.albedoMap, getAssetPath() + "textures/stonefloor02_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+    loadTexture(StoneFloor02->Textures.normalMap, getAssetPath() + "textures/stonefloor02_normal_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vks::compression::TextureContent::NormalMap);
     StoneFloor02->set_node(*StoneFloor02Node);
     
     // components are collected & managed independently, now collected by scene
@@ -318,19 +410,22 @@ void voko::loadScene()
 
 void voko::loadScene2() {
     CurrentScene = std::make_unique<Scene>("Scene2: PBR Texture + IBL");
-    const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+    // Single model, barely any overdraw
+    voko_global::bDepthPrepass = false;
+    const uint32_t glTFLoadingFlags = sceneLoadingFlags(vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors
+        | vkglTF::FileLoadingFlags::FlipY);
 
     // Add cerberus mesh + pbr textures
     std::unique_ptr<Node> cerberusNode = std::make_unique<Node>(0, "cerberus");;
     std::unique_ptr<Mesh> cerberus = std::make_unique<Mesh>("cerberus");
-    cerberus->VkGltfModel.loadFromFile(getAssetPath() + "models/cerberus/cerberus.gltf", vulkanDevice, queue, glTFLoadingFlags);
+    loadModel(cerberus->VkGltfModel, getAssetPath() + "models/cerberus/cerberus.gltf", glTFLoadingFlags);
     // cerberus has all textures
     cerberus->meshProperty.usedSamplers = voko_global::EMeshSamplerFlags::ALL;
-    cerberus->Textures.albedoMap.loadFromFile(getAssetPath() + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-    cerberus->Textures.normalMap.loadFromFile(getAssetPath() + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-    cerberus->Textures.aoMap.loadFromFile(getAssetPath() + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-    cerberus->Textures.metallicMap.loadFromFile(getAssetPath() + "models/cerberus/metallic.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-    cerberus->Textures.roughnessMap.loadFromFile(getAssetPath() + "models/cerberus/roughness.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
+    loadTexture(cerberus->Textures.albedoMap, getAssetPath() + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+    loadTexture(cerberus->Textures.normalMap, getAssetPath() + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, vks::compression::TextureContent::NormalMap);
+    // ao, roughness & metallic are cooked into one texture next to the sources
+    loadORMTexture(cerberus->Textures.ormMap, getAssetPath() + "models/cerberus/orm.ktx", getAssetPath() + "models/cerberus/ao.ktx",
+        getAssetPath() + "models/cerberus/roughness.ktx", getAssetPath() + "models/cerberus/metallic.ktx", cerberus->meshProperty.matConstants);
     cerberus->set_node(*cerberusNode);
     // components are collected & managed independently, now collected by scene
     CurrentScene->add_component(std::move(cerberus));
@@ -339,11 +434,20 @@ void voko::loadScene2() {
     // Add background wall
     std::unique_ptr<Node> StoneFloor02Node = std::make_unique<Node>(0, "StoneFloor02");
     std::unique_ptr<Mesh> StoneFloor02 = std::make_unique<Mesh>("StoneFloor02");
-    StoneFloor02->VkGltfModel.loadFromFile(getAssetPath() + "models/deferred_box.gltf", vulkanDevice, queue, glTFLoadingFlags);
+    loadModel(StoneFloor02->VkGltfModel, getAssetPath() + "models/deferred_box.gltf", glTFLoadingFlags);
     // StoneFloor02 has only albedo & normal map
     StoneFloor02->meshProperty.usedSamplers = voko_global::EMeshSamplerFlags::ALBEDO | voko_global::EMeshSamplerFlags::NORMAL;
-    StoneFloor02->Textures.albedoMap.loadFromFile(getAssetPath() + "textures/stonefloor02_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-    StoneFloor02->Textures.normalMap.loadFromFile(getAssetPath() + "textures/stonefloor02_normal_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+    if (voko_global::bVirtualTextures)
+    {
+        // Paged in as the view needs them
+        virtualTextures->add(StoneFloor02->Textures.albedoMap, getAssetPath() + "textures/stonefloor02_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+        virtualTextures->add(StoneFloor02->Textures.normalMap, getAssetPath() + "textures/stonefloor02_normal_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+    }
+    else
+    {
+        loadTexture(StoneFloor02->Textures.albedoMap, getAssetPath() + "textures/stonefloor02_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+        loadTexture(StoneFloor02->Textures.normalMap, getAssetPath() + "textures/stonefloor02_normal_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vks::compression::TextureContent::NormalMap);
+    }
     StoneFloor02->set_node(*StoneFloor02Node);
     CurrentScene->add_component(std::move(StoneFloor02));
     CurrentScene->add_node(std::move(StoneFloor02Node));
@@ -385,13 +489,16 @@ void voko::loadScene3() {
     CurrentScene->add_node(std::move(OwnerNode));
     CurrentScene->add_component(std::move(dirLight));
 
+    // Cube instances overlap along the view diagonal
+    voko_global::bDepthPrepass = true;
+
     // Add instanced objects for shadow quality visualization
-    const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY;
+    const uint32_t glTFLoadingFlags = sceneLoadingFlags(vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY);
     std::unique_ptr<Node> cubeNode = std::make_unique<Node>(0, "CubeNode");
     std::unique_ptr<Mesh> cube = std::make_unique<Mesh>("Cube");
-    cube->VkGltfModel.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
+    loadModel(cube->VkGltfModel, getAssetPath() + "models/cube.gltf", glTFLoadingFlags);
     for(int i=0;i<10.0;i++) {
-        cube->Instances.push_back(voko_buffer::PerInstanceSSBO{.instancePos = glm::vec4(i,i,i,1.0f)});
+        cube->Instances.emplace_back(glm::translate(glm::mat4(1.0f), glm::vec3(i, i, i)));
     }
     // cube has no texture
     cube->meshProperty.usedSamplers = 0;
@@ -402,7 +509,7 @@ void voko::loadScene3() {
 
     // std::unique_ptr<Node> sphereNode = std::make_unique<Node>(0, "SphereNode");
     // std::unique_ptr<Mesh> sphere = std::make_unique<Mesh>("Sphere");
-    // sphere->VkGltfModel.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
+    // loadModel(sphere->VkGltfModel, getAssetPath() + "models/sphere.gltf", glTFLoadingFlags);
     // sphere->meshProperty.usedSamplers = 0;
     // sphere->set_node(*sphereNode);
     // CurrentScene->add_component(std::move(sphere));
@@ -426,35 +533,41 @@ void voko::buildIBL() {
     // Enable ibl for environment lighting
     uniformBufferLighting.useIBL = 1;
 
-    // IBL preparations: cubes & env cube map
-    // Add cube mesh for ibl calculation
-    const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-    voko_global::skybox.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
-    // environment cube map
-    iblTextures.environmentCube.loadFromFile(getAssetPath() + "textures/hdr/gcanyon_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
+    // IBL preparations: skybox cube & env cube map
+    const uint32_t glTFLoadingFlags = modelLoadingFlags(vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors
+        | vkglTF::FileLoadingFlags::FlipY);
+    loadModel(voko_global::skybox, getAssetPath() + "models/cube.gltf", glTFLoadingFlags);
+    // environment cube map, read while the models import
+    const std::string environmentFilename = getAssetPath() + "textures/hdr/gcanyon_cube.ktx";
+    iblTextures.environmentCube.loadFromFile(environmentFilename, VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
+    // Scene & skybox geometry in one batch
+    finishModelLoads();
     // Precompute IBL
     bComputeIBL = true;
 
     if(bComputeIBL) {
-        generateBRDFLUT();
-        generateIrradianceCube();
-        generatePrefilteredCube();
+        precomputeIBL(environmentFilename);
         bComputeIBL = false;
     }
+    textureResidency->track(&iblTextures.environmentCube);
+    textureResidency->track(&iblTextures.lutBrdf);
+    textureResidency->track(&iblTextures.irradianceCube);
+    textureResidency->track(&iblTextures.prefilteredCube);
 
 
 }
 
 void voko::buildMeshes()
 {
-    CreatePerMeshDescriptor();
-
     voko_global::SceneMeshes = CurrentScene->get_components<Mesh>();
 
-    for(int Mesh_Index=0;Mesh_Index< voko_global::SceneMeshes.size();Mesh_Index++)
-    {
-        CreateAndUploadPerMeshBuffer(voko_global::SceneMeshes[Mesh_Index], Mesh_Index);
-    }
+    // Fixed size page cache, whatever the scene's virtual textures add up to
+    virtualTextures->prepare();
+    textureResidency->track(&virtualTextures->getCache());
+
+    // One set for all meshes, draws pick their mesh by push constant
+    CreateAndUploadMeshBuffers();
+    CreateMeshDescriptor();
 }
 
 void voko::buildLights() {
@@ -490,8 +603,18 @@ void voko::render()
     if (!prepared) 
     	return;
 
+    voko_global::frameSlot = (voko_global::frameSlot + 1) % voko_global::FRAME_SLOTS;
     updateCSM();
     UpdateSceneUniformBuffer();
+    // Mip priorities use this frame's view
+    streamTextures();
+    SceneRenderer->UpdateView(uniformBufferView.viewMatrix, uniformBufferView.projectionMatrix);
+
+    // Upload instances edited since last frame
+    for (Mesh* mesh : voko_global::SceneMeshes)
+    {
+        mesh->flush_instances();
+    }
 
     draw();
 }
@@ -730,18 +853,10 @@ VkPipelineShaderStageCreateInfo voko::loadShader(std::string fileName, VkShaderS
 
 void voko::CreateSceneDescriptor()
 {
-    // Scene pool
-    std::vector<VkDescriptorPoolSize> poolSizes = {
-        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),
-    };
-    VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
-    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &SceneDescriptorPool));
-
-    
     std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-        // Binding 0: Scene Uniform Buffer: view info, light info...
-        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS, 0),
+        // Binding 0: View uniform buffer, camera matrices
+        // Also read by the culling compute shaders
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, 0),
         // IBLs:
         // Binding 1: Environment Cube
         vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
@@ -750,52 +865,44 @@ void voko::CreateSceneDescriptor()
         // Binding 3: lutBrdf
         vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS, 3),
         // Binding 4: prefiltered
-        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS, 4)
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS, 4),
+        // Binding 5: Lighting uniform buffer, lights & shadow cascades
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, 5),
+        // Binding 6: Debug uniform buffer, lighting pass switches
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, 6)
     };
 
-    VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &voko_global::SceneDescriptorSetLayout));
-
-    // Sets
-    std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-    VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(SceneDescriptorPool, &voko_global::SceneDescriptorSetLayout, 1);
-    
-    // mapping 
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &voko_global::SceneDescriptorSet));
-    writeDescriptorSets = {
-        // Binding 0: Vertex shader uniform buffer
-        vks::initializers::writeDescriptorSet(voko_global::SceneDescriptorSet,
-                                              VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
-                                              &SceneUB.descriptor),
+    voko_global::SceneDescriptorSetLayout = descriptorAllocator->getLayout(setLayoutBindings);
+    voko_global::SceneDescriptorSet = descriptorAllocator->allocate(voko_global::SceneDescriptorSetLayout);
+    descriptorAllocator->update(voko_global::SceneDescriptorSet, voko_global::SceneDescriptorSetLayout, {
+        // Binding 0: View uniform buffer
+        sceneUniforms->getDescriptor(sceneUniformBlocks.view),
         // Binding 1: Environment map
-        vks::initializers::writeDescriptorSet(voko_global::SceneDescriptorSet,
-                                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
-                                              &iblTextures.environmentCube.descriptor),
-        // Binding 2: IBLs
-        vks::initializers::writeDescriptorSet(voko_global::SceneDescriptorSet,
-                                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2,
-                                              &iblTextures.irradianceCube.descriptor),
-        vks::initializers::writeDescriptorSet(voko_global::SceneDescriptorSet,
-                                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3,
-                                              &iblTextures.lutBrdf.descriptor),
-        vks::initializers::writeDescriptorSet(voko_global::SceneDescriptorSet,
-                                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4,
-                                              &iblTextures.prefilteredCube.descriptor)
-    };
-    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0,
-                           nullptr);
+        iblTextures.environmentCube.descriptor,
+        // Binding 2-4: IBLs
+        iblTextures.irradianceCube.descriptor,
+        iblTextures.lutBrdf.descriptor,
+        iblTextures.prefilteredCube.descriptor,
+        // Binding 5-6: Lighting & debug uniform buffers
+        sceneUniforms->getDescriptor(sceneUniformBlocks.lighting),
+        sceneUniforms->getDescriptor(sceneUniformBlocks.debug)
+    });
+
+    // Every block of a slot shares its offset, dynamic offsets follow the binding order
+    for (uint32_t slot = 0; slot < voko_global::FRAME_SLOTS; slot++)
+    {
+        voko_global::SceneDynamicOffsets[slot].fill(sceneUniforms->getDynamicOffset(slot));
+    }
 }
 
 void voko::CreateSceneUniformBuffer()
 {
-    // std::cout << "Scene UB Size: "<< sizeof(uniformBufferScene) << std::endl;
-
-    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-     &SceneUB, sizeof(uniformBufferScene)));
-
-
-    // Map persistent
-    VK_CHECK_RESULT(SceneUB.map());
+    // View changes every frame, lighting with the animated lights & cascades, debug on user input
+    sceneUniforms = std::make_unique<vks::UniformRing>(vulkanDevice, voko_global::FRAME_SLOTS);
+    sceneUniformBlocks.view = sceneUniforms->addBlock(&uniformBufferView, sizeof(uniformBufferView));
+    sceneUniformBlocks.lighting = sceneUniforms->addBlock(&uniformBufferLighting, sizeof(uniformBufferLighting));
+    sceneUniformBlocks.debug = sceneUniforms->addBlock(&uniformBufferDebug, sizeof(uniformBufferDebug));
+    sceneUniforms->create();
 }
 
 void voko::UpdateSceneUniformBuffer()
@@ -804,6 +911,7 @@ void voko::UpdateSceneUniformBuffer()
     uniformBufferView.projectionMatrix = camera.matrices.perspective;
     uniformBufferView.viewMatrix = camera.matrices.view;
     uniformBufferView.inverseViewMatrix = glm::inverse(camera.matrices.view);
+    uniformBufferView.viewProjectionMatrix = camera.matrices.perspective * camera.matrices.view;
 
     // why revert x&z? 
     uniformBufferView.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);;
@@ -830,7 +938,8 @@ void voko::UpdateSceneUniformBuffer()
     
         uniformBufferLighting.spotLights[i].viewMatrix = shadowProj * shadowView;
     }
-    memcpy(SceneUB.mapped, &uniformBufferScene, sizeof(uniformBufferScene));
+    // The frame that last used this slot finished in submitFrame
+    sceneUniforms->update(voko_global::frameSlot);
 }
 
 /*
@@ -920,142 +1029,264 @@ void voko::updateCSM()
 	}
 }
 
-void voko::CreatePerMeshDescriptor()
+void voko::CreateAndUploadMeshBuffers()
 {
-    // Create Per Mesh SSBO Pool
+    const auto& meshes = voko_global::SceneMeshes;
+    const uint32_t meshCount = static_cast<uint32_t>(meshes.size());
+
+    // Lay out every mesh's instances in one buffer, every mesh draws at least one instance
+    uint32_t instanceCount = 0;
+    const vkglTF::VertexFormat sceneVertexFormat = voko_global::bCompactVertices ? vkglTF::VertexFormat::Compact : vkglTF::VertexFormat::Full;
+    for (uint32_t Mesh_Index = 0; Mesh_Index < meshCount; Mesh_Index++)
+    {
+        Mesh* mesh = meshes[Mesh_Index];
+        // Scene pipelines are built for one vertex layout (skinned models load as CompactSkinned)
+        if (mesh->VkGltfModel.vertexFormat != sceneVertexFormat)
+        {
+            vks::tools::exitFatal("Mesh \"" + mesh->get_name() + "\" vertex layout doesn't match the scene pipelines!", VK_ERROR_FORMAT_NOT_SUPPORTED);
+        }
+        // Depth only passes draw the position stream
+        if (!mesh->VkGltfModel.positionStream.valid)
+        {
+            vks::tools::exitFatal("Mesh \"" + mesh->get_name() + "\" has no position stream, load it with FileLoadingFlags::PositionStream!", VK_ERROR_FORMAT_NOT_SUPPORTED);
+        }
+        if (mesh->Instances.empty())
+        {
+            mesh->Instances.emplace_back();
+        }
+        mesh->instanceOffset = instanceCount;
+        instanceCount += mesh->get_instance_count();
+    }
+
+    // Materials & bindless texture table, meshes with the same material share it & textures shared by materials are only referenced once
+    // Keyed by content plus the samplers streaming enables later, so a shared material is enabled for every mesh at once
+    struct MaterialKey
+    {
+        voko_buffer::MaterialSSBO material;
+        uint32_t streamingSamplers;
+    };
+    auto materialLess = [](const MaterialKey& a, const MaterialKey& b) {
+        const int order = memcmp(&a.material, &b.material, sizeof(voko_buffer::MaterialSSBO));
+        return order != 0 ? order < 0 : a.streamingSamplers < b.streamingSamplers;
+    };
+    std::map<MaterialKey, uint32_t, decltype(materialLess)> materialSlots(materialLess);
+    std::vector<voko_buffer::MaterialSSBO> materials;
+    BindlessTextures.clear();
+    BindlessTextureSlots.clear();
+    for (uint32_t Mesh_Index = 0; Mesh_Index < meshCount; Mesh_Index++)
+    {
+        Mesh* mesh = meshes[Mesh_Index];
+        const auto& matConstants = mesh->meshProperty.matConstants;
+        // Zeroed first, the whole struct is compared bytewise
+        voko_buffer::MaterialSSBO material;
+        memset(&material, 0, sizeof(material));
+        uint32_t streamingSamplers = 0;
+        material.rgba = matConstants.rgba;
+        material.metallic = matConstants.metallic;
+        material.roughness = matConstants.roughness;
+        material.ao = matConstants.ao;
+        material.usedSamplers = 0;
+        material.virtualSamplers = 0;
+
+        for (auto meshSampler : voko_global::meshSamplers)
+        {
+            material.textureIndices[meshSampler.slot] = 0;
+            // Only loaded textures count as used, streamed ones get their slot now & are enabled by streamTextures
+            const vks::Texture2D& texture = mesh->Textures.GetTexture(meshSampler.flag);
+            const bool streaming = isTextureStreaming(texture);
+            if (!(mesh->meshProperty.usedSamplers & meshSampler.flag) || (texture.view == VK_NULL_HANDLE && !streaming))
+            {
+                continue;
+            }
+            auto [it, inserted] = BindlessTextureSlots.try_emplace(&texture, static_cast<uint32_t>(BindlessTextures.size()));
+            if (inserted)
+            {
+                BindlessTextures.push_back(streaming ? VkDescriptorImageInfo{} : texture.descriptor);
+            }
+            material.textureIndices[meshSampler.slot] = it->second;
+            // Virtual textures are sampled through their page table, the material points at the virtual texture
+            const uint32_t virtualTexture = virtualTextures->find(&texture);
+            if (virtualTexture != vks::VirtualTextureCache::INVALID)
+            {
+                virtualTextures->setPageTableIndex(virtualTexture, it->second);
+                material.textureIndices[meshSampler.slot] = virtualTexture;
+                material.virtualSamplers |= meshSampler.flag;
+            }
+            if (!streaming)
+            {
+                material.usedSamplers |= meshSampler.flag;
+            }
+            else
+            {
+                streamingSamplers |= meshSampler.flag;
+            }
+        }
+        auto [slot, inserted] = materialSlots.try_emplace(MaterialKey{ material, streamingSamplers }, static_cast<uint32_t>(materials.size()));
+        if (inserted)
+        {
+            materials.push_back(material);
+        }
+        mesh->materialIndex = slot->second;
+    }
+    const uint32_t materialCount = static_cast<uint32_t>(materials.size());
+    if (BindlessTextures.size() > voko_global::BINDLESS_TEXTURE_MAX)
+    {
+        vks::tools::exitFatal("Scene textures exceed BINDLESS_TEXTURE_MAX!", VK_ERROR_TOO_MANY_OBJECTS);
+    }
+
+    // Draw data
+    std::vector<voko_buffer::MeshDrawData> drawData(meshCount);
+    for (uint32_t Mesh_Index = 0; Mesh_Index < meshCount; Mesh_Index++)
+    {
+        Mesh* mesh = meshes[Mesh_Index];
+        mesh->meshProperty.modelMatrix = mesh->get_node()->get_transform().get_matrix();
+
+        const auto& dimensions = mesh->VkGltfModel.dimensions;
+        const glm::vec3 center = (dimensions.min + dimensions.max) * 0.5f;
+        const float radius = glm::length(dimensions.max - dimensions.min) * 0.5f;
+
+        voko_buffer::MeshDrawData& draw = drawData[Mesh_Index];
+        draw.modelMatrix = mesh->meshProperty.modelMatrix;
+        draw.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(draw.modelMatrix))));
+        draw.localSphere = glm::vec4(center, radius);
+        draw.positionScale = glm::vec4(mesh->VkGltfModel.dequantization.scale, 0.0f);
+        draw.positionOffset = glm::vec4(mesh->VkGltfModel.dequantization.offset, 0.0f);
+        draw.materialIndex = mesh->materialIndex;
+        draw.instanceOffset = mesh->instanceOffset;
+        draw.instanceCount = mesh->get_instance_count();
+        draw.padding = 0;
+    }
+
+    // Storage buffers can't be zero sized
+    const VkDeviceSize drawDataSize = sizeof(voko_buffer::MeshDrawData) * std::max(meshCount, 1u);
+    const VkDeviceSize materialSize = sizeof(voko_buffer::MaterialSSBO) * std::max(materialCount, 1u);
+    const VkDeviceSize instanceSize = sizeof(voko_buffer::PerInstanceSSBO) * std::max(instanceCount, 1u);
+    const VkDeviceSize visibleInstanceSize = sizeof(uint32_t) * std::max(instanceCount, 1u);
+
+    // Create -> map -> upload draw data & materials
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &MeshDrawSSBO, drawDataSize));
+    VK_CHECK_RESULT(MeshDrawSSBO.map());
+    memcpy(MeshDrawSSBO.mapped, drawData.data(), sizeof(voko_buffer::MeshDrawData) * meshCount);
+
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &MaterialSSBO, materialSize));
+    VK_CHECK_RESULT(MaterialSSBO.map());
+    memcpy(MaterialSSBO.mapped, materials.data(), sizeof(voko_buffer::MaterialSSBO) * materialCount);
+
+    // Create -> map -> upload instances, kept mapped for incremental edits
+    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &InstanceSSBO, instanceSize));
+    VK_CHECK_RESULT(InstanceSSBO.map());
+    auto* mappedInstances = static_cast<voko_buffer::PerInstanceSSBO*>(InstanceSSBO.mapped);
+    for (Mesh* mesh : meshes)
+    {
+        mesh->mappedInstances = mappedInstances + mesh->instanceOffset;
+        memcpy(mesh->mappedInstances, mesh->Instances.data(), sizeof(voko_buffer::PerInstanceSSBO) * mesh->get_instance_count());
+    }
+
+    // Visible instances are gpu written: device local, identity until culled
+    {
+        std::vector<uint32_t> identity(std::max(instanceCount, 1u));
+        for (uint32_t i = 0; i < identity.size(); i++)
+        {
+            identity[i] = i;
+        }
+        vks::Buffer staging;
+        VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &staging, visibleInstanceSize, identity.data()));
+        VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &VisibleInstanceSSBO, visibleInstanceSize));
+        vulkanDevice->copyBuffer(&staging, &VisibleInstanceSSBO, queue);
+        staging.destroy();
+    }
+}
+
+void voko::CreateMeshDescriptor()
+{
+    const uint32_t textureCount = static_cast<uint32_t>(BindlessTextures.size());
+
+    // Create Mesh Ds Pool
     std::vector<VkDescriptorPoolSize> poolSizes = {
-        // 1 for meshPropsSSBO, 1 for meshInstanceSSBO
-        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, voko_global::MESH_MAX * 2),
-        // mesh_max * mesh_samplers_max
-        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, voko_global::MESH_MAX * voko_global::MESH_SAMPLER_MAX)
+        // draw data, instances, materials, visible instances, virtual textures, virtual feedback
+        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),
+        // page cache & textures
+        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + std::max(textureCount, 1u))
     };
-    VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, voko_global::MESH_MAX);
-    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &PerMeshDescriptorPool));
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+    descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &MeshDescriptorPool));
 
-    // Declare DescriptorSet Layout    
+    // Declare DescriptorSet Layout
     std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-        // Binding 0: Mesh Props SSBO
-        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS, 0),
-        // Binding 1: Mesh Instance SSBO
-        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS, 1),
+        // Binding 0: Mesh Draw Data, compute for instance culling
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, voko_global::MESH_BINDING_DRAW_DATA),
+        // Binding 1: All Mesh Instances
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, voko_global::MESH_BINDING_INSTANCES),
+        // Binding 2: Materials, deduplicated by content (MeshDrawData::materialIndex)
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, voko_global::MESH_BINDING_MATERIALS),
+        // Binding 3: Visible Instance Indices, written by instance culling
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, voko_global::MESH_BINDING_VISIBLE_INSTANCES),
+        // Binding 4: Virtual textures
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, voko_global::MESH_BINDING_VIRTUAL_TEXTURES),
+        // Binding 5: Virtual texture page cache
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, voko_global::MESH_BINDING_VIRTUAL_PAGE_CACHE),
+        // Binding 6: Virtual texture feedback, written by the geometry pass
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, voko_global::MESH_BINDING_VIRTUAL_FEEDBACK),
+        // Binding 7: Bindless textures
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, voko_global::MESH_BINDING_TEXTURES, voko_global::BINDLESS_TEXTURE_MAX),
     };
 
-    for(auto meshSampler : voko_global::meshSamplers) {
-        setLayoutBindings.emplace_back(
-            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, meshSampler.binding));
-    }
-  //   // Binding 2: Mesh Albedo map
-  //   vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
-  //   // Binding 3: Mesh Normal map
-  //   vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
-  //   // Binding 4: Mesh Metallic map
-  //   vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
-  //   // Binding 5: Mesh Roughness map
-  //  vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
-  //   // Binding 6: Mesh AO map
-  // vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
-
-    // Enable partially bound extensions for meshes with variable textures using same ds layout
-    // [POI] The fragment shader will be using an unsized array of samplers, which has to be marked with the VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT
+    // [POI] The fragment shader indexes an unsized array of samplers, which has to be marked with the VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT
     VkDescriptorSetLayoutBindingFlagsCreateInfoEXT setLayoutBindingFlags{};
     setLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
     setLayoutBindingFlags.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-    // Binding 0&1 is the buffer, which does not use indexing
-    // Binding 2-6 are the fragment shader images, which use indexing
+    // Binding 0-6 are buffers & the page cache, binding 7 is the indexed texture array
+    // Streamed textures & page tables are written into it between frames, the prerecorded command buffers stay valid (update after bind)
     std::vector<VkDescriptorBindingFlagsEXT> descriptorBindingFlags = {
-        0,0,
-        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
-        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
-        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
-        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
-        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+        0, 0, 0, 0, 0, 0, 0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
     };
     setLayoutBindingFlags.pBindingFlags = descriptorBindingFlags.data();
 
-    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI  = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-    // descriptorSetLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
     descriptorSetLayoutCI.pNext = &setLayoutBindingFlags;
+    descriptorSetLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &voko_global::MeshDescriptorSetLayout));
 
-    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &voko_global::PerMeshDescriptorSetLayout));
+    // Allocate with the scene's actual texture count
+    uint32_t variableDescCount = std::max(textureCount, 1u);
+    VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorCountAllocInfo{};
+    variableDescriptorCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+    variableDescriptorCountAllocInfo.descriptorSetCount = 1;
+    variableDescriptorCountAllocInfo.pDescriptorCounts = &variableDescCount;
 
+    VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(MeshDescriptorPool, &voko_global::MeshDescriptorSetLayout, 1);
+    allocInfo.pNext = &variableDescriptorCountAllocInfo;
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &voko_global::MeshDescriptorSet));
 
-    voko_global::PerMeshDescriptorSets.resize(voko_global::MESH_MAX);
-    for(int Mesh_Index = 0; Mesh_Index < voko_global::MESH_MAX; Mesh_Index++)
-    {
-        // pre allocate ds for meshes
-        VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(PerMeshDescriptorPool, &voko_global::PerMeshDescriptorSetLayout, 1);
-        VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &voko_global::PerMeshDescriptorSets[Mesh_Index]));
-    }
-}
-
-void voko::CreateAndUploadPerMeshBuffer(Mesh* mesh, uint32_t MeshIndex) const
-{
-    // 0: Mesh Prop
-    vks::Buffer& meshPropSSBO = mesh->meshPropSSBO;
-    uint32_t meshPropsSSBOSize = sizeof(voko_buffer::MeshProperty);
-    // 1: Mesh Instance
-    vks::Buffer& instanceSSBO = mesh->instanceSSBO;
-    uint32_t instanceSSBOSize = sizeof(voko_buffer::PerInstanceSSBO) * static_cast<uint32_t>(mesh->Instances.size());
-
-    // Create -> map -> upload mesh ssbo
-    VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &meshPropSSBO, meshPropsSSBOSize));
-    VK_CHECK_RESULT(meshPropSSBO.map());
-    mesh->meshProperty.modelMatrix = mesh->get_node()->get_transform().get_matrix();
-    memcpy(meshPropSSBO.mapped, 
-        &mesh->meshProperty,
-        meshPropsSSBOSize);
-
-    std::vector<VkWriteDescriptorSet> writeDescriptorSets = 
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets =
     {
-        // Binding 0: Mesh Prop Buffer
-        vks::initializers::writeDescriptorSet(voko_global::PerMeshDescriptorSets[MeshIndex], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &meshPropSSBO.descriptor),
+        vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, voko_global::MESH_BINDING_DRAW_DATA, &MeshDrawSSBO.descriptor),
+        vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, voko_global::MESH_BINDING_INSTANCES, &InstanceSSBO.descriptor),
+        vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, voko_global::MESH_BINDING_MATERIALS, &MaterialSSBO.descriptor),
+        vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, voko_global::MESH_BINDING_VISIBLE_INSTANCES, &VisibleInstanceSSBO.descriptor),
+        vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, voko_global::MESH_BINDING_VIRTUAL_TEXTURES, &virtualTextures->getInfoDescriptor()),
+        vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, voko_global::MESH_BINDING_VIRTUAL_PAGE_CACHE, &virtualTextures->getCache().descriptor),
+        vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, voko_global::MESH_BINDING_VIRTUAL_FEEDBACK, &virtualTextures->getFeedbackDescriptor()),
     };
-
-    // Only update mesh instance ssbo when valid data
-    if (instanceSSBOSize != 0) {
-        // Create -> map -> upload instance ssbo
-        VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &instanceSSBO, instanceSSBOSize));
-        VK_CHECK_RESULT(instanceSSBO.map());
-        memcpy(instanceSSBO.mapped,
-            mesh->Instances.data(),
-            instanceSSBOSize);
-
-    	// Binding 1: Mesh Instance Buffer
-        writeDescriptorSets.emplace_back(
-            vks::initializers::writeDescriptorSet(voko_global::PerMeshDescriptorSets[MeshIndex], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &instanceSSBO.descriptor));
-    }
-
-    // Only update sampler when valid data
-    for (auto meshSampler: voko_global::meshSamplers) {
-        if(mesh->meshProperty.usedSamplers & meshSampler.flag){
-            writeDescriptorSets.emplace_back(
-                vks::initializers::writeDescriptorSet(
-                    voko_global::PerMeshDescriptorSets[MeshIndex],
-                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                    meshSampler.binding,
-                    &mesh->Textures.GetTexture(meshSampler.flag).descriptor)
-            );
-        }else {
-
-            // to-do: if partially bound ext is not enabled, upload a 1x1 `null` image
-
-            // VkDescriptorImageInfo emptyImageInfo = {};
-            // emptyImageInfo.sampler = VK_NULL_HANDLE;
-            // emptyImageInfo.imageView = VK_NULL_HANDLE;
-            // emptyImageInfo.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            // writeDescriptorSets.emplace_back(
-            //     vks::initializers::writeDescriptorSet(
-            //         voko_global::PerMeshDescriptorSets[MeshIndex],
-            //         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            //         meshSampler.binding,
-            //         &emptyImageInfo)
-            // );
+    // Partially bound: only loaded textures are written, streamed ones follow in streamTextures
+    for (uint32_t i = 0; i < textureCount; i++)
+    {
+        if (BindlessTextures[i].imageView == VK_NULL_HANDLE)
+        {
+            continue;
         }
+        VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, voko_global::MESH_BINDING_TEXTURES, &BindlessTextures[i]);
+        writeDescriptorSet.dstArrayElement = i;
+        writeDescriptorSets.push_back(writeDescriptorSet);
     }
 
-    // Update pre-allocated descriptor sets
     vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 }
 
@@ -1063,6 +1294,36 @@ void voko::CreateAndUploadPerMeshBuffer(Mesh* mesh, uint32_t MeshIndex) const
 
 voko::~voko()
 {
+    // Passes go while everything they use is still there, the gpu must be done with their objects
+    if (SceneRenderer)
+    {
+        vkDeviceWaitIdle(device);
+        SceneRenderer.reset();
+    }
+    // Running loads finish first, textures read but never uploaded are dropped
+    voko_global::jobSystem = nullptr;
+    jobSystem.reset();
+    voko_global::descriptorAllocator = nullptr;
+    descriptorAllocator.reset();
+    // Global models (the skybox) keep their reference past the device, only their ranges are released later
+    vkglTF::geometryArena->destroy();
+    vkglTF::geometryArena.reset();
+    sceneUniforms.reset();
+    virtualTextures.reset();
+    for (const auto& pending : pendingTextures)
+    {
+        if (pending->ktx)
+        {
+            ktxTexture_Destroy(pending->ktx);
+        }
+    }
+    for (vks::Texture2D* texture : streamingTextures)
+    {
+        ktxTexture_Destroy(texture->streamSource);
+        texture->streamSource = nullptr;
+    }
+    vkglTF::mipGenerator.reset();
+
 	if(SDLWindow)
 	{
         SDL_DestroyWindow(SDLWindow);
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <unordered_map>
 #include <iostream>
 #include <memory>
 #include <chrono>
@@ -21,6 +22,14 @@
 #include "VulkanDevice.h"
 #include "VulkanglTFModel.h"
 #include "VulkanTexture.h"
+#include "JobSystem.h"
+#include "UploadBatch.h"
+#include "TextureCompression.h"
+#include "TextureResidency.h"
+#include "TexturePacking.h"
+#include "VirtualTexture.h"
+#include "DescriptorAllocator.h"
+#include "UniformRing.h"
 #include "VulkanFrameBuffer.hpp"
 
 // self defined scene graph
@@ -179,6 +188,57 @@ public:
     // Scene Management
     std::unique_ptr<Scene> CurrentScene;
 
+    // Asset loading (voko_loading.cpp): file reads, parsing & vertex processing run as jobs, their gpu work is batched on the main thread
+    std::unique_ptr<vks::JobSystem> jobSystem;
+    struct PendingModel {
+        vkglTF::Model* model;
+        vks::JobSystem::Handle job;
+    };
+    std::vector<PendingModel> pendingModels;
+    struct PendingTexture {
+        vks::Texture2D* texture;
+        std::string filename;
+        // Uploaded format, a block format when the job compresses the file
+        VkFormat format;
+        // Written by the job, null when the file couldn't be read
+        ktxTexture* ktx = nullptr;
+        vks::JobSystem::Handle job;
+    };
+    std::vector<std::unique_ptr<PendingTexture>> pendingTextures;
+    // Uploaded with their mip tail, finer mips stream in by on screen texel density
+    std::vector<vks::Texture2D*> streamingTextures;
+    // Every texture's memory against the budget, evicts mips of streaming textures off screen
+    std::unique_ptr<vks::TextureResidency> textureResidency;
+    // Page cache & page tables of the virtual textures, textures are added by the scene loaders (voko_global::bVirtualTextures)
+    std::unique_ptr<vks::VirtualTextureCache> virtualTextures;
+    // baseFlags plus the import optimization & the cooked cache, shared by every loaded model
+    uint32_t modelLoadingFlags(uint32_t baseFlags) const;
+    // modelLoadingFlags plus what the scene passes need of the scene meshes (position stream, compact vertices, lods, meshlets)
+    uint32_t sceneLoadingFlags(uint32_t baseFlags) const;
+    // Queues the model's import, it's drawable after finishModelLoads
+    vks::JobSystem::Handle loadModel(vkglTF::Model& model, const std::string& filename, uint32_t fileLoadingFlags);
+    // Queues the texture's read, materials sample their constants until streamTextures uploaded it
+    // format: of the file's data, content picks the block format it's compressed to (voko_global::bTextureCompression)
+    vks::JobSystem::Handle loadTexture(vks::Texture2D& texture, const std::string& filename, VkFormat format,
+        vks::compression::TextureContent content = vks::compression::TextureContent::Color);
+    // Packs the single channel occlusion / roughness / metallic files into cookedFilename (vks::packing::loadORM) unless it's up to date,
+    // empty names use the constant, the packed texture loads like loadTexture
+    vks::JobSystem::Handle loadORMTexture(vks::Texture2D& texture, const std::string& cookedFilename, const std::string& occlusionFilename,
+        const std::string& roughnessFilename, const std::string& metallicFilename, const voko_buffer::MaterialConstants& constants);
+    // read: fills the ktx texture on the job, compressed afterwards like every scene texture
+    vks::JobSystem::Handle submitTextureLoad(vks::Texture2D& texture, const std::string& filename, VkFormat format, vks::compression::TextureContent content,
+        std::function<ktxResult(ktxTexture**)> read);
+    bool isTextureStreaming(const vks::Texture2D& texture) const;
+    // Waits for the queued models & uploads them in one batch, with the textures read so far
+    void finishModelLoads();
+    std::vector<vks::Texture2D*> uploadReadTextures(vks::UploadBatch& batch);
+    // Stages finer mips of visible streaming textures within the frame budget, evicts mips of the others over the memory budget
+    // Returns the textures whose view changed
+    std::vector<vks::Texture2D*> streamTextureMips(vks::UploadBatch& batch);
+    // Per frame: uploads the textures read, the mips streamed & the virtual texture pages requested since the last one in one batch,
+    // swaps them into the bindless table
+    void streamTextures();
+
 
     void loadScene();
     void loadScene2();
@@ -190,7 +250,8 @@ public:
     void buildLights();
 
     // Scene Renderers
-    SceneRenderer* SceneRenderer;
+    // Destroyed first in ~voko, its passes release into the descriptor allocator & wait on the job system
+    std::unique_ptr<SceneRenderer> SceneRenderer;
 
     // Scene Config
     // Keep depth range as small as possible
@@ -209,6 +270,21 @@ public:
         vks::TextureCubeMap prefilteredCube;
     }iblTextures;
 
+    // Generation settings, part of the cached maps' keys
+    struct IBLSettings {
+        VkFormat lutFormat = VK_FORMAT_R16G16_SFLOAT; // R16G16 is supported pretty much everywhere
+        uint32_t lutDim = 512;
+        // Cube formats are the storage formats their filtering shaders write
+        VkFormat irradianceFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+        uint32_t irradianceDim = 64;
+        uint32_t irradianceSamples = 128;
+        VkFormat prefilteredFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+        uint32_t prefilteredDim = 512;
+        uint32_t prefilteredSamples = 32;
+    }iblSettings;
+
+    // Loads the maps cached for the environment, generates & caches the stale ones
+    void precomputeIBL(const std::string& environmentFilename);
     void generateBRDFLUT();
     void generateIrradianceCube();
     void generatePrefilteredCube();
@@ -330,9 +406,16 @@ public:
     voko_buffer::UniformBufferLighting& uniformBufferLighting  = uniformBufferScene.lighting;
     voko_buffer::UniformBufferDebug& uniformBufferDebug  = uniformBufferScene.debug;
 
-    VkDescriptorPool SceneDescriptorPool;
+    // Pass & scene descriptor sets, voko_global::descriptorAllocator points to it
+    std::unique_ptr<vks::DescriptorAllocator> descriptorAllocator;
 
-    vks::Buffer SceneUB;
+    // Per frame slot copies of the scene blocks, each written when it changed
+    std::unique_ptr<vks::UniformRing> sceneUniforms;
+    struct SceneUniformBlocks {
+        uint32_t view = 0;
+        uint32_t lighting = 0;
+        uint32_t debug = 0;
+    } sceneUniformBlocks;
 
     void CreateSceneUniformBuffer();
     void CreateSceneDescriptor();
@@ -340,11 +423,20 @@ public:
 
 
     
-    VkDescriptorPool PerMeshDescriptorPool;
-    // Allocate per mesh descriptor sets
-    void CreatePerMeshDescriptor();
-    // Create buffers and upload to pre-allocated corresponding sets
-    void CreateAndUploadPerMeshBuffer(Mesh* mesh, uint32_t MeshIndex) const;
+    VkDescriptorPool MeshDescriptorPool = VK_NULL_HANDLE;
+    // Scene wide mesh buffers, indexed by mesh index / instance offset / material index
+    vks::Buffer MeshDrawSSBO;
+    vks::Buffer InstanceSSBO;
+    vks::Buffer MaterialSSBO;
+    vks::Buffer VisibleInstanceSSBO;
+    // Deduplicated mesh textures, a material's texture indices point in here
+    // Streamed textures keep an empty (unwritten) slot until they're uploaded
+    std::vector<VkDescriptorImageInfo> BindlessTextures;
+    std::unordered_map<const vks::Texture2D*, uint32_t> BindlessTextureSlots;
+    // Pack all meshes' draw data, instances & materials into shared buffers
+    void CreateAndUploadMeshBuffers();
+    // Single bindless mesh descriptor set over the shared buffers & textures
+    void CreateMeshDescriptor();
     
     // require EXT dynamic uniform buffer!
     vks::Buffer meshUniformBuffer;
@@ -8,27 +8,131 @@ namespace voko_buffer {
     /*
      * Mesh buffers:
      */
-    struct PerInstanceSSBO
+    // 128 B, one per drawn instance of a mesh
+    struct alignas(16) PerInstanceSSBO
     {
-        glm::vec4 instancePos;
-        //glm::mat4 modelMatrix;
+        // Rows of the 3x4 affine transform, applied in mesh local space before the mesh model matrix
+        glm::vec4 transformRows[3];
+        // Rows of the transform's normal matrix (inverse transpose of its 3x3), kept by set_transform
+        glm::vec4 normalRows[3];
+        // Multiplies the mesh material
+        glm::vec4 colorFactor;
+        float metallicFactor;
+        float roughnessFactor;
+        float aoFactor;
+        float padding;
+
+        PerInstanceSSBO(): PerInstanceSSBO(glm::mat4(1.0f))
+        {}
+
+        explicit PerInstanceSSBO(const glm::mat4& transform, glm::vec4 _color = glm::vec4(1.0f),
+            float _m = 1.0f, float _r = 1.0f, float _a = 1.0f):
+            colorFactor(_color), metallicFactor(_m), roughnessFactor(_r), aoFactor(_a), padding(0.f)
+        {
+            set_transform(transform);
+        }
+
+        void set_transform(const glm::mat4& transform)
+        {
+            const glm::mat4 rows = glm::transpose(transform);
+            transformRows[0] = rows[0];
+            transformRows[1] = rows[1];
+            transformRows[2] = rows[2];
+
+            const glm::mat3 normalRowsMatrix = glm::inverse(glm::mat3(transform));
+            normalRows[0] = glm::vec4(normalRowsMatrix[0], 0.0f);
+            normalRows[1] = glm::vec4(normalRowsMatrix[1], 0.0f);
+            normalRows[2] = glm::vec4(normalRowsMatrix[2], 0.0f);
+        }
+
+        glm::mat4 get_transform() const
+        {
+            return glm::transpose(glm::mat4(transformRows[0], transformRows[1], transformRows[2], glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+        }
     };
 
     /*
      *
      * In glsl, dynamic sized ssbo are used like this:
     struct PerInstanceSSBO{
-        vec4 instancePos;
+        vec4 transformRows[3];
+        vec4 normalRows[3];
+        vec4 colorFactor;
+        vec4 materialFactors;
     };
     layout (std430, set = 1, binding = 1) buffer SSBOInstance
     {
         PerInstanceSSBO instances[];
     } ssboInstance
 
-    vec4 insPos = ssboInstance.instances[i].instancePos
+    PerInstanceSSBO instance = ssboInstance.instances[i];
     *
     */
 
+    // GPU occlusion culling input, one per scene mesh
+    struct alignas(16) CullDrawData {
+        glm::vec4 boundingSphere; // xyz: world center, w: radius
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t firstInstance;
+    };
+
+    // Meshlet culling input, one per meshlet of the culled meshes' lod levels
+    struct alignas(16) MeshletData {
+        glm::vec4 boundingSphere; // xyz: mesh local center, w: radius
+        glm::vec4 cone; // xyz: mesh local normal cone axis, w: cutoff, 1 when never backfacing
+        // In the arena index buffer, in elements of the model's index type
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        // 1: the model's indices are 16 bit
+        uint32_t index16;
+        uint32_t padding;
+    };
+
+    // Per culled mesh & frame: meshlets of its current lod & where its surviving indices go
+    struct alignas(16) MeshletCullMesh {
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+        uint32_t outputOffset;
+        uint32_t padding;
+    };
+
+    // 128 B, one per scene mesh, indexed by MeshPushConsts::meshIndex
+    struct alignas(16) MeshDrawData {
+        glm::mat4 modelMatrix;
+        // Inverse transpose of the model matrix' 3x3 (w column & row unused), shaders don't invert per vertex
+        glm::mat4 normalMatrix;
+        glm::vec4 localSphere; // xyz: mesh local center, w: radius, for instance culling
+        // Compact vertices: position = inPos.xyz * positionScale.xyz + positionOffset.xyz, identity for full vertices
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+        uint32_t materialIndex;
+        // First instance in the global instance buffer, also the draws' firstInstance
+        uint32_t instanceOffset;
+        uint32_t instanceCount;
+        uint32_t padding;
+    };
+
+    // 48 B, textures referenced by index into the bindless texture array
+    struct alignas(16) MaterialSSBO {
+        glm::vec4 rgba;
+        float metallic;
+        float roughness;
+        float ao;
+        uint32_t usedSamplers;
+        // Indexed by voko_global::MeshSampler::slot, valid when the flag is in usedSamplers
+        // Slots whose flag is in virtualSamplers index the virtual textures instead (vks::VirtualTextureCache)
+        uint32_t textureIndices[voko_global::MESH_SAMPLER_COUNT];
+        uint32_t virtualSamplers;
+    };
+
+    // Per draw, selects the mesh's draw data
+    struct MeshPushConsts {
+        uint32_t meshIndex;
+    };
+
     // mesh properties
     struct alignas(16) MaterialConstants {
         glm::vec4 rgba;
@@ -156,12 +260,13 @@ namespace voko_buffer {
     //
     // };
 
-    // debug switch & offs
-    struct UniformBufferDebug {
+    // debug switch & offs, bound on its own: padded to a std140 block
+    struct alignas(16) UniformBufferDebug {
         uint32_t debugGBuffer = 0; // 0:off, 1:shadow, 2:fragPos, 3:normal, 4:albedo.rgb, 5:albedo.aaa
         uint32_t debugLighting = 0; // 0:off, 1:ambient, 2:diffuse, 3:specular,
     };
 
+    // Cpu side of the scene ds uniform buffers, each member is its own block (voko::sceneUniforms)
     struct UniformBufferScene
     {
         UniformBufferView view;
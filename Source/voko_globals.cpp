@@ -18,28 +18,43 @@ namespace voko_global
     std::vector<VkFramebuffer> frameBuffers;
     // Active frame buffer index
     uint32_t currentBuffer = 0;
+    uint32_t frameSlot = 0;
 
 
     /* Global Color Textures & Depth Stencil */
     SceneColor sceneColor = {VK_NULL_HANDLE,VK_NULL_HANDLE,VK_NULL_HANDLE, VK_FORMAT_UNDEFINED, 0, 0};
 
     VkFormat depthFormat = VK_FORMAT_UNDEFINED;
-    DepthStencil depthStencil = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+    DepthStencil depthStencil = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_FORMAT_UNDEFINED, VK_NULL_HANDLE};
 
     VulkanSwapChain* swapChain = nullptr;
+    vks::DescriptorAllocator* descriptorAllocator = nullptr;
+    vks::JobSystem* jobSystem = nullptr;
 
     // Global scene infos for pass rendering
     std::vector<Mesh*> SceneMeshes;
 
     VkDescriptorSetLayout SceneDescriptorSetLayout = VK_NULL_HANDLE;
     VkDescriptorSet SceneDescriptorSet = VK_NULL_HANDLE;
+    std::array<std::array<uint32_t, SCENE_UNIFORM_BLOCK_COUNT>, FRAME_SLOTS> SceneDynamicOffsets = {};
 
-    VkDescriptorSetLayout PerMeshDescriptorSetLayout = VK_NULL_HANDLE;
-    std::vector<VkDescriptorSet> PerMeshDescriptorSets;
+    VkDescriptorSetLayout MeshDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet MeshDescriptorSet = VK_NULL_HANDLE;
 
     uint32_t width = 1280;
     uint32_t height = 720;
 
+    EOcclusionCulling occlusionCulling = EOcclusionCulling::GPU;
+    bool bInstanceCulling = true;
+    bool bDepthPrepass = false;
+    bool bCompactVertices = true;
+    bool bMeshLods = true;
+    bool bMeshCache = true;
+    bool bTextureCompression = true;
+    bool bComputeMipmaps = false;
+    bool bVirtualTextures = false;
+    bool bMeshletCulling = true;
+
     // IBL
     bool bDisplaySkybox = true;
     vkglTF::Model skybox = vkglTF::Model();
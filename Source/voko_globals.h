@@ -10,16 +10,35 @@ namespace vkglTF {
     class Model;
 }
 class VulkanSwapChain;
+namespace vks {
+    class DescriptorAllocator;
+    class JobSystem;
+}
 
 namespace voko_global
 {
     // Consts & Counts
     constexpr int SPOT_LIGHT_MAX = 3;
     constexpr int DIR_LIGHT_MAX = 4;
-    constexpr int MESH_MAX = 100;
-    constexpr int MESH_SAMPLER_MAX = 12;
-    constexpr int MESH_SAMPLER_COUNT = 2;
+    // Upper bound of the bindless texture array, allocated with the actual texture count
+    constexpr int BINDLESS_TEXTURE_MAX = 4096;
+    // Geometry arena capacity shared by every loaded model, vertices in bytes (any vertex layout), indices in elements
+    constexpr uint32_t GEOMETRY_ARENA_VERTEX_BYTES = 64u << 20;
+    constexpr uint32_t GEOMETRY_ARENA_POSITION_BYTES = 16u << 20;
+    constexpr uint32_t GEOMETRY_ARENA_INDEX_MAX = 4u << 20;
+    // Streamed textures start with their mips of at most this size (texels), finer mips are staged up to the budget per frame
+    constexpr uint32_t TEXTURE_STREAM_TAIL_SIZE = 128;
+    constexpr uint32_t TEXTURE_STREAM_FRAME_BYTES = 8u << 20;
+    // Device memory of all textures, streamed textures that aren't visible lose their finest mips beyond it (lower with VK_EXT_memory_budget)
+    constexpr uint64_t TEXTURE_BUDGET_BYTES = 1536ull << 20;
+    // Virtual texture page cache, pages per side (fixed device memory: (32 * 130)² RGBA8) & decoded pages uploaded per frame
+    constexpr uint32_t VIRTUAL_TEXTURE_CACHE_PAGES = 32;
+    constexpr uint32_t VIRTUAL_TEXTURE_FRAME_PAGES = 32;
     constexpr int SHADOW_MAP_CASCADE_COUNT = 4;
+    // Frames whose uniform copies & pass cmd buffers are kept apart (vks::UniformRing), submitFrame still waits for each
+    constexpr uint32_t FRAME_SLOTS = 2;
+    // Dynamic uniform buffers of the scene ds: view, lighting, debug
+    constexpr uint32_t SCENE_UNIFORM_BLOCK_COUNT = 3;
 
     extern float cascadeSplitLambda;
 
@@ -36,6 +55,8 @@ namespace voko_global
     extern std::vector<VkFramebuffer> frameBuffers;
     // Active frame buffer index
     extern uint32_t currentBuffer;
+    // Frame slot being rendered, or recorded while the passes build their cmd buffers
+    extern uint32_t frameSlot;
 
     /* Global Color Textures & Depth Stencil */
     extern struct SceneColor {
@@ -53,9 +74,15 @@ namespace voko_global
         VkDeviceMemory mem;
         VkImageView view;
         VkFormat format;
+        // Depth aspect only view, for sampling scene depth in shaders
+        VkImageView depthView;
     } depthStencil;
 
     extern VulkanSwapChain* swapChain;
+    // Layouts & sets of the passes (fixed size bindings)
+    extern vks::DescriptorAllocator* descriptorAllocator;
+    // Cpu workers of asset loading & per frame cpu culling
+    extern vks::JobSystem* jobSystem;
 
     
     // Global scene infos for pass rendering
@@ -63,13 +90,46 @@ namespace voko_global
 
     extern VkDescriptorSetLayout SceneDescriptorSetLayout;
     extern VkDescriptorSet SceneDescriptorSet;
+    // Per frame slot, passed whenever the scene ds is bound
+    extern std::array<std::array<uint32_t, SCENE_UNIFORM_BLOCK_COUNT>, FRAME_SLOTS> SceneDynamicOffsets;
 
-    extern VkDescriptorSetLayout PerMeshDescriptorSetLayout;
-    extern std::vector<VkDescriptorSet> PerMeshDescriptorSets;
+    // All meshes' draw data, instances, materials & bindless textures, bound once per pass
+    extern VkDescriptorSetLayout MeshDescriptorSetLayout;
+    extern VkDescriptorSet MeshDescriptorSet;
 
     extern uint32_t width;
     extern uint32_t height;
 
+    // Occlusion culling of geometry pass meshes
+    enum class EOcclusionCulling
+    {
+        None,
+        // Two-phase Hi-Z culling in compute
+        GPU,
+        // Occluder meshes rasterized on cpu worker threads
+        CPU
+    };
+    extern EOcclusionCulling occlusionCulling;
+    // Per instance frustum culling & compaction of instanced geometry pass meshes
+    extern bool bInstanceCulling;
+    // Meshlet (cluster) frustum & backface cone culling of large single instance meshes, loaded with vkglTF::FileLoadingFlags::BuildMeshlets
+    extern bool bMeshletCulling;
+    // Depth only pre-pass before the geometry pass, which then shades with an EQUAL depth test
+    // Set per scene: pays off with high depth complexity, otherwise it's an extra geometry pass
+    extern bool bDepthPrepass;
+    // Scene meshes are loaded quantized (vkglTF::VertexFormat::Compact), their pipelines decode in the vertex shader
+    extern bool bCompactVertices;
+    // Scene meshes are loaded with a simplified LOD chain (vkglTF::FileLoadingFlags::GenerateLods), picked per view by projected size
+    extern bool bMeshLods;
+    // Scene meshes are loaded from cooked binaries next to their glTF files (vkglTF::FileLoadingFlags::CookedCache), written on the first load
+    extern bool bMeshCache;
+    // Scene textures are block compressed on the loading jobs (BC7 color, BC5 normals, BC4 masks), uncompressed without device support
+    extern bool bTextureCompression;
+    // glTF mips are downsampled by compute instead of blits (formats without linear blits always are)
+    extern bool bComputeMipmaps;
+    // Large scene textures are paged through the virtual texture cache instead of streamed whole (vks::VirtualTextureCache)
+    extern bool bVirtualTextures;
+
     // IBL Resources
     extern bool bDisplaySkybox;
     extern vkglTF::Model skybox;
@@ -80,23 +140,35 @@ namespace voko_global
     {
         ALBEDO    = 0x01,   // 0000 0001
         NORMAL    = 0x02,   // 0000 0010
-        METALLIC        = 0x04,   // 0000 0100
-        ROUGHNESS  = 0x08,   // 0000 1000
-        AO = 0x10,    // 0001 0000
+        ORM       = 0x04,   // 0000 0100, packed r: occlusion, g: roughness, b: metallic (vks::packing)
         ALL = 0xff      // 1111 1111
     };
     struct MeshSampler {
-        uint32_t binding;
+        // index into a material's texture indices
+        uint32_t slot;
         EMeshSamplerFlags flag;
     };
 
-    // Declare mesh samplers & their binding pos
+    // Declare mesh samplers & their material texture slot
     constexpr MeshSampler meshSamplers[] = {
-        {2, ALBEDO},
-        {3, NORMAL},
-        {4, METALLIC},
-        {5, ROUGHNESS},
-        {6, AO}
+        {0, ALBEDO},
+        {1, NORMAL},
+        {2, ORM}
+    };
+    constexpr uint32_t MESH_SAMPLER_COUNT = sizeof(meshSamplers) / sizeof(meshSamplers[0]);
+
+    // Mesh ds bindings
+    enum EMeshBinding : uint32_t
+    {
+        MESH_BINDING_DRAW_DATA = 0,
+        MESH_BINDING_INSTANCES = 1,
+        MESH_BINDING_MATERIALS = 2,
+        MESH_BINDING_VISIBLE_INSTANCES = 3,
+        MESH_BINDING_VIRTUAL_TEXTURES = 4,
+        MESH_BINDING_VIRTUAL_PAGE_CACHE = 5,
+        MESH_BINDING_VIRTUAL_FEEDBACK = 6,
+        // Variable count, has to be the last binding
+        MESH_BINDING_TEXTURES = 7
     };
 
 
@@ -1,10 +1,228 @@
 #include "voko.h"
 
+#include <algorithm>
+
+#include "IBLCache.h"
+#include "MeshCache.h"
+#include "voko_globals.h"
+
+namespace
+{
+    // Clamped, the LUT is sampled at its edges
+    VkSamplerCreateInfo lutSamplerCreateInfo()
+    {
+        VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+        samplerCI.magFilter = VK_FILTER_LINEAR;
+        samplerCI.minFilter = VK_FILTER_LINEAR;
+        samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCI.minLod = 0.0f;
+        samplerCI.maxLod = 1.0f;
+        samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        return samplerCI;
+    }
+
+    uint32_t mipCount(uint32_t dim)
+    {
+        return static_cast<uint32_t>(floor(log2(dim))) + 1;
+    }
+
+    // Workgroup size of the cube filtering shaders
+    constexpr uint32_t FILTER_GROUP_SIZE = 8;
+
+    // Push constants of the cube filtering shaders, per level
+    struct FilterPushConsts
+    {
+        float roughness = 0.0f;
+        uint32_t numSamples = 0;
+    };
+
+    // Sampled, written per level through storage views & read back when cached
+    void createFilteredCube(vks::VulkanDevice* vulkanDevice, VkFormat format, uint32_t dim, uint32_t mipLevels, vks::TextureCubeMap& cube)
+    {
+        VkDevice device = vulkanDevice->logicalDevice;
+        VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+        imageCI.imageType = VK_IMAGE_TYPE_2D;
+        imageCI.format = format;
+        imageCI.extent.width = dim;
+        imageCI.extent.height = dim;
+        imageCI.extent.depth = 1;
+        imageCI.mipLevels = mipLevels;
+        imageCI.arrayLayers = 6;
+        imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+        VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &cube.image));
+        VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(device, cube.image, &memReqs);
+        memAlloc.allocationSize = memReqs.size;
+        memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &cube.deviceMemory));
+        cube.memorySize = memAlloc.allocationSize;
+        VK_CHECK_RESULT(vkBindImageMemory(device, cube.image, cube.deviceMemory, 0));
+
+        VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+        viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+        viewCI.format = format;
+        viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 6 };
+        viewCI.image = cube.image;
+        VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &cube.view));
+
+        VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+        samplerCI.magFilter = VK_FILTER_LINEAR;
+        samplerCI.minFilter = VK_FILTER_LINEAR;
+        samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCI.minLod = 0.0f;
+        samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+        samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        cube.sampler = vulkanDevice->getSampler(samplerCI);
+
+        cube.width = dim;
+        cube.height = dim;
+        cube.mipLevels = mipLevels;
+        cube.layerCount = 6;
+        cube.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        cube.device = vulkanDevice;
+        cube.updateDescriptor();
+    }
+
+    // Filters source into every level of target, one dispatch per level covering all six faces (z) through a 2D array storage view
+    // Levels only read the source & are written once, so the dispatches need no barriers between them
+    void filterCube(vks::VulkanDevice* vulkanDevice, VkQueue queue, const vks::TextureCubeMap& source, const vks::TextureCubeMap& target,
+                    VkFormat format, const std::string& shaderFilename, const std::vector<FilterPushConsts>& levelConsts)
+    {
+        VkDevice device = vulkanDevice->logicalDevice;
+        const uint32_t mipLevels = static_cast<uint32_t>(levelConsts.size());
+
+        std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+            // Binding 0: Environment
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            // Binding 1: Target level, every face
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        };
+        VkDescriptorSetLayout descriptorSetLayout = voko_global::descriptorAllocator->getLayout(setLayoutBindings);
+
+        VkPipelineLayout pipelineLayout;
+        VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(FilterPushConsts), 0);
+        VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+        pipelineLayoutCI.pushConstantRangeCount = 1;
+        pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+        VkPipeline pipeline;
+        VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+        pipelineCI.stage = vks::tools::loadShader(shaderFilename, VK_SHADER_STAGE_COMPUTE_BIT, device);
+        VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+        vkDestroyShaderModule(device, pipelineCI.stage.module, nullptr);
+
+        std::vector<VkImageView> levelViews(mipLevels);
+        std::vector<VkDescriptorSet> descriptorSets(mipLevels);
+        VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+        viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        viewCI.format = format;
+        viewCI.image = target.image;
+        for (uint32_t level = 0; level < mipLevels; level++)
+        {
+            viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 6 };
+            VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &levelViews[level]));
+            descriptorSets[level] = voko_global::descriptorAllocator->allocate(descriptorSetLayout);
+            voko_global::descriptorAllocator->update(descriptorSets[level], descriptorSetLayout, {
+                source.descriptor,
+                vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL),
+            });
+        }
+
+        VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+        VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 6 };
+        VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+        imageBarrier.image = target.image;
+        imageBarrier.subresourceRange = subresourceRange;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        for (uint32_t level = 0; level < mipLevels; level++)
+        {
+            const uint32_t levelDim = std::max(1u, target.width >> level);
+            const uint32_t groups = (levelDim + FILTER_GROUP_SIZE - 1) / FILTER_GROUP_SIZE;
+            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[level], 0, nullptr);
+            vkCmdPushConstants(cmdBuf, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FilterPushConsts), &levelConsts[level]);
+            vkCmdDispatch(cmdBuf, groups, groups, 6);
+        }
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+        vulkanDevice->flushCommandBuffer(cmdBuf, queue);
+
+        for (uint32_t level = 0; level < mipLevels; level++)
+        {
+            voko_global::descriptorAllocator->release(descriptorSetLayout, descriptorSets[level]);
+            vkDestroyImageView(device, levelViews[level], nullptr);
+        }
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    }
+}
+
+void voko::precomputeIBL(const std::string& environmentFilename) {
+    // Maps are cached next to the environment, keyed by its content. The BRDF LUT doesn't depend on it & is shared by every environment
+    const std::string shaderPath = getShaderBasePath() + "ibl/";
+    const std::string cachedBase = environmentFilename.substr(0, environmentFilename.rfind('.'));
+    const uint64_t environmentHash = vks::meshcache::hashFile(environmentFilename);
+
+    const std::string lutFilename = getAssetPath() + "textures/hdr/brdf_lut.ktx";
+    const uint64_t lutKey = vks::iblcache::key(0, {static_cast<uint32_t>(iblSettings.lutFormat), iblSettings.lutDim},
+                                               {shaderPath + "genbrdflut.vert.spv", shaderPath + "genbrdflut.frag.spv"});
+    if (vks::iblcache::isCurrent(lutFilename, lutKey)) {
+        iblTextures.lutBrdf.loadFromFile(lutFilename, iblSettings.lutFormat, vulkanDevice, queue);
+        iblTextures.lutBrdf.sampler = vulkanDevice->getSampler(lutSamplerCreateInfo());
+        iblTextures.lutBrdf.updateDescriptor();
+    } else {
+        generateBRDFLUT();
+        vks::iblcache::write(lutFilename, lutKey, iblTextures.lutBrdf.image, iblSettings.lutFormat, iblSettings.lutDim, 1, 1, vulkanDevice, queue);
+    }
+
+    const std::string irradianceFilename = cachedBase + ".irradiance.ktx";
+    const uint64_t irradianceKey = vks::iblcache::key(environmentHash, {static_cast<uint32_t>(iblSettings.irradianceFormat), iblSettings.irradianceDim, iblSettings.irradianceSamples},
+                                                      {shaderPath + "irradiancecube.comp.spv"});
+    if (vks::iblcache::isCurrent(irradianceFilename, irradianceKey)) {
+        iblTextures.irradianceCube.loadFromFile(irradianceFilename, iblSettings.irradianceFormat, vulkanDevice, queue);
+    } else {
+        generateIrradianceCube();
+        vks::iblcache::write(irradianceFilename, irradianceKey, iblTextures.irradianceCube.image, iblSettings.irradianceFormat, iblSettings.irradianceDim,
+                             mipCount(iblSettings.irradianceDim), 6, vulkanDevice, queue);
+    }
+
+    const std::string prefilteredFilename = cachedBase + ".prefiltered.ktx";
+    const uint64_t prefilteredKey = vks::iblcache::key(environmentHash,
+                                                       {static_cast<uint32_t>(iblSettings.prefilteredFormat), iblSettings.prefilteredDim, iblSettings.prefilteredSamples},
+                                                       {shaderPath + "prefilterenvmap.comp.spv"});
+    if (vks::iblcache::isCurrent(prefilteredFilename, prefilteredKey)) {
+        iblTextures.prefilteredCube.loadFromFile(prefilteredFilename, iblSettings.prefilteredFormat, vulkanDevice, queue);
+    } else {
+        generatePrefilteredCube();
+        vks::iblcache::write(prefilteredFilename, prefilteredKey, iblTextures.prefilteredCube.image, iblSettings.prefilteredFormat,
+                             iblSettings.prefilteredDim, mipCount(iblSettings.prefilteredDim), 6, vulkanDevice, queue);
+    }
+}
+
 void voko::generateBRDFLUT() {
     auto tStart = std::chrono::high_resolution_clock::now();
 
-    const VkFormat format = VK_FORMAT_R16G16_SFLOAT; // R16G16 is supported pretty much everywhere
-    const int32_t dim = 512;
+    const VkFormat format = iblSettings.lutFormat;
+    const int32_t dim = static_cast<int32_t>(iblSettings.lutDim);
 
     // Image
     VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
@@ -17,7 +235,8 @@ void voko::generateBRDFLUT() {
     imageCI.arrayLayers = 1;
     imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
     imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // Read back when cached
+    imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &iblTextures.lutBrdf.image));
     VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
     VkMemoryRequirements memReqs;
@@ -25,6 +244,7 @@ void voko::generateBRDFLUT() {
     memAlloc.allocationSize = memReqs.size;
     memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &iblTextures.lutBrdf.deviceMemory));
+    iblTextures.lutBrdf.memorySize = memAlloc.allocationSize;
     VK_CHECK_RESULT(vkBindImageMemory(device, iblTextures.lutBrdf.image, iblTextures.lutBrdf.deviceMemory, 0));
     // Image view
     VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
@@ -37,17 +257,7 @@ void voko::generateBRDFLUT() {
     viewCI.image = iblTextures.lutBrdf.image;
     VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &iblTextures.lutBrdf.view));
     // Sampler
-    VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
-    samplerCI.magFilter = VK_FILTER_LINEAR;
-    samplerCI.minFilter = VK_FILTER_LINEAR;
-    samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.minLod = 0.0f;
-    samplerCI.maxLod = 1.0f;
-    samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &iblTextures.lutBrdf.sampler));
+    iblTextures.lutBrdf.sampler = vulkanDevice->getSampler(lutSamplerCreateInfo());
 
     iblTextures.lutBrdf.descriptor.imageView = iblTextures.lutBrdf.view;
     iblTextures.lutBrdf.descriptor.sampler = iblTextures.lutBrdf.sampler;
@@ -218,397 +428,12 @@ void voko::generateBRDFLUT() {
 void voko::generateIrradianceCube() {
     auto tStart = std::chrono::high_resolution_clock::now();
 
-    const VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    const int32_t dim = 64;
-    const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
-
-    // Pre-filtered cube map
-    // Image
-    VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
-    imageCI.imageType = VK_IMAGE_TYPE_2D;
-    imageCI.format = format;
-    imageCI.extent.width = dim;
-    imageCI.extent.height = dim;
-    imageCI.extent.depth = 1;
-    imageCI.mipLevels = numMips;
-    imageCI.arrayLayers = 6;
-    imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-    VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &iblTextures.irradianceCube.image));
-    VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(device, iblTextures.irradianceCube.image, &memReqs);
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &iblTextures.irradianceCube.deviceMemory));
-    VK_CHECK_RESULT(
-        vkBindImageMemory(device, iblTextures.irradianceCube.image, iblTextures.irradianceCube.deviceMemory, 0));
-    // Image view
-    VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
-    viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-    viewCI.format = format;
-    viewCI.subresourceRange = {};
-    viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewCI.subresourceRange.levelCount = numMips;
-    viewCI.subresourceRange.layerCount = 6;
-    viewCI.image = iblTextures.irradianceCube.image;
-    VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &iblTextures.irradianceCube.view));
-    // Sampler
-    VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
-    samplerCI.magFilter = VK_FILTER_LINEAR;
-    samplerCI.minFilter = VK_FILTER_LINEAR;
-    samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.minLod = 0.0f;
-    samplerCI.maxLod = static_cast<float>(numMips);
-    samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &iblTextures.irradianceCube.sampler));
-
-    iblTextures.irradianceCube.descriptor.imageView = iblTextures.irradianceCube.view;
-    iblTextures.irradianceCube.descriptor.sampler = iblTextures.irradianceCube.sampler;
-    iblTextures.irradianceCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    iblTextures.irradianceCube.device = vulkanDevice;
-
-    // FB, Att, RP, Pipe, etc.
-    VkAttachmentDescription attDesc = {};
-    // Color attachment
-    attDesc.format = format;
-    attDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-    attDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-    VkSubpassDescription subpassDescription = {};
-    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpassDescription.colorAttachmentCount = 1;
-    subpassDescription.pColorAttachments = &colorReference;
-
-    // Use subpass dependencies for layout transitions
-    std::array<VkSubpassDependency, 2> dependencies;
-    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    dependencies[1].srcSubpass = 0;
-    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-    // Renderpass
-    VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
-    renderPassCI.attachmentCount = 1;
-    renderPassCI.pAttachments = &attDesc;
-    renderPassCI.subpassCount = 1;
-    renderPassCI.pSubpasses = &subpassDescription;
-    renderPassCI.dependencyCount = 2;
-    renderPassCI.pDependencies = dependencies.data();
-    VkRenderPass renderpass;
-    VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &renderpass));
-
-    struct {
-        VkImage image;
-        VkImageView view;
-        VkDeviceMemory memory;
-        VkFramebuffer framebuffer;
-    } offscreen;
-
-    // Offfscreen framebuffer
-    {
-        // Color attachment
-        VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageCreateInfo.format = format;
-        imageCreateInfo.extent.width = dim;
-        imageCreateInfo.extent.height = dim;
-        imageCreateInfo.extent.depth = 1;
-        imageCreateInfo.mipLevels = 1;
-        imageCreateInfo.arrayLayers = 1;
-        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreen.image));
-
-        VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements(device, offscreen.image, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits,
-                                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreen.memory));
-        VK_CHECK_RESULT(vkBindImageMemory(device, offscreen.image, offscreen.memory, 0));
-
-        VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-        colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        colorImageView.format = format;
-        colorImageView.flags = 0;
-        colorImageView.subresourceRange = {};
-        colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        colorImageView.subresourceRange.baseMipLevel = 0;
-        colorImageView.subresourceRange.levelCount = 1;
-        colorImageView.subresourceRange.baseArrayLayer = 0;
-        colorImageView.subresourceRange.layerCount = 1;
-        colorImageView.image = offscreen.image;
-        VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreen.view));
-
-        VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-        fbufCreateInfo.renderPass = renderpass;
-        fbufCreateInfo.attachmentCount = 1;
-        fbufCreateInfo.pAttachments = &offscreen.view;
-        fbufCreateInfo.width = dim;
-        fbufCreateInfo.height = dim;
-        fbufCreateInfo.layers = 1;
-        VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreen.framebuffer));
-
-        VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        vks::tools::setImageLayout(
-            layoutCmd,
-            offscreen.image,
-            VK_IMAGE_ASPECT_COLOR_BIT,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
-    }
-
-    // Descriptors
-    VkDescriptorSetLayout descriptorsetlayout;
-    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                                      VK_SHADER_STAGE_FRAGMENT_BIT, 0),
-    };
-    VkDescriptorSetLayoutCreateInfo descriptorsetlayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(
-        setLayoutBindings);
-    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorsetlayoutCI, nullptr, &descriptorsetlayout));
-
-    // Descriptor Pool
-    std::vector<VkDescriptorPoolSize> poolSizes = {
-        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
-    };
-    VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
-    VkDescriptorPool descriptorpool;
-    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorpool));
-
-    // Descriptor sets
-    VkDescriptorSet descriptorset;
-    VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(
-        descriptorpool, &descriptorsetlayout, 1);
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorset));
-    VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(
-        descriptorset, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &iblTextures.environmentCube.descriptor);
-    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
-
-    // Pipeline layout
-    struct PushBlock {
-        glm::mat4 mvp;
-        // Sampling deltas
-        float deltaPhi = (2.0f * float(voko_math::M_PI)) / 180.0f;
-        float deltaTheta = (0.5f * float(voko_math::M_PI)) / 64.0f;
-    } pushBlock;
-
-    VkPipelineLayout pipelinelayout;
-    std::vector<VkPushConstantRange> pushConstantRanges = {
-        vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                                             sizeof(PushBlock), 0),
-    };
-    VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorsetlayout, 1);
-    pipelineLayoutCI.pushConstantRangeCount = 1;
-    pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
-    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelinelayout));
-
-    // Pipeline
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(
-        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-    VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(
-        VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
-    VkPipelineColorBlendAttachmentState blendAttachmentState =
-            vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
-    VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(
-        1, &blendAttachmentState);
-    VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(
-        VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
-    VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1);
-    VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(
-        VK_SAMPLE_COUNT_1_BIT);
-    std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-    VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(
-        dynamicStateEnables);
-    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
-
-    VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelinelayout, renderpass);
-    pipelineCI.pInputAssemblyState = &inputAssemblyState;
-    pipelineCI.pRasterizationState = &rasterizationState;
-    pipelineCI.pColorBlendState = &colorBlendState;
-    pipelineCI.pMultisampleState = &multisampleState;
-    pipelineCI.pViewportState = &viewportState;
-    pipelineCI.pDepthStencilState = &depthStencilState;
-    pipelineCI.pDynamicState = &dynamicState;
-    pipelineCI.stageCount = 2;
-    pipelineCI.pStages = shaderStages.data();
-    pipelineCI.renderPass = renderpass;
-    pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({
-        vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV
-    });
-
-    shaderStages[0] = vks::tools::loadShader(getShaderBasePath() + "ibl/filtercube.vert.spv", VK_SHADER_STAGE_VERTEX_BIT, device);
-    shaderStages[1] = vks::tools::loadShader(getShaderBasePath() + "ibl/irradianceCube.frag.spv",
-                                 VK_SHADER_STAGE_FRAGMENT_BIT, device);
-    VkPipeline pipeline;
-    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
-
-    // Render
-
-    VkClearValue clearValues[1];
-    clearValues[0].color = {{0.0f, 0.0f, 0.2f, 0.0f}};
-
-    VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-    // Reuse render pass from example pass
-    renderPassBeginInfo.renderPass = renderpass;
-    renderPassBeginInfo.framebuffer = offscreen.framebuffer;
-    renderPassBeginInfo.renderArea.extent.width = dim;
-    renderPassBeginInfo.renderArea.extent.height = dim;
-    renderPassBeginInfo.clearValueCount = 1;
-    renderPassBeginInfo.pClearValues = clearValues;
-
-    std::vector<glm::mat4> matrices = {
-        // POSITIVE_X
-        glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-                    glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // NEGATIVE_X
-        glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-                    glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // POSITIVE_Y
-        glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // NEGATIVE_Y
-        glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // POSITIVE_Z
-        glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // NEGATIVE_Z
-        glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-    };
-
-    VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-    VkViewport viewport = vks::initializers::viewport((float) dim, (float) dim, 0.0f, 1.0f);
-    VkRect2D scissor = vks::initializers::rect2D(dim, dim, 0, 0);
-
-    vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-    vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
-
-    VkImageSubresourceRange subresourceRange = {};
-    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subresourceRange.baseMipLevel = 0;
-    subresourceRange.levelCount = numMips;
-    subresourceRange.layerCount = 6;
-
-    // Change image layout for all cubemap faces to transfer destination
-    vks::tools::setImageLayout(
-        cmdBuf,
-        iblTextures.irradianceCube.image,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        subresourceRange);
-
-    for (uint32_t m = 0; m < numMips; m++) {
-        for (uint32_t f = 0; f < 6; f++) {
-            viewport.width = static_cast<float>(dim * std::pow(0.5f, m));
-            viewport.height = static_cast<float>(dim * std::pow(0.5f, m));
-            vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-
-            // Render scene from cube face's point of view
-            vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-            // Update shader push constant block
-            pushBlock.mvp = glm::perspective((float) (voko_math::M_PI / 2.0), 1.0f, 0.1f, 512.0f) * matrices[f];
-
-            vkCmdPushConstants(cmdBuf, pipelinelayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                               sizeof(PushBlock), &pushBlock);
-
-            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelinelayout, 0, 1, &descriptorset, 0,
-                                    NULL);
-
-            voko_global::skybox.draw(cmdBuf);
-
-            vkCmdEndRenderPass(cmdBuf);
-
-            vks::tools::setImageLayout(
-                cmdBuf,
-                offscreen.image,
-                VK_IMAGE_ASPECT_COLOR_BIT,
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-            // Copy region for transfer from framebuffer to cube face
-            VkImageCopy copyRegion = {};
-
-            copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copyRegion.srcSubresource.baseArrayLayer = 0;
-            copyRegion.srcSubresource.mipLevel = 0;
-            copyRegion.srcSubresource.layerCount = 1;
-            copyRegion.srcOffset = {0, 0, 0};
-
-            copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copyRegion.dstSubresource.baseArrayLayer = f;
-            copyRegion.dstSubresource.mipLevel = m;
-            copyRegion.dstSubresource.layerCount = 1;
-            copyRegion.dstOffset = {0, 0, 0};
-
-            copyRegion.extent.width = static_cast<uint32_t>(viewport.width);
-            copyRegion.extent.height = static_cast<uint32_t>(viewport.height);
-            copyRegion.extent.depth = 1;
-
-            vkCmdCopyImage(
-                cmdBuf,
-                offscreen.image,
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                iblTextures.irradianceCube.image,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1,
-                &copyRegion);
-
-            // Transform framebuffer color attachment back
-            vks::tools::setImageLayout(
-                cmdBuf,
-                offscreen.image,
-                VK_IMAGE_ASPECT_COLOR_BIT,
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        }
-    }
-
-    vks::tools::setImageLayout(
-        cmdBuf,
-        iblTextures.irradianceCube.image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        subresourceRange);
-
-    vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-    vkDestroyRenderPass(device, renderpass, nullptr);
-    vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-    vkFreeMemory(device, offscreen.memory, nullptr);
-    vkDestroyImageView(device, offscreen.view, nullptr);
-    vkDestroyImage(device, offscreen.image, nullptr);
-    vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-    vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-    vkDestroyPipeline(device, pipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+    const uint32_t numMips = mipCount(iblSettings.irradianceDim);
+    createFilteredCube(vulkanDevice, iblSettings.irradianceFormat, iblSettings.irradianceDim, numMips, iblTextures.irradianceCube);
+    // Every level holds the whole convolution
+    std::vector<FilterPushConsts> levelConsts(numMips, {0.0f, iblSettings.irradianceSamples});
+    filterCube(vulkanDevice, queue, iblTextures.environmentCube, iblTextures.irradianceCube, iblSettings.irradianceFormat,
+               getShaderBasePath() + "ibl/irradiancecube.comp.spv", levelConsts);
 
     auto tEnd = std::chrono::high_resolution_clock::now();
     auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -620,402 +445,19 @@ void voko::generateIrradianceCube() {
 void voko::generatePrefilteredCube() {
     auto tStart = std::chrono::high_resolution_clock::now();
 
-    const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
-    const int32_t dim = 512;
-    const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
-
-    // Pre-filtered cube map
-    // Image
-    VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
-    imageCI.imageType = VK_IMAGE_TYPE_2D;
-    imageCI.format = format;
-    imageCI.extent.width = dim;
-    imageCI.extent.height = dim;
-    imageCI.extent.depth = 1;
-    imageCI.mipLevels = numMips;
-    imageCI.arrayLayers = 6;
-    imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-    VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &iblTextures.prefilteredCube.image));
-    VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(device, iblTextures.prefilteredCube.image, &memReqs);
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &iblTextures.prefilteredCube.deviceMemory));
-    VK_CHECK_RESULT(
-        vkBindImageMemory(device, iblTextures.prefilteredCube.image, iblTextures.prefilteredCube.deviceMemory, 0));
-    // Image view
-    VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
-    viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-    viewCI.format = format;
-    viewCI.subresourceRange = {};
-    viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewCI.subresourceRange.levelCount = numMips;
-    viewCI.subresourceRange.layerCount = 6;
-    viewCI.image = iblTextures.prefilteredCube.image;
-    VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &iblTextures.prefilteredCube.view));
-    // Sampler
-    VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
-    samplerCI.magFilter = VK_FILTER_LINEAR;
-    samplerCI.minFilter = VK_FILTER_LINEAR;
-    samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCI.minLod = 0.0f;
-    samplerCI.maxLod = static_cast<float>(numMips);
-    samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &iblTextures.prefilteredCube.sampler));
-
-    iblTextures.prefilteredCube.descriptor.imageView = iblTextures.prefilteredCube.view;
-    iblTextures.prefilteredCube.descriptor.sampler = iblTextures.prefilteredCube.sampler;
-    iblTextures.prefilteredCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    iblTextures.prefilteredCube.device = vulkanDevice;
-
-    // FB, Att, RP, Pipe, etc.
-    VkAttachmentDescription attDesc = {};
-    // Color attachment
-    attDesc.format = format;
-    attDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-    attDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-    VkSubpassDescription subpassDescription = {};
-    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpassDescription.colorAttachmentCount = 1;
-    subpassDescription.pColorAttachments = &colorReference;
-
-    // Use subpass dependencies for layout transitions
-    std::array<VkSubpassDependency, 2> dependencies;
-    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    dependencies[1].srcSubpass = 0;
-    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-    // Renderpass
-    VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
-    renderPassCI.attachmentCount = 1;
-    renderPassCI.pAttachments = &attDesc;
-    renderPassCI.subpassCount = 1;
-    renderPassCI.pSubpasses = &subpassDescription;
-    renderPassCI.dependencyCount = 2;
-    renderPassCI.pDependencies = dependencies.data();
-    VkRenderPass renderpass;
-    VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &renderpass));
-
-    struct {
-        VkImage image;
-        VkImageView view;
-        VkDeviceMemory memory;
-        VkFramebuffer framebuffer;
-    } offscreen;
-
-    // Offfscreen framebuffer
-    {
-        // Color attachment
-        VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageCreateInfo.format = format;
-        imageCreateInfo.extent.width = dim;
-        imageCreateInfo.extent.height = dim;
-        imageCreateInfo.extent.depth = 1;
-        imageCreateInfo.mipLevels = 1;
-        imageCreateInfo.arrayLayers = 1;
-        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreen.image));
-
-        VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements(device, offscreen.image, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits,
-                                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreen.memory));
-        VK_CHECK_RESULT(vkBindImageMemory(device, offscreen.image, offscreen.memory, 0));
-
-        VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-        colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        colorImageView.format = format;
-        colorImageView.flags = 0;
-        colorImageView.subresourceRange = {};
-        colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        colorImageView.subresourceRange.baseMipLevel = 0;
-        colorImageView.subresourceRange.levelCount = 1;
-        colorImageView.subresourceRange.baseArrayLayer = 0;
-        colorImageView.subresourceRange.layerCount = 1;
-        colorImageView.image = offscreen.image;
-        VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreen.view));
-
-        VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-        fbufCreateInfo.renderPass = renderpass;
-        fbufCreateInfo.attachmentCount = 1;
-        fbufCreateInfo.pAttachments = &offscreen.view;
-        fbufCreateInfo.width = dim;
-        fbufCreateInfo.height = dim;
-        fbufCreateInfo.layers = 1;
-        VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreen.framebuffer));
-
-        VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        vks::tools::setImageLayout(
-            layoutCmd,
-            offscreen.image,
-            VK_IMAGE_ASPECT_COLOR_BIT,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
-    }
-
-    // Descriptors
-    VkDescriptorSetLayout descriptorsetlayout;
-    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                                      VK_SHADER_STAGE_FRAGMENT_BIT, 0),
-    };
-    VkDescriptorSetLayoutCreateInfo descriptorsetlayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(
-        setLayoutBindings);
-    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorsetlayoutCI, nullptr, &descriptorsetlayout));
-
-    // Descriptor Pool
-    std::vector<VkDescriptorPoolSize> poolSizes = {
-        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
-    };
-    VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
-    VkDescriptorPool descriptorpool;
-    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorpool));
-
-    // Descriptor sets
-    VkDescriptorSet descriptorset;
-    VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(
-        descriptorpool, &descriptorsetlayout, 1);
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorset));
-    VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(
-        descriptorset, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &iblTextures.environmentCube.descriptor);
-    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
-
-    // Pipeline layout
-    struct PushBlock {
-        glm::mat4 mvp;
-        float roughness;
-        uint32_t numSamples = 32u;
-    } pushBlock;
-
-    VkPipelineLayout pipelinelayout;
-    std::vector<VkPushConstantRange> pushConstantRanges = {
-        vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                                             sizeof(PushBlock), 0),
-    };
-    VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorsetlayout, 1);
-    pipelineLayoutCI.pushConstantRangeCount = 1;
-    pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
-    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelinelayout));
-
-    // Pipeline
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(
-        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-    VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(
-        VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
-    VkPipelineColorBlendAttachmentState blendAttachmentState =
-            vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
-    VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(
-        1, &blendAttachmentState);
-    VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(
-        VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
-    VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1);
-    VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(
-        VK_SAMPLE_COUNT_1_BIT);
-    std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-    VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(
-        dynamicStateEnables);
-    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
-
-    VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelinelayout, renderpass);
-    pipelineCI.pInputAssemblyState = &inputAssemblyState;
-    pipelineCI.pRasterizationState = &rasterizationState;
-    pipelineCI.pColorBlendState = &colorBlendState;
-    pipelineCI.pMultisampleState = &multisampleState;
-    pipelineCI.pViewportState = &viewportState;
-    pipelineCI.pDepthStencilState = &depthStencilState;
-    pipelineCI.pDynamicState = &dynamicState;
-    pipelineCI.stageCount = 2;
-    pipelineCI.pStages = shaderStages.data();
-    pipelineCI.renderPass = renderpass;
-    pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({
-        vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV
-    });
-
-    shaderStages[0] = vks::tools::loadShader(getShaderBasePath() + "ibl/filtercube.vert.spv", VK_SHADER_STAGE_VERTEX_BIT, device);
-    shaderStages[1] = vks::tools::loadShader(getShaderBasePath() + "ibl/prefilterenvmap.frag.spv",
-                                 VK_SHADER_STAGE_FRAGMENT_BIT, device);
-    VkPipeline pipeline;
-    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
-
-    // Render
-
-    VkClearValue clearValues[1];
-    clearValues[0].color = {{0.0f, 0.0f, 0.2f, 0.0f}};
-
-    VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-    // Reuse render pass from example pass
-    renderPassBeginInfo.renderPass = renderpass;
-    renderPassBeginInfo.framebuffer = offscreen.framebuffer;
-    renderPassBeginInfo.renderArea.extent.width = dim;
-    renderPassBeginInfo.renderArea.extent.height = dim;
-    renderPassBeginInfo.clearValueCount = 1;
-    renderPassBeginInfo.pClearValues = clearValues;
-
-    std::vector<glm::mat4> matrices = {
-        // POSITIVE_X
-        glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-                    glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // NEGATIVE_X
-        glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-                    glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // POSITIVE_Y
-        glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // NEGATIVE_Y
-        glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // POSITIVE_Z
-        glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-        // NEGATIVE_Z
-        glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-    };
-
-    VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-    VkViewport viewport = vks::initializers::viewport((float) dim, (float) dim, 0.0f, 1.0f);
-    VkRect2D scissor = vks::initializers::rect2D(dim, dim, 0, 0);
-
-    vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-    vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
-
-    VkImageSubresourceRange subresourceRange = {};
-    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subresourceRange.baseMipLevel = 0;
-    subresourceRange.levelCount = numMips;
-    subresourceRange.layerCount = 6;
-
-    // Change image layout for all cubemap faces to transfer destination
-    vks::tools::setImageLayout(
-        cmdBuf,
-        iblTextures.prefilteredCube.image,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        subresourceRange);
-
+    const uint32_t numMips = mipCount(iblSettings.prefilteredDim);
+    createFilteredCube(vulkanDevice, iblSettings.prefilteredFormat, iblSettings.prefilteredDim, numMips, iblTextures.prefilteredCube);
+    // Roughness 0 is a mirror, its single sample is the environment itself
+    std::vector<FilterPushConsts> levelConsts(numMips);
     for (uint32_t m = 0; m < numMips; m++) {
-        pushBlock.roughness = (float) m / (float) (numMips - 1);
-        for (uint32_t f = 0; f < 6; f++) {
-            viewport.width = static_cast<float>(dim * std::pow(0.5f, m));
-            viewport.height = static_cast<float>(dim * std::pow(0.5f, m));
-            vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-
-            // Render scene from cube face's point of view
-            vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-            // Update shader push constant block
-            pushBlock.mvp = glm::perspective((float) (voko_math::M_PI / 2.0), 1.0f, 0.1f, 512.0f) * matrices[f];
-
-            vkCmdPushConstants(cmdBuf, pipelinelayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                               sizeof(PushBlock), &pushBlock);
-
-            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelinelayout, 0, 1, &descriptorset, 0,
-                                    NULL);
-
-            voko_global::skybox.draw(cmdBuf);
-
-            vkCmdEndRenderPass(cmdBuf);
-
-            vks::tools::setImageLayout(
-                cmdBuf,
-                offscreen.image,
-                VK_IMAGE_ASPECT_COLOR_BIT,
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-            // Copy region for transfer from framebuffer to cube face
-            VkImageCopy copyRegion = {};
-
-            copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copyRegion.srcSubresource.baseArrayLayer = 0;
-            copyRegion.srcSubresource.mipLevel = 0;
-            copyRegion.srcSubresource.layerCount = 1;
-            copyRegion.srcOffset = {0, 0, 0};
-
-            copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copyRegion.dstSubresource.baseArrayLayer = f;
-            copyRegion.dstSubresource.mipLevel = m;
-            copyRegion.dstSubresource.layerCount = 1;
-            copyRegion.dstOffset = {0, 0, 0};
-
-            copyRegion.extent.width = static_cast<uint32_t>(viewport.width);
-            copyRegion.extent.height = static_cast<uint32_t>(viewport.height);
-            copyRegion.extent.depth = 1;
-
-            vkCmdCopyImage(
-                cmdBuf,
-                offscreen.image,
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                iblTextures.prefilteredCube.image,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1,
-                &copyRegion);
-
-            // Transform framebuffer color attachment back
-            vks::tools::setImageLayout(
-                cmdBuf,
-                offscreen.image,
-                VK_IMAGE_ASPECT_COLOR_BIT,
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        }
+        levelConsts[m].roughness = (float) m / (float) (numMips - 1);
+        levelConsts[m].numSamples = m == 0 ? 1u : iblSettings.prefilteredSamples;
     }
-
-    vks::tools::setImageLayout(
-        cmdBuf,
-        iblTextures.prefilteredCube.image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        subresourceRange);
-
-    vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-    vkDestroyRenderPass(device, renderpass, nullptr);
-    vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-    vkFreeMemory(device, offscreen.memory, nullptr);
-    vkDestroyImageView(device, offscreen.view, nullptr);
-    vkDestroyImage(device, offscreen.image, nullptr);
-    vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-    vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-    vkDestroyPipeline(device, pipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+    filterCube(vulkanDevice, queue, iblTextures.environmentCube, iblTextures.prefilteredCube, iblSettings.prefilteredFormat,
+               getShaderBasePath() + "ibl/prefilterenvmap.comp.spv", levelConsts);
 
     auto tEnd = std::chrono::high_resolution_clock::now();
     auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
     std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" <<
             std::endl;
 }
-
-
@@ -121,7 +121,8 @@ void voko::setupDepthStencil()
     imageCI.arrayLayers = 1;
     imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
     imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    // Sampled by the Hi-Z pyramid build
+    imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
     VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &voko_global::depthStencil.image));
     VkMemoryRequirements memReqs{};
@@ -149,6 +150,10 @@ void voko::setupDepthStencil()
         imageViewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
     }
     VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &voko_global::depthStencil.view));
+
+    // Sampled views may only contain a single aspect
+    imageViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &voko_global::depthStencil.depthView));
 }
 
 /**
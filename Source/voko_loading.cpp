@@ -0,0 +1,332 @@
+#include "voko.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+
+#include "SpatialStructure/Frustum.h"
+
+vks::JobSystem::Handle voko::loadModel(vkglTF::Model& model, const std::string& filename, uint32_t fileLoadingFlags)
+{
+    vks::VulkanDevice* loadingDevice = vulkanDevice;
+    vks::JobSystem::Handle job = jobSystem->submit([&model, filename, loadingDevice, fileLoadingFlags]()
+    {
+        model.importFile(filename, loadingDevice, fileLoadingFlags);
+    });
+    pendingModels.push_back({ &model, job });
+    return job;
+}
+
+uint32_t voko::modelLoadingFlags(uint32_t baseFlags) const
+{
+    return baseFlags | vkglTF::FileLoadingFlags::OptimizeGeometry | (voko_global::bMeshCache ? vkglTF::FileLoadingFlags::CookedCache : 0);
+}
+
+uint32_t voko::sceneLoadingFlags(uint32_t baseFlags) const
+{
+    return modelLoadingFlags(baseFlags) | vkglTF::FileLoadingFlags::PositionStream
+        | (voko_global::bCompactVertices ? vkglTF::FileLoadingFlags::CompactVertices : 0)
+        | (voko_global::bMeshLods ? vkglTF::FileLoadingFlags::GenerateLods : 0)
+        | (voko_global::bMeshletCulling ? vkglTF::FileLoadingFlags::BuildMeshlets : 0);
+}
+
+vks::JobSystem::Handle voko::loadTexture(vks::Texture2D& texture, const std::string& filename, VkFormat format, vks::compression::TextureContent content)
+{
+    return submitTextureLoad(texture, filename, format, content, [filename](ktxTexture** ktx)
+    {
+        return vks::Texture::loadKTXFile(filename, ktx);
+    });
+}
+
+vks::JobSystem::Handle voko::loadORMTexture(vks::Texture2D& texture, const std::string& cookedFilename, const std::string& occlusionFilename,
+    const std::string& roughnessFilename, const std::string& metallicFilename, const voko_buffer::MaterialConstants& constants)
+{
+    // Channels without a source keep the material's constant
+    const auto toUnorm = [](float value) { return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f)); };
+    const std::array<std::string, vks::packing::ORM_CHANNEL_COUNT> sources = { occlusionFilename, roughnessFilename, metallicFilename };
+    const std::array<uint8_t, vks::packing::ORM_CHANNEL_COUNT> fallbacks = { toUnorm(constants.ao), toUnorm(constants.roughness), toUnorm(constants.metallic) };
+    return submitTextureLoad(texture, cookedFilename, VK_FORMAT_R8G8B8A8_UNORM, vks::compression::TextureContent::Color,
+        [cookedFilename, sources, fallbacks](ktxTexture** ktx)
+    {
+        return vks::packing::loadORM(cookedFilename, sources, fallbacks, ktx);
+    });
+}
+
+vks::JobSystem::Handle voko::submitTextureLoad(vks::Texture2D& texture, const std::string& filename, VkFormat format, vks::compression::TextureContent content,
+    std::function<ktxResult(ktxTexture**)> read)
+{
+    auto pending = std::make_unique<PendingTexture>();
+    pending->texture = &texture;
+    pending->filename = filename;
+    pending->format = voko_global::bTextureCompression ? vks::compression::selectFormat(vulkanDevice, content, format) : format;
+    PendingTexture* target = pending.get();
+    pending->job = jobSystem->submit([target, format, read]()
+    {
+        if (read(&target->ktx) != KTX_SUCCESS)
+        {
+            target->ktx = nullptr;
+            return;
+        }
+        if (target->format == format)
+        {
+            return;
+        }
+        // Encoded next to the read, the uncompressed data is dropped before the upload
+        ktxTexture* compressed = nullptr;
+        if (vks::compression::compressTexture(target->ktx, format, target->format, &compressed) == KTX_SUCCESS)
+        {
+            ktxTexture_Destroy(target->ktx);
+            target->ktx = compressed;
+        }
+        else
+        {
+            std::cerr << "Could not compress texture " << target->filename << ", uploaded uncompressed" << std::endl;
+            target->format = format;
+        }
+    });
+    vks::JobSystem::Handle job = pending->job;
+    pendingTextures.push_back(std::move(pending));
+    return job;
+}
+
+bool voko::isTextureStreaming(const vks::Texture2D& texture) const
+{
+    for (const auto& pending : pendingTextures)
+    {
+        if (pending->texture == &texture)
+        {
+            return true;
+        }
+    }
+    // Page tables until their coarsest page is resident
+    return virtualTextures->isLoading(&texture);
+}
+
+void voko::finishModelLoads()
+{
+    // One batch for every model & the textures read so far
+    vks::UploadBatch batch(vulkanDevice, vkglTF::mipGenerator.get());
+    for (const PendingModel& pending : pendingModels)
+    {
+        jobSystem->wait(pending.job);
+        pending.model->upload(queue, &batch);
+    }
+    pendingModels.clear();
+    uploadReadTextures(batch);
+    batch.flush(queue);
+}
+
+std::vector<vks::Texture2D*> voko::uploadReadTextures(vks::UploadBatch& batch)
+{
+    std::vector<vks::Texture2D*> uploaded;
+    for (auto it = pendingTextures.begin(); it != pendingTextures.end();)
+    {
+        PendingTexture& pending = **it;
+        if (!pending.job.done())
+        {
+            ++it;
+            continue;
+        }
+        if (!pending.ktx)
+        {
+            vks::tools::exitFatal("Could not load texture from " + pending.filename, -1);
+        }
+        pending.texture->loadMipTail(pending.ktx, pending.format, vulkanDevice, batch, voko_global::TEXTURE_STREAM_TAIL_SIZE);
+        if (pending.texture->isStreaming())
+        {
+            streamingTextures.push_back(pending.texture);
+            textureResidency->trackStreamed(pending.texture);
+        }
+        else
+        {
+            textureResidency->track(pending.texture);
+        }
+        uploaded.push_back(pending.texture);
+        it = pendingTextures.erase(it);
+    }
+    return uploaded;
+}
+
+std::vector<vks::Texture2D*> voko::streamTextureMips(vks::UploadBatch& batch)
+{
+    std::vector<vks::Texture2D*> refined;
+    textureResidency->beginFrame();
+    if (streamingTextures.empty())
+    {
+        return refined;
+    }
+
+    // Wanted level per texture from the densest on screen use: texels per model unit (uv assumed to span the bounds once)
+    // over projected pixels per model unit, textures off screen keep their level until the residency evicts it
+    std::unordered_map<vks::Texture2D*, uint32_t> wantedMips;
+    for (vks::Texture2D* texture : streamingTextures)
+    {
+        wantedMips[texture] = texture->residentMip;
+    }
+    const float pixelScale = 0.5f * static_cast<float>(voko_global::height) * std::abs(uniformBufferView.projectionMatrix[1][1]);
+    voko::Frustum frustum;
+    frustum.update(uniformBufferView.projectionMatrix * uniformBufferView.viewMatrix);
+    for (Mesh* mesh : voko_global::SceneMeshes)
+    {
+        float pixelsPerUnit = -1.0f;
+        for (auto meshSampler : voko_global::meshSamplers)
+        {
+            if (!(mesh->meshProperty.usedSamplers & meshSampler.flag))
+            {
+                continue;
+            }
+            auto wanted = wantedMips.find(&mesh->Textures.GetTexture(meshSampler.flag));
+            if (wanted == wantedMips.end())
+            {
+                continue;
+            }
+            if (pixelsPerUnit < 0.0f)
+            {
+                pixelsPerUnit = mesh->get_pixels_per_unit(uniformBufferView.viewMatrix, pixelScale, &frustum);
+            }
+            if (pixelsPerUnit == 0.0f)
+            {
+                continue;
+            }
+            textureResidency->markVisible(wanted->first);
+            const vks::Texture2D* texture = wanted->first;
+            const float texelsPerUnit = static_cast<float>(std::max(texture->width, texture->height)) / std::max(2.0f * mesh->VkGltfModel.dimensions.radius, FLT_MIN);
+            const float texelsPerPixel = texelsPerUnit / pixelsPerUnit;
+            const uint32_t level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+            wanted->second = std::min(wanted->second, level);
+        }
+    }
+
+    // Back under a budget that shrank (other allocations, VK_EXT_memory_budget)
+    textureResidency->reserve(0, batch, refined);
+
+    // One level per texture & pass, textures furthest from their wanted level first, at least one level per frame
+    // Levels are planned first so each texture moves to its new image once
+    std::unordered_map<vks::Texture2D*, uint32_t> targetMips;
+    for (vks::Texture2D* texture : streamingTextures)
+    {
+        targetMips[texture] = texture->residentMip;
+    }
+    std::vector<vks::Texture2D*> candidates(streamingTextures);
+    int64_t budget = voko_global::TEXTURE_STREAM_FRAME_BYTES;
+    std::vector<vks::Texture2D*> planned;
+    VkDeviceSize growth = 0;
+    while (budget > 0)
+    {
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](vks::Texture2D* texture)
+        {
+            return !texture->isStreaming() || targetMips[texture] <= wantedMips[texture];
+        }), candidates.end());
+        if (candidates.empty())
+        {
+            break;
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [&](vks::Texture2D* a, vks::Texture2D* b)
+        {
+            return targetMips[a] - wantedMips[a] > targetMips[b] - wantedMips[b];
+        });
+        for (vks::Texture2D* texture : candidates)
+        {
+            if (budget <= 0)
+            {
+                break;
+            }
+            // Textures that don't fit the memory budget stay at their level this frame
+            uint32_t& target = targetMips[texture];
+            const VkDeviceSize size = texture->getLevelsSize(target - 1) - texture->getLevelsSize(target);
+            if (!textureResidency->reserve(growth + size, batch, refined))
+            {
+                wantedMips[texture] = target;
+                continue;
+            }
+            if (target == texture->residentMip)
+            {
+                planned.push_back(texture);
+            }
+            target--;
+            growth += size;
+            budget -= static_cast<int64_t>(size);
+        }
+    }
+    for (vks::Texture2D* texture : planned)
+    {
+        texture->setResidentMip(targetMips[texture], batch);
+        if (std::find(refined.begin(), refined.end(), texture) == refined.end())
+        {
+            refined.push_back(texture);
+        }
+    }
+
+    streamingTextures.erase(std::remove_if(streamingTextures.begin(), streamingTextures.end(), [](vks::Texture2D* texture)
+    {
+        return !texture->isStreaming();
+    }), streamingTextures.end());
+    return refined;
+}
+
+void voko::streamTextures()
+{
+    if (pendingTextures.empty() && streamingTextures.empty() && virtualTextures->empty())
+    {
+        return;
+    }
+    vks::UploadBatch batch(vulkanDevice, vkglTF::mipGenerator.get());
+    std::vector<vks::Texture2D*> uploaded = uploadReadTextures(batch);
+    const std::vector<vks::Texture2D*> refined = streamTextureMips(batch);
+    // Page tables that became sampleable are enabled like uploaded textures, the last frame's feedback was written by now
+    for (vks::Texture2D* pageTable : virtualTextures->update(batch))
+    {
+        textureResidency->track(pageTable);
+        uploaded.push_back(pageTable);
+    }
+    if (batch.empty())
+    {
+        return;
+    }
+    batch.flush(queue);
+
+    // Last frame is done (submitFrame waits), the update after bind slots & the mapped materials can be rewritten
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+    writeDescriptorSets.reserve(uploaded.size() + refined.size());
+    auto writeSlot = [&](vks::Texture2D* texture)
+    {
+        auto slot = BindlessTextureSlots.find(texture);
+        if (slot == BindlessTextureSlots.end())
+        {
+            return;
+        }
+        BindlessTextures[slot->second] = texture->descriptor;
+        VkWriteDescriptorSet write = vks::initializers::writeDescriptorSet(voko_global::MeshDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            voko_global::MESH_BINDING_TEXTURES, &BindlessTextures[slot->second]);
+        write.dstArrayElement = slot->second;
+        writeDescriptorSets.push_back(write);
+    };
+
+    auto* materials = static_cast<voko_buffer::MaterialSSBO*>(MaterialSSBO.mapped);
+    for (vks::Texture2D* texture : uploaded)
+    {
+        writeSlot(texture);
+
+        // Materials sampled their constants meanwhile
+        for (Mesh* mesh : voko_global::SceneMeshes)
+        {
+            for (auto meshSampler : voko_global::meshSamplers)
+            {
+                if ((mesh->meshProperty.usedSamplers & meshSampler.flag) && &mesh->Textures.GetTexture(meshSampler.flag) == texture)
+                {
+                    materials[mesh->materialIndex].usedSamplers |= meshSampler.flag;
+                }
+            }
+        }
+    }
+    // New views of the resident levels, textures uploaded this frame were already written
+    for (vks::Texture2D* texture : refined)
+    {
+        if (std::find(uploaded.begin(), uploaded.end(), texture) == uploaded.end())
+        {
+            writeSlot(texture);
+        }
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
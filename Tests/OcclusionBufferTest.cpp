@@ -0,0 +1,192 @@
+//
+// Cpu occlusion culling without a gpu: known occluder / occludee cases & rasterize / test timings
+// Built once per rasterizer path (scalar, AVX2), see Tests/CMakeLists.txt
+//   <target>                        run the cases
+//   <target> --benchmark [frames]   time a random scene after the cases
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "JobSystem.h"
+#include "SpatialStructure/OcclusionBuffer.h"
+
+namespace {
+
+    // ctest SKIP_RETURN_CODE
+    constexpr int SKIP = 77;
+
+    constexpr uint32_t WIDTH = 64;
+    constexpr uint32_t HEIGHT = 64;
+
+    int failures = 0;
+
+    void check(bool condition, const char* name)
+    {
+        std::printf("%s %s\n", condition ? "pass" : "FAIL", name);
+        if (!condition)
+        {
+            failures++;
+        }
+    }
+
+    // Pixel coordinate to ndc, the cases are set up on the pixel grid
+    float ndcX(float px) { return px / WIDTH * 2.0f - 1.0f; }
+    float ndcY(float py) { return py / HEIGHT * 2.0f - 1.0f; }
+
+    // Screen aligned quad, z per corner: (x0, y0), (x1, y0), (x1, y1), (x0, y1)
+    void addQuad(voko::OcclusionBuffer& buffer, float x0, float y0, float x1, float y1, float z00, float z10, float z11, float z01)
+    {
+        const std::vector<glm::vec3> positions = {
+            glm::vec3(ndcX(x0), ndcY(y0), z00),
+            glm::vec3(ndcX(x1), ndcY(y0), z10),
+            glm::vec3(ndcX(x1), ndcY(y1), z11),
+            glm::vec3(ndcX(x0), ndcY(y1), z01) };
+        const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+        // Positions are already in clip space (w = 1)
+        buffer.addOccluder(glm::mat4(1.0f), positions, indices);
+    }
+
+    voko::AABB box(float x0, float y0, float x1, float y1, float z0, float z1)
+    {
+        return { glm::vec3(ndcX(x0), ndcY(y0), z0), glm::vec3(ndcX(x1), ndcY(y1), z1) };
+    }
+
+    void runCases()
+    {
+        const glm::mat4 viewProj(1.0f);
+        voko::OcclusionBuffer buffer(WIDTH, HEIGHT, 2);
+
+        // Flat occluder over pixels [16, 48) at depth 0.5
+        // Pixels along the diagonal are only partly covered by either triangle & stay open, culled boxes sit below it
+        addQuad(buffer, 16.0f, 16.0f, 48.0f, 48.0f, 0.5f, 0.5f, 0.5f, 0.5f);
+        buffer.rasterize();
+        check(!buffer.isVisible(viewProj, box(32.0f, 18.0f, 44.0f, 28.0f, 0.7f, 0.8f)), "box behind occluder is culled");
+        check(buffer.isVisible(viewProj, box(20.0f, 20.0f, 40.0f, 40.0f, 0.7f, 0.8f)), "box behind a shared edge is visible");
+        check(buffer.isVisible(viewProj, box(20.0f, 20.0f, 40.0f, 40.0f, 0.2f, 0.3f)), "box in front of occluder is visible");
+        check(buffer.isVisible(viewProj, box(20.0f, 20.0f, 40.0f, 40.0f, 0.4f, 0.8f)), "box intersecting occluder is visible");
+        check(buffer.isVisible(viewProj, box(40.0f, 20.0f, 56.0f, 40.0f, 0.7f, 0.8f)), "box sticking out of occluder is visible");
+        check(buffer.isVisible(viewProj, box(2.0f, 2.0f, 10.0f, 10.0f, 0.7f, 0.8f)), "box beside occluder is visible");
+        check(!buffer.isVisible(viewProj, box(-40.0f, 20.0f, -20.0f, 40.0f, 0.2f, 0.3f)), "box off screen is culled");
+        check(buffer.isVisible(viewProj, box(20.0f, 20.0f, 40.0f, 40.0f, -0.5f, 0.8f)), "box crossing the near plane is visible");
+
+        // Left edge inside pixel 15: its center is covered, the box only overlaps the uncovered part
+        buffer.clear();
+        addQuad(buffer, 15.4f, 16.0f, 48.0f, 48.0f, 0.5f, 0.5f, 0.5f, 0.5f);
+        buffer.rasterize();
+        check(buffer.isVisible(viewProj, box(15.1f, 20.0f, 15.3f, 40.0f, 0.7f, 0.8f)), "box behind a partly covered edge pixel is visible");
+        check(!buffer.isVisible(viewProj, box(32.0f, 18.0f, 44.0f, 28.0f, 0.7f, 0.8f)), "box behind fully covered pixels is culled");
+
+        // Depth rising along x: 0.49375 at the center of pixel 31, 0.5 at its far side
+        buffer.clear();
+        addQuad(buffer, 16.0f, 16.0f, 48.0f, 48.0f, 0.3f, 0.7f, 0.7f, 0.3f);
+        buffer.rasterize();
+        check(buffer.isVisible(viewProj, box(31.0f, 18.0f, 31.0f, 26.0f, 0.497f, 0.6f)), "box within a sloped pixel's depth range is visible");
+        check(!buffer.isVisible(viewProj, box(31.0f, 18.0f, 31.0f, 26.0f, 0.51f, 0.6f)), "box behind a sloped pixel is culled");
+
+        // Batch test matches single tests
+        const std::vector<voko::AABB> boxes = {
+            box(31.0f, 18.0f, 31.0f, 26.0f, 0.51f, 0.6f),
+            box(20.0f, 20.0f, 40.0f, 40.0f, 0.1f, 0.2f) };
+        std::vector<uint8_t> visible;
+        buffer.testVisibility(viewProj, boxes, visible);
+        check(visible.size() == 2 && visible[0] == 0 && visible[1] == 1, "batch test matches single tests");
+        check(buffer.get_stats().testedBoxes == 2 && buffer.get_stats().occludedBoxes == 1, "batch test stats");
+
+        // Bands & chunks as jobs, driven from a job like CpuOcclusionCulling does
+        vks::JobSystem jobSystem(2);
+        voko::OcclusionBuffer jobBuffer(WIDTH, HEIGHT, 4, &jobSystem);
+        std::vector<uint8_t> jobVisible;
+        jobSystem.wait(jobSystem.submit([&]() {
+            addQuad(jobBuffer, 16.0f, 16.0f, 48.0f, 48.0f, 0.3f, 0.7f, 0.7f, 0.3f);
+            jobBuffer.rasterize();
+            jobBuffer.testVisibility(viewProj, boxes, jobVisible);
+        }));
+        check(jobBuffer.get_depth() == buffer.get_depth() && jobVisible == visible, "job system path matches threads");
+    }
+
+    void runBenchmark(uint32_t frames)
+    {
+        // Default resolution, random walls & props in front of & behind them
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        const uint32_t occluderCount = 256;
+        const uint32_t boxCount = 16384;
+
+        voko::OcclusionBuffer buffer;
+        const float width = static_cast<float>(buffer.get_width());
+        const float height = static_cast<float>(buffer.get_height());
+        std::vector<voko::AABB> boxes(boxCount);
+        for (auto& b : boxes)
+        {
+            const glm::vec3 center(unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f, 0.05f + unit(random) * 0.9f);
+            const glm::vec3 extent(unit(random) * 0.05f, unit(random) * 0.05f, unit(random) * 0.02f);
+            b = { center - extent, center + extent };
+        }
+
+        double rasterizeMs = 0.0;
+        double testMs = 0.0;
+        uint32_t occluded = 0;
+        std::vector<uint8_t> visible;
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            buffer.clear();
+            std::mt19937 frameRandom(frame);
+            for (uint32_t i = 0; i < occluderCount; i++)
+            {
+                const float x = unit(frameRandom) * width;
+                const float y = unit(frameRandom) * height;
+                const float w = 8.0f + unit(frameRandom) * 64.0f;
+                const float h = 8.0f + unit(frameRandom) * 64.0f;
+                const float z = 0.1f + unit(frameRandom) * 0.8f;
+                const std::vector<glm::vec3> positions = {
+                    glm::vec3(x / width * 2.0f - 1.0f, y / height * 2.0f - 1.0f, z),
+                    glm::vec3((x + w) / width * 2.0f - 1.0f, y / height * 2.0f - 1.0f, z + 0.05f),
+                    glm::vec3((x + w) / width * 2.0f - 1.0f, (y + h) / height * 2.0f - 1.0f, z + 0.05f),
+                    glm::vec3(x / width * 2.0f - 1.0f, (y + h) / height * 2.0f - 1.0f, z) };
+                buffer.addOccluder(glm::mat4(1.0f), positions, { 0, 1, 2, 0, 2, 3 });
+            }
+            buffer.rasterize();
+            buffer.testVisibility(glm::mat4(1.0f), boxes, visible);
+            rasterizeMs += buffer.get_stats().rasterizeMs;
+            testMs += buffer.get_stats().testMs;
+            occluded += buffer.get_stats().occludedBoxes;
+        }
+
+        std::printf("%s %ux%u, %u frames: %u occluder triangles, %u boxes, %.1f%% occluded\n", voko::OcclusionBuffer::get_simd_name(),
+            buffer.get_width(), buffer.get_height(), frames, occluderCount * 2, boxCount, 100.0 * occluded / (double(frames) * boxCount));
+        std::printf("rasterize %.3f ms, test %.3f ms per frame\n", rasterizeMs / frames, testMs / frames);
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+#if defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__))
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        std::printf("AVX2 isn't supported by this cpu, skipped\n");
+        return SKIP;
+    }
+#endif
+    std::printf("Occlusion buffer path: %s\n", voko::OcclusionBuffer::get_simd_name());
+    runCases();
+
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+    {
+        const uint32_t frames = argc > 2 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[2]))) : 100;
+        runBenchmark(frames);
+    }
+
+    if (failures > 0)
+    {
+        std::printf("%d case(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}